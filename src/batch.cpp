@@ -0,0 +1,1233 @@
+﻿/// @file batch.cpp
+///
+/// @brief バッチモード
+///
+#include "batch.h"
+#include <wx/filename.h>
+#include <wx/dir.h>
+#include <wx/msgout.h>
+#include "config.h"
+#include "parse_l3s1basic.h"
+#include "parse_msxbasic.h"
+#include "watchfolder.h"
+#include "parseserver.h"
+#include "version.h"
+
+#define OPTION_VERBOSE "verbose"
+#define OPTION_OUTPUT "output"
+#define OPTION_TYPE "type"
+#define OPTION_MACHINE "machine"
+#define OPTION_BASIC "basic"
+#define OPTION_DIAG "diag"
+#define OPTION_DIAG_LIMIT "diag-limit"
+#define OPTION_STATS "stats"
+#define OPTION_PIPELINE "pipeline"
+#define OPTION_TAPE_LIST "tape-list"
+#define OPTION_TAPE_EXTRACT "tape-extract"
+#define OPTION_TAPE_FILES "tape-files"
+#define OPTION_TAPE_VERIFY "tape-verify"
+#define OPTION_DISK_LIST "disk-list"
+#define OPTION_DISK_EXTRACT "disk-extract"
+#define OPTION_DISK_IMAGE "disk-image"
+#define OPTION_DISK_DELETE "disk-delete"
+#define OPTION_WAV_RATE "wav-rate"
+#define OPTION_WAV_BITS "wav-bits"
+#define OPTION_WAV_BAUD "wav-baud"
+#define OPTION_WATCH "watch"
+#define OPTION_WATCH_SETTLE "watch-settle"
+#define OPTION_SERVE "serve"
+#define OPTION_SERVE_THREADS "serve-threads"
+
+BasicBatch::BasicBatch()
+{
+	batch_mode = false;
+	diag_limit = -1;
+	show_stats = false;
+	use_pipeline = false;
+	tape_list = false;
+	tape_verify = false;
+	disk_list = false;
+	wave_rate = -1;
+	wave_bits = -1;
+	wave_baud = -1;
+	watch_mode = false;
+	watch_settle = WATCH_FOLDER_SETTLE_MSEC;
+	serve_threads = 0;
+}
+
+/// 設定ファイルとリソースのパスを設定
+/// @param[in] ini 設定ファイル 監視フォルダで書き換えを調べる
+/// @param[in] res データと言語ファイルがあるディレクトリ
+void BasicBatch::SetPaths(const wxString &ini, const wxString &res)
+{
+	ini_file = ini;
+	res_path = res;
+}
+
+/// コマンドラインのオプションを設定
+/// @param[in] parser パーサー
+void BasicBatch::InitCmdLine(wxCmdLineParser &parser)
+{
+	// the standard command line options
+	static const wxCmdLineEntryDesc cmdLineDesc[] = {
+		{
+			wxCMD_LINE_SWITCH, "h", "help",
+			"show this help message",
+			wxCMD_LINE_VAL_NONE,
+			wxCMD_LINE_OPTION_HELP
+		},
+
+#if wxUSE_LOG
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_VERBOSE,
+			"generate verbose log messages",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+#endif // wxUSE_LOG
+		{
+			wxCMD_LINE_OPTION, "o", OPTION_OUTPUT,
+			"convert without window and write to file (or directory)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, "t", OPTION_TYPE,
+			"output type: bin, bintape, binwav, bindisk, ascii, asciitape, asciiwav, asciidisk, utf8 (default)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, "m", OPTION_MACHINE,
+			"machine: l3s1, msx",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, "b", OPTION_BASIC,
+			"basic type",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_DIAG,
+			"write diagnostics to file (.jsonl or .csv)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_DIAG_LIMIT,
+			"stop converting a file after this many errors (0: never stop)",
+			wxCMD_LINE_VAL_NUMBER,
+			0x0
+		},
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_STATS,
+			"print time and throughput of each stage after converting",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_PIPELINE,
+			"export binary to text through decode/convert/write threads",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_TAPE_LIST,
+			"list files in tape images (L3/S1, or MSX .cas with -m msx)",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_TAPE_EXTRACT,
+			"extract files in tape images to directory",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_TAPE_VERIFY,
+			"check block checksums in L3/S1 tape images without converting",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_TAPE_FILES,
+			"file numbers to extract (e.g. 1,3-5, default all)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_DISK_LIST,
+			"list files in disk images (L3/S1 D88, or MSX DSK with -m msx; directories are searched)",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_DISK_EXTRACT,
+			"extract files in disk images to directory (file numbers by --tape-files)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_DISK_IMAGE,
+			"write converted files into this existing disk image (L3/S1 D88 or MSX DSK, bindisk or asciidisk)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_DISK_DELETE,
+			"delete files in disk images (e.g. 1,3-5)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_WAV_RATE,
+			"sample rate of L3/S1 tape audio output (default 44100)",
+			wxCMD_LINE_VAL_NUMBER,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_WAV_BITS,
+			"sample bits of L3/S1 tape audio output, 8 or 16 (default 8)",
+			wxCMD_LINE_VAL_NUMBER,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_WAV_BAUD,
+			"baud rate of L3/S1 tape audio (default 600)",
+			wxCMD_LINE_VAL_NUMBER,
+			0x0
+		},
+		{
+			wxCMD_LINE_SWITCH, NULL, OPTION_WATCH,
+			"keep running and convert new or changed files in the input directories into the -o directory",
+			wxCMD_LINE_VAL_NONE,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_WATCH_SETTLE,
+			"milliseconds a watched file must stay unchanged before converting (default 500)",
+			wxCMD_LINE_VAL_NUMBER,
+			0x0
+		},
+#ifdef USE_PARSE_SERVER
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_SERVE,
+			"keep running and convert requests sent to the unix domain socket SOCKET (-t and -m set the defaults)",
+			wxCMD_LINE_VAL_STRING,
+			0x0
+		},
+		{
+			wxCMD_LINE_OPTION, NULL, OPTION_SERVE_THREADS,
+			"number of requests converted at the same time by --serve (default: number of CPUs)",
+			wxCMD_LINE_VAL_NUMBER,
+			0x0
+		},
+#endif
+	    {
+			wxCMD_LINE_PARAM, NULL, NULL,
+			"input file",
+			wxCMD_LINE_VAL_STRING,
+			wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE
+		},
+
+		// terminator
+		wxCMD_LINE_DESC_END
+	};
+
+	parser.SetDesc(cmdLineDesc);
+}
+
+/// コマンドラインを解釈する
+///
+/// 出力先やテープ、ディスクイメージの操作を指定した場合はバッチモードにする。
+/// @param[in] parser パーサー
+/// @return パラメータエラーの場合false
+bool BasicBatch::CmdLineParsed(wxCmdLineParser &parser)
+{
+#if wxUSE_LOG
+	if ( parser.Found(OPTION_VERBOSE) ) {
+		wxLog::SetVerbose(true);
+	}
+#endif // wxUSE_LOG
+	for(size_t i=0; i<parser.GetParamCount(); i++) {
+		in_files.Add(parser.GetParam(i));
+	}
+
+	// batch mode
+	batch_mode = parser.Found(OPTION_OUTPUT, &out_path);
+	parser.Found(OPTION_TYPE, &out_type);
+	parser.Found(OPTION_MACHINE, &machine_name);
+	parser.Found(OPTION_BASIC, &basic_type);
+	parser.Found(OPTION_DIAG, &diag_file);
+	parser.Found(OPTION_DIAG_LIMIT, &diag_limit);
+	show_stats = parser.Found(OPTION_STATS);
+	use_pipeline = parser.Found(OPTION_PIPELINE);
+	tape_list = parser.Found(OPTION_TAPE_LIST);
+	tape_verify = parser.Found(OPTION_TAPE_VERIFY);
+	parser.Found(OPTION_TAPE_EXTRACT, &tape_extract_dir);
+	parser.Found(OPTION_TAPE_FILES, &tape_files);
+	disk_list = parser.Found(OPTION_DISK_LIST);
+	parser.Found(OPTION_DISK_EXTRACT, &disk_extract_dir);
+	parser.Found(OPTION_DISK_IMAGE, &disk_image);
+	parser.Found(OPTION_DISK_DELETE, &disk_delete);
+	parser.Found(OPTION_WAV_RATE, &wave_rate);
+	parser.Found(OPTION_WAV_BITS, &wave_bits);
+	parser.Found(OPTION_WAV_BAUD, &wave_baud);
+	watch_mode = parser.Found(OPTION_WATCH);
+	parser.Found(OPTION_WATCH_SETTLE, &watch_settle);
+#ifdef USE_PARSE_SERVER
+	parser.Found(OPTION_SERVE, &serve_path);
+	parser.Found(OPTION_SERVE_THREADS, &serve_threads);
+	if (!serve_path.IsEmpty()) {
+		// 入力ファイルはソケットで受け取る
+		batch_mode = true;
+		return true;
+	}
+#endif
+	if (watch_mode && out_path.IsEmpty()) {
+		wxMessageOutputStderr().Printf(_T("%s\n"), _("Specify the output directory with -o."));
+		return false;
+	}
+	if (tape_list || tape_verify || !tape_extract_dir.IsEmpty()) {
+		batch_mode = true;
+	}
+	if (disk_list || !disk_extract_dir.IsEmpty() || !disk_delete.IsEmpty() || !disk_image.IsEmpty()) {
+		batch_mode = true;
+	}
+	if (batch_mode && in_files.Count() == 0) {
+		wxMessageOutputStderr().Printf(_T("%s\n"), _("No input file."));
+		return false;
+	}
+	return true;
+}
+
+/// バッチモードで変換する
+/// @return 0:成功 1:変換に失敗したファイルあり 2:パラメータエラー
+int BasicBatch::Run()
+{
+	wxMessageOutputStderr out;
+
+	if (tape_list || tape_verify || !tape_extract_dir.IsEmpty()) {
+		return RunTapeArchive();
+	}
+	if (disk_list || !disk_extract_dir.IsEmpty() || !disk_delete.IsEmpty()) {
+		return RunDiskImage();
+	}
+
+	// output type
+	if (out_type.IsEmpty()) {
+		out_type = (disk_image.IsEmpty() ? _T("utf8") : _T("bindisk"));
+	}
+	int out_flags = ParseCollection::FindTypeFlags(out_type);
+	if (out_flags < 0) {
+		out.Printf(_T("%s: %s\n"), _("Unknown output type"), out_type);
+		return 2;
+	}
+	if (!disk_image.IsEmpty() && (out_flags & psDiskImage) == 0) {
+		out.Printf(_T("%s: %s\n"), _("Use bindisk or asciidisk to write into a disk image"), out_type);
+		return 2;
+	}
+
+	// machine
+	int machine = gConfig.GetCurrentMachine();
+	if (!machine_name.IsEmpty()) {
+		machine = ParseCollection::FindMachine(machine_name);
+		if (machine < 0) {
+			out.Printf(_T("%s: %s\n"), _("Unknown machine"), machine_name);
+			return 2;
+		}
+	}
+
+	// initialize
+	ParseCollection coll;
+	coll.SetAppPath(res_path);
+	coll.Set(eL3S1Basic, new ParseL3S1Basic(&coll));
+	coll.Set(eMSXBasic, new ParseMSXBasic(&coll));
+	for(int i=0; i<eMachineCount; i++) {
+		if (!(coll.Get(i)->Init())) {
+			return 2;
+		}
+	}
+	Parse *ps = coll.Get(machine);
+
+	// テープの音声の形式
+	ParseL3S1Basic *l3ps = (ParseL3S1Basic *)coll.Get(eL3S1Basic);
+	L3WaveParam wave_param = l3ps->GetWaveParam();
+	if (wave_rate > 0) wave_param.mSampleRate = (int)wave_rate;
+	if (wave_bits > 0) wave_param.mSampleBits = (int)wave_bits;
+	if (wave_baud > 0) {
+		// 周波数はボーレートに合わせる
+		wave_param.mFreq0 = wave_param.mFreq0 * (int)wave_baud / wave_param.mBaud;
+		wave_param.mFreq1 = wave_param.mFreq1 * (int)wave_baud / wave_param.mBaud;
+		wave_param.mLeaderBits = wave_param.mLeaderBits * (int)wave_baud / wave_param.mBaud;
+		wave_param.mTrailerBits = wave_param.mTrailerBits * (int)wave_baud / wave_param.mBaud;
+		wave_param.mBaud = (int)wave_baud;
+	}
+	l3ps->SetWaveParam(wave_param);
+#ifdef USE_PARSE_SERVER
+	if (!serve_path.IsEmpty()) {
+		return RunServe(machine, out_flags, wave_param);
+	}
+#endif
+	if (!disk_image.IsEmpty() && !ps->CanExportDiskImage()) {
+		out.Printf(_T("%s: %s\n"), _("Disk image output is not supported"), ps->GetMachineName());
+		return 2;
+	}
+	if (out_flags & psWaveAudio) {
+		if (!ps->CanExportTapeAudio()) {
+			out.Printf(_T("%s: %s\n"), _("Audio output is not supported"), ps->GetMachineName());
+			return 2;
+		}
+		if (!wave_param.IsValidForOutput()) {
+			out.Printf(_T("%s\n"), _("Invalid audio parameters."));
+			return 2;
+		}
+	}
+
+	// diagnostics
+	ParseResultSink *sink = NULL;
+	if (!diag_file.IsEmpty()) {
+		sink = ParseResultSink::Create(diag_file);
+		if (!sink) {
+			out.Printf(_T("%s: %s\n"), _("Cannot open file."), diag_file);
+			return 2;
+		}
+	}
+	ps->SetResultSink(sink, (int)diag_limit);
+	ps->SetPipelineMode(use_pipeline);
+
+	int rc = 0;
+	if (watch_mode) {
+		rc = RunWatch(ps, out_flags);
+	} else {
+		for(size_t i=0; i<in_files.Count(); i++) {
+			if (!ExportBatchFile(ps, in_files[i], out_flags)) {
+				rc = 1;
+			}
+		}
+	}
+
+	ps->SetResultSink(NULL);
+	if (show_stats) {
+		wxArrayString lines;
+#ifdef USE_PARSE_STATS
+		ps->GetStats().Report(lines);
+#else
+		lines.Add(_T("statistics are not compiled in."));
+#endif
+		for(size_t i=0; i<lines.Count(); i++) {
+			out.Printf(_T("%s\n"), lines[i]);
+		}
+	}
+	if (sink) {
+		// エラーコードごとの件数
+		out.Printf(_T("%s: %u\n"), diag_file, (unsigned)sink->GetCount());
+		for(int code = 0; code < prErrCodeCount; code++) {
+			size_t cnt = sink->GetCodeCount((PrErrCode)code);
+			if (cnt > 0) {
+				out.Printf(_T("  %s: %u\n"), ParseResultSink::CodeName((PrErrCode)code), (unsigned)cnt);
+			}
+		}
+		sink->Close();
+		delete sink;
+	}
+
+	return rc;
+}
+
+/// 監視フォルダに置かれたファイルを変換し続ける
+///
+/// パーサーとコードテーブルは初期化したものを使い続ける。
+/// 書き込みが終わってから変換し、内容が前に変換したときと同じファイルは変換しない。
+/// 設定ファイルが書き換えられたら読み直し、すべてのファイルを変換しなおせるようにする。
+/// SIGINT/SIGTERMで終わる。
+/// @param[in] ps        パーサー
+/// @param[in] out_flags 出力形式
+/// @return 0:成功 1:変換に失敗したファイルあり 2:パラメータエラー
+int BasicBatch::RunWatch(Parse *ps, int out_flags)
+{
+	wxMessageOutputStderr out;
+
+	for(size_t i=0; i<in_files.Count(); i++) {
+		if (!wxFileName::DirExists(in_files[i])) {
+			out.Printf(_T("%s: %s\n"), _("Not a directory"), in_files[i]);
+			return 2;
+		}
+	}
+	if (!wxFileName::DirExists(out_path)) {
+		if (!wxFileName::Mkdir(out_path, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+			out.Printf(_T("%s: %s\n"), _("Cannot create directory."), out_path);
+			return 2;
+		}
+	}
+
+	WatchFolder watch;
+	if (!watch.Open(in_files, out_path, (int)watch_settle)) {
+		out.Printf(_T("%s\n"), _("Cannot watch the input directories."));
+		return 2;
+	}
+	watch.LoadState(wxFileName(out_path, WATCH_FOLDER_STATE_FILE).GetFullPath());
+	WatchFolder::CatchStopSignals();
+
+	wxDateTime ini_time;
+	if (wxFileName::FileExists(ini_file)) {
+		ini_time = wxFileName(ini_file).GetModificationTime();
+	}
+
+	int rc = 0;
+	while(!WatchFolder::IsStopRequested()) {
+		wxArrayString ready;
+		if (!watch.Wait(ready, 1000)) {
+			out.Printf(_T("%s\n"), _("Cannot watch the input directories."));
+			rc = 2;
+			break;
+		}
+
+		// 設定が変わったら読み直す パーサーは同じ設定を参照している
+		if (wxFileName::FileExists(ini_file)) {
+			wxDateTime t = wxFileName(ini_file).GetModificationTime();
+			if (t.IsValid() && (!ini_time.IsValid() || t != ini_time)) {
+				ini_time = t;
+				gConfig.Load();
+				watch.ForgetHashes();
+				out.Printf(_T("%s: %s\n"), ini_file, _("reloaded"));
+			}
+		}
+
+		bool converted = false;
+		for(size_t i=0; i<ready.Count(); i++) {
+			wxULongLong hash;
+			if (!watch.HashFile(ready[i], hash) || watch.IsConverted(ready[i], hash)) {
+				continue;
+			}
+			// サブディレクトリの同じ名前のファイルを上書きしないよう、出力先にも同じ構成で作る
+			// 変換できたものだけ覚える
+			if (!ExportBatchFile(ps, ready[i], out_flags, watch.GetRelativeDir(ready[i]))) {
+				rc = 1;
+				continue;
+			}
+			watch.Remember(ready[i], hash);
+			converted = true;
+		}
+		if (converted && !watch.SaveState()) {
+			out.Printf(_T("%s: %s\n"), _("Cannot write file."), WATCH_FOLDER_STATE_FILE);
+		}
+	}
+	watch.Close();
+	return rc;
+}
+
+#ifdef USE_PARSE_SERVER
+/// Unixドメインソケットで受け付けた変換要求を処理し続ける
+///
+/// パーサーの組はスレッドの数だけ初期化しておき、要求ごとに作り直さない。
+/// SIGINT/SIGTERMで終わる。
+/// @param[in] machine    要求で指定しない場合の機種
+/// @param[in] out_flags  要求で指定しない場合の出力形式
+/// @param[in] wave_param テープの音声の形式
+/// @return 0:成功 2:パラメータエラーかソケットを使えない
+int BasicBatch::RunServe(int machine, int out_flags, const L3WaveParam &wave_param)
+{
+	wxMessageOutputStderr out;
+
+	if (out_flags & psDiskImage) {
+		out.Printf(_T("%s: %s\n"), _("Disk image output is not supported"), out_type);
+		return 2;
+	}
+
+	ParseServer server;
+	if (!server.Open(serve_path, (int)serve_threads, res_path)) {
+		out.Printf(_T("%s: %s\n"), _("Cannot open the socket."), serve_path);
+		return 2;
+	}
+	server.SetDefaults(machine, out_flags, (int)diag_limit);
+	server.SetWaveParam(wave_param);
+	if (!server.Start()) {
+		out.Printf(_T("%s\n"), _("Cannot start threads."));
+		return 2;
+	}
+	WatchFolder::CatchStopSignals();
+	out.Printf(_T("%s: %s (%d)\n"), _("Listening"), serve_path, server.GetCount());
+
+	int rc = 0;
+	while(!WatchFolder::IsStopRequested()) {
+		if (!server.Accept(1000)) {
+			out.Printf(_T("%s: %s\n"), _("Cannot accept a connection."), serve_path);
+			rc = 2;
+			break;
+		}
+	}
+	server.Close();
+	return rc;
+}
+#endif
+
+/// バッチモードで1ファイルを変換する
+/// @param[in] ps        パーサー
+/// @param[in] in_path   入力ファイル
+/// @param[in] out_flags 出力形式
+/// @param[in] out_sub   出力先の下のサブディレクトリ 出力先がディレクトリの場合のみ
+/// @return false:変換できなかった
+bool BasicBatch::ExportBatchFile(Parse *ps, const wxString &in_path, int out_flags, const wxString &out_sub)
+{
+	wxArrayString basic_types;
+	ps->GetBasicTypes(basic_types);
+	wxString in_basic_type = basic_type;
+	if (in_basic_type.IsEmpty() && basic_types.Count() > 0) {
+		in_basic_type = basic_types[0];
+	}
+
+	PsFileType in_type;
+	in_type.SetMachineAndBasicType(ps->GetMachineType(in_basic_type), in_basic_type, ps->IsExtendedBasic(in_basic_type));
+	if (!ps->OpenDataFile(in_path, in_type)) {
+		return false;
+	}
+
+	// 内部ファイル名
+	PsFileType *opened_flags = ps->GetOpenedDataTypePtr();
+	if (opened_flags && opened_flags->GetInternalName().IsEmpty()) {
+		opened_flags->SetInternalName(wxFileName::FileName(in_path).GetName());
+	}
+	wxArrayString lines;
+	wxString char_type = ps->GetParsedData(lines);
+
+	// 出力ファイル名 入力が複数またはディレクトリ指定ならその下に作る
+	wxString path = out_path;
+	if (in_files.Count() > 1 || wxFileName::DirExists(out_path)) {
+		wxString file_base = ps->GetFileNameBase();
+		switch(out_flags) {
+			case psBinary:
+				file_base += ps->GetExportBasicBinaryFileExtension();
+				break;
+			case psBinary | psTapeImage:
+				file_base += ps->GetExportBasicBinaryTapeImageExtension();
+				break;
+			case psBinary | psDiskImage:
+				file_base += ps->GetExportBasicBinaryDiskImageExtension();
+				break;
+			case psAscii:
+				file_base += ps->GetExportBasicAsciiFileExtension();
+				break;
+			case psAscii | psTapeImage:
+				file_base += ps->GetExportBasicAsciiTapeImageExtension();
+				break;
+			case psAscii | psDiskImage:
+				file_base += ps->GetExportBasicAsciiDiskImageExtension();
+				break;
+			case psBinary | psTapeImage | psWaveAudio:
+			case psAscii | psTapeImage | psWaveAudio:
+				file_base += wxT(".wav");
+				break;
+			default:
+				file_base += ps->GetExportUTF8TextFileExtension();
+				break;
+		}
+		wxString out_dir = out_path;
+		if (!out_sub.IsEmpty()) {
+			out_dir = wxFileName::DirName(out_path).GetPathWithSep() + out_sub;
+			if (!wxFileName::DirExists(out_dir) && !wxFileName::Mkdir(out_dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+				wxMessageOutputStderr().Printf(_T("%s: %s\n"), _("Cannot create directory."), out_dir);
+				ps->CloseDataFile();
+				return false;
+			}
+		}
+		path = wxFileName(out_dir, file_base).GetFullPath();
+	}
+
+	PsFileType file_type;
+	file_type.SetTypeFlag(out_flags, true);
+	if (out_flags & psTapeImage) {
+		file_type.SetInternalName(opened_flags->GetInternalName());
+	}
+	if (out_flags & psUTF8) {
+		file_type.SetCharType(char_type);
+	}
+	wxString out_basic_type = basic_type.IsEmpty() ? ps->GetOpenedBasicType() : basic_type;
+	file_type.SetMachineAndBasicType(ps->GetMachineType(out_basic_type), out_basic_type, ps->IsExtendedBasic(out_basic_type));
+	if (!disk_image.IsEmpty()) {
+		// ディスクイメージの中に入力ファイルの名前で書き込む
+		path = disk_image;
+		file_type.SetInternalName(wxFileName::FileName(in_path).GetName());
+		if (!ps->OpenOutDiskImage(path, file_type)) {
+			ps->CloseDataFile();
+			return false;
+		}
+	} else if (!ps->OpenOutFile(path, file_type)) {
+		ps->CloseDataFile();
+		return false;
+	}
+
+	bool rc = ps->ExportData();
+	ps->CloseOutFile();
+
+	// output report
+	wxMessageOutputStderr out;
+	out.Printf(_T("%s -> %s\n"), in_path, path);
+	lines.Empty();
+	ps->GetParsedData(lines);
+	for(size_t i=0; i<lines.Count(); i++) {
+		out.Printf(_T("%s\n"), lines[i]);
+	}
+
+	ps->CloseDataFile();
+
+	return rc;
+}
+
+/// 取り出したファイルの名前を作る
+///
+/// 内部ファイル名の空白、制御文字とファイル名に使えない文字は_にする。
+/// @param[in] base イメージのファイル名
+/// @param[in] idx  ファイルの番号(0から)
+/// @param[in] name 内部ファイル名
+/// @param[in] ext  拡張子
+/// @return ファイル名
+static wxString MakeExtractName(const wxString &base, int idx, const wxString &name, const wxString &ext)
+{
+	wxString forbidden = wxFileName::GetForbiddenChars();
+	wxString fixed = name;
+	for(size_t c=0; c<fixed.Length(); c++) {
+		if (fixed[c] == _T(' ') || fixed[c] < _T(' ') || forbidden.Find(fixed[c]) != wxNOT_FOUND) fixed[c] = _T('_');
+	}
+	return wxString::Format(_T("%s_%02d_%s%s"), base, idx + 1, fixed, ext);
+}
+
+/// テープイメージの一覧表示、検査と取り出しで機種ごとに違う部分
+class BatchTapeImage
+{
+public:
+	virtual ~BatchTapeImage() {}
+	/// 開く
+	/// @param[in] verify_only チェックサムだけ調べる
+	virtual bool Open(const wxString &path, bool verify_only) = 0;
+	/// ファイル数
+	virtual size_t Count() const = 0;
+	/// 内部ファイル名
+	virtual wxString GetName(size_t idx) const = 0;
+	/// 取り出したファイルに付ける拡張子
+	virtual wxString GetExtractExtension(size_t idx) const = 0;
+	/// ファイルを取り出す
+	/// @param[out] results それぞれ書けたら1、書けなかったら0
+	virtual void ExtractFiles(const wxArrayInt &indexes, const wxArrayString &paths, wxArrayInt &results) const = 0;
+	/// チェックサムが合わないブロックを表示する
+	/// @return 合わないブロック数
+	virtual size_t PrintBadBlocks(const wxString &path) = 0;
+	/// 一覧を表示する
+	virtual void PrintList(const wxString &path, wxMessageOutput &list) = 0;
+};
+
+/// L3/S1 BASICのテープイメージ
+class BatchL3TapeImage : public BatchTapeImage
+{
+private:
+	ParseCollection mColl;
+	ParseL3S1Basic *pParse;
+	L3TapeArchive mArchive;
+	wxArrayInt mBadBlocks;	///< チェックサムが合わないブロックの番号
+	bool mVerified;			///< mBadBlocksを調べたか
+
+public:
+	BatchL3TapeImage(const wxString &res_path)
+	{
+		mColl.SetAppPath(res_path);
+		pParse = new ParseL3S1Basic(&mColl);
+		mColl.Set(eL3S1Basic, pParse);
+		mVerified = false;
+	}
+	bool Open(const wxString &path, bool verify_only)
+	{
+		mBadBlocks.Empty();
+		mVerified = verify_only;
+		if (verify_only) {
+			return pParse->VerifyTapeImage(path, mArchive, mBadBlocks);
+		}
+		return pParse->OpenTapeArchive(path, mArchive);
+	}
+	size_t Count() const { return mArchive.Count(); }
+	wxString GetExtractExtension(size_t idx) const
+	{
+		const L3TapeFile &file = mArchive[idx];
+		if (file.file_type != 0) {
+			return _T(".bin");
+		}
+		return (file.ascii ? pParse->GetExportBasicAsciiFileExtension() : pParse->GetExportBasicBinaryFileExtension());
+	}
+	void ExtractFiles(const wxArrayInt &indexes, const wxArrayString &paths, wxArrayInt &results) const
+	{
+		mArchive.ExtractFiles(indexes, paths, results);
+	}
+	wxString GetName(size_t idx) const { return mArchive.GetName(idx); }
+	size_t PrintBadBlocks(const wxString &path)
+	{
+		if (!mVerified) {
+			mArchive.GetBlocks().GetBadBlocks(mBadBlocks);
+			mVerified = true;
+		}
+		wxMessageOutputStdout list;
+		const L3TapeBlocks &blocks = mArchive.GetBlocks();
+
+		list.Printf(_T("%s: %u blocks, %u bad\n"), path, (unsigned)blocks.Count(), (unsigned)mBadBlocks.Count());
+		for(size_t i=0; i<mBadBlocks.Count(); i++) {
+			const L3TapeBlock &block = blocks[mBadBlocks[i]];
+			const wxChar *type = (block.type == L3TAPE_NAME ? _T("name") : (block.type == L3TAPE_DATA ? _T("data") : _T("end")));
+			if (block.stored_sum < 0) {
+				list.Printf(_T("  block %u at 0x%06x (%s): truncated\n"),
+					(unsigned)(mBadBlocks[i] + 1), (unsigned)block.offset, type);
+			} else {
+				list.Printf(_T("  block %u at 0x%06x (%s): stored %02x calculated %02x\n"),
+					(unsigned)(mBadBlocks[i] + 1), (unsigned)block.offset, type, block.stored_sum, block.calc_sum);
+			}
+		}
+		return mBadBlocks.Count();
+	}
+	void PrintList(const wxString &path, wxMessageOutput &list)
+	{
+		list.Printf(_T("%s: %u files\n"), path, (unsigned)mArchive.Count());
+		list.Printf(_T("  No  Name      Type    Blocks    Bytes  Offset    Checksum\n"));
+		for(size_t i=0; i<mArchive.Count(); i++) {
+			const L3TapeFile &file = mArchive[i];
+			wxString sum = (file.bad_sums == 0 ? wxString(_T("ok")) : wxString::Format(_T("%u bad"), (unsigned)file.bad_sums));
+			if (!file.has_end) sum += _T(" (no end)");
+			list.Printf(_T("  %2u  %-8s  %-6s  %6u  %7u  0x%06x  %s\n"),
+				(unsigned)(i + 1), mArchive.GetName(i),
+				file.file_type != 0 ? _T("other") : (file.ascii ? _T("ascii") : _T("binary")),
+				(unsigned)file.data_blocks, (unsigned)file.data_len, (unsigned)file.offset, sum);
+		}
+		if (mArchive.GetOrphanBlocks() > 0) {
+			list.Printf(_T("  %u data blocks without file name\n"), (unsigned)mArchive.GetOrphanBlocks());
+		}
+	}
+};
+
+/// MSXのテープイメージ(.cas)
+///
+/// チェックサムはないので検査はしない。
+class BatchMsxTapeImage : public BatchTapeImage
+{
+private:
+	MsxTapeArchive mArchive;
+
+public:
+	bool Open(const wxString &path, bool WXUNUSED(verify_only)) { return mArchive.Open(path); }
+	size_t Count() const { return mArchive.Count(); }
+	wxString GetExtractExtension(size_t idx) const
+	{
+		static const wxChar *type_exts[] = { _T(".bas"), _T(".asc"), _T(".bin") };
+		return type_exts[mArchive[idx].file_type];
+	}
+	void ExtractFiles(const wxArrayInt &indexes, const wxArrayString &paths, wxArrayInt &results) const
+	{
+		results.Empty();
+		for(size_t i=0; i<indexes.Count(); i++) {
+			results.Add(mArchive.ExtractTo(indexes[i], paths[i]) ? 1 : 0);
+		}
+	}
+	wxString GetName(size_t idx) const { return mArchive.GetName(idx); }
+	size_t PrintBadBlocks(const wxString &WXUNUSED(path)) { return 0; }
+	void PrintList(const wxString &path, wxMessageOutput &list)
+	{
+		static const wxChar *type_names[] = { _T("binary"), _T("ascii"), _T("machine") };
+
+		list.Printf(_T("%s: %u files\n"), path, (unsigned)mArchive.Count());
+		list.Printf(_T("  No  Name    Type     Blocks    Bytes  Offset\n"));
+		for(size_t i=0; i<mArchive.Count(); i++) {
+			const MsxTapeFile &file = mArchive[i];
+			list.Printf(_T("  %2u  %-6s  %-7s  %6u  %7u  0x%06x%s\n"),
+				(unsigned)(i + 1), mArchive.GetName(i), type_names[file.file_type],
+				(unsigned)file.data_blocks, (unsigned)file.data_len, (unsigned)file.offset,
+				(file.file_type == MSXTAPE_ASCII && !file.has_end) ? _T("  (no end)") : _T(""));
+		}
+		if (mArchive.GetOrphanBlocks() > 0) {
+			list.Printf(_T("  %u blocks without file header\n"), (unsigned)mArchive.GetOrphanBlocks());
+		}
+	}
+};
+
+/// テープイメージ内のファイルの一覧表示、チェックサムの検査と取り出し
+/// @return 0:成功 1:読めなかったファイルかチェックサムが合わないブロックあり 2:パラメータエラー
+int BasicBatch::RunTapeArchive()
+{
+	if (ParseCollection::FindMachine(machine_name) == eMSXBasic) {
+		if (tape_verify) {
+			wxMessageOutputStderr().Printf(_T("%s\n"), _("MSX tape images have no checksum."));
+			return 2;
+		}
+		BatchMsxTapeImage tape;
+		return RunTapeImageFiles(tape);
+	} else {
+		BatchL3TapeImage tape(res_path);
+		return RunTapeImageFiles(tape);
+	}
+}
+
+/// テープイメージ内のファイルの一覧表示、チェックサムの検査と取り出し (機種によらない部分)
+/// @param[in] tape 機種ごとのテープイメージ
+/// @return 0:成功 1:読めなかったファイルか書けなかったファイルかチェックサムが合わないブロックあり 2:パラメータエラー
+int BasicBatch::RunTapeImageFiles(BatchTapeImage &tape)
+{
+	wxMessageOutputStderr out;
+	wxMessageOutputStdout list;
+
+	if (!tape_extract_dir.IsEmpty() && !wxFileName::DirExists(tape_extract_dir)) {
+		if (!wxFileName::Mkdir(tape_extract_dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+			out.Printf(_T("%s: %s\n"), _("Cannot create directory."), tape_extract_dir);
+			return 2;
+		}
+	}
+
+	int rc = 0;
+	for(size_t n=0; n<in_files.Count(); n++) {
+		// 一覧も取り出しもしないならチェックサムだけ調べる
+		bool verify_only = (tape_verify && !tape_list && tape_extract_dir.IsEmpty());
+		if (!tape.Open(in_files[n], verify_only)) {
+			out.Printf(_T("%s: %s\n"), _("Cannot open file."), in_files[n]);
+			rc = 1;
+			continue;
+		}
+		if (tape_verify && tape.PrintBadBlocks(in_files[n]) > 0) {
+			rc = 1;
+		}
+
+		// 一覧
+		if (tape_list) {
+			tape.PrintList(in_files[n], list);
+		}
+
+		// 取り出す
+		if (!tape_extract_dir.IsEmpty()) {
+			wxArrayInt indexes;
+			if (!ParseTapeFileNumbers(tape_files, tape.Count(), indexes)) {
+				out.Printf(_T("%s: %s\n"), _("Invalid file number"), tape_files);
+				return 2;
+			}
+			wxString base = wxFileName::FileName(in_files[n]).GetName();
+			wxArrayString paths;
+			for(size_t i=0; i<indexes.Count(); i++) {
+				wxString name = MakeExtractName(base, indexes[i], tape.GetName(indexes[i]), tape.GetExtractExtension(indexes[i]));
+				paths.Add(wxFileName(tape_extract_dir, name).GetFullPath());
+			}
+			wxArrayInt results;
+			tape.ExtractFiles(indexes, paths, results);
+			for(size_t i=0; i<paths.Count(); i++) {
+				if (results[i]) {
+					out.Printf(_T("%s -> %s\n"), in_files[n], paths[i]);
+				} else {
+					out.Printf(_T("%s: %s\n"), _("Cannot write file."), paths[i]);
+					rc = 1;
+				}
+			}
+		}
+	}
+	return rc;
+}
+
+/// 番号を大きい順に並べる
+static int CompareIntDesc(int *a, int *b)
+{
+	return *b - *a;
+}
+
+/// ディスクイメージの一覧表示、取り出しと削除で機種ごとに違う部分
+class BatchDiskImage
+{
+public:
+	virtual ~BatchDiskImage() {}
+	/// ディスクイメージの拡張子
+	virtual const wxChar *GetFileExtension() const = 0;
+	/// 開く
+	virtual bool Open(const wxString &path, bool writable) = 0;
+	/// ファイル数
+	virtual size_t Count() const = 0;
+	/// ファイル名
+	virtual wxString GetName(size_t idx) const = 0;
+	/// 取り出したファイルに付ける拡張子
+	virtual wxString GetExtractExtension(size_t idx) const = 0;
+	/// ファイルを取り出す
+	virtual bool ExtractTo(size_t idx, const wxString &path) const = 0;
+	/// ファイルを削除する
+	virtual bool DeleteFile(size_t idx) = 0;
+	/// 一覧を表示する
+	virtual void PrintList(const wxString &path, wxMessageOutput &list) = 0;
+};
+
+/// L3/S1 BASICのディスクイメージ(D88)
+class BatchL3DiskImage : public BatchDiskImage
+{
+private:
+	ParseCollection mColl;
+	ParseL3S1Basic *pParse;
+	L3DiskBasic mDisk;
+
+public:
+	BatchL3DiskImage(const wxString &res_path)
+	{
+		mColl.SetAppPath(res_path);
+		pParse = new ParseL3S1Basic(&mColl);
+		mColl.Set(eL3S1Basic, pParse);
+	}
+	const wxChar *GetFileExtension() const { return pParse->GetDiskImageFileExtension(); }
+	bool Open(const wxString &path, bool writable) { return pParse->OpenDiskImage(path, mDisk, writable); }
+	size_t Count() const { return mDisk.Count(); }
+	wxString GetName(size_t idx) const { return mDisk.GetName(idx); }
+	wxString GetExtractExtension(size_t idx) const
+	{
+		if ((mDisk[idx].attr & L3DISK_ATTR_MACHINE) != 0) {
+			return _T(".bin");
+		}
+		return (mDisk.IsAscii(idx) ? pParse->GetExportBasicAsciiFileExtension() : pParse->GetExportBasicBinaryFileExtension());
+	}
+	bool ExtractTo(size_t idx, const wxString &path) const { return mDisk.ExtractTo(idx, path); }
+	bool DeleteFile(size_t idx) { return mDisk.DeleteFile(idx); }
+	void PrintList(const wxString &path, wxMessageOutput &list)
+	{
+		list.Printf(_T("%s: %s, %u files, %d/%d clusters free\n"), path, mDisk.GetDisk().GetName(),
+			(unsigned)mDisk.Count(), mDisk.GetFreeClusters(), mDisk.GetClusterCount());
+		list.Printf(_T("  No  Name        Type     Clusters    Bytes\n"));
+		for(size_t i=0; i<mDisk.Count(); i++) {
+			const L3DiskFile &file = mDisk[i];
+			const wxChar *type = ((file.attr & L3DISK_ATTR_MACHINE) != 0 ? _T("machine") : (mDisk.IsAscii(i) ? _T("ascii") : _T("binary")));
+			list.Printf(_T("  %2u  %-10s  %-7s  %8d  %7u%s\n"),
+				(unsigned)(i + 1), mDisk.GetName(i), type, file.clusters, (unsigned)file.data_len,
+				file.broken ? _T("  (broken FAT)") : _T(""));
+		}
+	}
+};
+
+/// MSX-DOSのディスクイメージ
+///
+/// たくさんのイメージを一覧するときも1つのMsxDiskを開きなおして使う。
+class BatchMsxDiskImage : public BatchDiskImage
+{
+private:
+	ParseCollection mColl;
+	ParseMSXBasic *pParse;
+	MsxDisk mDisk;
+
+public:
+	BatchMsxDiskImage(const wxString &res_path)
+	{
+		mColl.SetAppPath(res_path);
+		pParse = new ParseMSXBasic(&mColl);
+		mColl.Set(eMSXBasic, pParse);
+	}
+	const wxChar *GetFileExtension() const { return pParse->GetDiskImageFileExtension(); }
+	bool Open(const wxString &path, bool writable) { return pParse->OpenDiskImage(path, mDisk, writable); }
+	size_t Count() const { return mDisk.Count(); }
+	wxString GetName(size_t idx) const { return mDisk.GetName(idx); }
+	/// MSX-DOSのファイル名は拡張子を含む
+	wxString GetExtractExtension(size_t WXUNUSED(idx)) const { return wxEmptyString; }
+	bool ExtractTo(size_t idx, const wxString &path) const { return mDisk.ExtractTo(idx, path); }
+	bool DeleteFile(size_t idx) { return mDisk.DeleteFile(idx); }
+	void PrintList(const wxString &path, wxMessageOutput &list)
+	{
+		static const wxChar *type_names[] = { _T("binary"), _T("ascii"), _T("machine"), _T("other") };
+
+		list.Printf(_T("%s: %u files, %d/%d clusters free\n"), path,
+			(unsigned)mDisk.Count(), mDisk.GetFreeClusters(), mDisk.GetClusterCount());
+		list.Printf(_T("  No  Name          Type     Clusters    Bytes\n"));
+		for(size_t i=0; i<mDisk.Count(); i++) {
+			const MsxDiskFile &file = mDisk[i];
+			list.Printf(_T("  %2u  %-12s  %-7s  %8d  %7u%s\n"),
+				(unsigned)(i + 1), mDisk.GetName(i), type_names[file.file_type], file.clusters, (unsigned)file.size,
+				file.broken ? _T("  (broken FAT)") : _T(""));
+		}
+	}
+};
+
+/// ディスクイメージ内のファイルの一覧表示、取り出しと削除
+///
+/// 一覧は削除した後の内容を表示する。
+/// @return 0:成功 1:読めなかったファイルあり 2:パラメータエラー
+int BasicBatch::RunDiskImage()
+{
+	if (ParseCollection::FindMachine(machine_name) == eMSXBasic) {
+		BatchMsxDiskImage disk(res_path);
+		return RunDiskImageFiles(disk);
+	} else {
+		BatchL3DiskImage disk(res_path);
+		return RunDiskImageFiles(disk);
+	}
+}
+
+/// ディスクイメージ内のファイルの一覧表示、取り出しと削除 (機種によらない部分)
+/// @param[in] disk 機種ごとのディスクイメージ
+/// @return 0:成功 1:読めなかったファイルあり 2:パラメータエラー
+int BasicBatch::RunDiskImageFiles(BatchDiskImage &disk)
+{
+	wxMessageOutputStderr out;
+	wxMessageOutputStdout list;
+
+	wxArrayString files;
+	ExpandDiskImageFiles(disk.GetFileExtension(), files);
+
+	if (!disk_extract_dir.IsEmpty() && !wxFileName::DirExists(disk_extract_dir)) {
+		if (!wxFileName::Mkdir(disk_extract_dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+			out.Printf(_T("%s: %s\n"), _("Cannot create directory."), disk_extract_dir);
+			return 2;
+		}
+	}
+
+	int rc = 0;
+	for(size_t n=0; n<files.Count(); n++) {
+		if (!disk.Open(files[n], !disk_delete.IsEmpty())) {
+			out.Printf(_T("%s: %s\n"), _("Cannot open file."), files[n]);
+			rc = 1;
+			continue;
+		}
+
+		// 取り出す
+		if (!disk_extract_dir.IsEmpty()) {
+			wxArrayInt indexes;
+			if (!ParseTapeFileNumbers(tape_files, disk.Count(), indexes)) {
+				out.Printf(_T("%s: %s\n"), _("Invalid file number"), tape_files);
+				return 2;
+			}
+			wxString base = wxFileName::FileName(files[n]).GetName();
+			for(size_t i=0; i<indexes.Count(); i++) {
+				wxString name = MakeExtractName(base, indexes[i], disk.GetName(indexes[i]), disk.GetExtractExtension(indexes[i]));
+				wxString path = wxFileName(disk_extract_dir, name).GetFullPath();
+				if (disk.ExtractTo(indexes[i], path)) {
+					out.Printf(_T("%s -> %s\n"), files[n], path);
+				} else {
+					out.Printf(_T("%s: %s\n"), _("Cannot write file."), path);
+					rc = 1;
+				}
+			}
+		}
+
+		// 削除する 番号がずれないように後ろから
+		if (!disk_delete.IsEmpty()) {
+			wxArrayInt indexes;
+			if (!ParseTapeFileNumbers(disk_delete, disk.Count(), indexes)) {
+				out.Printf(_T("%s: %s\n"), _("Invalid file number"), disk_delete);
+				return 2;
+			}
+			indexes.Sort(CompareIntDesc);
+			for(size_t i=0; i<indexes.Count(); i++) {
+				if (i > 0 && indexes[i] == indexes[i - 1]) continue;
+				wxString name = disk.GetName(indexes[i]);
+				if (disk.DeleteFile(indexes[i])) {
+					out.Printf(_T("%s: %s %s\n"), files[n], _("deleted"), name);
+				} else {
+					out.Printf(_T("%s: %s\n"), _("Cannot write to the disk image."), files[n]);
+					rc = 1;
+					break;
+				}
+			}
+		}
+
+		// 一覧
+		if (disk_list) {
+			disk.PrintList(files[n], list);
+		}
+	}
+	return rc;
+}
+
+/// 入力のディレクトリをその下のディスクイメージに展開する
+///
+/// ディレクトリはサブディレクトリも含めて拡張子が一致するファイルを名前順に加える。
+/// @param[in]  ext   ディスクイメージの拡張子 (大文字小文字は区別しない)
+/// @param[out] files ディスクイメージのファイル
+void BasicBatch::ExpandDiskImageFiles(const wxString &ext, wxArrayString &files)
+{
+	files.Empty();
+	for(size_t n=0; n<in_files.Count(); n++) {
+		if (!wxFileName::DirExists(in_files[n])) {
+			files.Add(in_files[n]);
+			continue;
+		}
+		wxArrayString found;
+		wxDir::GetAllFiles(in_files[n], &found, wxEmptyString, wxDIR_FILES | wxDIR_DIRS);
+		found.Sort();
+		for(size_t i=0; i<found.Count(); i++) {
+			if (wxFileName(found[i]).GetExt().CmpNoCase(ext) == 0) {
+				files.Add(found[i]);
+			}
+		}
+	}
+}
+
+/// 取り出すファイルの番号を解釈する
+/// @param[in]  str     番号 "1,3-5" 空の場合はすべて
+/// @param[in]  count   ファイル数
+/// @param[out] indexes ファイルの番号(0から)
+/// @return 範囲外や書式が違う場合false
+bool BasicBatch::ParseTapeFileNumbers(const wxString &str, size_t count, wxArrayInt &indexes)
+{
+	indexes.Empty();
+	if (str.IsEmpty()) {
+		for(size_t i=0; i<count; i++) {
+			indexes.Add((int)i);
+		}
+		return true;
+	}
+	wxArrayString items = wxSplit(str, _T(','));
+	for(size_t i=0; i<items.Count(); i++) {
+		wxString first = items[i].BeforeFirst(_T('-'));
+		wxString last = items[i].AfterFirst(_T('-'));
+		long st, ed;
+		if (!first.ToLong(&st)) return false;
+		if (last.IsEmpty()) ed = st;
+		else if (!last.ToLong(&ed)) return false;
+		if (st < 1 || ed < st || ed > (long)count) return false;
+		for(long v = st; v <= ed; v++) {
+			indexes.Add((int)(v - 1));
+		}
+	}
+	return true;
+}
+
+/// 実行ファイルの場所から設定ファイルとリソースの場所を決める
+///
+/// macOSのアプリケーションバンドルの中にある場合は、設定ファイルはバンドルの横、
+/// リソースはContents/Resourcesに置く。
+/// @param[in]  argv0    実行ファイルのパス
+/// @param[out] app_path 実行ファイルのディレクトリ
+/// @param[out] ini_path 設定ファイルのディレクトリ
+/// @param[out] res_path リソースのディレクトリ
+void BasicBatch::GetAppPaths(const wxString &argv0, wxString &app_path, wxString &ini_path, wxString &res_path)
+{
+	app_path = wxFileName::FileName(argv0).GetPath(wxPATH_GET_SEPARATOR);
+#ifdef __WXOSX__
+	if (app_path.Find(_T("MacOS")) >= 0) {
+		wxFileName file = wxFileName::FileName(app_path+"../../../");
+		file.Normalize(wxPATH_NORM_ALL);
+		ini_path = file.GetPath(wxPATH_GET_SEPARATOR);
+		file = wxFileName::FileName(app_path+"../../Contents/Resources/");
+		file.Normalize(wxPATH_NORM_ALL);
+		res_path = file.GetPath(wxPATH_GET_SEPARATOR);
+	} else
+#endif
+	{
+		ini_path = app_path;
+		res_path = app_path;
+	}
+}
+
+/// 設定した言語のカタログを読み込む
+/// @param[in,out] locale   ロケール
+/// @param[in]     res_path リソースのディレクトリ
+void BasicBatch::InitLocale(wxLocale &locale, const wxString &res_path)
+{
+	// set locale search path and catalog name
+	wxString locale_name = gConfig.GetLanguage();
+	int lang_num = 0;
+	if (locale_name.IsEmpty()) {
+		lang_num = wxLocale::GetSystemLanguage();
+	} else {
+		const wxLanguageInfo * const lang = wxLocale::FindLanguageInfo(locale_name);
+		if (lang) {
+			lang_num = lang->Language;
+		} else {
+			lang_num = wxLANGUAGE_UNKNOWN;
+		}
+	}
+	if (locale.Init(lang_num, wxLOCALE_LOAD_DEFAULT)) {
+		locale.AddCatalogLookupPathPrefix(res_path + _T("lang"));
+		locale.AddCatalogLookupPathPrefix(_T("lang"));
+		locale.AddCatalog(_T(APPLICATION_NAME));
+	}
+}
@@ -0,0 +1,86 @@
+﻿/// @file batch.h
+///
+/// @brief バッチモード
+///
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/cmdline.h>
+#include "parse.h"
+
+class L3WaveParam;
+class BatchTapeImage;
+class BatchDiskImage;
+
+/// バッチモード
+///
+/// ウィンドウを作らずにコマンドラインの指定で変換する。
+/// GUIとコマンドライン版で共有し、変換エンジンのほかはwxBaseだけを使う。
+class BasicBatch
+{
+private:
+	wxString ini_file;
+	wxString res_path;
+
+	bool batch_mode;
+	wxArrayString in_files;
+	wxString out_path;
+	wxString out_type;
+	wxString machine_name;
+	wxString basic_type;
+	wxString diag_file;
+	long diag_limit;
+	bool show_stats;
+	bool use_pipeline;
+	bool tape_list;
+	bool tape_verify;
+	wxString tape_extract_dir;
+	wxString tape_files;
+	bool disk_list;
+	wxString disk_extract_dir;
+	wxString disk_image;
+	wxString disk_delete;
+	long wave_rate;
+	long wave_bits;
+	long wave_baud;
+	bool watch_mode;
+	long watch_settle;
+	wxString serve_path;
+	long serve_threads;
+
+	bool ExportBatchFile(Parse *ps, const wxString &in_path, int out_flags, const wxString &out_sub = wxEmptyString);
+	int  RunWatch(Parse *ps, int out_flags);
+	int  RunServe(int machine, int out_flags, const L3WaveParam &wave_param);
+	int  RunTapeArchive();
+	int  RunTapeImageFiles(BatchTapeImage &tape);
+	int  RunDiskImage();
+	int  RunDiskImageFiles(BatchDiskImage &disk);
+	void ExpandDiskImageFiles(const wxString &ext, wxArrayString &files);
+	bool ParseTapeFileNumbers(const wxString &str, size_t count, wxArrayInt &indexes);
+
+public:
+	BasicBatch();
+
+	/// 設定ファイルとリソースのパスを設定
+	void SetPaths(const wxString &ini, const wxString &res);
+	/// コマンドラインのオプションを設定
+	static void InitCmdLine(wxCmdLineParser &parser);
+	/// コマンドラインを解釈する
+	bool CmdLineParsed(wxCmdLineParser &parser);
+	/// バッチモードで変換する
+	int  Run();
+
+	/// バッチモードか
+	bool IsBatchMode() const { return batch_mode; }
+	/// 入力ファイル
+	const wxArrayString &GetInFiles() const { return in_files; }
+
+	/// 実行ファイルの場所から設定ファイルとリソースの場所を決める
+	static void GetAppPaths(const wxString &argv0, wxString &app_path, wxString &ini_path, wxString &res_path);
+	/// 設定した言語のカタログを読み込む
+	static void InitLocale(wxLocale &locale, const wxString &res_path);
+};
+
+#endif /* BATCH_H */
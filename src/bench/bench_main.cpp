@@ -0,0 +1,554 @@
+﻿/// @file bench_main.cpp
+///
+/// @brief 変換ベンチマーク
+///
+/// 生成したBASICプログラムを各方向に変換して処理速度を計測する。
+/// 結果はJSON Lines(既定)またはCSVで出力する。
+///
+#include "../common.h"
+#include <wx/wx.h>
+#include <wx/cmdline.h>
+#include <wx/filename.h>
+#include <wx/ffile.h>
+#include <wx/msgout.h>
+#include <wx/stopwatch.h>
+#include "../config.h"
+#include "../parse_l3s1basic.h"
+#include "../parse_msxbasic.h"
+#include "benchgen.h"
+#include "benchverify.h"
+
+/// 入出力ファイルの種類
+enum enBenchKinds {
+	BENCH_NONE = -1,
+	BENCH_ASCII = 0,
+	BENCH_BIN,
+	BENCH_UTF8,
+	BENCH_TAPE,
+	BENCH_KIND_COUNT
+};
+
+/// 変換方向 前の方向の出力を後の方向の入力に使う
+static const struct st_bench_directions {
+	const char *name;
+	int in_kind;
+	int out_flags;
+	int out_kind;
+} cBenchDirections[] = {
+	{ "ascii->bin",		BENCH_ASCII,	psBinary,					BENCH_BIN },
+	{ "ascii->utf8",	BENCH_ASCII,	psAscii | psUTF8,			BENCH_UTF8 },
+	{ "ascii->bintape",	BENCH_ASCII,	psBinary | psTapeImage,		BENCH_TAPE },
+	{ "ascii->ascii",	BENCH_ASCII,	psAscii,					BENCH_NONE },
+	{ "ascii->asciitape", BENCH_ASCII,	psAscii | psTapeImage,		BENCH_NONE },
+	{ "bin->ascii",		BENCH_BIN,		psAscii,					BENCH_NONE },
+	{ "bin->utf8",		BENCH_BIN,		psAscii | psUTF8,			BENCH_NONE },
+	{ "bin->bin",		BENCH_BIN,		psBinary,					BENCH_NONE },
+	{ "utf8->bin",		BENCH_UTF8,		psBinary,					BENCH_NONE },
+	{ "utf8->ascii",	BENCH_UTF8,		psAscii,					BENCH_NONE },
+	{ "utf8->utf8",		BENCH_UTF8,		psAscii | psUTF8,			BENCH_NONE },
+	{ "tape->ascii",	BENCH_TAPE,		psAscii,					BENCH_NONE },
+	{ "tape->utf8",		BENCH_TAPE,		psAscii | psUTF8,			BENCH_NONE },
+	{ NULL, 0, 0, 0 }
+};
+
+/// 機種ごとのコード変換テーブル
+static const char *cBenchTables[eMachineCount] = {
+	"l3s1_basic_code.dat",
+	"msx_basic_code.dat"
+};
+
+/// 機種名
+static const char *cBenchMachines[eMachineCount] = {
+	"l3s1",
+	"msx"
+};
+
+/// ベンチマーク
+class BenchApp : public wxAppConsole
+{
+private:
+	wxString mDataPath;
+	wxString mMachine;
+	wxString mFormat;
+	wxString mOutput;
+	long mLines;
+	long mIterations;
+	long mSeed;
+	long mThreads;
+	bool mPipeline;
+	bool mKeep;
+	bool mVerify;
+
+	wxFFile mOut;
+	wxString mWorkDir;
+	wxArrayString mWorkFiles;
+
+	bool FindDataPath();
+	bool RunMachine(Parse *ps, int machine, const wxString &basic_type);
+	bool RunDirection(Parse *ps, int machine, const wxString &basic_type, int dir, wxString *paths, size_t lines);
+	bool ExportOnce(Parse *ps, const wxString &in_path, const wxString &out_path, const wxString &basic_type, int out_flags);
+	int  CompareSerial(Parse *ps, const wxString &in_path, const wxString &out_path, const wxString &basic_type, int out_flags);
+	int  RunMeasure();
+	bool RunVerify();
+	void Output(const wxString &str);
+
+public:
+	BenchApp();
+	bool OnInit();
+	int  OnRun();
+	void OnInitCmdLine(wxCmdLineParser &parser);
+	bool OnCmdLineParsed(wxCmdLineParser &parser);
+};
+
+IMPLEMENT_APP_CONSOLE(BenchApp)
+
+BenchApp::BenchApp()
+{
+	mLines = 10000;
+	mIterations = 5;
+	mSeed = 1;
+	mThreads = 0;
+	mPipeline = false;
+	mKeep = false;
+	mVerify = false;
+}
+
+bool BenchApp::OnInit()
+{
+	SetAppName(_T("l3s1basic_bench"));
+
+	if (!wxAppConsole::OnInit()) {
+		return false;
+	}
+
+	if (!mVerify && !FindDataPath()) {
+		wxMessageOutputStderr().Printf(_T("data directory not found. use --data.\n"));
+		return false;
+	}
+	return true;
+}
+
+void BenchApp::OnInitCmdLine(wxCmdLineParser &parser)
+{
+	static const wxCmdLineEntryDesc cmdLineDesc[] = {
+		{ wxCMD_LINE_SWITCH, "h", "help", "show this help message", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
+		{ wxCMD_LINE_OPTION, "d", "data", "directory that contains data/", wxCMD_LINE_VAL_STRING, 0x0 },
+		{ wxCMD_LINE_OPTION, "m", "machine", "l3s1, msx or all (default)", wxCMD_LINE_VAL_STRING, 0x0 },
+		{ wxCMD_LINE_OPTION, "l", "lines", "lines of generated program (default 10000)", wxCMD_LINE_VAL_NUMBER, 0x0 },
+		{ wxCMD_LINE_OPTION, "n", "iterations", "iterations of each direction (default 5)", wxCMD_LINE_VAL_NUMBER, 0x0 },
+		{ wxCMD_LINE_OPTION, NULL, "seed", "seed of generator (default 1)", wxCMD_LINE_VAL_NUMBER, 0x0 },
+		{ wxCMD_LINE_OPTION, "j", "threads", "threads of ascii<->bin (default 0: cpu count, 1: serial)", wxCMD_LINE_VAL_NUMBER, 0x0 },
+		{ wxCMD_LINE_SWITCH, "p", "pipeline", "export bin->ascii through decode/convert/write threads", wxCMD_LINE_VAL_NONE, 0x0 },
+		{ wxCMD_LINE_OPTION, "f", "format", "json (default) or csv", wxCMD_LINE_VAL_STRING, 0x0 },
+		{ wxCMD_LINE_OPTION, "o", "output", "write results to file instead of stdout", wxCMD_LINE_VAL_STRING, 0x0 },
+		{ wxCMD_LINE_SWITCH, "k", "keep", "keep generated files", wxCMD_LINE_VAL_NONE, 0x0 },
+		{ wxCMD_LINE_SWITCH, NULL, "verify", "check round trips of wave and disk images instead of measuring", wxCMD_LINE_VAL_NONE, 0x0 },
+		wxCMD_LINE_DESC_END
+	};
+	parser.SetDesc(cmdLineDesc);
+}
+
+bool BenchApp::OnCmdLineParsed(wxCmdLineParser &parser)
+{
+	parser.Found(_T("data"), &mDataPath);
+	parser.Found(_T("machine"), &mMachine);
+	parser.Found(_T("lines"), &mLines);
+	parser.Found(_T("iterations"), &mIterations);
+	parser.Found(_T("seed"), &mSeed);
+	parser.Found(_T("threads"), &mThreads);
+	parser.Found(_T("format"), &mFormat);
+	parser.Found(_T("output"), &mOutput);
+	mPipeline = parser.Found(_T("pipeline"));
+	mKeep = parser.Found(_T("keep"));
+	mVerify = parser.Found(_T("verify"));
+
+	if (mLines < 1) mLines = 1;
+	if (mIterations < 1) mIterations = 1;
+	if (mThreads < 0) mThreads = 0;
+	if (mFormat.IsEmpty()) mFormat = _T("json");
+	if (mFormat != _T("json") && mFormat != _T("csv")) {
+		wxMessageOutputStderr().Printf(_T("unknown format: %s\n"), mFormat);
+		return false;
+	}
+	return true;
+}
+
+/// data/があるディレクトリを探す
+bool BenchApp::FindDataPath()
+{
+	wxArrayString candidates;
+	if (!mDataPath.IsEmpty()) {
+		candidates.Add(mDataPath);
+	} else {
+		wxString exe_path = wxFileName::FileName(argv[0]).GetPath();
+		candidates.Add(wxGetCwd());
+		candidates.Add(exe_path);
+		candidates.Add(exe_path + wxFILE_SEP_PATH + _T(".."));
+	}
+	for(size_t i=0; i<candidates.Count(); i++) {
+		wxFileName dir = wxFileName::DirName(candidates[i]);
+		if (wxFileName::DirExists(dir.GetPath(wxPATH_GET_SEPARATOR) + _T("data"))) {
+			mDataPath = dir.GetPath(wxPATH_GET_SEPARATOR);
+			return true;
+		}
+	}
+	return false;
+}
+
+void BenchApp::Output(const wxString &str)
+{
+	mOut.Write(str, wxConvUTF8);
+}
+
+int BenchApp::OnRun()
+{
+	if (mOutput.IsEmpty()) {
+		mOut.Attach(stdout);
+	} else if (!mOut.Open(mOutput, _T("w"))) {
+		return 2;
+	}
+	if (mFormat == _T("csv")) {
+		if (mVerify) {
+			Output(_T("verify,case,ok,detail\n"));
+		} else {
+			Output(_T("machine,basic,direction,lines,bytes,out_bytes,iterations,open_sec,export_sec,mb_per_s,lines_per_s,serial_identical\n"));
+		}
+	}
+
+	// work directory
+	mWorkDir = wxFileName::GetTempDir() + wxFILE_SEP_PATH + wxString::Format(_T("l3s1basic_bench_%lu"), wxGetProcessId());
+	if (!wxFileName::Mkdir(mWorkDir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+		wxMessageOutputStderr().Printf(_T("cannot create %s\n"), mWorkDir);
+		return 2;
+	}
+
+	int rc = 0;
+	if (mVerify) {
+		rc = (RunVerify() ? 0 : 1);
+	} else {
+		rc = RunMeasure();
+	}
+
+	if (!mKeep) {
+		for(size_t i=0; i<mWorkFiles.Count(); i++) {
+			wxRemoveFile(mWorkFiles[i]);
+		}
+		wxFileName::Rmdir(mWorkDir);
+	} else {
+		wxMessageOutputStderr().Printf(_T("files are kept in %s\n"), mWorkDir);
+	}
+
+	if (mOutput.IsEmpty()) {
+		mOut.Flush();
+		mOut.Detach();
+	} else {
+		mOut.Close();
+	}
+	return rc;
+}
+
+/// 全機種で計測
+/// @return 0:正常 1:変換できなかった方向がある 2:初期化できなかった
+int BenchApp::RunMeasure()
+{
+	ParseCollection coll;
+	coll.SetAppPath(mDataPath);
+	coll.Set(eL3S1Basic, new ParseL3S1Basic(&coll));
+	coll.Set(eMSXBasic, new ParseMSXBasic(&coll));
+
+	int rc = 0;
+	for(int machine = 0; machine < eMachineCount; machine++) {
+		if (!mMachine.IsEmpty() && mMachine != _T("all") && mMachine != cBenchMachines[machine]) {
+			continue;
+		}
+		Parse *ps = coll.Get(machine);
+		if (!ps->Init()) {
+			rc = 2;
+			continue;
+		}
+		// 標準のBASICでマシンタイプごとに計測
+		ps->SetResultSink(NULL, 0);
+		ps->SetThreadCount((int)mThreads);
+		ps->SetPipelineMode(mPipeline);
+		wxArrayString basic_types;
+		ps->GetBasicTypes(basic_types);
+		wxArrayInt done;
+		for(size_t i=0; i<basic_types.Count(); i++) {
+			if (ps->IsExtendedBasic(basic_types[i])) continue;
+			int machine_type = ps->GetMachineType(basic_types[i]);
+			if (done.Index(machine_type) != wxNOT_FOUND) continue;
+			done.Add(machine_type);
+			if (!RunMachine(ps, machine, basic_types[i])) {
+				rc = 1;
+			}
+		}
+	}
+	return rc;
+}
+
+/// 往復の検証
+/// @return 全部成功したらtrue
+bool BenchApp::RunVerify()
+{
+	BenchVerifier verifier(mWorkDir, mWorkFiles);
+	verifier.VerifyWave();
+	verifier.VerifyWaveLevels();
+	verifier.VerifyL3Disk();
+	verifier.VerifyMsxDisk();
+
+	for(size_t i=0; i<verifier.Count(); i++) {
+		wxString rec;
+		wxString detail = verifier.GetDetail(i);
+		if (mFormat == _T("csv")) {
+			detail.Replace(_T("\""), _T("\"\""));
+			rec = wxString::Format(_T("%s,%s,%s,\"%s\"\n"),
+				verifier.GetName(i), verifier.GetCase(i),
+				verifier.IsOk(i) ? _T("true") : _T("false"), detail);
+		} else {
+			detail.Replace(_T("\\"), _T("\\\\"));
+			detail.Replace(_T("\""), _T("\\\""));
+			rec = wxString::Format(_T("{\"verify\":\"%s\",\"case\":\"%s\",\"ok\":%s,\"detail\":\"%s\"}\n"),
+				verifier.GetName(i), verifier.GetCase(i),
+				verifier.IsOk(i) ? _T("true") : _T("false"), detail);
+		}
+		Output(rec);
+	}
+	return (verifier.GetFailures() == 0);
+}
+
+/// 1つのBASIC種類で全方向を計測
+bool BenchApp::RunMachine(Parse *ps, int machine, const wxString &basic_type)
+{
+	// generate program
+	BenchGenerator gen((wxUint32)mSeed);
+	if (!gen.LoadKeywords(mDataPath + _T("data") + wxFILE_SEP_PATH + cBenchTables[machine], basic_type)) {
+		wxMessageOutputStderr().Printf(_T("no keywords for %s\n"), basic_type);
+		return false;
+	}
+	wxMemoryBuffer prog;
+	gen.Generate((size_t)mLines, prog);
+
+	wxString base = basic_type;
+	base.Replace(_T(" "), _T("_"));
+	wxString paths[BENCH_KIND_COUNT];
+	paths[BENCH_ASCII] = mWorkDir + wxFILE_SEP_PATH + base + _T(".bas");
+	wxFFile file(paths[BENCH_ASCII], _T("wb"));
+	if (!file.IsOpened() || file.Write(prog.GetData(), prog.GetDataLen()) != prog.GetDataLen()) {
+		return false;
+	}
+	file.Close();
+	mWorkFiles.Add(paths[BENCH_ASCII]);
+
+	bool st = true;
+	for(int dir = 0; cBenchDirections[dir].name != NULL; dir++) {
+		if (paths[cBenchDirections[dir].in_kind].IsEmpty()) {
+			// 入力ファイルを作れなかった
+			st = false;
+			continue;
+		}
+		if (!RunDirection(ps, machine, basic_type, dir, paths, (size_t)mLines)) {
+			st = false;
+		}
+	}
+	return st;
+}
+
+/// 1方向を計測
+bool BenchApp::RunDirection(Parse *ps, int machine, const wxString &basic_type, int dir, wxString *paths, size_t lines)
+{
+	const st_bench_directions *d = &cBenchDirections[dir];
+	const wxString &in_path = paths[d->in_kind];
+
+	wxString out_path = mWorkDir + wxFILE_SEP_PATH + basic_type + _T(" ") + d->name;
+	out_path.Replace(_T(" "), _T("_"));
+	out_path.Replace(_T(">"), _T(""));
+	out_path += _T(".out");
+
+	PsFileType in_type;
+	in_type.SetMachineAndBasicType(ps->GetMachineType(basic_type), basic_type, ps->IsExtendedBasic(basic_type));
+
+	wxLongLong open_usec = 0;
+	wxLongLong export_usec = 0;
+	ps->ResetStats();
+
+	for(long n = 0; n < mIterations; n++) {
+		wxStopWatch sw;
+		if (!ps->OpenDataFile(in_path, in_type)) {
+			return false;
+		}
+		PsFileType *opened_flags = ps->GetOpenedDataTypePtr();
+		if (opened_flags && opened_flags->GetInternalName().IsEmpty()) {
+			opened_flags->SetInternalName(_T("BENCH"));
+		}
+		wxArrayString parsed;
+		wxString char_type = ps->GetParsedData(parsed);
+		open_usec += sw.TimeInMicro();
+
+		PsFileType out_type;
+		out_type.SetTypeFlag(d->out_flags, true);
+		if (d->out_flags & psTapeImage) {
+			out_type.SetInternalName(opened_flags->GetInternalName());
+		}
+		if (d->out_flags & psUTF8) {
+			out_type.SetCharType(char_type);
+		}
+		out_type.SetMachineAndBasicType(ps->GetMachineType(basic_type), basic_type, ps->IsExtendedBasic(basic_type));
+		if (!ps->OpenOutFile(out_path, out_type)) {
+			ps->CloseDataFile();
+			return false;
+		}
+		sw.Start();
+		ps->ExportData();
+		ps->CloseOutFile();
+		export_usec += sw.TimeInMicro();
+
+		ps->CloseDataFile();
+	}
+	if (mWorkFiles.Index(out_path) == wxNOT_FOUND) {
+		mWorkFiles.Add(out_path);
+	}
+	if (d->out_kind != BENCH_NONE) {
+		paths[d->out_kind] = out_path;
+	}
+
+	// 比べる前の計測結果
+#ifdef USE_PARSE_STATS
+	ParseStats stats = ps->GetStats();
+#endif
+	ParsePipelineStats pipe_stats = ps->GetPipelineStats();
+
+	// 並列やパイプラインで変換した場合は1スレッドの結果と比べる
+	int identical = -1;
+	if ((mThreads != 1 || mPipeline) && ((d->out_flags & psBinary) || d->in_kind == BENCH_BIN)) {
+		identical = CompareSerial(ps, in_path, out_path, basic_type, d->out_flags);
+	}
+
+	wxULongLong in_bytes = wxFileName::GetSize(in_path);
+	wxULongLong out_bytes = wxFileName::GetSize(out_path);
+	double export_sec = export_usec.ToDouble() / 1000000.0;
+	double open_sec = open_usec.ToDouble() / 1000000.0;
+	double total_bytes = in_bytes.ToDouble() * mIterations;
+	double total_lines = (double)lines * mIterations;
+	double mbps = export_sec > 0.0 ? total_bytes / export_sec / 1000000.0 : 0.0;
+	double lps = export_sec > 0.0 ? total_lines / export_sec : 0.0;
+
+	wxString rec;
+	if (mFormat == _T("csv")) {
+		rec = wxString::Format(_T("%s,\"%s\",%s,%lu,%s,%s,%ld,%.6f,%.6f,%.3f,%.1f,%s\n"),
+			cBenchMachines[machine], basic_type, d->name, (unsigned long)lines,
+			in_bytes.ToString(), out_bytes.ToString(), mIterations,
+			open_sec, export_sec, mbps, lps,
+			identical < 0 ? _T("") : (identical ? _T("true") : _T("false")));
+	} else {
+		rec = wxString::Format(_T("{\"machine\":\"%s\",\"basic\":\"%s\",\"direction\":\"%s\",\"lines\":%lu,\"bytes\":%s,\"out_bytes\":%s,\"iterations\":%ld,\"open_sec\":%.6f,\"export_sec\":%.6f,\"mb_per_s\":%.3f,\"lines_per_s\":%.1f"),
+			cBenchMachines[machine], basic_type, d->name, (unsigned long)lines,
+			in_bytes.ToString(), out_bytes.ToString(), mIterations,
+			open_sec, export_sec, mbps, lps);
+#ifdef USE_PARSE_STATS
+		// 処理段階ごとの内訳 (開くときの解析も含む)
+		rec += _T(",\"stages\":{");
+		bool first = true;
+		for(int stage = 0; stage < psStageCount; stage++) {
+			if (stats.GetCalls((ParseStage)stage) == 0) continue;
+			if (!first) rec += _T(",");
+			first = false;
+			rec += wxString::Format(_T("\"%s\":{\"calls\":%u,\"sec\":%.6f,\"bytes\":%llu,\"lines\":%llu}"),
+				ParseStats::StageName((ParseStage)stage),
+				(unsigned)stats.GetCalls((ParseStage)stage),
+				stats.GetTime((ParseStage)stage).ToDouble() / 1000000.0,
+				(unsigned long long)stats.GetBytes((ParseStage)stage),
+				(unsigned long long)stats.GetLines((ParseStage)stage));
+		}
+		rec += wxString::Format(_T("},\"lookups\":{\"char\":%llu,\"basic\":%llu}"),
+			(unsigned long long)stats.GetCharLookups(),
+			(unsigned long long)stats.GetBasicLookups());
+#endif
+		if (pipe_stats.GetRuns() > 0) {
+			// パイプラインの段階ごとの内訳
+			rec += _T(",\"pipeline\":{");
+			for(int stage = 0; stage < ppStageCount; stage++) {
+				rec += wxString::Format(_T("\"%s\":{\"batches\":%llu,\"busy_sec\":%.6f,\"wait_in_sec\":%.6f,\"wait_out_sec\":%.6f},"),
+					ParsePipelineStats::StageName((PipeStage)stage),
+					(unsigned long long)pipe_stats.GetBatches((PipeStage)stage),
+					pipe_stats.GetBusy((PipeStage)stage).ToDouble() / 1000000.0,
+					pipe_stats.GetWaitIn((PipeStage)stage).ToDouble() / 1000000.0,
+					pipe_stats.GetWaitOut((PipeStage)stage).ToDouble() / 1000000.0);
+			}
+			rec += wxString::Format(_T("\"latency_avg_sec\":%.6f,\"latency_max_sec\":%.6f}"),
+				pipe_stats.GetLatencyAverage() / 1000000.0,
+				pipe_stats.GetLatencyMax().ToDouble() / 1000000.0);
+		}
+		if (identical >= 0) {
+			rec += wxString::Format(_T(",\"serial_identical\":%s"), identical ? _T("true") : _T("false"));
+		}
+		rec += _T("}\n");
+	}
+	Output(rec);
+
+	return (identical != 0);
+}
+
+/// 1回変換して出力
+bool BenchApp::ExportOnce(Parse *ps, const wxString &in_path, const wxString &out_path, const wxString &basic_type, int out_flags)
+{
+	PsFileType in_type;
+	in_type.SetMachineAndBasicType(ps->GetMachineType(basic_type), basic_type, ps->IsExtendedBasic(basic_type));
+	if (!ps->OpenDataFile(in_path, in_type)) {
+		return false;
+	}
+	PsFileType *opened_flags = ps->GetOpenedDataTypePtr();
+	if (opened_flags && opened_flags->GetInternalName().IsEmpty()) {
+		opened_flags->SetInternalName(_T("BENCH"));
+	}
+	wxArrayString parsed;
+	wxString char_type = ps->GetParsedData(parsed);
+
+	PsFileType out_type;
+	out_type.SetTypeFlag(out_flags, true);
+	if (out_flags & psTapeImage) {
+		out_type.SetInternalName(opened_flags->GetInternalName());
+	}
+	out_type.SetMachineAndBasicType(ps->GetMachineType(basic_type), basic_type, ps->IsExtendedBasic(basic_type));
+	if (!ps->OpenOutFile(out_path, out_type)) {
+		ps->CloseDataFile();
+		return false;
+	}
+	ps->ExportData();
+	ps->CloseOutFile();
+	ps->CloseDataFile();
+	return true;
+}
+
+/// 1スレッドで変換した結果と比べる
+/// @return 1:同じ 0:異なる
+int BenchApp::CompareSerial(Parse *ps, const wxString &in_path, const wxString &out_path, const wxString &basic_type, int out_flags)
+{
+	wxString serial_path = out_path + _T(".serial");
+	ps->SetThreadCount(1);
+	ps->SetPipelineMode(false);
+	bool st = ExportOnce(ps, in_path, serial_path, basic_type, out_flags);
+	ps->SetThreadCount((int)mThreads);
+	ps->SetPipelineMode(mPipeline);
+	if (mWorkFiles.Index(serial_path) == wxNOT_FOUND) {
+		mWorkFiles.Add(serial_path);
+	}
+	if (!st) {
+		return 0;
+	}
+
+	wxFFile a(out_path, _T("rb"));
+	wxFFile b(serial_path, _T("rb"));
+	if (!a.IsOpened() || !b.IsOpened() || a.Length() != b.Length()) {
+		return 0;
+	}
+	char bufa[4096], bufb[4096];
+	for(;;) {
+		size_t la = a.Read(bufa, sizeof(bufa));
+		size_t lb = b.Read(bufb, sizeof(bufb));
+		if (la != lb || memcmp(bufa, bufb, la) != 0) {
+			return 0;
+		}
+		if (la == 0) break;
+	}
+	return 1;
+}
@@ -0,0 +1,281 @@
+﻿/// @file benchgen.cpp
+///
+/// @brief ベンチマーク用BASICプログラム生成
+///
+#include "benchgen.h"
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+
+BenchGenerator::BenchGenerator(wxUint32 seed)
+{
+	mSeed = (seed ? seed : 1);
+	mKana = true;
+}
+
+/// xorshift32
+wxUint32 BenchGenerator::Rand()
+{
+	mSeed ^= mSeed << 13;
+	mSeed ^= mSeed >> 17;
+	mSeed ^= mSeed << 5;
+	return mSeed;
+}
+
+/// コード変換テーブルから指定セクションのキーワードを読み込む
+/// @param[in] path    テーブルファイル
+/// @param[in] section セクション名 同じ名前のセクションはすべて読む
+/// @return false:ファイルがない or キーワードがない
+bool BenchGenerator::LoadKeywords(const wxString &path, const wxString &section)
+{
+	wxTextFile file;
+	if (!file.Open(path, wxConvUTF8)) {
+		return false;
+	}
+
+	mStatements.Empty();
+	mFunctions.Empty();
+	mJumps.Empty();
+
+	bool in_section = false;
+	for(wxString line = file.GetFirstLine(); !file.Eof(); line = file.GetNextLine()) {
+		line.Trim(false).Trim(true);
+		if (line.IsEmpty() || line[0] == '#') continue;
+		if (line[0] == '[') {
+			in_section = (line.Mid(1).BeforeLast(']') == section);
+			continue;
+		}
+		if (!in_section) continue;
+
+		// <code>,<keyword>,<attr>[,<attr2>]
+		wxArrayString cols = wxStringTokenize(line, _T(","), wxTOKEN_RET_EMPTY_ALL);
+		if (cols.Count() < 2) continue;
+		wxString code = cols[0].Trim(false).Trim(true);
+		wxString word = cols[1].Trim(false).Trim(true);
+		wxString attr;
+		for(size_t i=2; i<cols.Count(); i++) {
+			attr += _T(" ");
+			attr += cols[i];
+		}
+
+		// 英字で始まるキーワードのみ使う
+		if (word.Len() < 2 || !wxIsalpha(word[0])) continue;
+		// DATA/REMなどは専用に生成する
+		if (attr.Find(_T("data")) >= 0 || attr.Find(_T("comment")) >= 0) continue;
+		if (attr.Find(_T("nostatement")) >= 0 || attr.Find(_T("innersentence")) >= 0) continue;
+
+		if (code.Upper().StartsWith(_T("FF"))) {
+			// 関数
+			mFunctions.Add(word);
+		} else if (attr.Find(_T("linenumber")) >= 0 && attr.Find(_T("cont")) < 0) {
+			mJumps.Add(word);
+		} else {
+			mStatements.Add(word);
+		}
+	}
+	file.Close();
+
+	return (mStatements.Count() > 0);
+}
+
+void BenchGenerator::AddStr(wxMemoryBuffer &buf, const char *str)
+{
+	buf.AppendData(str, strlen(str));
+}
+
+void BenchGenerator::AddStr(wxMemoryBuffer &buf, const wxString &str)
+{
+	wxCharBuffer cb = str.To8BitData();
+	buf.AppendData(cb.data(), cb.length());
+}
+
+/// 数値 整数、実数、指数、16進
+void BenchGenerator::AddNumber(wxMemoryBuffer &buf)
+{
+	char num[32];
+	switch(Rand(6)) {
+	case 0:
+		sprintf(num, "%u", Rand(32768));
+		break;
+	case 1:
+		sprintf(num, "%u.%u", Rand(10000), Rand(1000));
+		break;
+	case 2:
+		sprintf(num, "%u.%uE%c%u", Rand(10), Rand(100000), Rand(2) ? '+' : '-', Rand(38));
+		break;
+	case 3:
+		sprintf(num, "&H%X", Rand(65536));
+		break;
+	case 4:
+		sprintf(num, "%u.%u#", Rand(100000), Rand(10000000));
+		break;
+	default:
+		sprintf(num, "%u", Rand(10));
+		break;
+	}
+	AddStr(buf, num);
+}
+
+/// 変数名
+void BenchGenerator::AddVariable(wxMemoryBuffer &buf, bool str_var)
+{
+	char name[4];
+	name[0] = (char)('A' + Rand(26));
+	name[1] = (Rand(2) ? (char)('0' + Rand(10)) : '\0');
+	name[2] = '\0';
+	AddStr(buf, name);
+	if (str_var) AddStr(buf, "$");
+}
+
+/// 半角カナ
+void BenchGenerator::AddKana(wxMemoryBuffer &buf, size_t len)
+{
+	for(size_t i=0; i<len; i++) {
+		if (mKana && Rand(3) == 0) {
+			wxUint8 c = (wxUint8)(0xb1 + Rand(0xdd - 0xb1 + 1));
+			buf.AppendByte((char)c);
+		} else {
+			buf.AppendByte((char)('A' + Rand(26)));
+		}
+	}
+}
+
+/// 式
+void BenchGenerator::AddExpression(wxMemoryBuffer &buf)
+{
+	static const char *ops[] = { "+", "-", "*", "/", "^" };
+	size_t terms = 1 + Rand(3);
+	for(size_t i=0; i<terms; i++) {
+		if (i > 0) AddStr(buf, ops[Rand(5)]);
+		switch(Rand(3)) {
+		case 0:
+			AddVariable(buf);
+			break;
+		case 1:
+			if (mFunctions.Count() > 0) {
+				const wxString &func = mFunctions[Rand(mFunctions.Count())];
+				AddStr(buf, func);
+				if (!func.EndsWith(_T("("))) AddStr(buf, "(");
+				AddVariable(buf);
+				AddStr(buf, ")");
+				break;
+			}
+			// fall through
+		default:
+			AddNumber(buf);
+			break;
+		}
+	}
+}
+
+/// 1ステートメント
+void BenchGenerator::AddStatement(wxMemoryBuffer &buf, long line_number, long last_line_number)
+{
+	// 参照先の行番号
+	long target = (long)Rand((wxUint32)last_line_number) + 1;
+	char num[16];
+	sprintf(num, "%ld", target);
+
+	switch(Rand(10)) {
+	case 0:
+		AddVariable(buf);
+		AddStr(buf, "=");
+		AddExpression(buf);
+		break;
+	case 1:
+		AddStr(buf, "PRINT \"");
+		AddKana(buf, 4 + Rand(16));
+		AddStr(buf, "\";");
+		AddVariable(buf, true);
+		break;
+	case 2:
+		AddStr(buf, "IF ");
+		AddVariable(buf);
+		AddStr(buf, ">");
+		AddNumber(buf);
+		AddStr(buf, " THEN ");
+		AddStr(buf, num);
+		AddStr(buf, " ELSE ");
+		sprintf(num, "%ld", line_number);
+		AddStr(buf, num);
+		break;
+	case 3:
+		AddStr(buf, Rand(2) ? "GOTO " : "GOSUB ");
+		AddStr(buf, num);
+		break;
+	case 4:
+		AddStr(buf, "FOR I=1 TO ");
+		AddNumber(buf);
+		AddStr(buf, " STEP 2:NEXT I");
+		break;
+	case 5:
+		AddVariable(buf, true);
+		AddStr(buf, "=\"");
+		AddKana(buf, 1 + Rand(12));
+		AddStr(buf, "\"");
+		break;
+	case 6:
+		if (mJumps.Count() > 0) {
+			AddStr(buf, mJumps[Rand(mJumps.Count())]);
+			AddStr(buf, " ");
+			AddStr(buf, num);
+			break;
+		}
+		// fall through
+	default:
+		AddStr(buf, mStatements[Rand(mStatements.Count())]);
+		AddStr(buf, " ");
+		AddExpression(buf);
+		AddStr(buf, ",");
+		AddExpression(buf);
+		break;
+	}
+}
+
+/// プログラムを生成
+/// @param[in]  lines 行数
+/// @param[out] out   アスキー形式のプログラム 改行はCR+LF
+void BenchGenerator::Generate(size_t lines, wxMemoryBuffer &out)
+{
+	// 行番号は10刻み 収まらない場合は刻みを小さくして範囲を超えたら折り返す
+	long step = (lines > 0 ? 63990 / (long)lines : 10);
+	if (step > 10) step = 10;
+	if (step < 1) step = 1;
+	long last_line_number = (long)lines * step;
+	if (last_line_number > 63990) last_line_number = 63990;
+
+	out.SetDataLen(0);
+	for(size_t row = 0; row < lines; row++) {
+		long line_number = (long)(row % (63990 / step) + 1) * step;
+		char num[16];
+		sprintf(num, "%ld ", line_number);
+		AddStr(out, num);
+
+		switch(Rand(8)) {
+		case 0:
+			AddStr(out, "REM ");
+			AddKana(out, 8 + Rand(40));
+			break;
+		case 1:
+			AddStr(out, "DATA ");
+			for(size_t i = Rand(8) + 1; i > 0; i--) {
+				AddNumber(out);
+				AddStr(out, ",\"");
+				AddKana(out, 1 + Rand(6));
+				AddStr(out, "\"");
+				if (i > 1) AddStr(out, ",");
+			}
+			break;
+		default:
+			for(size_t i = Rand(4) + 1; i > 0; i--) {
+				AddStatement(out, line_number, last_line_number);
+				if (i > 1) AddStr(out, ":");
+			}
+			if (Rand(6) == 0) {
+				AddStr(out, ":'");
+				AddKana(out, 4 + Rand(16));
+			}
+			break;
+		}
+		AddStr(out, "\r\n");
+	}
+}
@@ -0,0 +1,47 @@
+﻿/// @file benchgen.h
+///
+/// @brief ベンチマーク用BASICプログラム生成
+///
+#ifndef _BENCHGEN_H_
+#define _BENCHGEN_H_
+
+#include "../common.h"
+#include <wx/wx.h>
+#include <wx/buffer.h>
+
+/// ベンチマーク用のBASICプログラムを生成
+///
+/// コード変換テーブルのキーワードを使ってアスキー形式(8bit文字)の
+/// プログラムを作る。数値、文字列、DATA/REM、行番号参照、カナを含む。
+class BenchGenerator
+{
+private:
+	wxArrayString mStatements;	///< ステートメント
+	wxArrayString mFunctions;	///< 関数
+	wxArrayString mJumps;		///< 行番号をとるステートメント
+	wxUint32 mSeed;				///< 乱数の状態
+	bool mKana;					///< カナを含めるか
+
+	wxUint32 Rand();
+	wxUint32 Rand(wxUint32 range) { return Rand() % range; }
+
+	void AddStr(wxMemoryBuffer &buf, const char *str);
+	void AddStr(wxMemoryBuffer &buf, const wxString &str);
+	void AddNumber(wxMemoryBuffer &buf);
+	void AddVariable(wxMemoryBuffer &buf, bool str_var = false);
+	void AddKana(wxMemoryBuffer &buf, size_t len);
+	void AddExpression(wxMemoryBuffer &buf);
+	void AddStatement(wxMemoryBuffer &buf, long line_number, long last_line_number);
+
+public:
+	BenchGenerator(wxUint32 seed = 1);
+
+	/// コード変換テーブルから指定セクションのキーワードを読み込む
+	bool LoadKeywords(const wxString &path, const wxString &section);
+	/// カナを含めるか
+	void SetKana(bool val) { mKana = val; }
+	/// プログラムを生成 改行はCR+LF
+	void Generate(size_t lines, wxMemoryBuffer &out);
+};
+
+#endif /* _BENCHGEN_H_ */
@@ -0,0 +1,798 @@
+﻿/// @file benchverify.cpp
+///
+/// @brief 変換処理の往復の検証
+///
+#include "benchverify.h"
+#include "../fileinfo.h"
+#include "../bsstring.h"
+#include "../l3wave.h"
+#include "../l3disk.h"
+#include "../msxdisk.h"
+#include <wx/ffile.h>
+#include <string.h>
+
+BenchVerifier::BenchVerifier(const wxString &work_dir, wxArrayString &work_files)
+{
+	mWorkDir = work_dir;
+	pWorkFiles = &work_files;
+}
+
+/// 結果を追加
+/// @return ok
+bool BenchVerifier::AddResult(const wxString &name, const wxString &case_name, bool ok, const wxString &detail)
+{
+	mNames.Add(name);
+	mCases.Add(case_name);
+	mResults.Add(ok ? 1 : 0);
+	mDetails.Add(detail);
+	return ok;
+}
+
+/// 失敗した数
+size_t BenchVerifier::GetFailures() const
+{
+	size_t count = 0;
+	for(size_t i=0; i<mResults.Count(); i++) {
+		if (!mResults[i]) count++;
+	}
+	return count;
+}
+
+/// 作業ファイルのパス
+/// @param[in] name ファイル名
+/// @return 作業ディレクトリのパス ファイル一覧にも入れる
+wxString BenchVerifier::AddWorkFile(const wxString &name)
+{
+	wxString path = mWorkDir + wxFILE_SEP_PATH + name;
+	if (pWorkFiles->Index(path) == wxNOT_FOUND) {
+		pWorkFiles->Add(path);
+	}
+	return path;
+}
+
+/// リトルエンディアンで入れる
+static inline void verify_set_le16(wxUint8 *p, wxUint32 val)
+{
+	p[0] = (wxUint8)val; p[1] = (wxUint8)(val >> 8);
+}
+static inline void verify_set_le32(wxUint8 *p, wxUint32 val)
+{
+	p[0] = (wxUint8)val; p[1] = (wxUint8)(val >> 8); p[2] = (wxUint8)(val >> 16); p[3] = (wxUint8)(val >> 24);
+}
+
+/// ファイル全体を読む
+static bool verify_read_file(const wxString &path, wxMemoryBuffer &buf)
+{
+	buf.SetDataLen(0);
+	wxFFile file(path, _T("rb"));
+	if (!file.IsOpened()) {
+		return false;
+	}
+	size_t len = (size_t)file.Length();
+	size_t got = file.Read(buf.GetWriteBuf(len + 1), len);
+	buf.UngetWriteBuf(got);
+	return (got == len);
+}
+
+/// ファイルに書く
+static bool verify_write_file(const wxString &path, const wxMemoryBuffer &buf)
+{
+	wxFFile file(path, _T("wb"));
+	return (file.IsOpened() && file.Write(buf.GetData(), buf.GetDataLen()) == buf.GetDataLen());
+}
+
+/// 同じ内容か
+/// @param[in]  actual   比べるデータ
+/// @param[in]  expected 期待するデータ
+/// @param[out] detail   違うところ
+static bool verify_same_data(const wxMemoryBuffer &actual, const wxMemoryBuffer &expected, wxString &detail)
+{
+	if (actual.GetDataLen() != expected.GetDataLen()) {
+		detail = wxString::Format(_T("%lu bytes, expected %lu"), (unsigned long)actual.GetDataLen(), (unsigned long)expected.GetDataLen());
+		return false;
+	}
+	const wxUint8 *a = (const wxUint8 *)expected.GetData();
+	const wxUint8 *b = (const wxUint8 *)actual.GetData();
+	for(size_t i=0; i<expected.GetDataLen(); i++) {
+		if (a[i] != b[i]) {
+			detail = wxString::Format(_T("mismatch at %lu: %02x, expected %02x"), (unsigned long)i, b[i], a[i]);
+			return false;
+		}
+	}
+	detail = wxString::Format(_T("%lu bytes"), (unsigned long)expected.GetDataLen());
+	return true;
+}
+
+/// 取り出したファイルを比べる
+/// @param[in]  path     取り出したファイル
+/// @param[in]  expected 期待するデータ
+/// @param[out] detail   違うところ
+static bool verify_check_extracted(const wxString &path, const wxMemoryBuffer &expected, wxString &detail)
+{
+	wxMemoryBuffer actual;
+	if (!verify_read_file(path, actual)) {
+		detail = _T("cannot read ") + path;
+		return false;
+	}
+	return verify_same_data(actual, expected, detail);
+}
+
+/// ディスクに書き込むデータ
+///
+/// アスキー形式はBASICの行(1Aを含まない)、それ以外は先頭がFFの乱数にする。
+/// @param[in]  seed  乱数の種
+/// @param[in]  len   長さ
+/// @param[in]  ascii アスキー形式
+/// @param[out] data  データ
+static void verify_make_file_data(wxUint32 seed, size_t len, bool ascii, wxMemoryBuffer &data)
+{
+	data.SetDataLen(0);
+	if (ascii) {
+		for(int line = 10; data.GetDataLen() < len; line += 10) {
+			wxString str = wxString::Format(_T("%d PRINT \"LINE %d SEED %u\"\r\n"), line, line, (unsigned)seed);
+			wxCharBuffer cb = str.To8BitData();
+			data.AppendData(cb.data(), cb.length());
+		}
+		data.SetDataLen(len);
+		return;
+	}
+	wxUint32 x = (seed ? seed : 1);
+	for(size_t i=0; i<len; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		data.AppendByte((char)(i == 0 ? 0xff : (x & 0xff)));
+	}
+}
+
+/// 長さが単位の倍数になるまで00で埋める
+static void verify_pad_data(const wxMemoryBuffer &data, size_t unit, wxMemoryBuffer &padded)
+{
+	padded.SetDataLen(0);
+	padded.AppendData(data.GetData(), data.GetDataLen());
+	while(padded.GetDataLen() % unit) {
+		padded.AppendByte(0);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// サンプルの振幅と直流分を変える
+///
+/// 16ビットに換算して 値 * scale / 100 + offset とし、範囲外は切り詰める。
+/// @param[in]     param  音声の形式
+/// @param[in]     scale  振幅 (%)
+/// @param[in]     offset 直流分 (16ビット換算)
+/// @param[in,out] wave   WAVファイル (ヘッダは44バイト)
+void BenchVerifier::ChangeLevel(const L3WaveParam &param, int scale, int offset, wxMemoryBuffer &wave)
+{
+	wxUint8 *p = (wxUint8 *)wave.GetData();
+	size_t len = wave.GetDataLen();
+	size_t frame = (param.mSampleBits == 16 ? 2 : 1);
+	for(size_t pos = 44; pos + frame <= len; pos += frame) {
+		int v;
+		if (frame == 2) {
+			v = (wxInt16)(p[pos] | (p[pos + 1] << 8));
+		} else {
+			v = ((int)p[pos] - 128) << 8;
+		}
+		v = v * scale / 100 + offset;
+		if (v > 32767) v = 32767;
+		if (v < -32768) v = -32768;
+		if (frame == 2) {
+			p[pos] = (wxUint8)v;
+			p[pos + 1] = (wxUint8)(v >> 8);
+		} else {
+			p[pos] = (wxUint8)((v + 32768) >> 8);
+		}
+	}
+}
+
+/// テープイメージを音声にして復調する
+/// @param[in]  param  音声の形式
+/// @param[in]  data   テープイメージ
+/// @param[in]  scale  復調する前に変える振幅 (%)
+/// @param[in]  offset 復調する前に加える直流分 (16ビット換算)
+/// @param[out] detail 失敗した理由
+/// @return 復調したバイト列が元と同じならtrue
+bool BenchVerifier::WaveRoundTrip(const L3WaveParam &param, const wxMemoryBuffer &data, int scale, int offset, wxString &detail)
+{
+	L3WaveEncoder encoder(param);
+	PsFileStrOutput wave_out;
+	if (!encoder.Encode((const wxUint8 *)data.GetData(), data.GetDataLen(), wave_out)) {
+		detail = _T("cannot encode");
+		return false;
+	}
+	wxMemoryBuffer wave;
+	PsFileStrInput wave_in(wave_out);
+	wave_in.ReadAll(wave);
+	size_t frame = (param.mSampleBits == 16 ? 2 : 1);
+	size_t expected = 44 + (size_t)encoder.CountSamples(data.GetDataLen()) * frame;
+	if (wave.GetDataLen() != expected) {
+		detail = wxString::Format(_T("wave length %lu, expected %lu"), (unsigned long)wave.GetDataLen(), (unsigned long)expected);
+		return false;
+	}
+	if (scale != 100 || offset != 0) {
+		ChangeLevel(param, scale, offset, wave);
+	}
+
+	L3WaveDecoder decoder(param);
+	BinString wave_str((const wxUint8 *)wave.GetData(), wave.GetDataLen());
+	PsFileStrInput in(wave_str);
+	PsFileStrOutput out;
+	if (!decoder.Decode(in, out)) {
+		detail = _T("cannot decode");
+		return false;
+	}
+	wxMemoryBuffer decoded;
+	PsFileStrInput decoded_in(out);
+	decoded_in.ReadAll(decoded);
+	if (decoder.GetFramingErrors() > 0) {
+		detail = wxString::Format(_T("%lu framing errors"), (unsigned long)decoder.GetFramingErrors());
+		return false;
+	}
+	if (decoded.GetDataLen() != data.GetDataLen()) {
+		detail = wxString::Format(_T("decoded %lu bytes, expected %lu"), (unsigned long)decoded.GetDataLen(), (unsigned long)data.GetDataLen());
+		return false;
+	}
+	const wxUint8 *a = (const wxUint8 *)data.GetData();
+	const wxUint8 *b = (const wxUint8 *)decoded.GetData();
+	for(size_t i=0; i<data.GetDataLen(); i++) {
+		if (a[i] != b[i]) {
+			detail = wxString::Format(_T("mismatch at %lu: %02x, expected %02x"), (unsigned long)i, b[i], a[i]);
+			return false;
+		}
+	}
+	detail = wxString::Format(_T("%lu bytes"), (unsigned long)decoded.GetDataLen());
+	return true;
+}
+
+/// 0(1200Hz)と1(2400Hz)の波形をどちらも使うバイト列
+static void MakeWaveData(wxMemoryBuffer &data)
+{
+	for(int i=0; i<256; i++) {
+		data.AppendByte((char)i);
+	}
+	static const wxUint8 cPattern[] = { 0x00, 0xff, 0x55, 0xaa, 0x0f, 0xf0 };
+	data.AppendData(cPattern, sizeof(cPattern));
+}
+
+/// テープの音声(WAV)の書き出しと復調
+///
+/// 既定の形式(600ボー、リーダ600ビット、トレーラ60ビット)で、
+/// 0(1200Hz)と1(2400Hz)の波形をどちらも使うバイト列を8ビットと16ビットで往復させる。
+void BenchVerifier::VerifyWave()
+{
+	wxMemoryBuffer data;
+	MakeWaveData(data);
+
+	static const int cBits[] = { 8, 16 };
+	for(size_t i=0; i<sizeof(cBits)/sizeof(cBits[0]); i++) {
+		L3WaveParam param;
+		param.mSampleBits = cBits[i];
+		wxString detail;
+		bool ok = WaveRoundTrip(param, data, 100, 0, detail);
+		AddResult(_T("wave"), wxString::Format(_T("%dbit"), cBits[i]), ok, detail);
+	}
+}
+
+/// 振幅や直流分が違う音声の復調
+///
+/// 書き出した音声の振幅を変えたり直流分を加えたりしてから復調する。
+/// 録音レベルが低い、大きすぎて振り切れている、中心がずれている場合を想定する。
+void BenchVerifier::VerifyWaveLevels()
+{
+	wxMemoryBuffer data;
+	MakeWaveData(data);
+
+	static const struct {
+		const char *name;
+		int scale;
+		int offset;
+	} cLevels[] = {
+		{ "quiet",		10,		0 },
+		{ "loud",		200,	0 },
+		{ "dc+",		50,		12000 },
+		{ "dc-",		50,		-12000 },
+		{ "loud_dc+",	150,	8000 },
+		{ NULL, 0, 0 }
+	};
+	static const int cBits[] = { 8, 16 };
+	for(size_t i=0; i<sizeof(cBits)/sizeof(cBits[0]); i++) {
+		L3WaveParam param;
+		param.mSampleBits = cBits[i];
+		for(int n=0; cLevels[n].name != NULL; n++) {
+			wxString detail;
+			bool ok = WaveRoundTrip(param, data, cLevels[n].scale, cLevels[n].offset, detail);
+			AddResult(_T("wave_level"), wxString::Format(_T("%dbit_%s"), cBits[i], cLevels[n].name), ok, detail);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// L3/S1のDISK BASICの空のディスク
+///
+/// 全トラックを同じ構成でフォーマットし、管理トラックのクラスタをFATで予約する。
+/// @param[in]  layout ディスクの構成
+/// @param[in]  tracks トラック数
+/// @param[out] image  D88形式のイメージ
+static void verify_make_l3_disk(const L3DiskLayout &layout, int tracks, wxMemoryBuffer &image)
+{
+	size_t sector_len = D88_SECTOR_HEADER_SIZE + (size_t)layout.mSectorSize;
+	size_t track_len = sector_len * layout.mSectorsPerTrack;
+	size_t size = D88_HEADER_SIZE + track_len * tracks;
+	int n = 0;
+	while((128 << n) < layout.mSectorSize) n++;
+
+	wxUint8 *p = (wxUint8 *)image.GetWriteBuf(size);
+	memset(p, 0, D88_HEADER_SIZE);
+	memcpy(p, "VERIFY", 6);
+	verify_set_le32(&p[0x1c], (wxUint32)size);
+	for(int t=0; t<tracks; t++) {
+		size_t pos = D88_HEADER_SIZE + track_len * t;
+		verify_set_le32(&p[0x20 + t * 4], (wxUint32)pos);
+		for(int s=0; s<layout.mSectorsPerTrack; s++, pos += sector_len) {
+			wxUint8 *h = &p[pos];
+			memset(h, 0, D88_SECTOR_HEADER_SIZE);
+			h[0] = (wxUint8)(t / 2);
+			h[1] = (wxUint8)(t % 2);
+			h[2] = (wxUint8)(s + 1);
+			h[3] = (wxUint8)n;
+			verify_set_le16(&h[4], (wxUint32)layout.mSectorsPerTrack);
+			verify_set_le16(&h[0x0e], (wxUint32)layout.mSectorSize);
+			// 管理トラックは未使用のディレクトリとFAT
+			memset(&h[D88_SECTOR_HEADER_SIZE], t == layout.mDirTrack ? 0xff : 0xe5, layout.mSectorSize);
+		}
+	}
+	int per_track = layout.GetClustersPerTrack();
+	for(int i=0; i<layout.mFatCopies; i++) {
+		size_t pos = D88_HEADER_SIZE + track_len * layout.mDirTrack + sector_len * (layout.mFatSector - 1 + i) + D88_SECTOR_HEADER_SIZE;
+		memset(&p[pos + layout.mDirTrack * per_track], L3DISK_FAT_RESERVED, per_track);
+	}
+	image.UngetWriteBuf(size);
+}
+
+/// ファイルの一覧 "名前.拡張子,..."
+static wxString verify_list_l3(const L3DiskBasic &disk)
+{
+	wxString list;
+	for(size_t i=0; i<disk.Count(); i++) {
+		if (i > 0) list += _T(",");
+		list += disk.GetName(i);
+		if (disk[i].broken) list += _T("(broken)");
+	}
+	return list;
+}
+
+/// ファイル名で探す
+static int verify_find_l3(const L3DiskBasic &disk, const wxString &name, const wxString &ext)
+{
+	wxUint8 raw_name[L3DISK_NAME_LEN + L3DISK_EXT_LEN];
+	L3DiskBasic::MakeRawName(name, ext, raw_name);
+	return disk.FindFile(raw_name);
+}
+
+/// 一覧、空きクラスタ数、FATの複製を確かめる
+/// @param[in]  disk          ディスク
+/// @param[in]  list          期待する一覧
+/// @param[in]  free_clusters 期待する空きクラスタ数
+/// @param[out] detail        今の状態
+static bool verify_l3_state(L3DiskBasic &disk, const wxString &list, int free_clusters, wxString &detail)
+{
+	wxString cur = verify_list_l3(disk);
+	detail = wxString::Format(_T("[%s] %d free"), cur, disk.GetFreeClusters());
+	if (cur != list || disk.GetFreeClusters() != free_clusters) {
+		detail += wxString::Format(_T(", expected [%s] %d free"), list, free_clusters);
+		return false;
+	}
+	// FATの複製は最初のFATと同じ
+	const L3DiskLayout &layout = disk.GetLayout();
+	D88Disk &d88 = disk.GetDisk();
+	const D88Sector *first = d88.FindSector(layout.mDirTrack, layout.mFatSector);
+	for(int i=1; i<layout.mFatCopies; i++) {
+		const D88Sector *sector = d88.FindSector(layout.mDirTrack, layout.mFatSector + i);
+		if (!first || !sector || memcmp(d88.GetSectorData(first), d88.GetSectorData(sector), disk.GetClusterCount()) != 0) {
+			detail += wxString::Format(_T(", FAT copy %d differs"), i + 1);
+			return false;
+		}
+	}
+	return true;
+}
+
+/// ファイルを取り出して比べる
+static bool verify_extract_l3(const L3DiskBasic &disk, const wxString &name, const wxString &ext, const wxString &out_path, const wxMemoryBuffer &expected, wxString &detail)
+{
+	int idx = verify_find_l3(disk, name, ext);
+	if (idx < 0) {
+		detail = name + _T(".") + ext + _T(" not found");
+		return false;
+	}
+	if (!disk.ExtractTo(idx, out_path)) {
+		detail = _T("cannot extract ") + disk.GetName(idx);
+		return false;
+	}
+	return verify_check_extracted(out_path, expected, detail);
+}
+
+/// L3/S1のDISK BASICのディスクへの書き込みと削除
+///
+/// 空のディスクにアスキー形式と中間言語のファイルを書き、一覧、取り出し、置き換え、削除を確かめる。
+/// 空きクラスタがないときは書き込みに失敗してイメージが変わらないこと、
+/// 空きがなくても置き換えるファイルのクラスタに収まれば置き換えられることも確かめる。
+void BenchVerifier::VerifyL3Disk()
+{
+	const wxString name = _T("l3disk");
+	wxString path = AddWorkFile(_T("verify_l3.d88"));
+	wxString out_path = AddWorkFile(_T("verify_l3.out"));
+	wxString detail;
+	bool ok;
+
+	L3DiskLayout layout;
+	size_t cluster_size = (size_t)layout.mSectorsPerCluster * layout.mSectorSize;
+	wxMemoryBuffer image;
+	verify_make_l3_disk(layout, 40, image);
+	if (!AddResult(name, _T("create"), verify_write_file(path, image), path)) return;
+
+	L3DiskBasic disk;
+	ok = disk.Open(path, true);
+	int all_free = disk.GetFreeClusters();
+	ok = ok && disk.Count() == 0 && all_free == disk.GetClusterCount() - layout.GetClustersPerTrack();
+	if (!AddResult(name, _T("open"), ok, wxString::Format(_T("%d free clusters"), all_free))) return;
+
+	// 書き込んで開きなおす
+	wxMemoryBuffer text, bin, bin_padded;
+	verify_make_file_data(1, 3000, true, text);
+	verify_make_file_data(2, 5000, false, bin);
+	verify_pad_data(bin, layout.mSectorSize, bin_padded);
+	int used_text = disk.GetRequiredClusters(text.GetDataLen(), true);
+	int used_bin = disk.GetRequiredClusters(bin.GetDataLen(), false);
+	detail = _T("cannot save");
+	ok = disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text.GetData(), text.GetDataLen(), true)
+		&& disk.SaveBasicFile(_T("data"), _T("bin"), (const wxUint8 *)bin.GetData(), bin.GetDataLen(), false);
+	disk.Close();
+	ok = ok && disk.Open(path, true)
+		&& verify_l3_state(disk, _T("PROG.BAS,DATA.BIN"), all_free - used_text - used_bin, detail);
+	if (!AddResult(name, _T("save"), ok, detail)) return;
+
+	// 中間言語は最後のセクタの残りが00になる
+	ok = verify_extract_l3(disk, _T("PROG"), _T("BAS"), out_path, text, detail)
+		&& verify_extract_l3(disk, _T("DATA"), _T("BIN"), out_path, bin_padded, detail);
+	if (ok && (!disk.IsAscii(0) || disk.IsAscii(1))) {
+		detail = _T("wrong attributes");
+		ok = false;
+	}
+	if (!AddResult(name, _T("extract"), ok, detail)) return;
+
+	// 大きいファイルで置き換える
+	wxMemoryBuffer text2;
+	verify_make_file_data(3, 20000, true, text2);
+	int used_text2 = disk.GetRequiredClusters(text2.GetDataLen(), true);
+	detail = _T("cannot replace");
+	ok = disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text2.GetData(), text2.GetDataLen(), true)
+		&& verify_l3_state(disk, _T("PROG.BAS,DATA.BIN"), all_free - used_text2 - used_bin, detail)
+		&& verify_extract_l3(disk, _T("PROG"), _T("BAS"), out_path, text2, detail);
+	if (!AddResult(name, _T("replace"), ok, detail)) return;
+
+	// 削除して開きなおす
+	int idx = verify_find_l3(disk, _T("DATA"), _T("BIN"));
+	detail = _T("cannot delete");
+	ok = (idx >= 0 && disk.DeleteFile(idx));
+	disk.Close();
+	ok = ok && disk.Open(path, true)
+		&& verify_l3_state(disk, _T("PROG.BAS"), all_free - used_text2, detail);
+	if (!AddResult(name, _T("delete"), ok, detail)) return;
+
+	// 空きクラスタをすべて使う
+	wxMemoryBuffer fill;
+	verify_make_file_data(4, (size_t)disk.GetFreeClusters() * cluster_size, false, fill);
+	detail = _T("cannot fill");
+	ok = disk.SaveBasicFile(_T("fill"), _T("bin"), (const wxUint8 *)fill.GetData(), fill.GetDataLen(), false)
+		&& verify_l3_state(disk, _T("PROG.BAS,FILL.BIN"), 0, detail)
+		&& verify_extract_l3(disk, _T("FILL"), _T("BIN"), out_path, fill, detail);
+	if (!AddResult(name, _T("fill"), ok, detail)) return;
+
+	// 空きがないときは書き込めず、イメージも変わらない
+	wxMemoryBuffer before, after, one;
+	verify_make_file_data(5, 1, false, one);
+	detail = _T("saved on a full disk");
+	ok = verify_read_file(path, before)
+		&& !disk.SaveBasicFile(_T("extra"), _T("bin"), (const wxUint8 *)one.GetData(), one.GetDataLen(), false)
+		&& verify_read_file(path, after)
+		&& verify_same_data(after, before, detail)
+		&& verify_l3_state(disk, _T("PROG.BAS,FILL.BIN"), 0, detail);
+	if (!AddResult(name, _T("full"), ok, detail)) return;
+
+	// 空きがなくても置き換えるファイルのクラスタに収まれば置き換えられる
+	wxMemoryBuffer text3;
+	verify_make_file_data(6, 10000, true, text3);
+	int used_text3 = disk.GetRequiredClusters(text3.GetDataLen(), true);
+	detail = _T("cannot replace on a full disk");
+	ok = disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text3.GetData(), text3.GetDataLen(), true)
+		&& verify_l3_state(disk, _T("PROG.BAS,FILL.BIN"), used_text2 - used_text3, detail)
+		&& verify_extract_l3(disk, _T("PROG"), _T("BAS"), out_path, text3, detail);
+	if (!AddResult(name, _T("full_replace"), ok, detail)) return;
+
+	// 収まらないときは置き換えず、元のファイルが残る
+	wxMemoryBuffer text4;
+	verify_make_file_data(7, (size_t)used_text2 * cluster_size, true, text4);
+	detail = _T("replaced beyond free clusters");
+	ok = verify_read_file(path, before)
+		&& !disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text4.GetData(), text4.GetDataLen(), true)
+		&& verify_read_file(path, after)
+		&& verify_same_data(after, before, detail)
+		&& verify_l3_state(disk, _T("PROG.BAS,FILL.BIN"), used_text2 - used_text3, detail)
+		&& verify_extract_l3(disk, _T("PROG"), _T("BAS"), out_path, text3, detail);
+	if (!AddResult(name, _T("full_replace_larger"), ok, detail)) return;
+
+	// すべて削除すると最初の空きに戻る
+	detail = _T("cannot delete");
+	ok = true;
+	while(ok && disk.Count() > 0) {
+		ok = disk.DeleteFile(0);
+	}
+	disk.Close();
+	ok = ok && disk.Open(path, true)
+		&& verify_l3_state(disk, wxEmptyString, all_free, detail);
+	AddResult(name, _T("delete_all"), ok, detail);
+	disk.Close();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// MSX-DOSの空のディスク
+///
+/// ブートセクタにBPBを入れ、すべてのFATの先頭をメディアの種類とFFFFにする。
+/// @param[in]  bpb   ディスクの構成
+/// @param[out] image ベタのイメージ
+static void verify_make_msx_disk(const MsxDiskBpb &bpb, wxMemoryBuffer &image)
+{
+	size_t size = (size_t)bpb.mTotalSectors * bpb.mBytesPerSector;
+	wxUint8 *p = (wxUint8 *)image.GetWriteBuf(size);
+	memset(p, 0, size);
+	p[0] = 0xeb;
+	p[1] = 0xfe;
+	p[2] = 0x90;
+	memcpy(&p[3], "VERIFY  ", 8);
+	verify_set_le16(&p[0x0b], (wxUint32)bpb.mBytesPerSector);
+	p[0x0d] = (wxUint8)bpb.mSectorsPerCluster;
+	verify_set_le16(&p[0x0e], (wxUint32)bpb.mReservedSectors);
+	p[0x10] = (wxUint8)bpb.mFats;
+	verify_set_le16(&p[0x11], (wxUint32)bpb.mRootEntries);
+	verify_set_le16(&p[0x13], (wxUint32)bpb.mTotalSectors);
+	p[0x15] = (wxUint8)bpb.mMedia;
+	verify_set_le16(&p[0x16], (wxUint32)bpb.mSectorsPerFat);
+	for(int i=0; i<bpb.mFats; i++) {
+		wxUint8 *fat = &p[bpb.GetFatPos(i)];
+		fat[0] = (wxUint8)bpb.mMedia;
+		fat[1] = 0xff;
+		fat[2] = 0xff;
+	}
+	image.UngetWriteBuf(size);
+}
+
+/// FAT12の値を取り出す
+static int verify_fat12(const wxUint8 *fat, int n)
+{
+	const wxUint8 *q = &fat[n + n / 2];
+	if (n & 1) {
+		return (q[0] >> 4) | (q[1] << 4);
+	}
+	return q[0] | ((q[1] & 0x0f) << 8);
+}
+
+/// ファイルの一覧 "名前.拡張子,..."
+static wxString verify_list_msx(const MsxDisk &disk)
+{
+	wxString list;
+	for(size_t i=0; i<disk.Count(); i++) {
+		if (i > 0) list += _T(",");
+		list += disk.GetName(i);
+		if (disk[i].broken) list += _T("(broken)");
+	}
+	return list;
+}
+
+/// ファイル名で探す
+static int verify_find_msx(const MsxDisk &disk, const wxString &name, const wxString &ext)
+{
+	wxUint8 raw_name[MSXDISK_NAME_LEN + MSXDISK_EXT_LEN];
+	MsxDisk::MakeRawName(name, ext, raw_name);
+	return disk.FindFile(raw_name);
+}
+
+/// 一覧、空きクラスタ数、FATを確かめる
+///
+/// FATはイメージから12ビットずつ取り出しなおし、先頭のメディアの種類、空きクラスタ数、
+/// ファイルごとのつながりと終わりの値(FFF)を確かめる。FATの複製は最初のFATと同じであること。
+/// @param[in]  disk          ディスク
+/// @param[in]  list          期待する一覧
+/// @param[in]  free_clusters 期待する空きクラスタ数
+/// @param[out] detail        今の状態
+static bool verify_msx_state(MsxDisk &disk, const wxString &list, int free_clusters, wxString &detail)
+{
+	wxString cur = verify_list_msx(disk);
+	detail = wxString::Format(_T("[%s] %d free"), cur, disk.GetFreeClusters());
+	if (cur != list || disk.GetFreeClusters() != free_clusters) {
+		detail += wxString::Format(_T(", expected [%s] %d free"), list, free_clusters);
+		return false;
+	}
+
+	const MsxDiskBpb &bpb = disk.GetBpb();
+	const wxUint8 *data = disk.GetFile().GetData();
+	const wxUint8 *fat = &data[bpb.GetFatPos(0)];
+	size_t fat_len = (size_t)bpb.mSectorsPerFat * bpb.mBytesPerSector;
+	for(int i=1; i<bpb.mFats; i++) {
+		if (memcmp(fat, &data[bpb.GetFatPos(i)], fat_len) != 0) {
+			detail += wxString::Format(_T(", FAT copy %d differs"), i + 1);
+			return false;
+		}
+	}
+	if (fat[0] != bpb.mMedia || fat[1] != 0xff || fat[2] != 0xff) {
+		detail += _T(", FAT header changed");
+		return false;
+	}
+	int clusters = disk.GetClusterCount() + 2;
+	int free_count = 0;
+	for(int n=2; n<clusters; n++) {
+		if (verify_fat12(fat, n) == MSXDISK_FAT_FREE) free_count++;
+	}
+	if (free_count != free_clusters) {
+		detail += wxString::Format(_T(", FAT12 has %d free"), free_count);
+		return false;
+	}
+	for(size_t i=0; i<disk.Count(); i++) {
+		const MsxDiskFile &file = disk[i];
+		int n = file.first_cluster;
+		int count = 0;
+		int next = 0;
+		while(n >= 2 && n < clusters && count < clusters) {
+			count++;
+			next = verify_fat12(fat, n);
+			if (next >= MSXDISK_FAT_LAST) break;
+			n = next;
+		}
+		if (count != file.clusters || next != 0xfff) {
+			detail += wxString::Format(_T(", FAT12 chain of %s has %d clusters, ends with %03x"), disk.GetName(i), count, next);
+			return false;
+		}
+	}
+	return true;
+}
+
+/// ファイルを取り出して比べる
+static bool verify_extract_msx(const MsxDisk &disk, const wxString &name, const wxString &ext, const wxString &out_path, const wxMemoryBuffer &expected, wxString &detail)
+{
+	int idx = verify_find_msx(disk, name, ext);
+	if (idx < 0) {
+		detail = name + _T(".") + ext + _T(" not found");
+		return false;
+	}
+	if (!disk.ExtractTo(idx, out_path)) {
+		detail = _T("cannot extract ") + disk.GetName(idx);
+		return false;
+	}
+	return verify_check_extracted(out_path, expected, detail);
+}
+
+/// MSX-DOSのディスクへの書き込みと削除
+///
+/// L3/S1と同じ手順で書き込み、一覧、取り出し、置き換え、削除と空きがない場合を確かめる。
+/// 書き込むたびに12ビットのFATを読みなおし、2つのFATが同じであることも確かめる。
+/// 途中を削除してから書くので、つながりが飛んでいるファイルも取り出す。
+void BenchVerifier::VerifyMsxDisk()
+{
+	const wxString name = _T("msxdisk");
+	wxString path = AddWorkFile(_T("verify_msx.dsk"));
+	wxString out_path = AddWorkFile(_T("verify_msx.out"));
+	wxString detail;
+	bool ok;
+
+	MsxDiskBpb bpb;
+	size_t cluster_size = bpb.GetClusterSize();
+	wxMemoryBuffer image;
+	verify_make_msx_disk(bpb, image);
+	if (!AddResult(name, _T("create"), verify_write_file(path, image), path)) return;
+
+	MsxDisk disk;
+	ok = disk.Open(path, true);
+	int all_free = disk.GetFreeClusters();
+	ok = ok && disk.Count() == 0 && all_free == disk.GetClusterCount();
+	if (!AddResult(name, _T("open"), ok, wxString::Format(_T("%d free clusters"), all_free))) return;
+
+	// 書き込んで開きなおす
+	wxMemoryBuffer text, bin;
+	verify_make_file_data(1, 3000, true, text);
+	verify_make_file_data(2, 5000, false, bin);
+	int used_text = disk.GetRequiredClusters(text.GetDataLen());
+	int used_bin = disk.GetRequiredClusters(bin.GetDataLen());
+	detail = _T("cannot save");
+	ok = disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text.GetData(), text.GetDataLen(), true)
+		&& disk.SaveBasicFile(_T("data"), _T("bin"), (const wxUint8 *)bin.GetData(), bin.GetDataLen(), false);
+	disk.Close();
+	ok = ok && disk.Open(path, true)
+		&& verify_msx_state(disk, _T("PROG.BAS,DATA.BIN"), all_free - used_text - used_bin, detail);
+	if (!AddResult(name, _T("save"), ok, detail)) return;
+
+	// 種類はデータの先頭で決まる
+	ok = verify_extract_msx(disk, _T("PROG"), _T("BAS"), out_path, text, detail)
+		&& verify_extract_msx(disk, _T("DATA"), _T("BIN"), out_path, bin, detail);
+	if (ok && (disk[0].file_type != MSXDISK_ASCII || disk[1].file_type != MSXDISK_BASIC)) {
+		detail = _T("wrong file types");
+		ok = false;
+	}
+	if (!AddResult(name, _T("extract"), ok, detail)) return;
+
+	// 大きいファイルで置き換える
+	wxMemoryBuffer text2;
+	verify_make_file_data(3, 20000, true, text2);
+	int used_text2 = disk.GetRequiredClusters(text2.GetDataLen());
+	detail = _T("cannot replace");
+	ok = disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text2.GetData(), text2.GetDataLen(), true)
+		&& verify_msx_state(disk, _T("PROG.BAS,DATA.BIN"), all_free - used_text2 - used_bin, detail)
+		&& verify_extract_msx(disk, _T("PROG"), _T("BAS"), out_path, text2, detail);
+	if (!AddResult(name, _T("replace"), ok, detail)) return;
+
+	// 削除して開きなおす
+	int idx = verify_find_msx(disk, _T("DATA"), _T("BIN"));
+	detail = _T("cannot delete");
+	ok = (idx >= 0 && disk.DeleteFile(idx));
+	disk.Close();
+	ok = ok && disk.Open(path, true)
+		&& verify_msx_state(disk, _T("PROG.BAS"), all_free - used_text2, detail);
+	if (!AddResult(name, _T("delete"), ok, detail)) return;
+
+	// 空きクラスタをすべて使う 削除したところから書くのでつながりが飛ぶ
+	wxMemoryBuffer fill;
+	verify_make_file_data(4, (size_t)disk.GetFreeClusters() * cluster_size, false, fill);
+	detail = _T("cannot fill");
+	ok = disk.SaveBasicFile(_T("fill"), _T("bin"), (const wxUint8 *)fill.GetData(), fill.GetDataLen(), false)
+		&& verify_msx_state(disk, _T("PROG.BAS,FILL.BIN"), 0, detail)
+		&& verify_extract_msx(disk, _T("FILL"), _T("BIN"), out_path, fill, detail);
+	if (!AddResult(name, _T("fill"), ok, detail)) return;
+
+	// 空きがないときは書き込めず、イメージも変わらない
+	wxMemoryBuffer before, after, one;
+	verify_make_file_data(5, 1, false, one);
+	detail = _T("saved on a full disk");
+	ok = verify_read_file(path, before)
+		&& !disk.SaveBasicFile(_T("extra"), _T("bin"), (const wxUint8 *)one.GetData(), one.GetDataLen(), false)
+		&& verify_read_file(path, after)
+		&& verify_same_data(after, before, detail)
+		&& verify_msx_state(disk, _T("PROG.BAS,FILL.BIN"), 0, detail);
+	if (!AddResult(name, _T("full"), ok, detail)) return;
+
+	// 空きがなくても置き換えるファイルのクラスタに収まれば置き換えられる
+	wxMemoryBuffer text3;
+	verify_make_file_data(6, 10000, true, text3);
+	int used_text3 = disk.GetRequiredClusters(text3.GetDataLen());
+	detail = _T("cannot replace on a full disk");
+	ok = disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text3.GetData(), text3.GetDataLen(), true)
+		&& verify_msx_state(disk, _T("PROG.BAS,FILL.BIN"), used_text2 - used_text3, detail)
+		&& verify_extract_msx(disk, _T("PROG"), _T("BAS"), out_path, text3, detail);
+	if (!AddResult(name, _T("full_replace"), ok, detail)) return;
+
+	// 収まらないときは置き換えず、元のファイルが残る
+	wxMemoryBuffer text4;
+	verify_make_file_data(7, (size_t)used_text2 * cluster_size + 1, true, text4);
+	detail = _T("replaced beyond free clusters");
+	ok = verify_read_file(path, before)
+		&& !disk.SaveBasicFile(_T("prog"), _T("bas"), (const wxUint8 *)text4.GetData(), text4.GetDataLen(), true)
+		&& verify_read_file(path, after)
+		&& verify_same_data(after, before, detail)
+		&& verify_msx_state(disk, _T("PROG.BAS,FILL.BIN"), used_text2 - used_text3, detail)
+		&& verify_extract_msx(disk, _T("PROG"), _T("BAS"), out_path, text3, detail);
+	if (!AddResult(name, _T("full_replace_larger"), ok, detail)) return;
+
+	// すべて削除すると最初の空きに戻る
+	detail = _T("cannot delete");
+	ok = true;
+	while(ok && disk.Count() > 0) {
+		ok = disk.DeleteFile(0);
+	}
+	disk.Close();
+	ok = ok && disk.Open(path, true)
+		&& verify_msx_state(disk, wxEmptyString, all_free, detail);
+	AddResult(name, _T("delete_all"), ok, detail);
+	disk.Close();
+}
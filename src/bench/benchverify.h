@@ -0,0 +1,66 @@
+﻿/// @file benchverify.h
+///
+/// @brief 変換処理の往復の検証
+///
+#ifndef _BENCHVERIFY_H_
+#define _BENCHVERIFY_H_
+
+#include "../common.h"
+#include <wx/wx.h>
+#include <wx/buffer.h>
+
+class L3WaveParam;
+
+/// 書き出したものを読み戻して元と同じになるかを調べる
+///
+/// 結果は検証ごとに名前、成否、内容を1件ずつ記録する。
+/// 作業ファイルは作業ディレクトリに作り、パスをファイル一覧に追加する。
+class BenchVerifier
+{
+private:
+	wxString mWorkDir;			///< 作業ディレクトリ
+	wxArrayString *pWorkFiles;	///< 作ったファイルの一覧
+
+	/// @name 結果
+	//@{
+	wxArrayString mNames;
+	wxArrayString mCases;
+	wxArrayInt mResults;
+	wxArrayString mDetails;
+	//@}
+
+	/// 結果を追加
+	bool AddResult(const wxString &name, const wxString &case_name, bool ok, const wxString &detail);
+
+	/// サンプルの振幅と直流分を変える
+	static void ChangeLevel(const L3WaveParam &param, int scale, int offset, wxMemoryBuffer &wave);
+	/// テープイメージを音声にして復調する
+	bool WaveRoundTrip(const L3WaveParam &param, const wxMemoryBuffer &data, int scale, int offset, wxString &detail);
+
+	/// 作業ファイルのパス
+	wxString AddWorkFile(const wxString &name);
+
+public:
+	BenchVerifier(const wxString &work_dir, wxArrayString &work_files);
+
+	/// テープの音声(WAV)の書き出しと復調
+	void VerifyWave();
+	/// 振幅や直流分が違う音声の復調
+	void VerifyWaveLevels();
+	/// L3/S1のDISK BASICのディスクへの書き込みと削除
+	void VerifyL3Disk();
+	/// MSX-DOSのディスクへの書き込みと削除
+	void VerifyMsxDisk();
+
+	size_t Count() const { return mNames.Count(); }
+	const wxString &GetName(size_t idx) const { return mNames[idx]; }
+	const wxString &GetCase(size_t idx) const { return mCases[idx]; }
+	bool IsOk(size_t idx) const { return (mResults[idx] != 0); }
+	const wxString &GetDetail(size_t idx) const { return mDetails[idx]; }
+	/// 失敗した数
+	size_t GetFailures() const;
+
+	DECLARE_NO_COPY_CLASS(BenchVerifier)
+};
+
+#endif /* _BENCHVERIFY_H_ */
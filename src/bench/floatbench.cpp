@@ -0,0 +1,1203 @@
+﻿/// @file floatbench.cpp
+///
+/// @brief 実数変換(L3Float/UINT192)のベンチマークと検証
+///
+/// bench : 各変換関数の1回あたりの処理時間を計測してJSON Linesで出力する。
+/// verify: 4バイト実数の全パターンと8バイト実数のサンプルを
+///         バイト列→文字列→バイト列と変換して、一致しないものを報告する。
+///         さらに文字列→バイト列とやり直して値が変わらないことを確かめる。
+///         結果のダイジェストを出力するので、関数を変更した前後で比較できる。
+/// uint192: UINT192の各操作を以前の実装(UINT192Ref)と比較する。
+/// msxbcd : MSXの単精度BCDの全パターンと倍精度BCDのサンプルを
+///          バイト列→文字列→バイト列と変換して比較する。
+///
+/// L3Float/UINT192/DeciStr/MSXBcdのみを使うのでwxWidgetsは不要。
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "../l3float.h"
+#include "uint192ref.h"
+#include "../msxbcd.h"
+
+/// 検証結果の例を保存する数
+#define FLOAT_VERIFY_SAMPLES	8
+/// 1スレッドが一度に処理するパターン数
+#define FLOAT_VERIFY_CHUNK		0x10000
+
+/// 乱数(xorshift64)
+static unsigned long long xorshift64(unsigned long long &state)
+{
+	state ^= (state << 13);
+	state ^= (state >> 7);
+	state ^= (state << 17);
+	return state;
+}
+
+/// バイト列を10進文字列にする
+/// ParseL3S1Basic::FloatBytesToStr と同じ手順
+static void float_to_str(const unsigned char *src, int size, DeciStr &decs)
+{
+	L3Float::RealStrToDeciStr(src, size, size > 4 ? 16 : 6, decs);
+}
+
+/// 10進文字列をバイト列にする
+/// ParseL3S1Basic::NumStrToBytes の実数部分と同じ手順
+/// @param[in]  str  10進文字列
+/// @param[in]  len  文字列長さ
+/// @param[out] dst  バイト列(8バイト以上)
+/// @param[out] err  1:オーバーフロー 2:アンダーフロー
+/// @return バイト数 4 or 8
+static int str_to_float(const char *str, int len, unsigned char *dst, int &err)
+{
+	int bytes = 0;
+	memset(dst, 0, 8);
+	err = L3Float::DeciStrToRealStr(str, len, dst, bytes);
+	return bytes;
+}
+
+/// バイト列を10進文字列にする(UINT192のみ)
+static void float_to_str_uint192(const unsigned char *src, int size, DeciStr &decs)
+{
+	UINT192 cin;
+	UINT192 cpo;
+	L3Float::RealStrToUint192(src, size, cin, cpo);
+	L3Float::Uint192ToDeciStr(cin, cpo, size > 4 ? 16 : 6, decs);
+}
+
+/// 10進文字列をバイト列にする(UINT192のみ)
+static int str_to_float_uint192(const char *str, int len, unsigned char *dst, int &err)
+{
+	UINT192 cin;
+	UINT192 cpo;
+	int bytes = L3Float::DeciStrToUint192(str, len, cin, cpo) * 4;
+	memset(dst, 0, 8);
+	err = L3Float::Uint192ToRealStr(cin, cpo, dst, bytes);
+	return bytes;
+}
+
+/// 比較用に正規化する
+/// 符号は中間言語では別に持つので落とす。指数部0は値0。
+static void float_normalize(unsigned char *vals, int size)
+{
+	vals[1] &= 0x7f;
+	if (vals[0] == 0) {
+		memset(vals, 0, size);
+	}
+}
+
+/// 指数部と仮数部を一つの整数にする(ULP差の計算用)
+static unsigned long long float_to_ordinal(const unsigned char *vals, int size)
+{
+	unsigned long long v = 0;
+	for(int i=0; i<size; i++) {
+		v = (v << 8) | vals[i];
+	}
+	return v;
+}
+
+/// バイト列を16進文字列にする
+static std::string bytes_to_hex(const unsigned char *vals, int size)
+{
+	std::string str;
+	char buf[4];
+	for(int i=0; i<size; i++) {
+		sprintf(buf, "%02x", vals[i]);
+		str += buf;
+	}
+	return str;
+}
+
+/// ダイジェスト(FNV-1a)
+static unsigned long long fnv1a(unsigned long long h, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	for(size_t i=0; i<len; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// 検証結果の例
+struct FloatVerifySample {
+	std::string src;
+	std::string str;
+	std::string dst;
+	std::string str2;
+};
+
+/// 検証結果の集計
+class FloatVerifyResult
+{
+public:
+	/// 変換したパターン数
+	unsigned long long total;
+	/// 正規化でスキップしたパターン数 (指数部0で仮数部が0以外、符号付き)
+	unsigned long long skipped;
+	/// 完全に一致
+	unsigned long long exact;
+	/// 一致しない
+	unsigned long long mismatch;
+	/// 一致しないもののうち1ULP差
+	unsigned long long ulp1;
+	/// 最大ULP差
+	unsigned long long max_ulp;
+	/// 文字列に戻してからバイト列にすると値が変わる
+	unsigned long long unstable;
+	/// 文字列に戻すと最初の文字列と異なるが値は同じ (1E+15付近の表記の違いなど)
+	unsigned long long reformatted;
+	/// サイズが変わった(4→8など)
+	unsigned long long resized;
+	/// オーバーフロー、アンダーフロー
+	unsigned long long overflow;
+	unsigned long long underflow;
+	/// UINT192のみで変換した結果と異なる
+	unsigned long long uint192_diff;
+	/// 全パターンの変換結果のダイジェスト(順序に依存しない)
+	unsigned long long digest;
+	/// 例
+	std::vector<FloatVerifySample> mismatch_samples;
+	std::vector<FloatVerifySample> unstable_samples;
+	std::vector<FloatVerifySample> uint192_samples;
+
+	FloatVerifyResult();
+	/// 1パターン検証
+	void Verify(const unsigned char *src, int size);
+	/// 結果を足す
+	void Merge(const FloatVerifyResult &src);
+	/// JSONで出力
+	void Print(FILE *fp, const char *name, double secs) const;
+};
+
+FloatVerifyResult::FloatVerifyResult()
+{
+	total = 0;
+	skipped = 0;
+	exact = 0;
+	mismatch = 0;
+	ulp1 = 0;
+	max_ulp = 0;
+	unstable = 0;
+	reformatted = 0;
+	resized = 0;
+	overflow = 0;
+	underflow = 0;
+	uint192_diff = 0;
+	digest = 0;
+}
+
+/// 1パターン検証
+/// バイト列→文字列→バイト列→文字列→バイト列と変換し、バイト列と文字列を比較する
+///
+/// 8バイトは16桁で表示するので最初のバイト列には戻らないことがある。
+/// 一度丸めた値が文字列を経由しても変わらなければ安定とする。
+/// @param[in] src  バイト列
+/// @param[in] size 4 or 8
+void FloatVerifyResult::Verify(const unsigned char *src, int size)
+{
+	unsigned char norm[8];
+	memcpy(norm, src, size);
+	float_normalize(norm, size);
+	if (memcmp(norm, src, size) != 0) {
+		// 正規化した値は別に検証する
+		skipped++;
+		return;
+	}
+	total++;
+
+	DeciStr decs;
+	float_to_str(src, size, decs);
+
+	unsigned char dst[8];
+	int err = 0;
+	int dst_size = str_to_float(decs.GetStr(0), decs.Length(), dst, err);
+	if (err == 1) overflow++;
+	else if (err == 2) underflow++;
+
+	DeciStr decs2;
+	float_to_str(dst, dst_size, decs2);
+
+	// 変換結果のダイジェスト 各パターンのハッシュを足していく
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	h = fnv1a(h, src, size);
+	h = fnv1a(h, decs.GetStr(0), decs.Length());
+	h = fnv1a(h, dst, dst_size);
+	digest += h;
+
+	// UINT192のみで変換した結果と比較
+	DeciStr udecs;
+	float_to_str_uint192(src, size, udecs);
+	unsigned char udst[8];
+	int uerr = 0;
+	int udst_size = str_to_float_uint192(decs.GetStr(0), decs.Length(), udst, uerr);
+	if (udecs.Length() != decs.Length() || memcmp(udecs.GetStr(0), decs.GetStr(0), decs.Length()) != 0
+		|| udst_size != dst_size || memcmp(udst, dst, dst_size) != 0 || uerr != err) {
+		uint192_diff++;
+		if (uint192_samples.size() < FLOAT_VERIFY_SAMPLES) {
+			FloatVerifySample usample;
+			usample.src = bytes_to_hex(src, size);
+			usample.str.assign(decs.GetStr(0), decs.Length());
+			usample.dst = bytes_to_hex(dst, dst_size);
+			usample.str2.assign(udecs.GetStr(0), udecs.Length());
+			usample.str2 += " ";
+			usample.str2 += bytes_to_hex(udst, udst_size);
+			uint192_samples.push_back(usample);
+		}
+	}
+
+	bool same_str = (decs.Length() == decs2.Length() && memcmp(decs.GetStr(0), decs2.GetStr(0), decs.Length()) == 0);
+	bool same_bytes = (dst_size == size && memcmp(src, dst, size) == 0);
+
+	// 表記が変わったときは値が変わらないか読み直して確かめる
+	unsigned char dst2[8];
+	int dst2_size = dst_size;
+	bool same_value = true;
+	if (!same_str) {
+		int err2 = 0;
+		dst2_size = str_to_float(decs2.GetStr(0), decs2.Length(), dst2, err2);
+		same_value = (dst2_size == dst_size && memcmp(dst, dst2, dst_size) == 0);
+	}
+
+	FloatVerifySample sample;
+	if (!same_bytes || !same_str) {
+		sample.src = bytes_to_hex(src, size);
+		sample.str.assign(decs.GetStr(0), decs.Length());
+		sample.dst = bytes_to_hex(dst, dst_size);
+		sample.str2.assign(decs2.GetStr(0), decs2.Length());
+		if (!same_value) {
+			sample.str2 += " ";
+			sample.str2 += bytes_to_hex(dst2, dst2_size);
+		}
+	}
+
+	if (same_bytes) {
+		exact++;
+	} else {
+		mismatch++;
+		if (dst_size != size) {
+			resized++;
+		} else {
+			unsigned long long a = float_to_ordinal(src, size);
+			unsigned long long b = float_to_ordinal(dst, size);
+			unsigned long long ulp = (a > b ? a - b : b - a);
+			if (ulp == 1) ulp1++;
+			if (max_ulp < ulp) max_ulp = ulp;
+		}
+		if (mismatch_samples.size() < FLOAT_VERIFY_SAMPLES) {
+			mismatch_samples.push_back(sample);
+		}
+	}
+	if (!same_value) {
+		unstable++;
+		if (unstable_samples.size() < FLOAT_VERIFY_SAMPLES) {
+			unstable_samples.push_back(sample);
+		}
+	} else if (!same_str) {
+		reformatted++;
+	}
+}
+
+/// 結果を足す
+void FloatVerifyResult::Merge(const FloatVerifyResult &src)
+{
+	total += src.total;
+	skipped += src.skipped;
+	exact += src.exact;
+	mismatch += src.mismatch;
+	ulp1 += src.ulp1;
+	if (max_ulp < src.max_ulp) max_ulp = src.max_ulp;
+	unstable += src.unstable;
+	reformatted += src.reformatted;
+	resized += src.resized;
+	overflow += src.overflow;
+	underflow += src.underflow;
+	uint192_diff += src.uint192_diff;
+	digest += src.digest;
+	for(size_t i=0; i<src.mismatch_samples.size() && mismatch_samples.size() < FLOAT_VERIFY_SAMPLES; i++) {
+		mismatch_samples.push_back(src.mismatch_samples[i]);
+	}
+	for(size_t i=0; i<src.unstable_samples.size() && unstable_samples.size() < FLOAT_VERIFY_SAMPLES; i++) {
+		unstable_samples.push_back(src.unstable_samples[i]);
+	}
+	for(size_t i=0; i<src.uint192_samples.size() && uint192_samples.size() < FLOAT_VERIFY_SAMPLES; i++) {
+		uint192_samples.push_back(src.uint192_samples[i]);
+	}
+}
+
+/// 例をJSON配列で出力
+static void print_samples(FILE *fp, const std::vector<FloatVerifySample> &samples)
+{
+	fprintf(fp, "[");
+	for(size_t i=0; i<samples.size(); i++) {
+		const FloatVerifySample &s = samples[i];
+		fprintf(fp, "%s{\"src\":\"%s\",\"str\":\"%s\",\"dst\":\"%s\",\"str2\":\"%s\"}"
+			, i > 0 ? "," : ""
+			, s.src.c_str(), s.str.c_str(), s.dst.c_str(), s.str2.c_str());
+	}
+	fprintf(fp, "]");
+}
+
+/// JSONで出力
+void FloatVerifyResult::Print(FILE *fp, const char *name, double secs) const
+{
+	fprintf(fp, "{\"mode\":\"verify\",\"set\":\"%s\",\"total\":%llu,\"skipped\":%llu"
+		",\"exact\":%llu,\"mismatch\":%llu,\"ulp1\":%llu,\"max_ulp\":%llu"
+		",\"unstable\":%llu,\"reformatted\":%llu,\"resized\":%llu,\"overflow\":%llu,\"underflow\":%llu"
+		",\"uint192_diff\":%llu,\"digest\":\"%016llx\",\"seconds\":%.3f"
+		, name, total, skipped
+		, exact, mismatch, ulp1, max_ulp
+		, unstable, reformatted, resized, overflow, underflow
+		, uint192_diff, digest, secs);
+	fprintf(fp, ",\"mismatch_samples\":");
+	print_samples(fp, mismatch_samples);
+	fprintf(fp, ",\"unstable_samples\":");
+	print_samples(fp, unstable_samples);
+	fprintf(fp, ",\"uint192_samples\":");
+	print_samples(fp, uint192_samples);
+	fprintf(fp, "}\n");
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// 検証の範囲と進捗
+struct FloatVerifyRange {
+	int size;
+	unsigned long long start;
+	unsigned long long count;
+	unsigned long long seed;
+	bool progress;
+	std::atomic<unsigned long long> next;
+	std::atomic<unsigned long long> done;
+	std::mutex lock;
+	FloatVerifyResult result;
+};
+
+/// 4バイトのパターンをチャンク単位で検証するスレッド
+static void verify_single_worker(FloatVerifyRange *range)
+{
+	FloatVerifyResult local;
+	for(;;) {
+		unsigned long long pos = range->next.fetch_add(FLOAT_VERIFY_CHUNK);
+		if (pos >= range->count) break;
+		unsigned long long end = pos + FLOAT_VERIFY_CHUNK;
+		if (end > range->count) end = range->count;
+		for(unsigned long long i = pos; i < end; i++) {
+			unsigned int pat = (unsigned int)(range->start + i);
+			unsigned char src[4];
+			src[0] = (pat >> 24) & 0xff;
+			src[1] = (pat >> 16) & 0xff;
+			src[2] = (pat >> 8) & 0xff;
+			src[3] = pat & 0xff;
+			local.Verify(src, 4);
+		}
+		unsigned long long done = range->done.fetch_add(end - pos) + (end - pos);
+		if (range->progress && (done / FLOAT_VERIFY_CHUNK) % 256 == 0) {
+			fprintf(stderr, "single: %llu / %llu\r", done, range->count);
+		}
+	}
+	std::lock_guard<std::mutex> guard(range->lock);
+	range->result.Merge(local);
+}
+
+/// 8バイトのパターンを乱数で作成して検証するスレッド
+/// 乱数の系列はチャンクの位置から作るのでスレッド数によらず同じ結果になる
+static void verify_double_worker(FloatVerifyRange *range)
+{
+	FloatVerifyResult local;
+	for(;;) {
+		unsigned long long pos = range->next.fetch_add(FLOAT_VERIFY_CHUNK);
+		if (pos >= range->count) break;
+		unsigned long long end = pos + FLOAT_VERIFY_CHUNK;
+		if (end > range->count) end = range->count;
+		unsigned long long state = (range->seed ^ (pos * 0x9e3779b97f4a7c15ULL)) | 1;
+		for(unsigned long long i = pos; i < end; i++) {
+			unsigned long long pat = xorshift64(state);
+			unsigned char src[8];
+			for(int n=0; n<8; n++) {
+				src[n] = (pat >> (56 - n * 8)) & 0xff;
+			}
+			// 符号ビットと指数部0は正規化しておく
+			float_normalize(src, 8);
+			local.Verify(src, 8);
+		}
+		unsigned long long done = range->done.fetch_add(end - pos) + (end - pos);
+		if (range->progress && (done / FLOAT_VERIFY_CHUNK) % 256 == 0) {
+			fprintf(stderr, "double: %llu / %llu\r", done, range->count);
+		}
+	}
+	std::lock_guard<std::mutex> guard(range->lock);
+	range->result.Merge(local);
+}
+
+/// スレッドを起動して検証する
+static void run_verify(FloatVerifyRange &range, int threads, const char *name)
+{
+	if (range.count == 0) return;
+
+	range.next = 0;
+	range.done = 0;
+
+	std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for(int i=0; i<threads; i++) {
+		workers.push_back(std::thread(range.size == 4 ? verify_single_worker : verify_double_worker, &range));
+	}
+	for(size_t i=0; i<workers.size(); i++) {
+		workers[i].join();
+	}
+
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+	if (range.progress) fprintf(stderr, "\n");
+
+	range.result.Print(stdout, name, secs);
+	fflush(stdout);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// ベンチマークの計測対象
+enum enFloatBenchKernels {
+	FLOAT_BENCH_REAL_TO_UINT192 = 0,
+	FLOAT_BENCH_UINT192_TO_DECI,
+	FLOAT_BENCH_DECI_TO_UINT192,
+	FLOAT_BENCH_UINT192_TO_REAL,
+	FLOAT_BENCH_REAL_TO_DECI,
+	FLOAT_BENCH_DECI_TO_REAL,
+	FLOAT_BENCH_ROUND_TRIP,
+	FLOAT_BENCH_KERNEL_COUNT
+};
+
+static const char *cFloatBenchKernels[FLOAT_BENCH_KERNEL_COUNT] = {
+	"RealStrToUint192",
+	"Uint192ToDeciStr",
+	"DeciStrToUint192",
+	"Uint192ToRealStr",
+	"RealStrToDeciStr",
+	"DeciStrToRealStr",
+	"RoundTrip",
+};
+
+/// 1つのサイズについて各関数を計測する
+/// @param[in] size    4 or 8
+/// @param[in] samples パターン数
+/// @param[in] iterations 繰り返し回数
+/// @param[in] seed    乱数の種
+static void run_bench(int size, int samples, int iterations, unsigned long long seed)
+{
+	// 入力パターンを作成
+	std::vector<unsigned char> pats(samples * size);
+	unsigned long long state = seed | 1;
+	for(int i=0; i<samples; i++) {
+		unsigned long long pat = xorshift64(state);
+		unsigned char *src = &pats[i * size];
+		for(int n=0; n<size; n++) {
+			src[n] = (pat >> (56 - n * 8)) & 0xff;
+		}
+		float_normalize(src, size);
+		// 0は計測にならないので指数部を入れる
+		if (src[0] == 0) src[0] = 0x81;
+	}
+
+	// 各段の入力を用意
+	std::vector<UINT192> cins(samples);
+	std::vector<UINT192> cpos(samples);
+	std::vector<DeciStr> strs(samples);
+	for(int i=0; i<samples; i++) {
+		L3Float::RealStrToUint192(&pats[i * size], size, cins[i], cpos[i]);
+		UINT192 cin(cins[i]);
+		UINT192 cpo(cpos[i]);
+		L3Float::Uint192ToDeciStr(cin, cpo, size > 4 ? 16 : 6, strs[i]);
+	}
+
+	for(int k=0; k<FLOAT_BENCH_KERNEL_COUNT; k++) {
+		unsigned long long sink = 0;
+		std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+		for(int it=0; it<iterations; it++) {
+			for(int i=0; i<samples; i++) {
+				const unsigned char *src = &pats[i * size];
+				switch(k) {
+				case FLOAT_BENCH_REAL_TO_UINT192:
+					{
+						UINT192 cin;
+						UINT192 cpo;
+						L3Float::RealStrToUint192(src, size, cin, cpo);
+						sink += cin.GetByte(0) + cpo.GetByte(UINT192_MAX_BYTE - 1);
+					}
+					break;
+				case FLOAT_BENCH_UINT192_TO_DECI:
+					{
+						UINT192 cin(cins[i]);
+						UINT192 cpo(cpos[i]);
+						DeciStr decs;
+						L3Float::Uint192ToDeciStr(cin, cpo, size > 4 ? 16 : 6, decs);
+						sink += decs.Length();
+					}
+					break;
+				case FLOAT_BENCH_DECI_TO_UINT192:
+					{
+						UINT192 cin;
+						UINT192 cpo;
+						sink += L3Float::DeciStrToUint192(strs[i].GetStr(0), strs[i].Length(), cin, cpo);
+					}
+					break;
+				case FLOAT_BENCH_UINT192_TO_REAL:
+					{
+						UINT192 cin(cins[i]);
+						UINT192 cpo(cpos[i]);
+						unsigned char dst[8];
+						L3Float::Uint192ToRealStr(cin, cpo, dst, size);
+						sink += dst[0];
+					}
+					break;
+				case FLOAT_BENCH_REAL_TO_DECI:
+					{
+						DeciStr decs;
+						L3Float::RealStrToDeciStr(src, size, size > 4 ? 16 : 6, decs);
+						sink += decs.Length();
+					}
+					break;
+				case FLOAT_BENCH_DECI_TO_REAL:
+					{
+						unsigned char dst[8];
+						int bytes = 0;
+						L3Float::DeciStrToRealStr(strs[i].GetStr(0), strs[i].Length(), dst, bytes);
+						sink += dst[0];
+					}
+					break;
+				default:
+					{
+						DeciStr decs;
+						unsigned char dst[8];
+						int err = 0;
+						float_to_str(src, size, decs);
+						sink += str_to_float(decs.GetStr(0), decs.Length(), dst, err);
+					}
+					break;
+				}
+			}
+		}
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+		double ops = (double)samples * iterations;
+		printf("{\"mode\":\"bench\",\"kernel\":\"%s\",\"size\":%d,\"ops\":%.0f,\"seconds\":%.6f,\"ns_per_op\":%.1f,\"sink\":%llu}\n"
+			, cFloatBenchKernels[k], size, ops, secs, ops > 0 ? secs * 1e9 / ops : 0.0, sink);
+		fflush(stdout);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// UINT192の差分検証の値
+struct Uint192Value {
+	unsigned char b[UINT192_MAX_BYTE];
+};
+
+/// UINT192の差分検証
+/// 以前の実装(UINT192Ref)と同じ操作をして、結果を比較する
+class Uint192Diff
+{
+public:
+	unsigned long long cases;
+	unsigned long long diffs;
+	std::vector<std::string> samples;
+
+	Uint192Diff() : cases(0), diffs(0) {}
+
+	/// 結果を比較
+	void Check(const char *op, const Uint192Value &a, const Uint192Value *b, unsigned int arg, UINT192 &res, UINT192Ref &ref, long long ires = 0, long long iref = 0)
+	{
+		cases++;
+		bool same = (ires == iref);
+		for(int i=0; i<UINT192_MAX_BYTE && same; i++) {
+			if (res.GetByte(i) != ref.GetByte(i)) same = false;
+		}
+		if (same) return;
+		diffs++;
+		if (samples.size() >= FLOAT_VERIFY_SAMPLES) return;
+		std::string str = "{\"op\":\"";
+		str += op;
+		str += "\",\"a\":\"";
+		str += bytes_to_hex(a.b, UINT192_MAX_BYTE);
+		if (b) {
+			str += "\",\"b\":\"";
+			str += bytes_to_hex(b->b, UINT192_MAX_BYTE);
+		}
+		char buf[32];
+		sprintf(buf, "\",\"arg\":%u}", arg);
+		str += buf;
+		samples.push_back(str);
+	}
+
+	/// 1つの値の操作を比較
+	void Unary(const Uint192Value &a)
+	{
+		UINT192 x(a.b, UINT192_MAX_BYTE);
+		UINT192Ref r(a.b, UINT192_MAX_BYTE);
+
+		{ UINT192 y(x); UINT192Ref s(r); y.Not(); s.Not(); Check("Not", a, NULL, 0, y, s); }
+		{ UINT192 y(x); UINT192Ref s(r); y.Mul10(); s.Mul10(); Check("Mul10", a, NULL, 0, y, s); }
+		{ Check("Digits", a, NULL, 0, x, r, x.Digits(), r.Digits()); }
+
+		static const unsigned int cAddVals[] = { 0, 1, 5, 10, 0x7fffffff, 0xffffffff };
+		for(size_t i=0; i<sizeof(cAddVals)/sizeof(cAddVals[0]); i++) {
+			unsigned int v = cAddVals[i];
+			{ UINT192 y(x); UINT192Ref s(r); y.Add(v); s.Add(v); Check("AddInt", a, NULL, v, y, s); }
+			{ Check("EqInt", a, NULL, v, x, r, x == v, r == v); }
+		}
+		for(unsigned int n=0; n<=UINT192_MAX_BITS+8; n++) {
+			{ UINT192 y(x); UINT192Ref s(r); y.LShift(n); s.LShift(n); Check("LShift", a, NULL, n, y, s); }
+			{ UINT192 y(x); UINT192Ref s(r); y.RShift(n); s.RShift(n); Check("RShift", a, NULL, n, y, s); }
+			{ UINT192 y(x); UINT192Ref s(r); y.Shift(-(int)n); s.Shift(-(int)n); Check("Shift", a, NULL, n, y, s); }
+			{ UINT192 y(x); UINT192Ref s(r); y.RoundBit(n); s.RoundBit(n); Check("RoundBit", a, NULL, n, y, s); }
+			{ UINT192 y(x); UINT192Ref s(r); y.RoundDownBit(n); s.RoundDownBit(n); Check("RoundDownBit", a, NULL, n, y, s); }
+			{ UINT192 y(x); UINT192Ref s(r); y.RoundUpBit(n); s.RoundUpBit(n); Check("RoundUpBit", a, NULL, n, y, s); }
+		}
+		for(int n=0; n<=UINT192_MAX_BYTE; n++) {
+			{ UINT192 y(a.b, n, true); UINT192Ref s(a.b, n, true); Check("SetBE", a, NULL, n, y, s); }
+			{ UINT192 y(a.b, n, false); UINT192Ref s(a.b, n, false); Check("SetLE", a, NULL, n, y, s); }
+		}
+	}
+
+	/// 2つの値の操作を比較
+	void Binary(const Uint192Value &a, const Uint192Value &b, bool with_mul)
+	{
+		UINT192 x(a.b, UINT192_MAX_BYTE);
+		UINT192Ref r(a.b, UINT192_MAX_BYTE);
+		UINT192 y(b.b, UINT192_MAX_BYTE);
+		UINT192Ref s(b.b, UINT192_MAX_BYTE);
+
+		{ UINT192 z(x); UINT192Ref t(r); z.Add(y); t.Add(s); Check("Add", a, &b, 0, z, t); }
+		{ UINT192 z(x); UINT192Ref t(r); z.Sub(y); t.Sub(s); Check("Sub", a, &b, 0, z, t); }
+		{ UINT192 z(x); UINT192Ref t(r); z.And(y); t.And(s); Check("And", a, &b, 0, z, t); }
+		{ UINT192 z(x); UINT192Ref t(r); z.Or(y); t.Or(s); Check("Or", a, &b, 0, z, t); }
+		if (with_mul) {
+			UINT192 z(x); UINT192Ref t(r); z.Mul(y); t.Mul(s); Check("Mul", a, &b, 0, z, t);
+		}
+		{ Check("Eq", a, &b, 0, x, r, x == y, r == s); }
+		{ Check("Gt", a, &b, 0, x, r, x > y, r > s); }
+		{ Check("Lt", a, &b, 0, x, r, x < y, r < s); }
+	}
+
+	/// 結果を足す
+	void Merge(const Uint192Diff &src)
+	{
+		cases += src.cases;
+		diffs += src.diffs;
+		for(size_t i=0; i<src.samples.size() && samples.size() < FLOAT_VERIFY_SAMPLES; i++) {
+			samples.push_back(src.samples[i]);
+		}
+	}
+};
+
+/// 境界になる値を作る
+static void make_uint192_edges(std::vector<Uint192Value> &vals)
+{
+	static const unsigned long long cLimbs[] = {
+		0, 1, 0x7fffffffffffffffULL, 0x8000000000000000ULL, 0xffffffffffffffffULL
+	};
+	Uint192Value v;
+
+	// 64ビットごとの組み合わせ
+	for(int i=0; i<5; i++) for(int j=0; j<5; j++) for(int k=0; k<5; k++) {
+		unsigned long long d[3] = { cLimbs[i], cLimbs[j], cLimbs[k] };
+		for(int n=0; n<UINT192_MAX_BYTE; n++) v.b[n] = (d[n / 8] >> ((n % 8) * 8)) & 0xff;
+		vals.push_back(v);
+	}
+	// 2^k, 2^k-1, ~2^k
+	for(int k=0; k<UINT192_MAX_BITS; k++) {
+		memset(v.b, 0, sizeof(v.b));
+		v.b[k / 8] = (1 << (k % 8));
+		vals.push_back(v);
+		Uint192Value w;
+		for(int n=0; n<UINT192_MAX_BYTE; n++) w.b[n] = (unsigned char)~v.b[n];
+		vals.push_back(w);
+		memset(w.b, 0, sizeof(w.b));
+		for(int n=0; n<k; n++) w.b[n / 8] |= (1 << (n % 8));
+		vals.push_back(w);
+	}
+	// 10^k
+	UINT192Ref p(1);
+	for(int k=0; k<58; k++) {
+		for(int n=0; n<UINT192_MAX_BYTE; n++) v.b[n] = p.GetByte(n);
+		vals.push_back(v);
+		p.Mul10();
+	}
+}
+
+/// 乱数で値を作る 桁上がりが起きやすいように一部のビットをそろえる
+static void make_uint192_random(unsigned long long &state, Uint192Value &v)
+{
+	for(int n=0; n<UINT192_MAX_BYTE; n+=8) {
+		unsigned long long d = xorshift64(state);
+		for(int i=0; i<8; i++) v.b[n + i] = (d >> (i * 8)) & 0xff;
+	}
+	unsigned long long mode = xorshift64(state);
+	int bits = (int)(mode % (UINT192_MAX_BITS + 1));
+	switch((mode >> 16) % 4) {
+	case 1:
+		// 上位を0
+		for(int k=bits; k<UINT192_MAX_BITS; k++) v.b[k / 8] &= ~(1 << (k % 8));
+		break;
+	case 2:
+		// 下位を1
+		for(int k=0; k<bits; k++) v.b[k / 8] |= (1 << (k % 8));
+		break;
+	case 3:
+		// 下位を0
+		for(int k=0; k<bits; k++) v.b[k / 8] &= ~(1 << (k % 8));
+		break;
+	}
+}
+
+/// UINT192の差分検証の範囲
+struct Uint192DiffRange {
+	const std::vector<Uint192Value> *edges;
+	unsigned long long randoms;
+	unsigned long long seed;
+	std::atomic<unsigned long long> next;
+	std::mutex lock;
+	Uint192Diff result;
+};
+
+/// UINT192の差分検証のスレッド
+/// 境界値はすべての組み合わせ、乱数は指定数
+static void uint192_diff_worker(Uint192DiffRange *range)
+{
+	Uint192Diff local;
+	const std::vector<Uint192Value> &edges = *range->edges;
+	unsigned long long edge_count = edges.size();
+	unsigned long long total = edge_count + range->randoms;
+	for(;;) {
+		unsigned long long pos = range->next.fetch_add(1);
+		if (pos >= total) break;
+		if (pos < edge_count) {
+			const Uint192Value &a = edges[pos];
+			local.Unary(a);
+			for(size_t j=0; j<edges.size(); j++) {
+				local.Binary(a, edges[j], true);
+			}
+		} else {
+			unsigned long long state = (range->seed ^ (pos * 0x9e3779b97f4a7c15ULL)) | 1;
+			Uint192Value a, b;
+			make_uint192_random(state, a);
+			make_uint192_random(state, b);
+			if (pos % 64 == 0) local.Unary(a);
+			local.Binary(a, b, true);
+			UINT192 x(a.b, UINT192_MAX_BYTE);
+			UINT192Ref r(a.b, UINT192_MAX_BYTE);
+			x.Mul10();
+			r.Mul10();
+			local.Check("Mul10", a, NULL, 0, x, r);
+		}
+	}
+	std::lock_guard<std::mutex> guard(range->lock);
+	range->result.Merge(local);
+}
+
+/// UINT192の差分検証
+/// @return 差分の数
+static unsigned long long run_uint192_diff(unsigned long long randoms, unsigned long long seed, int threads)
+{
+	std::vector<Uint192Value> edges;
+	make_uint192_edges(edges);
+
+	Uint192DiffRange range;
+	range.edges = &edges;
+	range.randoms = randoms;
+	range.seed = seed;
+	range.next = 0;
+
+	std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for(int i=0; i<threads; i++) {
+		workers.push_back(std::thread(uint192_diff_worker, &range));
+	}
+	for(size_t i=0; i<workers.size(); i++) {
+		workers[i].join();
+	}
+
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+	printf("{\"mode\":\"uint192\",\"edges\":%u,\"randoms\":%llu,\"cases\":%llu,\"diffs\":%llu,\"seconds\":%.3f,\"samples\":["
+		, (unsigned int)edges.size(), randoms, range.result.cases, range.result.diffs, secs);
+	for(size_t i=0; i<range.result.samples.size(); i++) {
+		printf("%s%s", i > 0 ? "," : "", range.result.samples[i].c_str());
+	}
+	printf("]}\n");
+	fflush(stdout);
+
+	return range.result.diffs;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// 以前の ParseMSXBasic::FloatBytesToStr と同じ手順で文字列にする(比較用)
+/// 仮数部を1桁ずつ書式化する
+static std::string msx_float_to_str_ref(const unsigned char *src, int src_len)
+{
+	char num[16];
+
+	if ((src[0] & 0x7f) == 0) {
+		return "0";
+	}
+	bool expview = true;
+	int ex = (int)(src[0] & 0x7f) - 64;
+	if (-1 <= ex && ex <= 13) {
+		expview = false;
+	} else {
+		ex--;
+	}
+	std::string dst;
+	if (src[0] & 0x80) {
+		dst += "-";
+	}
+	int len = src_len * 2 - 1;
+	for(;len >= 2; len--) {
+		if (src[len >> 1] & (0xf0 >> ((len & 1) << 2))) break;
+	}
+	if (expview) {
+		for(int i=2; i <= len; i++) {
+			if (i == 3) dst += ".";
+			sprintf(num, "%d", (src[i >> 1] & (0xf0 >> ((i & 1) << 2))) >> ((1 - (i & 1)) << 2));
+			dst += num;
+		}
+		dst += "E";
+		sprintf(num, "%+03d", ex);
+		dst += num;
+	} else {
+		int imin = ex < 0 ? ex + 2 : 2;
+		int imax = ex >= len ? ex + 1 : len;
+		for(int i=imin; i <= imax; i++) {
+			if (i == (ex + 2)) dst += ".";
+			if (2 <= i && i <= len) {
+				sprintf(num, "%d", (src[i >> 1] & (0xf0 >> ((i & 1) << 2))) >> ((1 - (i & 1)) << 2));
+				dst += num;
+			} else {
+				dst += "0";
+			}
+		}
+		dst += (src_len == 8 ? "#" : "!");
+	}
+	return dst;
+}
+
+/// MSXのBCDの検証結果
+class MsxBcdResult
+{
+public:
+	unsigned long long total;
+	/// 以前の書式化と文字列が違う
+	unsigned long long format_diff;
+	/// バイト列→文字列→バイト列で一致しない
+	unsigned long long mismatch;
+	std::vector<std::string> samples;
+
+	MsxBcdResult() : total(0), format_diff(0), mismatch(0) {}
+
+	/// 1パターン検証
+	/// @param[in] src        実数(BCD)
+	/// @param[in] size       4 or 8
+	/// @param[in] round_trip 正規化されたBCDなので元に戻ること
+	void Verify(const unsigned char *src, int size, bool round_trip)
+	{
+		total++;
+
+		char str[MSXBCD_STR_MAX];
+		int len = MSXBcd::BytesToStr(src, size, str);
+		std::string ref = msx_float_to_str_ref(src, size);
+		bool bad = false;
+		if (ref.length() != (size_t)len || memcmp(ref.c_str(), str, len) != 0) {
+			format_diff++;
+			bad = true;
+		}
+
+		unsigned char dst[8];
+		int dst_len = 0;
+		int type = 0;
+		if (round_trip) {
+			type = MSXBcd::StrToBytes(str, len, dst, dst_len);
+			if (type != (size == 8 ? MSXBcd::BCD_DOUBLE : MSXBcd::BCD_SINGLE)
+				|| dst_len != size || memcmp(src, dst, size) != 0) {
+				mismatch++;
+				bad = true;
+			}
+		}
+		if (bad && samples.size() < FLOAT_VERIFY_SAMPLES) {
+			std::string s = "{\"src\":\"";
+			s += bytes_to_hex(src, size);
+			s += "\",\"str\":\"";
+			s.append(str, len);
+			s += "\",\"ref\":\"";
+			s += ref;
+			s += "\",\"dst\":\"";
+			s += bytes_to_hex(dst, dst_len);
+			char buf[32];
+			sprintf(buf, "\",\"type\":%d}", type);
+			s += buf;
+			samples.push_back(s);
+		}
+	}
+
+	/// 結果を足す
+	void Merge(const MsxBcdResult &src)
+	{
+		total += src.total;
+		format_diff += src.format_diff;
+		mismatch += src.mismatch;
+		for(size_t i=0; i<src.samples.size() && samples.size() < FLOAT_VERIFY_SAMPLES; i++) {
+			samples.push_back(src.samples[i]);
+		}
+	}
+
+	/// JSONで出力
+	void Print(const char *name, double secs) const
+	{
+		printf("{\"mode\":\"msxbcd\",\"set\":\"%s\",\"total\":%llu,\"format_diff\":%llu,\"mismatch\":%llu,\"seconds\":%.3f,\"samples\":["
+			, name, total, format_diff, mismatch, secs);
+		for(size_t i=0; i<samples.size(); i++) {
+			printf("%s%s", i > 0 ? "," : "", samples[i].c_str());
+		}
+		printf("]}\n");
+		fflush(stdout);
+	}
+};
+
+/// 単精度の正規化された仮数部の数 (100000～999999)
+#define MSXBCD_SINGLE_MANTISSAS	900000ULL
+
+/// MSXのBCDの検証の範囲
+struct MsxBcdRange {
+	int size;
+	unsigned long long count;
+	unsigned long long seed;
+	std::atomic<unsigned long long> next;
+	std::mutex lock;
+	MsxBcdResult result;
+};
+
+/// 数値をBCDにする
+static void to_bcd(unsigned long long val, unsigned char *dst, int bytes)
+{
+	for(int i=bytes-1; i>=0; i--) {
+		unsigned int lo = (unsigned int)(val % 10);
+		val /= 10;
+		unsigned int hi = (unsigned int)(val % 10);
+		val /= 10;
+		dst[i] = (unsigned char)((hi << 4) | lo);
+	}
+}
+
+/// MSXのBCDの検証のスレッド
+/// 単精度は指数1～127と正規化された仮数部のすべて、倍精度は乱数
+static void msxbcd_worker(MsxBcdRange *range)
+{
+	MsxBcdResult local;
+	for(;;) {
+		unsigned long long pos = range->next.fetch_add(FLOAT_VERIFY_CHUNK);
+		if (pos >= range->count) break;
+		unsigned long long end = pos + FLOAT_VERIFY_CHUNK;
+		if (end > range->count) end = range->count;
+		unsigned long long state = (range->seed ^ (pos * 0x9e3779b97f4a7c15ULL)) | 1;
+		for(unsigned long long i = pos; i < end; i++) {
+			unsigned char src[8];
+			if (range->size == 4) {
+				src[0] = (unsigned char)(1 + i / MSXBCD_SINGLE_MANTISSAS);
+				to_bcd(100000 + i % MSXBCD_SINGLE_MANTISSAS, &src[1], 3);
+				local.Verify(src, 4, true);
+			} else {
+				// 14桁 最上位と最下位は0以外
+				unsigned long long r = xorshift64(state);
+				unsigned long long m = r % 100000000000000ULL;
+				m = (m / 10) * 10 + 1 + (r >> 60) % 9;
+				if (m < 10000000000000ULL) m += 10000000000000ULL * (1 + (r >> 56) % 9);
+				src[0] = (unsigned char)(1 + (r >> 48) % 127);
+				to_bcd(m, &src[1], 7);
+				local.Verify(src, 8, true);
+				// 符号、BCDでない値も含めて書式化だけ比較
+				unsigned long long q = xorshift64(state);
+				for(int n=0; n<8; n++) src[n] = (q >> (n * 8)) & 0xff;
+				local.Verify(src, (q & 1) ? 8 : 4, false);
+			}
+		}
+	}
+	std::lock_guard<std::mutex> guard(range->lock);
+	range->result.Merge(local);
+}
+
+/// MSXのBCDの検証
+/// @return エラーの数
+static unsigned long long run_msxbcd(unsigned long long doubles, unsigned long long seed, int threads)
+{
+	unsigned long long errors = 0;
+	for(int n=0; n<2; n++) {
+		MsxBcdRange range;
+		range.size = (n == 0 ? 4 : 8);
+		range.count = (n == 0 ? 127 * MSXBCD_SINGLE_MANTISSAS : doubles);
+		range.seed = seed;
+		range.next = 0;
+		if (range.count == 0) continue;
+
+		std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> workers;
+		for(int i=0; i<threads; i++) {
+			workers.push_back(std::thread(msxbcd_worker, &range));
+		}
+		for(size_t i=0; i<workers.size(); i++) {
+			workers[i].join();
+		}
+
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+		range.result.Print(n == 0 ? "single" : "double", secs);
+		errors += range.result.format_diff + range.result.mismatch;
+	}
+	return errors;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s bench [options]\n"
+		"       %s verify [options]\n"
+		"       %s uint192 [options]\n"
+		"       %s msxbcd [options]\n"
+		"\n"
+		"bench options:\n"
+		"  --samples N      number of random patterns (default 100000)\n"
+		"  --iterations N   repeat count (default 5)\n"
+		"  --seed N         random seed\n"
+		"\n"
+		"verify options:\n"
+		"  --start N        first 4-byte pattern (default 0)\n"
+		"  --count N        number of 4-byte patterns (default 4294967296, 0 to skip)\n"
+		"  --doubles N      number of sampled 8-byte patterns (default 100000000, 0 to skip)\n"
+		"  --seed N         random seed for 8-byte patterns\n"
+		"  --threads N      worker threads (default: number of cores)\n"
+		"  --progress       show progress on stderr\n"
+		"\n"
+		"uint192 options:\n"
+		"  --random N       number of random pairs after all edge pairs (default 1000000)\n"
+		"  --seed N         random seed\n"
+		"  --threads N      worker threads\n"
+		"\n"
+		"msxbcd options:\n"
+		"  --doubles N      number of random double precision values (default 100000000)\n"
+		"  --seed N         random seed\n"
+		"  --threads N      worker threads\n"
+		"\n"
+		"Results are written to stdout as JSON lines.\n"
+		"verify exits with 1 when a value changes through bytes->string->bytes again,\n"
+		"a conversion overflows or changes the size, or the 128-bit path differs\n"
+		"from the UINT192 path. Mismatches against the first bytes and strings\n"
+		"printed differently with the same value are only counted since values\n"
+		"are printed with 6 or 16 digits.\n"
+		"uint192 exits with 1 when any result differs from the previous UINT192.\n"
+		"msxbcd exits with 1 when a value does not round trip or is formatted\n"
+		"differently from the previous code.\n"
+		, prog, prog, prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		usage(argv[0]);
+		return 2;
+	}
+	std::string mode = argv[1];
+
+	unsigned long long samples = 100000;
+	unsigned long long iterations = 5;
+	unsigned long long seed = 0x2545f4914f6cdd1dULL;
+	unsigned long long start = 0;
+	unsigned long long count = 0x100000000ULL;
+	unsigned long long doubles = 100000000ULL;
+	unsigned long long randoms = 1000000ULL;
+	int threads = (int)std::thread::hardware_concurrency();
+	bool progress = false;
+
+	for(int i=2; i<argc; i++) {
+		std::string opt = argv[i];
+		if (opt == "--progress") {
+			progress = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+			return 2;
+		}
+		unsigned long long val = strtoull(argv[++i], NULL, 0);
+		if (opt == "--samples") samples = val;
+		else if (opt == "--iterations") iterations = val;
+		else if (opt == "--seed") seed = val;
+		else if (opt == "--start") start = val;
+		else if (opt == "--count") count = val;
+		else if (opt == "--doubles") doubles = val;
+		else if (opt == "--random") randoms = val;
+		else if (opt == "--threads") threads = (int)val;
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (threads <= 0) threads = 1;
+	if (seed == 0) seed = 1;
+
+	if (mode == "bench") {
+		if (samples == 0 || iterations == 0) {
+			usage(argv[0]);
+			return 2;
+		}
+		run_bench(4, (int)samples, (int)iterations, seed);
+		run_bench(8, (int)samples, (int)iterations, seed);
+		return 0;
+
+	} else if (mode == "verify") {
+		if (start > 0xffffffffULL) start = 0xffffffffULL;
+		if (count > 0x100000000ULL - start) count = 0x100000000ULL - start;
+
+		FloatVerifyRange single;
+		single.size = 4;
+		single.start = start;
+		single.count = count;
+		single.seed = seed;
+		single.progress = progress;
+		run_verify(single, threads, "single");
+
+		FloatVerifyRange dbl;
+		dbl.size = 8;
+		dbl.start = 0;
+		dbl.count = doubles;
+		dbl.seed = seed;
+		dbl.progress = progress;
+		run_verify(dbl, threads, "double");
+
+		// 6桁/16桁で表示するので最初のバイト列との不一致と表記の違いはエラーにしない
+		// 読み直して値が変わるもの、サイズが変わるもの、オーバーフローするものはエラー
+		bool failed = false;
+		const FloatVerifyResult *results[2] = { &single.result, &dbl.result };
+		for(int i=0; i<2; i++) {
+			const FloatVerifyResult *r = results[i];
+			if (r->unstable > 0 || r->resized > 0 || r->overflow > 0 || r->underflow > 0 || r->uint192_diff > 0) failed = true;
+		}
+		return failed ? 1 : 0;
+
+	} else if (mode == "uint192") {
+		return run_uint192_diff(randoms, seed, threads) > 0 ? 1 : 0;
+
+	} else if (mode == "msxbcd") {
+		return run_msxbcd(doubles, seed, threads) > 0 ? 1 : 0;
+	}
+
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,86 @@
+﻿/** @file uint192ref.h
+
+ @brief 192ビット数値 (比較用)
+
+ 最適化前のUINT192の実装。l3s1basic_floatbench の差分検証で使う。
+
+*/
+
+#include <stdio.h>
+
+#ifndef _UINT192REF_H_
+#define _UINT192REF_H_
+
+#define UINT192_MAX_INT64 3
+#define UINT192_MAX_BYTE  24
+#define UINT192_MAX_BITS  192
+
+/// 192ビットunsigned int
+class UINT192Ref
+{
+private:
+	typedef struct st_uint192 {
+		union un_uint192 {
+			unsigned long long d[UINT192_MAX_INT64];
+			unsigned char      b[UINT192_MAX_BYTE];
+		} u;
+	} t_uint192;
+
+	t_uint192 value;
+public:
+	UINT192Ref();
+	UINT192Ref(const UINT192Ref &src);
+	UINT192Ref(unsigned int val);
+	UINT192Ref(const unsigned int *vals);
+	UINT192Ref(const unsigned char *vals, int size, bool bigendian = false);
+	~UINT192Ref();
+
+	void Set(unsigned int val);
+	void Set(const unsigned int *vals);
+	void Set(const unsigned char *vals, int size, bool bigendian = false);
+
+	UINT192Ref &operator=(const UINT192Ref &src);
+	UINT192Ref &operator=(unsigned int src);
+
+	UINT192Ref &Add(const UINT192Ref &src);
+	UINT192Ref &operator+=(const UINT192Ref &src);
+	UINT192Ref &Add(unsigned int src);
+
+	UINT192Ref &Sub(const UINT192Ref &src);
+	UINT192Ref &operator-=(const UINT192Ref &src);
+
+	UINT192Ref &And(const UINT192Ref &src);
+	UINT192Ref &Or(const UINT192Ref &src);
+	UINT192Ref &Not();
+
+	UINT192Ref &Shift(int size);
+	UINT192Ref &LShift(unsigned int size);
+	UINT192Ref &RShift(unsigned int size);
+
+	UINT192Ref &Mul(const UINT192Ref &src);
+	UINT192Ref &Mul(unsigned char src);
+	UINT192Ref &operator*=(const UINT192Ref &src);
+
+	void Mul10();
+
+	bool operator==(const UINT192Ref &src);
+	bool operator==(unsigned int src);
+	bool operator>(const UINT192Ref &src);
+	bool operator<(const UINT192Ref &src);
+
+	unsigned char GetByte(unsigned int pos);
+	void SetByte(unsigned int pos, unsigned char val);
+
+	unsigned int Digits() const;
+
+	void RoundBit(unsigned int digit);
+	void RoundDownBit(unsigned int digit);
+	void RoundUpBit(unsigned int digit);
+};
+
+
+
+
+
+
+#endif /* _UINT192REF_H_ */
@@ -98,7 +98,8 @@ size_t BinStringInputStream::OnSysRead(void *buffer, size_t size)
         size = sizeMax;
     }
 
-    memcpy(buffer, m_str.Mid(m_pos).To8BitData(), size);
+    // copy only the requested part, not the rest of the string
+    memcpy(buffer, m_str.Mid(m_pos, size).To8BitData(), size);
     m_pos += size;
 
     return size;
@@ -0,0 +1,78 @@
+﻿/// @file climain.cpp
+///
+/// @brief コマンドライン版
+///
+/// ウィンドウを使わずにバッチモードだけで変換する。
+/// 変換エンジンとバッチモードはGUI版と共通で、wxBaseだけにリンクする。
+///
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/cmdline.h>
+#include <wx/msgout.h>
+#include "config.h"
+#include "batch.h"
+#include "version.h"
+
+/// コマンドライン版
+class BasicCliApp : public wxAppConsole
+{
+private:
+	wxString app_path;
+	wxString ini_path;
+	wxString res_path;
+	wxLocale mLocale;
+	BasicBatch mBatch;
+
+public:
+	bool OnInit();
+	int  OnRun();
+	void OnInitCmdLine(wxCmdLineParser &parser);
+	bool OnCmdLineParsed(wxCmdLineParser &parser);
+};
+
+IMPLEMENT_APP_CONSOLE(BasicCliApp)
+
+bool BasicCliApp::OnInit()
+{
+	BasicBatch::GetAppPaths(argv[0], app_path, ini_path, res_path);
+	// 設定ファイルはGUI版と共有する
+	SetAppName(_T(APPLICATION_NAME));
+
+	if (!wxAppConsole::OnInit()) {
+		return false;
+	}
+
+	// load ini file
+	wxString ini_file = ini_path + GetAppName() + _T(".ini");
+	gConfig.Load(ini_file);
+	mBatch.SetPaths(ini_file, res_path);
+
+	// set locale search path and catalog name
+	BasicBatch::InitLocale(mLocale, res_path);
+
+	return true;
+}
+
+int BasicCliApp::OnRun()
+{
+	return mBatch.Run();
+}
+
+void BasicCliApp::OnInitCmdLine(wxCmdLineParser &parser)
+{
+	BasicBatch::InitCmdLine(parser);
+}
+
+bool BasicCliApp::OnCmdLineParsed(wxCmdLineParser &parser)
+{
+	if (!mBatch.CmdLineParsed(parser)) {
+		return false;
+	}
+	if (!mBatch.IsBatchMode()) {
+		// 表示するウィンドウがないので出力先が必要
+		wxMessageOutputStderr().Printf(_T("%s\n"), _("Specify the output with -o."));
+		parser.Usage();
+		return false;
+	}
+	return true;
+}
@@ -62,15 +62,6 @@ void MyColorTag::Set(int id, wxUint8 r, wxUint8 g, wxUint8 b)
 	}
 }
 
-void MyColorTag::Set(int id, const wxColour &col)
-{
-	if (id >= 0 && id < COLOR_TAG_COUNT) {
-		mColorTags[id].red = (wxUint8)col.Red();
-		mColorTags[id].green = (wxUint8)col.Green();
-		mColorTags[id].blue = (wxUint8)col.Blue();
-	}
-}
-
 bool MyColorTag::Get(int id, wxUint8 *r, wxUint8 *g, wxUint8 *b) const
 {
 	if (id >= 0 && id < COLOR_TAG_COUNT && mColorTags[id].start == 1) {
@@ -82,19 +73,12 @@ bool MyColorTag::Get(int id, wxUint8 *r, wxUint8 *g, wxUint8 *b) const
 	return false;
 }
 
-bool MyColorTag::Get(int id, wxColour &col) const
-{
-	if (id >= 0 && id < COLOR_TAG_COUNT && mColorTags[id].start == 1) {
-		col.Set(mColorTags[id].red, mColorTags[id].green, mColorTags[id].blue);
-		return true;
-	}
-	return false;
-}
-
-bool MyColorTag::GetDefault(int id, wxColour &col) const
+bool MyColorTag::GetDefault(int id, wxUint8 *r, wxUint8 *g, wxUint8 *b) const
 {
 	if (id >= 0 && id < COLOR_TAG_COUNT && mColorTags[id].start == 1) {
-		col.Set(cColorTags[id].red, cColorTags[id].green, cColorTags[id].blue);
+		if (r) *r = cColorTags[id].red;
+		if (g) *g = cColorTags[id].green;
+		if (b) *b = cColorTags[id].blue;
 		return true;
 	}
 	return false;
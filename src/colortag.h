@@ -8,7 +8,9 @@
 
 #include "common.h"
 #include <wx/string.h>
+#if wxUSE_GUI
 #include <wx/colour.h>
+#endif
 
 /// @brief テキスト色を保持する
 typedef struct st_color_tag {
@@ -43,13 +45,32 @@ public:
 
 	void Clear();
 	void Set(int id, wxUint8 r, wxUint8 g, wxUint8 b);
-	void Set(int id, const wxColour &col);
 	bool Get(int id, wxUint8 *r, wxUint8 *g, wxUint8 *b) const;
-	bool Get(int id, wxColour &col) const;
-	bool GetDefault(int id, wxColour &col) const;
+	bool GetDefault(int id, wxUint8 *r, wxUint8 *g, wxUint8 *b) const;
 	color_tag_t *Get(int id);
 	void SetFromHTMLColor(int id, const wxString &val);
 	bool GetFromHTMLColor(int id, wxString &val) const;
+
+#if wxUSE_GUI
+	/// @name GUIで使う (変換エンジンはwxColourを使わない)
+	//@{
+	void Set(int id, const wxColour &col) {
+		Set(id, (wxUint8)col.Red(), (wxUint8)col.Green(), (wxUint8)col.Blue());
+	}
+	bool Get(int id, wxColour &col) const {
+		wxUint8 r, g, b;
+		if (!Get(id, &r, &g, &b)) return false;
+		col.Set(r, g, b);
+		return true;
+	}
+	bool GetDefault(int id, wxColour &col) const {
+		wxUint8 r, g, b;
+		if (!GetDefault(id, &r, &g, &b)) return false;
+		col.Set(r, g, b);
+		return true;
+	}
+	//@}
+#endif
 };
 
 #endif /* MYCOLORTAG_H */
@@ -0,0 +1,183 @@
+﻿/// @file d88disk.cpp
+///
+/// @brief D88形式のディスクイメージ
+///
+///
+#include "d88disk.h"
+#include <string.h>
+
+/// リトルエンディアンの値
+static inline wxUint32 d88_le32(const wxUint8 *p)
+{
+	return (wxUint32)p[0] | ((wxUint32)p[1] << 8) | ((wxUint32)p[2] << 16) | ((wxUint32)p[3] << 24);
+}
+static inline wxUint16 d88_le16(const wxUint8 *p)
+{
+	return (wxUint16)(p[0] | (p[1] << 8));
+}
+
+D88Disk::D88Disk()
+{
+	mMediaType = 0;
+	mWriteProtect = false;
+	mDiskSize = 0;
+	mTracks = 0;
+	memset(mTrackStart, 0, sizeof(mTrackStart));
+}
+
+/// D88形式か
+///
+/// メディアの種類、ディスクの長さ、最初のトラックの位置が正しいかを見る。
+/// @param[in] data      ファイルの先頭
+/// @param[in] len       長さ
+/// @param[in] file_size ファイルの長さ
+bool D88Disk::IsD88(const wxUint8 *data, size_t len, size_t file_size)
+{
+	if (len < 0x24) {
+		return false;
+	}
+	int media = data[0x1b];
+	if (media != 0x00 && media != 0x10 && media != 0x20 && media != 0x30 && media != 0x40) {
+		return false;
+	}
+	if (data[0x1a] != 0x00 && data[0x1a] != 0x10) {
+		return false;
+	}
+	wxUint32 disk_size = d88_le32(&data[0x1c]);
+	if (disk_size < 0x24 || disk_size > file_size) {
+		return false;
+	}
+	wxUint32 first = d88_le32(&data[0x20]);
+	return (first >= 0x24 && first <= D88_HEADER_SIZE && (first & 3) == 0);
+}
+
+/// 開く
+/// @param[in] path     イメージのファイル
+/// @param[in] writable 書き込みもする
+/// @return D88形式でない場合false
+bool D88Disk::Open(const wxString &path, bool writable)
+{
+	Close();
+	if (!mFile.Open(path, writable)) {
+		return false;
+	}
+	if (!IsD88(mFile.GetData(), mFile.GetSize(), mFile.GetSize()) || !Index()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+/// 閉じる
+void D88Disk::Close()
+{
+	mFile.Close();
+	mName.Empty();
+	mSectors.SetDataLen(0);
+	memset(mTrackStart, 0, sizeof(mTrackStart));
+	mTracks = 0;
+}
+
+/// 一覧を作る
+///
+/// トラックの先頭から、セクタヘッダにあるセクタ数だけ順にたどる。
+/// @return イメージが壊れている場合false
+bool D88Disk::Index()
+{
+	const wxUint8 *data = mFile.GetData();
+	mName = wxString::From8BitData((const char *)data, strnlen((const char *)data, D88_NAME_LEN));
+	mWriteProtect = (data[0x1a] != 0);
+	mMediaType = data[0x1b];
+	mDiskSize = d88_le32(&data[0x1c]);
+
+	// トラックの位置の表はヘッダの後ろか最初のトラックの手前まで
+	size_t table_end = d88_le32(&data[0x20]);
+	int table_len = (int)((table_end - 0x20) / 4);
+	if (table_len > D88_MAX_TRACKS) table_len = D88_MAX_TRACKS;
+
+	D88Sector sector;
+	mTracks = 0;
+	for(int t = 0; t < table_len; t++) {
+		mTrackStart[t] = mSectors.GetDataLen() / sizeof(D88Sector);
+		size_t pos = d88_le32(&data[0x20 + t * 4]);
+		if (pos == 0) {
+			continue;
+		}
+		if (pos + D88_SECTOR_HEADER_SIZE > mDiskSize) {
+			return false;
+		}
+		int count = d88_le16(&data[pos + 4]);
+		for(int s = 0; s < count; s++) {
+			const wxUint8 *p = &data[pos];
+			if (pos + D88_SECTOR_HEADER_SIZE > mDiskSize) {
+				return false;
+			}
+			sector.c = p[0];
+			sector.h = p[1];
+			sector.r = p[2];
+			sector.n = p[3];
+			sector.deleted = p[7];
+			sector.status = p[8];
+			sector.header_pos = pos;
+			sector.data_pos = pos + D88_SECTOR_HEADER_SIZE;
+			sector.size = d88_le16(&p[0x0e]);
+			if (sector.data_pos + sector.size > mDiskSize) {
+				return false;
+			}
+			mSectors.AppendData(&sector, sizeof(sector));
+			pos = sector.data_pos + sector.size;
+		}
+		mTracks = t + 1;
+	}
+	for(int t = mTracks; t <= D88_MAX_TRACKS; t++) {
+		mTrackStart[t] = mSectors.GetDataLen() / sizeof(D88Sector);
+	}
+	return true;
+}
+
+/// セクタを探す
+/// @param[in] track トラック番号 (シリンダ * サイド数 + サイド)
+/// @param[in] r     セクタ番号
+/// @return ないときNULL
+const D88Sector *D88Disk::FindSector(int track, int r) const
+{
+	if (track < 0 || track >= mTracks) {
+		return NULL;
+	}
+	const D88Sector *sectors = (const D88Sector *)mSectors.GetData();
+	for(size_t i = mTrackStart[track]; i < mTrackStart[track + 1]; i++) {
+		if (sectors[i].r == r) {
+			return &sectors[i];
+		}
+	}
+	return NULL;
+}
+
+/// セクタのデータ
+const wxUint8 *D88Disk::GetSectorData(const D88Sector *sector) const
+{
+	return mFile.GetData() + sector->data_pos;
+}
+
+/// トラックのセクタ数
+size_t D88Disk::GetSectorCount(int track) const
+{
+	if (track < 0 || track >= mTracks) {
+		return 0;
+	}
+	return mTrackStart[track + 1] - mTrackStart[track];
+}
+
+/// セクタのデータを書き換える
+/// @param[in] sector セクタ
+/// @param[in] offset セクタ内の位置
+/// @param[in] data   データ
+/// @param[in] len    長さ
+/// @return 書き込み禁止かセクタからはみ出す場合false
+bool D88Disk::WriteSector(const D88Sector *sector, size_t offset, const wxUint8 *data, size_t len)
+{
+	if (mWriteProtect || offset > sector->size || len > sector->size - offset) {
+		return false;
+	}
+	return mFile.WriteAt(sector->data_pos + offset, data, len);
+}
@@ -0,0 +1,85 @@
+﻿/// @file d88disk.h
+///
+/// @brief D88形式のディスクイメージ
+///
+///
+#ifndef _D88DISK_H_
+#define _D88DISK_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include "diskimage.h"
+
+/// ヘッダの長さ
+#define D88_HEADER_SIZE			0x2b0
+/// トラックの最大数
+#define D88_MAX_TRACKS			164
+/// セクタヘッダの長さ
+#define D88_SECTOR_HEADER_SIZE	16
+/// ディスク名の長さ
+#define D88_NAME_LEN			17
+
+/// D88のセクタ
+typedef struct st_d88_sector {
+	wxUint8 c;			///< ID C (シリンダ)
+	wxUint8 h;			///< ID H (サイド)
+	wxUint8 r;			///< ID R (セクタ番号)
+	wxUint8 n;			///< ID N (長さ)
+	wxUint8 deleted;	///< 削除マーク
+	wxUint8 status;		///< 読み込み時の状態
+	size_t header_pos;	///< セクタヘッダの位置
+	size_t data_pos;	///< データの位置
+	size_t size;		///< データの長さ
+} D88Sector;
+
+/// D88形式のディスクイメージ
+///
+/// イメージはマップしたまま参照し、開いたときにトラックとセクタの位置の一覧を作る。
+/// 1ファイルに複数のディスクがある場合は最初のディスクだけを扱う。
+/// 書き込みはセクタのデータだけを書き換え、トラックの配置は変えない。
+class D88Disk
+{
+private:
+	DiskImageFile mFile;	///< イメージ
+	wxString mName;			///< ディスク名
+	int mMediaType;			///< メディアの種類
+	bool mWriteProtect;		///< 書き込み禁止
+	size_t mDiskSize;		///< ディスクの長さ
+	wxMemoryBuffer mSectors;	///< D88Sector の並び (トラック順)
+	size_t mTrackStart[D88_MAX_TRACKS + 1];	///< トラックごとの最初のセクタの番号
+	int mTracks;			///< トラック数
+
+	/// 一覧を作る
+	bool Index();
+
+public:
+	D88Disk();
+	~D88Disk() {}
+
+	/// D88形式か
+	static bool IsD88(const wxUint8 *data, size_t len, size_t file_size);
+
+	/// 開く
+	bool Open(const wxString &path, bool writable = false);
+	/// 閉じる
+	void Close();
+
+	/// セクタを探す
+	const D88Sector *FindSector(int track, int r) const;
+	/// セクタのデータ
+	const wxUint8 *GetSectorData(const D88Sector *sector) const;
+	/// トラックのセクタ数
+	size_t GetSectorCount(int track) const;
+	/// セクタのデータを書き換える
+	bool WriteSector(const D88Sector *sector, size_t offset, const wxUint8 *data, size_t len);
+
+	const wxString &GetName() const { return mName; }
+	int GetMediaType() const { return mMediaType; }
+	bool IsWriteProtected() const { return mWriteProtect; }
+	int GetTrackCount() const { return mTracks; }
+	DiskImageFile &GetFile() { return mFile; }
+
+	DECLARE_NO_COPY_CLASS(D88Disk)
+};
+
+#endif /* _D88DISK_H_ */
@@ -40,6 +40,16 @@ DeciStr::~DeciStr()
 {
 }
 
+/// 代入
+DeciStr &DeciStr::operator=(const DeciStr &src)
+{
+	if (this != &src) {
+		memcpy(decistr, src.decistr, sizeof(decistr));
+		decipos = src.decipos;
+	}
+	return *this;
+}
+
 /// 指定位置に文字を入れる
 bool DeciStr::Set(int digit, char val)
 {
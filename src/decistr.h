@@ -24,6 +24,8 @@ public:
 	DeciStr(const char *src, int len);
 	~DeciStr();
 
+	DeciStr &operator=(const DeciStr &src);
+
 	bool Set(int digit, char val);
 	bool Set(const char *vals);
 	bool Set(const char *vals, int len);
@@ -0,0 +1,215 @@
+﻿/// @file diskimage.cpp
+///
+/// @brief ディスクイメージのファイル
+///
+///
+#include "diskimage.h"
+#include <string.h>
+#ifdef USE_DISK_IMAGE_MMAP
+#if defined(__WXMSW__)
+#include <wx/msw/wrapwin.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#endif
+
+DiskImageFile::DiskImageFile()
+{
+	pData = NULL;
+	mSize = 0;
+	mMapped = false;
+	mWritable = false;
+#ifdef USE_DISK_IMAGE_MMAP
+#if defined(__WXMSW__)
+	mFileHandle = INVALID_HANDLE_VALUE;
+	mMapHandle = NULL;
+#else
+	mFd = -1;
+#endif
+#endif
+}
+
+DiskImageFile::~DiskImageFile()
+{
+	Close();
+}
+
+/// 開く
+/// @param[in] path     イメージのファイル
+/// @param[in] writable 書き込みもする
+/// @return 読めなかった場合false
+bool DiskImageFile::Open(const wxString &path, bool writable)
+{
+	Close();
+	mPath = path;
+	mWritable = writable;
+	if (Map()) {
+		return true;
+	}
+
+	// 全体を読み込む
+	if (!mFile.Open(path, writable ? wxFile::read_write : wxFile::read)) {
+		mWritable = false;
+		return false;
+	}
+	wxFileOffset len = mFile.Length();
+	if (len == wxInvalidOffset || len == 0) {
+		Close();
+		return false;
+	}
+	void *buf = mBuf.GetWriteBuf((size_t)len);
+	ssize_t rlen = mFile.Read(buf, (size_t)len);
+	if (rlen == wxInvalidOffset) {
+		mBuf.UngetWriteBuf(0);
+		Close();
+		return false;
+	}
+	mBuf.UngetWriteBuf((size_t)rlen);
+	pData = (const wxUint8 *)mBuf.GetData();
+	mSize = mBuf.GetDataLen();
+	return true;
+}
+
+/// 閉じる
+void DiskImageFile::Close()
+{
+	if (mMapped) {
+		Unmap();
+	}
+	if (mFile.IsOpened()) {
+		mFile.Close();
+	}
+	mBuf.SetDataLen(0);
+	pData = NULL;
+	mSize = 0;
+	mWritable = false;
+	mPath.Empty();
+}
+
+/// 位置を指定して書く
+///
+/// イメージの長さは変えない。マップしていない場合は読み込んだ内容も更新する。
+/// @param[in] pos  イメージ内の位置
+/// @param[in] data データ
+/// @param[in] len  長さ
+/// @return 書けなかった場合false
+bool DiskImageFile::WriteAt(size_t pos, const void *data, size_t len)
+{
+	if (!mWritable || pos > mSize || len > mSize - pos) {
+		return false;
+	}
+	if (!mMapped) {
+		if (mFile.Seek((wxFileOffset)pos) == wxInvalidOffset || mFile.Write(data, len) != len) {
+			return false;
+		}
+		memcpy((wxUint8 *)mBuf.GetData() + pos, data, len);
+		return true;
+	}
+#ifdef USE_DISK_IMAGE_MMAP
+#if defined(__WXMSW__)
+	// マップしたビューとWriteFileの内容は同じキャッシュを見る
+	OVERLAPPED ov;
+	memset(&ov, 0, sizeof(ov));
+	ov.Offset = (DWORD)pos;
+	DWORD wlen = 0;
+	if (!::WriteFile((HANDLE)mFileHandle, data, (DWORD)len, &wlen, &ov) || wlen != (DWORD)len) {
+		return false;
+	}
+#else
+	// MAP_SHAREDのマップにはpwriteした内容が見える
+	const char *p = (const char *)data;
+	while(len > 0) {
+		ssize_t wlen = ::pwrite(mFd, p, len, (off_t)pos);
+		if (wlen < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		p += wlen;
+		pos += (size_t)wlen;
+		len -= (size_t)wlen;
+	}
+#endif
+#endif
+	return true;
+}
+
+/// マップする
+/// @return マップできなかった場合false
+bool DiskImageFile::Map()
+{
+#ifdef USE_DISK_IMAGE_MMAP
+#if defined(__WXMSW__)
+	DWORD access = (mWritable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ);
+	HANDLE fh = ::CreateFileW(mPath.wc_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fh == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(fh, &size) || size.QuadPart == 0 || size.HighPart != 0) {
+		::CloseHandle(fh);
+		return false;
+	}
+	HANDLE mh = ::CreateFileMappingW(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mh) {
+		::CloseHandle(fh);
+		return false;
+	}
+	void *p = ::MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+	if (!p) {
+		::CloseHandle(mh);
+		::CloseHandle(fh);
+		return false;
+	}
+	mFileHandle = fh;
+	mMapHandle = mh;
+	pData = (const wxUint8 *)p;
+	mSize = (size_t)size.QuadPart;
+#else
+	int fd = ::open(mPath.fn_str(), mWritable ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *p = ::mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		::close(fd);
+		return false;
+	}
+	mFd = fd;
+	pData = (const wxUint8 *)p;
+	mSize = (size_t)st.st_size;
+#endif
+	mMapped = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// マップをやめる
+void DiskImageFile::Unmap()
+{
+#ifdef USE_DISK_IMAGE_MMAP
+#if defined(__WXMSW__)
+	::UnmapViewOfFile((LPCVOID)pData);
+	::CloseHandle((HANDLE)mMapHandle);
+	::CloseHandle((HANDLE)mFileHandle);
+	mMapHandle = NULL;
+	mFileHandle = INVALID_HANDLE_VALUE;
+#else
+	::munmap((void *)pData, mSize);
+	::close(mFd);
+	mFd = -1;
+#endif
+#endif
+	mMapped = false;
+}
@@ -0,0 +1,91 @@
+﻿/// @file diskimage.h
+///
+/// @brief ディスクイメージのファイル
+///
+///
+#ifndef _DISKIMAGE_H_
+#define _DISKIMAGE_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/file.h>
+
+#if defined(__WXMSW__) || defined(__UNIX__)
+/// イメージをメモリにマップして読む コメントアウトすると全体を読み込む
+#define USE_DISK_IMAGE_MMAP 1
+#endif
+
+/// ディスクイメージのファイル
+///
+/// ファイル全体を読み取り専用でメモリにマップし、セクタのデータを直接参照できるようにする。
+/// マップできない場合は全体をメモリに読み込む。
+/// 書き込みは位置を指定してファイルに直接書き、マップした内容にもそのまま反映される。
+class DiskImageFile
+{
+private:
+	wxString mPath;			///< ファイルのパス
+	const wxUint8 *pData;	///< イメージの先頭
+	size_t mSize;			///< イメージの長さ
+	bool mMapped;			///< マップしている falseならmBufに読み込んだ
+	bool mWritable;			///< 書き込みできる
+	wxMemoryBuffer mBuf;	///< マップできない場合の読み込み先
+	wxFile mFile;			///< マップできない場合の書き込み先
+#ifdef USE_DISK_IMAGE_MMAP
+#if defined(__WXMSW__)
+	void *mFileHandle;		///< ファイルのハンドル
+	void *mMapHandle;		///< マッピングのハンドル
+#else
+	int mFd;				///< ファイル記述子
+#endif
+#endif
+
+	/// マップする
+	bool Map();
+	/// マップをやめる
+	void Unmap();
+
+public:
+	DiskImageFile();
+	~DiskImageFile();
+
+	/// 開く
+	bool Open(const wxString &path, bool writable = false);
+	/// 閉じる
+	void Close();
+
+	bool IsOpened() const { return (pData != NULL); }
+	bool IsMapped() const { return mMapped; }
+	bool IsWritable() const { return mWritable; }
+	const wxString &GetPath() const { return mPath; }
+	const wxUint8 *GetData() const { return pData; }
+	size_t GetSize() const { return mSize; }
+
+	/// 位置を指定して書く
+	bool WriteAt(size_t pos, const void *data, size_t len);
+
+	DECLARE_NO_COPY_CLASS(DiskImageFile)
+};
+
+/// BASICのファイルを書き込めるディスクの機種によらない操作
+///
+/// Parse::WriteDiskImageFile が機種ごとのディスクをこの形で使う。
+/// ファイル名は機種ごとのディレクトリの形式に変換してから使う。
+class DiskBasicFiles
+{
+public:
+	virtual ~DiskBasicFiles() {}
+	/// 開く
+	virtual bool Open(const wxString &path, bool writable = false) = 0;
+	/// 書き込み禁止か
+	virtual bool IsWriteProtected() const { return false; }
+	/// 空きクラスタ数
+	virtual int GetFreeClusters() const = 0;
+	/// 同じ名前のファイルを置き換えると空くクラスタ数
+	virtual int GetReplacedClusters(const wxString &name, const wxString &ext) const = 0;
+	/// BASICのファイルに必要なクラスタ数
+	virtual int GetRequiredBasicClusters(size_t len, bool ascii) const = 0;
+	/// BASICのファイルを書き込む 同じ名前のファイルがあれば置き換える
+	virtual bool SaveBasicFile(const wxString &name, const wxString &ext, const wxUint8 *data, size_t len, bool ascii) = 0;
+};
+
+#endif /* _DISKIMAGE_H_ */
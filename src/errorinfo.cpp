@@ -3,6 +3,9 @@
 /// @brief エラー情報
 ///
 #include "errorinfo.h"
+#include <wx/msgout.h>
+
+PsErrHandler PsErrInfo::mHandler = NULL;
 
 PsErrInfo::PsErrInfo()
 {
@@ -65,6 +68,30 @@ wxString PsErrInfo::ErrMsg(PsErrCode code)
 			// 処理を続行します。
 			msg = _("Continue this process.");
 			break;
+		case psErrTapeChecksum:
+			// テープイメージにチェックサムが合わないブロックがあります。
+			msg = _("Some blocks in the tape image have wrong checksum.");
+			break;
+		case psErrWaveFormat:
+			// 対応していないWAVファイルです。
+			msg = _("Unsupported WAV file format.");
+			break;
+		case psErrDiskFormat:
+			// ディスクイメージのディレクトリかFATを読めません。
+			msg = _("Cannot read the directory or FAT in the disk image.");
+			break;
+		case psErrDiskNoBasic:
+			// ディスクイメージにBASICのファイルがありません。
+			msg = _("No BASIC file in the disk image.");
+			break;
+		case psErrDiskFull:
+			// ディスクイメージに空きがありません。
+			msg = _("Not enough free space in the disk image.");
+			break;
+		case psErrDiskWrite:
+			// ディスクイメージに書き込めません。
+			msg = _("Cannot write to the disk image.");
+			break;
 		default:
 			msg = _("Unknown error.");
 			break;
@@ -97,15 +124,46 @@ void PsErrInfo::SetInfo(int line, PsErrType type, PsErrCode code1, PsErrCode cod
 		mLine = line;
 }
 
-/// gui メッセージBOX
+/// エラー情報クリア
+void PsErrInfo::Clear()
+{
+	mType = psOK;
+	mCode = psErrNone;
+	mMsg = _T("");
+	mLine = 0;
+}
+
+/// エラーを知らせる
+///
+/// 登録した関数を呼ぶ。GUIはメッセージBOXを出す関数を登録する。
+/// @param[in] win 親ウィンドウ
 void PsErrInfo::ShowMsgBox(wxWindow *win)
 {
-	switch(mType) {
+	if (mHandler) {
+		mHandler(*this, win);
+	} else {
+		PrintToStderr(*this, win);
+	}
+}
+
+/// エラーを知らせる関数を登録
+/// @param[in] handler 関数 NULLなら標準エラーへ出力
+void PsErrInfo::SetHandler(PsErrHandler handler)
+{
+	mHandler = handler;
+}
+
+/// 標準エラーへ出力する
+/// @param[in] info エラー情報
+/// @param[in] win  使わない
+void PsErrInfo::PrintToStderr(const PsErrInfo &info, wxWindow *WXUNUSED(win))
+{
+	switch(info.mType) {
 		case psError:
-			wxMessageBox(mMsg, _("Error"), wxOK | wxICON_ERROR, win);
+			wxMessageOutputStderr().Printf(_T("%s: %s\n"), _("Error"), info.mMsg);
 			break;
 		case psWarning:
-			wxMessageBox(mMsg, _("Warning"), wxOK | wxICON_WARNING, win);
+			wxMessageOutputStderr().Printf(_T("%s: %s\n"), _("Warning"), info.mMsg);
 			break;
 		default:
 			break;
@@ -29,10 +29,27 @@ typedef enum enumPsErrCode {
 	psErrInvalidString,
 	psInfoFileInApp,
 	psInfoContinue,
+	psErrTapeChecksum,
+	psErrWaveFormat,
+	psErrDiskFormat,
+	psErrDiskNoBasic,
+	psErrDiskFull,
+	psErrDiskWrite,
 	psErrUnknown
 } PsErrCode;
 
+class PsErrInfo;
+class WXDLLIMPEXP_FWD_CORE wxWindow;
+
+/// エラーを知らせる関数
+/// @param[in] info エラー情報
+/// @param[in] win  親ウィンドウ (GUIのみ)
+typedef void (*PsErrHandler)(const PsErrInfo &info, wxWindow *win);
+
 /// エラー情報保存用
+///
+/// 変換エンジンはGUIを使わないので、エラーは登録した関数で知らせる。
+/// 登録しなければ標準エラーへ出力する。
 class PsErrInfo
 {
 private:
@@ -41,6 +58,8 @@ private:
 	wxString  mMsg;
 	int       mLine;
 
+	static PsErrHandler mHandler;
+
 public:
 	PsErrInfo();
 	~PsErrInfo();
@@ -52,9 +71,20 @@ public:
 	/// エラー情報セット
 	void SetInfo(int line, PsErrType type, PsErrCode code1, PsErrCode code2, const wxString &msg = wxEmptyString);
 
-	/// gui メッセージBOX
+	/// エラー情報クリア
+	void Clear();
+	PsErrType GetType() const { return mType; }
+	PsErrCode GetCode() const { return mCode; }
+	const wxString &GetMessage() const { return mMsg; }
+
+	/// エラーを知らせる (GUIではメッセージBOX)
 	void ShowMsgBox(wxWindow *win = 0);
 
+	/// エラーを知らせる関数を登録 NULLなら標準エラーへ出力
+	static void SetHandler(PsErrHandler handler);
+	/// 標準エラーへ出力する
+	static void PrintToStderr(const PsErrInfo &info, wxWindow *win);
+
 };
 
 #endif /* _ERRORINFO_H_ */
@@ -111,35 +111,160 @@ bool PsFileInfo::IsSameFile(const wxFileName &dst) const {
 //
 //
 PsFileData::PsFileData() : PsFileType() {
+	utf8_lines = 0;
 }
 PsFileData::PsFileData(const PsFileData &new_type) : PsFileType(new_type) {
-	datas = new_type.datas;
+	utf8_lines = 0;
+	CopyFrom(new_type);
 }
 PsFileData &PsFileData::operator=(const PsFileData &src) {
 	PsFileType::operator=(src);
-	datas = src.datas;
+	CopyFrom(src);
 	return *this; 
 }
-wxArrayString &PsFileData::GetData() {
-	return datas;
-}
+/// バッファは共有されるので中身をコピーする
+void PsFileData::CopyFrom(const PsFileData &src) {
+	if (this == &src) return;
+	datas.SetDataLen(0);
+	datas.AppendData(src.datas.GetData(), src.datas.GetDataLen());
+	index.SetDataLen(0);
+	index.AppendData(src.index.GetData(), src.index.GetDataLen());
+	utf8_lines = src.utf8_lines;
+}
+const PsFileData::line_index_t &PsFileData::Index(size_t nIndex) const {
+	wxASSERT(nIndex < GetCount());
+	return ((const line_index_t *)index.GetData())[nIndex];
+}
+/// 1行分の領域を末尾に追加する
+/// @return 書き込み先 次に追加するまで有効
+wxUint8 *PsFileData::AppendLine(size_t len, wxUint32 line_flags) {
+	line_index_t idx;
+	idx.pos = (wxUint32)datas.GetDataLen();
+	idx.len = (wxUint32)len;
+	idx.flags = line_flags;
+	index.AppendData(&idx, sizeof(idx));
+	if (line_flags & UTF8_LINE) utf8_lines++;
+	wxUint8 *dst = (wxUint8 *)datas.GetAppendBuf(len);
+	datas.UngetAppendBuf(len);
+	return dst;
+}
+/// 全行を文字列の配列にして返す
+void PsFileData::GetData(wxArrayString &lines) const {
+	lines.Alloc(lines.GetCount() + GetCount());
+	for(size_t i=0; i<GetCount(); i++) {
+		lines.Add(GetLine(i));
+	}
+}
+/// 1行追加
+/// 8bitに収まらない文字があればUTF-8にして格納する
 size_t PsFileData::Add(const wxString &str, size_t copies) {
-	return datas.Add(str, copies);
+	bool is_8bit = true;
+	for(wxString::const_iterator it = str.begin(); it != str.end(); ++it) {
+		if ((*it).GetValue() > 0xff) {
+			is_8bit = false;
+			break;
+		}
+	}
+	size_t pos = GetCount();
+	for(size_t n=0; n<copies; n++) {
+		if (is_8bit) {
+			wxUint8 *dst = AppendLine(str.Len(), 0);
+			for(wxString::const_iterator it = str.begin(); it != str.end(); ++it) {
+				*dst++ = (wxUint8)(*it).GetValue();
+			}
+		} else {
+			wxScopedCharBuffer buf = str.ToUTF8();
+			memcpy(AppendLine(buf.length(), UTF8_LINE), buf.data(), buf.length());
+		}
+	}
+	return pos;
 }
 size_t PsFileData::Add(const char *str, size_t len) {
-	return datas.Add(BinString(str, len));
+	return Add((const wxUint8 *)str, len);
 }
 size_t PsFileData::Add(const wxUint8 *str, size_t len) {
-	return datas.Add(BinString(str, len));
-}
+	size_t pos = GetCount();
+	memcpy(AppendLine(len, 0), str, len);
+	return pos;
+}
+/// 8bitの行を追加して書き込み先を返す
+/// @note 返したポインタは次に追加するまで有効
+wxUint8 *PsFileData::AddBuf(size_t len) {
+	return AppendLine(len, 0);
+}
+/// 8bitの行を複数まとめて追加して書き込み先を返す
+/// @param[in] lens  各行の長さ
+/// @param[in] count 行数
+/// @return 先頭行の書き込み先 各行は続けて並ぶ 次に追加するまで有効
+wxUint8 *PsFileData::AddBufs(const wxUint32 *lens, size_t count) {
+	wxUint32 pos = (wxUint32)datas.GetDataLen();
+	wxUint32 total = 0;
+	line_index_t *idx = (line_index_t *)index.GetAppendBuf(count * sizeof(line_index_t));
+	for(size_t i=0; i<count; i++) {
+		idx[i].pos = pos + total;
+		idx[i].len = lens[i];
+		idx[i].flags = 0;
+		total += lens[i];
+	}
+	index.UngetAppendBuf(count * sizeof(line_index_t));
+	wxUint8 *dst = (wxUint8 *)datas.GetAppendBuf(total);
+	datas.UngetAppendBuf(total);
+	return dst;
+}
+/// 他のデータの行をそのまま追加する
+/// @param[in] src   追加元
+/// @param[in] start 追加元の開始行
+/// @param[in] count 行数
+void PsFileData::AddLines(const PsFileData &src, size_t start, size_t count) {
+	for(size_t i=start; i<start+count; i++) {
+		const line_index_t &idx = src.Index(i);
+		memcpy(AppendLine(idx.len, idx.flags), src.GetLinePtr(i), idx.len);
+	}
+}
+/// クリア
+/// @note 領域は再利用する
 void PsFileData::Empty() {
-	datas.Empty();
+	datas.SetDataLen(0);
+	index.SetDataLen(0);
+	utf8_lines = 0;
 }
 size_t PsFileData::GetCount() const {
-	return datas.GetCount();
+	return index.GetDataLen() / sizeof(line_index_t);
+}
+/// 1行を文字列にして返す
+wxString PsFileData::GetLine(size_t nIndex) const {
+	const line_index_t &idx = Index(nIndex);
+	const char *p = (const char *)datas.GetData() + idx.pos;
+	if (idx.flags & UTF8_LINE) {
+		return wxString::FromUTF8(p, idx.len);
+	} else {
+		return wxString::From8BitData(p, idx.len);
+	}
+}
+wxString PsFileData::operator[](size_t nIndex) const {
+	return GetLine(nIndex);
+}
+/// 1行のデータへのポインタ
+/// @note 次に追加するまで有効
+const wxUint8 *PsFileData::GetLinePtr(size_t nIndex) const {
+	return (const wxUint8 *)datas.GetData() + Index(nIndex).pos;
+}
+size_t PsFileData::GetLineLen(size_t nIndex) const {
+	return Index(nIndex).len;
 }
-wxString &PsFileData::operator[](size_t nIndex) {
-	return datas[nIndex];
+bool PsFileData::IsUTF8Line(size_t nIndex) const {
+	return (Index(nIndex).flags & UTF8_LINE) != 0;
+}
+/// 全行を連結したデータ
+const wxUint8 *PsFileData::GetBuffer() const {
+	return (const wxUint8 *)datas.GetData();
+}
+size_t PsFileData::GetBufferLen() const {
+	return datas.GetDataLen();
+}
+/// 全行が8bitで格納されているか
+bool PsFileData::Is8Bit() const {
+	return (utf8_lines == 0);
 }
 
 //
@@ -169,6 +294,22 @@ PsFileInput &PsFileInput::operator=(const PsFileInput &src) {
 wxInputStream &PsFileInput::Read(void *buffer, size_t size) {
 	return wxInputStream::Read(buffer, size);
 }
+/// 終わりまで読んでバッファの後ろに追加する
+/// @param[in,out] buf 読み込み先
+/// @return 読んだバイト数
+size_t PsFileInput::ReadAll(wxMemoryBuffer &buf) {
+	size_t total = 0;
+	for(;;) {
+		wxUint8 *p = (wxUint8 *)buf.GetAppendBuf(65536);
+		size_t vlen = Read(p, 65536);
+		buf.UngetAppendBuf(vlen);
+		total += vlen;
+		if (vlen == 0 || Eof()) {
+			break;
+		}
+	}
+	return total;
+}
 #if 0
 size_t PsFileInput::Read(const wxUint8 *buffer, size_t size) {
 	return wxInputStream::Read((void *)buffer, size).LastRead();
@@ -212,6 +353,20 @@ PsFileOutput &PsFileOutput::operator=(const PsFileOutput &src) {
 wxOutputStream &PsFileOutput::Write(const void *buffer, size_t size) {
 	return wxOutputStream::Write(buffer, size);
 }
+/// 1行を出力 8bitで格納した行はそのまま出力する
+size_t PsFileOutput::WriteLine(const PsFileData &data, size_t row) {
+	if (data.IsUTF8Line(row)) {
+		return Write(data.GetLine(row));
+	}
+	return Write(data.GetLinePtr(row), data.GetLineLen(row));
+}
+/// 1行をUTF-8で出力 UTF-8で格納した行はそのまま出力する
+size_t PsFileOutput::WriteLineUTF8(const PsFileData &data, size_t row) {
+	if (data.IsUTF8Line(row)) {
+		return Write(data.GetLinePtr(row), data.GetLineLen(row));
+	}
+	return WriteUTF8(data.GetLine(row));
+}
 #if 0
 size_t PsFileOutput::Write(const wxUint8 *buffer, size_t size) {
 	return wxOutputStream::Write((void *)buffer, size).LastWrite();
@@ -24,6 +24,7 @@ enum enFileTypes {
 	psEncrypted   = 0x00000010,
 	psTapeImage   = 0x00000020,
 	psDiskImage   = 0x00000040,
+	psWaveAudio   = 0x00000080,	///< テープイメージを音声(WAV)で出力
 };
 
 /// ファイルタイプ情報
@@ -84,24 +85,56 @@ public:
 };
 
 /// ファイルタイプ＋バッファ
+///
+/// 全行を1つのバッファに詰めて格納し、各行の位置は索引で管理する。
+/// 8bitに収まらない行はUTF-8にして格納する。
 class PsFileData : public PsFileType
 {
+public:
+	enum enLineFlags {
+		UTF8_LINE = 0x01,
+	};
+	/// 行の索引
+	typedef struct st_line_index {
+		wxUint32 pos;	///< バッファ内の位置
+		wxUint32 len;	///< 長さ
+		wxUint32 flags;	///< enLineFlags
+	} line_index_t;
+
 private:
-	wxArrayString datas;
+	wxMemoryBuffer datas;	///< 全行のデータ
+	wxMemoryBuffer index;	///< 行の索引 line_index_t の並び
+	size_t utf8_lines;		///< UTF-8で格納した行数
+
+	const line_index_t &Index(size_t nIndex) const;
+	wxUint8 *AppendLine(size_t len, wxUint32 line_flags);
+	void CopyFrom(const PsFileData &src);
+
 public:
 	PsFileData();
 	PsFileData(const PsFileData &new_type);
 	PsFileData &operator=(const PsFileData &src);
 	~PsFileData() {}
 
-	wxArrayString &GetData();
+	void GetData(wxArrayString &lines) const;
 
 	size_t Add(const wxString &str, size_t copies=1);
 	size_t Add(const char *str, size_t len);
 	size_t Add(const wxUint8 *str, size_t len);
+	wxUint8 *AddBuf(size_t len);
+	wxUint8 *AddBufs(const wxUint32 *lens, size_t count);
+	void AddLines(const PsFileData &src, size_t start, size_t count);
 	void Empty();
 	size_t GetCount() const;
-	wxString &operator[](size_t nIndex);
+	wxString GetLine(size_t nIndex) const;
+	wxString operator[](size_t nIndex) const;
+	const wxUint8 *GetLinePtr(size_t nIndex) const;
+	size_t GetLineLen(size_t nIndex) const;
+	bool IsUTF8Line(size_t nIndex) const;
+
+	const wxUint8 *GetBuffer() const;
+	size_t GetBufferLen() const;
+	bool Is8Bit() const;
 };
 
 class PsFileOutput;
@@ -126,6 +159,8 @@ public:
 	virtual wxFileOffset Seek(wxFileOffset pos, wxSeekMode mode=wxFromStart) = 0;
 	virtual void SeekStartPos() = 0;
 	virtual void SeekStartPos(size_t pos) = 0;
+	/// 終わりまで読んでバッファの後ろに追加する
+	size_t ReadAll(wxMemoryBuffer &buf);
 
 protected:
 //	virtual size_t OnSysRead(void *, size_t);
@@ -145,6 +180,8 @@ public:
 	virtual size_t Write(const wxString &str) = 0;
 	virtual size_t WriteUTF8(const wxString &str) = 0;
 	virtual PsFileOutput &Write(PsFileInput &src) = 0;
+	size_t WriteLine(const PsFileData &data, size_t row);
+	size_t WriteLineUTF8(const PsFileData &data, size_t row);
 	virtual bool IsOpened() const = 0;
 	virtual wxFileOffset Seek(wxFileOffset pos, wxSeekMode mode=wxFromStart) = 0;
 
@@ -0,0 +1,557 @@
+﻿/// @file l3disk.cpp
+///
+/// @brief L3/S1のDISK BASICのディスク
+///
+///
+#include "l3disk.h"
+#include <wx/file.h>
+#include <string.h>
+
+/// 2Dのディスク 管理トラックはシリンダ18のサイド1
+L3DiskLayout::L3DiskLayout()
+{
+	mSectorsPerTrack = 16;
+	mSectorSize = 256;
+	mSectorsPerCluster = 8;
+	mDirTrack = 37;
+	mDirStart = 1;
+	mDirSectors = 12;
+	mFatSector = 14;
+	mFatCopies = 3;
+}
+
+/// 1トラックのクラスタ数
+int L3DiskLayout::GetClustersPerTrack() const
+{
+	int n = (mSectorsPerCluster > 0 ? mSectorsPerTrack / mSectorsPerCluster : 0);
+	return (n > 0 ? n : 1);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+L3DiskBasic::L3DiskBasic()
+{
+	memset(mFat, L3DISK_FAT_FREE, sizeof(mFat));
+	mClusters = 0;
+}
+
+/// 開く
+/// @param[in] path     イメージのファイル
+/// @param[in] writable 書き込みもする
+/// @return DISK BASICのディスクでない場合false
+bool L3DiskBasic::Open(const wxString &path, bool writable)
+{
+	Close();
+	if (!mDisk.Open(path, writable)) {
+		return false;
+	}
+	if (!ReadFat() || !ReadDirectory()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+/// 閉じる
+void L3DiskBasic::Close()
+{
+	mDisk.Close();
+	memset(mFat, L3DISK_FAT_FREE, sizeof(mFat));
+	mClusters = 0;
+	mFiles.SetDataLen(0);
+}
+
+/// クラスタのセクタ
+/// @param[in] cluster クラスタ番号
+/// @param[in] idx     クラスタ内のセクタの位置
+/// @return ないときNULL
+const D88Sector *L3DiskBasic::GetClusterSector(int cluster, int idx) const
+{
+	int per_track = mLayout.GetClustersPerTrack();
+	int track = cluster / per_track;
+	int r = (cluster % per_track) * mLayout.mSectorsPerCluster + idx + 1;
+	return mDisk.FindSector(track, r);
+}
+
+/// FATを読む
+///
+/// クラスタ数はイメージのトラック数から決める。
+/// @return FATのセクタがない場合false
+bool L3DiskBasic::ReadFat()
+{
+	const D88Sector *sector = mDisk.FindSector(mLayout.mDirTrack, mLayout.mFatSector);
+	if (!sector || sector->size == 0) {
+		return false;
+	}
+	mClusters = mDisk.GetTrackCount() * mLayout.GetClustersPerTrack();
+	if (mClusters > (int)sector->size) mClusters = (int)sector->size;
+	if (mClusters > L3DISK_FAT_LAST) mClusters = L3DISK_FAT_LAST;
+
+	memset(mFat, L3DISK_FAT_FREE, sizeof(mFat));
+	memcpy(mFat, mDisk.GetSectorData(sector), mClusters);
+	return true;
+}
+
+/// ディレクトリを読む
+///
+/// 先頭がFFのエントリで終わり、00のエントリは削除されたものとして飛ばす。
+/// @return ディレクトリのセクタがない場合false
+bool L3DiskBasic::ReadDirectory()
+{
+	mFiles.SetDataLen(0);
+
+	L3DiskFile file;
+	int entry = 0;
+	for(int s = 0; s < mLayout.mDirSectors; s++) {
+		const D88Sector *sector = mDisk.FindSector(mLayout.mDirTrack, mLayout.mDirStart + s);
+		if (!sector) {
+			return (s > 0);
+		}
+		const wxUint8 *p = mDisk.GetSectorData(sector);
+		for(size_t pos = 0; pos + L3DISK_ENTRY_SIZE <= sector->size; pos += L3DISK_ENTRY_SIZE, entry++) {
+			const wxUint8 *e = &p[pos];
+			if (e[0] == 0xff) {
+				// 以降は未使用
+				return true;
+			}
+			if (e[0] == 0x00) {
+				// 削除済み
+				continue;
+			}
+			memset(&file, 0, sizeof(file));
+			memcpy(file.raw_name, e, L3DISK_NAME_LEN + L3DISK_EXT_LEN);
+			file.attr = e[L3DISK_NAME_LEN + L3DISK_EXT_LEN];
+			file.first_cluster = e[L3DISK_NAME_LEN + L3DISK_EXT_LEN + 1];
+			file.entry = entry;
+			CountFile(file);
+			mFiles.AppendData(&file, sizeof(file));
+		}
+	}
+	return true;
+}
+
+/// ファイルの長さを求める
+///
+/// FATをたどってクラスタとセクタを数える。アスキー形式は最後のセクタの1Aまでにする。
+/// @param[in,out] file ファイル
+void L3DiskBasic::CountFile(L3DiskFile &file) const
+{
+	int cluster = file.first_cluster;
+	int last_cluster = -1;
+	int last_count = 0;
+	while(file.clusters <= mClusters) {
+		if (cluster >= mClusters) {
+			file.broken = true;
+			break;
+		}
+		file.clusters++;
+		int next = mFat[cluster];
+		if (next > L3DISK_FAT_LAST && next <= L3DISK_FAT_LAST + mLayout.mSectorsPerCluster) {
+			last_cluster = cluster;
+			last_count = next - L3DISK_FAT_LAST;
+			file.sectors += last_count;
+			break;
+		}
+		file.sectors += mLayout.mSectorsPerCluster;
+		cluster = next;
+	}
+	if (file.clusters > mClusters) {
+		// 循環している
+		file.broken = true;
+	}
+	file.data_len = (size_t)file.sectors * mLayout.mSectorSize;
+
+	if (!file.broken && last_cluster >= 0 && (file.attr & (L3DISK_ATTR_BINARY | L3DISK_ATTR_MACHINE)) == 0) {
+		const D88Sector *sector = GetClusterSector(last_cluster, last_count - 1);
+		if (sector) {
+			const wxUint8 *p = mDisk.GetSectorData(sector);
+			const wxUint8 *eof = (const wxUint8 *)memchr(p, 0x1a, sector->size);
+			if (eof) {
+				file.data_len -= (size_t)mLayout.mSectorSize - (size_t)(eof - p);
+			}
+		}
+	}
+}
+
+/// ファイルを返す
+const L3DiskFile &L3DiskBasic::Item(size_t idx) const
+{
+	wxASSERT(idx < Count());
+	return ((const L3DiskFile *)mFiles.GetData())[idx];
+}
+
+/// 表示用のファイル名
+/// @return 名前.拡張子 拡張子が空白のときは名前だけ
+wxString L3DiskBasic::GetName(size_t idx) const
+{
+	const L3DiskFile &file = Item(idx);
+	wxString name = wxString::From8BitData((const char *)file.raw_name, L3DISK_NAME_LEN);
+	wxString ext = wxString::From8BitData((const char *)&file.raw_name[L3DISK_NAME_LEN], L3DISK_EXT_LEN);
+	name.Trim();
+	ext.Trim();
+	if (!ext.IsEmpty()) {
+		name += _T(".");
+		name += ext;
+	}
+	return name;
+}
+
+/// アスキー形式か
+bool L3DiskBasic::IsAscii(size_t idx) const
+{
+	return ((Item(idx).attr & (L3DISK_ATTR_BINARY | L3DISK_ATTR_MACHINE)) == 0);
+}
+
+/// 最初のBASICのファイル
+/// @return ファイルの番号 ないとき-1
+int L3DiskBasic::FindBasic() const
+{
+	for(size_t i = 0; i < Count(); i++) {
+		const L3DiskFile &file = Item(i);
+		if (!file.broken && (file.attr & L3DISK_ATTR_MACHINE) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/// 空きクラスタ数
+int L3DiskBasic::GetFreeClusters() const
+{
+	int count = 0;
+	for(int i = 0; i < mClusters; i++) {
+		if (mFat[i] == L3DISK_FAT_FREE) count++;
+	}
+	return count;
+}
+
+/// ファイルのデータを書き出す
+///
+/// マップしたイメージのセクタから直接書く。
+/// @param[in]  idx ファイルの番号
+/// @param[out] out 出力先
+/// @return 書いたバイト数
+size_t L3DiskBasic::Write(size_t idx, PsFileOutput &out) const
+{
+	const L3DiskFile &file = Item(idx);
+	size_t remain = file.data_len;
+	int cluster = file.first_cluster;
+	for(int c = 0; c < file.clusters && remain > 0 && cluster < mClusters; c++) {
+		for(int s = 0; s < mLayout.mSectorsPerCluster && remain > 0; s++) {
+			const D88Sector *sector = GetClusterSector(cluster, s);
+			if (!sector) {
+				return file.data_len - remain;
+			}
+			size_t len = (sector->size < remain ? sector->size : remain);
+			if (out.Write(mDisk.GetSectorData(sector), len) != len) {
+				return file.data_len - remain;
+			}
+			remain -= len;
+		}
+		cluster = mFat[cluster];
+	}
+	return file.data_len - remain;
+}
+
+/// ファイルのデータをファイルに書く
+/// @param[in] idx  ファイルの番号
+/// @param[in] path 出力先
+/// @return 書けなかった場合false
+bool L3DiskBasic::ExtractTo(size_t idx, const wxString &path) const
+{
+	wxFile file;
+	if (!file.Create(path, true)) {
+		return false;
+	}
+	PsFileFsOutput out(file);
+	return (Write(idx, out) == Item(idx).data_len);
+}
+
+/// ファイル名と拡張子からディレクトリのファイル名を作る
+///
+/// 英小文字は大文字にし、足りない分は空白で埋める。
+/// @param[in]  name     ファイル名 (8ビットの文字)
+/// @param[in]  ext      拡張子
+/// @param[out] raw_name ディレクトリのファイル名 (9バイト)
+void L3DiskBasic::MakeRawName(const wxString &name, const wxString &ext, wxUint8 *raw_name)
+{
+	memset(raw_name, ' ', L3DISK_NAME_LEN + L3DISK_EXT_LEN);
+	for(size_t i = 0; i < name.Len() && i < L3DISK_NAME_LEN; i++) {
+		wxUint8 c = (wxUint8)(name[i].GetValue() & 0xff);
+		if (c >= 'a' && c <= 'z') c -= 0x20;
+		raw_name[i] = c;
+	}
+	for(size_t i = 0; i < ext.Len() && i < L3DISK_EXT_LEN; i++) {
+		wxUint8 c = (wxUint8)(ext[i].GetValue() & 0xff);
+		if (c >= 'a' && c <= 'z') c -= 0x20;
+		raw_name[L3DISK_NAME_LEN + i] = c;
+	}
+}
+
+/// ファイル名で探す
+/// @param[in] raw_name ディレクトリのファイル名 (9バイト)
+/// @return ファイルの番号 ないとき-1
+int L3DiskBasic::FindFile(const wxUint8 *raw_name) const
+{
+	for(size_t i = 0; i < Count(); i++) {
+		if (memcmp(Item(i).raw_name, raw_name, L3DISK_NAME_LEN + L3DISK_EXT_LEN) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/// ファイルに必要なクラスタ数
+/// @param[in] len   データの長さ
+/// @param[in] ascii アスキー形式 (終わりに1Aを足す)
+int L3DiskBasic::GetRequiredClusters(size_t len, bool ascii) const
+{
+	if (ascii) len++;
+	size_t sectors = (len + mLayout.mSectorSize - 1) / mLayout.mSectorSize;
+	if (sectors == 0) sectors = 1;
+	return (int)((sectors + mLayout.mSectorsPerCluster - 1) / mLayout.mSectorsPerCluster);
+}
+
+/// ファイルのクラスタを解放する
+///
+/// FATのつながりが壊れているファイルは解放しない。
+/// @param[in]     file ファイル
+/// @param[in,out] fat  FAT
+void L3DiskBasic::FreeChain(const L3DiskFile &file, wxUint8 *fat) const
+{
+	if (file.broken) {
+		return;
+	}
+	int cluster = file.first_cluster;
+	for(int c = 0; c < file.clusters && cluster < mClusters; c++) {
+		int next = fat[cluster];
+		fat[cluster] = L3DISK_FAT_FREE;
+		cluster = next;
+	}
+}
+
+/// ディレクトリのエントリのセクタ
+/// @param[in]  entry  エントリの番号
+/// @param[out] offset セクタ内の位置
+/// @return ないときNULL
+const D88Sector *L3DiskBasic::GetEntrySector(int entry, size_t &offset) const
+{
+	int per_sector = mLayout.mSectorSize / L3DISK_ENTRY_SIZE;
+	if (entry < 0 || per_sector <= 0 || entry >= per_sector * mLayout.mDirSectors) {
+		return NULL;
+	}
+	const D88Sector *sector = mDisk.FindSector(mLayout.mDirTrack, mLayout.mDirStart + entry / per_sector);
+	offset = (size_t)(entry % per_sector) * L3DISK_ENTRY_SIZE;
+	if (sector && offset + L3DISK_ENTRY_SIZE > sector->size) {
+		sector = NULL;
+	}
+	return sector;
+}
+
+/// 空いているエントリを探す
+/// @return エントリの番号 ないとき-1
+int L3DiskBasic::FindFreeEntry() const
+{
+	int count = (mLayout.mSectorSize / L3DISK_ENTRY_SIZE) * mLayout.mDirSectors;
+	for(int entry = 0; entry < count; entry++) {
+		size_t offset;
+		const D88Sector *sector = GetEntrySector(entry, offset);
+		if (!sector) {
+			break;
+		}
+		wxUint8 c = mDisk.GetSectorData(sector)[offset];
+		if (c == 0x00 || c == 0xff) {
+			return entry;
+		}
+	}
+	return -1;
+}
+
+/// FATを書く
+///
+/// 管理セクタにあるFATの複製もすべて書き換える。
+/// @param[in] fat FAT
+/// @return 書けなかった場合false
+bool L3DiskBasic::WriteFat(const wxUint8 *fat)
+{
+	for(int i = 0; i < mLayout.mFatCopies; i++) {
+		const D88Sector *sector = mDisk.FindSector(mLayout.mDirTrack, mLayout.mFatSector + i);
+		if (!sector) {
+			if (i == 0) return false;
+			break;
+		}
+		if (!mDisk.WriteSector(sector, 0, fat, mClusters)) {
+			return false;
+		}
+	}
+	memcpy(mFat, fat, mClusters);
+	return true;
+}
+
+/// ファイルを書き込む
+///
+/// 同じ名前のファイルがあればそのエントリを使って置き換える。
+/// 空きクラスタは先頭から順に使い、置き換えるファイルのクラスタは最後に使う。
+/// 最後のセクタの残りはアスキー形式では1A、それ以外では00で埋める。
+/// @param[in] raw_name ディレクトリのファイル名 (9バイト)
+/// @param[in] attr     属性 enL3DiskAttrs
+/// @param[in] data     データ
+/// @param[in] len      長さ
+/// @return 空きがないか書けなかった場合false
+bool L3DiskBasic::SaveFile(const wxUint8 *raw_name, int attr, const wxUint8 *data, size_t len)
+{
+	if (mDisk.IsWriteProtected() || !mDisk.GetFile().IsWritable()) {
+		return false;
+	}
+	bool ascii = ((attr & (L3DISK_ATTR_BINARY | L3DISK_ATTR_MACHINE)) == 0);
+	wxUint8 fat[L3DISK_FAT_SIZE];
+	memcpy(fat, mFat, sizeof(fat));
+
+	// 置き換えるファイルのクラスタを空ける
+	int idx = FindFile(raw_name);
+	int entry;
+	if (idx >= 0) {
+		FreeChain(Item(idx), fat);
+		entry = Item(idx).entry;
+	} else {
+		entry = FindFreeEntry();
+		if (entry < 0) {
+			return false;
+		}
+	}
+
+	// クラスタを割り当てる
+	int need = GetRequiredClusters(len, ascii);
+	int chain[L3DISK_FAT_SIZE];
+	int count = 0;
+	for(int i = 0; i < mClusters && count < need; i++) {
+		if (mFat[i] == L3DISK_FAT_FREE) {
+			chain[count++] = i;
+		}
+	}
+	for(int i = 0; i < mClusters && count < need; i++) {
+		if (fat[i] == L3DISK_FAT_FREE && mFat[i] != L3DISK_FAT_FREE) {
+			chain[count++] = i;
+		}
+	}
+	if (count < need) {
+		return false;
+	}
+	size_t total = len + (ascii ? 1 : 0);
+	int sectors = (int)((total + mLayout.mSectorSize - 1) / mLayout.mSectorSize);
+	if (sectors == 0) sectors = 1;
+	for(int i = 0; i < count - 1; i++) {
+		fat[chain[i]] = (wxUint8)chain[i + 1];
+	}
+	fat[chain[count - 1]] = (wxUint8)(L3DISK_FAT_LAST + sectors - (count - 1) * mLayout.mSectorsPerCluster);
+
+	// データを書く 最後のセクタだけ埋めてから書く
+	size_t pos = 0;
+	wxUint8 last[1024];
+	for(int s = 0; s < sectors; s++) {
+		const D88Sector *sector = GetClusterSector(chain[s / mLayout.mSectorsPerCluster], s % mLayout.mSectorsPerCluster);
+		if (!sector || sector->size > sizeof(last)) {
+			return false;
+		}
+		size_t remain = len - pos;
+		if (remain >= sector->size) {
+			if (!mDisk.WriteSector(sector, 0, &data[pos], sector->size)) {
+				return false;
+			}
+			pos += sector->size;
+		} else {
+			memset(last, ascii ? 0x1a : 0x00, sector->size);
+			memcpy(last, &data[pos], remain);
+			if (!mDisk.WriteSector(sector, 0, last, sector->size)) {
+				return false;
+			}
+			pos = len;
+		}
+	}
+
+	// FATを書く
+	if (!WriteFat(fat)) {
+		return false;
+	}
+
+	// ディレクトリを書く
+	size_t offset;
+	const D88Sector *sector = GetEntrySector(entry, offset);
+	if (!sector) {
+		return false;
+	}
+	wxUint8 e[L3DISK_ENTRY_SIZE];
+	if (idx >= 0) {
+		memcpy(e, mDisk.GetSectorData(sector) + offset, sizeof(e));
+	} else {
+		memset(e, 0, sizeof(e));
+	}
+	memcpy(e, raw_name, L3DISK_NAME_LEN + L3DISK_EXT_LEN);
+	e[L3DISK_NAME_LEN + L3DISK_EXT_LEN] = (wxUint8)attr;
+	e[L3DISK_NAME_LEN + L3DISK_EXT_LEN + 1] = (wxUint8)chain[0];
+	if (!mDisk.WriteSector(sector, offset, e, sizeof(e))) {
+		return false;
+	}
+	return ReadDirectory();
+}
+
+/// ファイルを削除する
+///
+/// エントリの先頭を00にしてクラスタを空ける。
+/// @param[in] idx ファイルの番号
+/// @return 書けなかった場合false
+bool L3DiskBasic::DeleteFile(size_t idx)
+{
+	if (mDisk.IsWriteProtected() || !mDisk.GetFile().IsWritable()) {
+		return false;
+	}
+	const L3DiskFile &file = Item(idx);
+	size_t offset;
+	const D88Sector *sector = GetEntrySector(file.entry, offset);
+	if (!sector) {
+		return false;
+	}
+	wxUint8 fat[L3DISK_FAT_SIZE];
+	memcpy(fat, mFat, sizeof(fat));
+	FreeChain(file, fat);
+
+	static const wxUint8 deleted = 0x00;
+	if (!mDisk.WriteSector(sector, offset, &deleted, 1)) {
+		return false;
+	}
+	if (!WriteFat(fat)) {
+		return false;
+	}
+	return ReadDirectory();
+}
+
+/// 同じ名前のファイルを置き換えると空くクラスタ数
+/// @param[in] name ファイル名
+/// @param[in] ext  拡張子
+/// @return クラスタ数 ないかFATが壊れている場合0
+int L3DiskBasic::GetReplacedClusters(const wxString &name, const wxString &ext) const
+{
+	wxUint8 raw_name[L3DISK_NAME_LEN + L3DISK_EXT_LEN];
+	MakeRawName(name, ext, raw_name);
+	int idx = FindFile(raw_name);
+	if (idx < 0 || Item(idx).broken) {
+		return 0;
+	}
+	return Item(idx).clusters;
+}
+
+/// BASICのファイルを書き込む
+///
+/// 同じ名前のファイルがあれば置き換える。
+/// @param[in] name  ファイル名
+/// @param[in] ext   拡張子
+/// @param[in] data  データ
+/// @param[in] len   データの長さ
+/// @param[in] ascii アスキー形式か
+/// @return 書けなかった場合false
+bool L3DiskBasic::SaveBasicFile(const wxString &name, const wxString &ext, const wxUint8 *data, size_t len, bool ascii)
+{
+	wxUint8 raw_name[L3DISK_NAME_LEN + L3DISK_EXT_LEN];
+	MakeRawName(name, ext, raw_name);
+	return SaveFile(raw_name, ascii ? 0 : L3DISK_ATTR_BINARY, data, len);
+}
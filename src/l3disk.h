@@ -0,0 +1,158 @@
+﻿/// @file l3disk.h
+///
+/// @brief L3/S1のDISK BASICのディスク
+///
+///
+#ifndef _L3DISK_H_
+#define _L3DISK_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include "fileinfo.h"
+#include "d88disk.h"
+
+/// ディレクトリのエントリの長さ
+#define L3DISK_ENTRY_SIZE	16
+/// ファイル名の長さ
+#define L3DISK_NAME_LEN		6
+/// 拡張子の長さ
+#define L3DISK_EXT_LEN		3
+/// FATの最大エントリ数
+#define L3DISK_FAT_SIZE		256
+
+/// ファイルの属性
+enum enL3DiskAttrs {
+	L3DISK_ATTR_BINARY = 0x01,	///< 中間言語
+	L3DISK_ATTR_PROTECT = 0x10,	///< 書き込み禁止
+	L3DISK_ATTR_MACHINE = 0x80	///< 機械語
+};
+
+/// FATの値
+enum enL3DiskFatValues {
+	L3DISK_FAT_LAST = 0xc0,		///< 最後のクラスタ 下位は使用セクタ数
+	L3DISK_FAT_RESERVED = 0xfe,	///< システムで使用
+	L3DISK_FAT_FREE = 0xff		///< 未使用
+};
+
+/// ディスクの構成
+///
+/// 1バイト1クラスタのFATを持つDISK BASICの配置で、既定値は2Dのディスク。
+/// クラスタはトラックの先頭から順に割り当てる。
+class L3DiskLayout
+{
+public:
+	int mSectorsPerTrack;	///< 1トラックのセクタ数
+	int mSectorSize;		///< セクタの長さ
+	int mSectorsPerCluster;	///< 1クラスタのセクタ数
+	int mDirTrack;			///< 管理トラック (D88のトラック番号)
+	int mDirStart;			///< ディレクトリの最初のセクタ
+	int mDirSectors;		///< ディレクトリのセクタ数
+	int mFatSector;			///< FATのセクタ
+	int mFatCopies;			///< FATの数
+
+	L3DiskLayout();
+
+	/// 1トラックのクラスタ数
+	int GetClustersPerTrack() const;
+};
+
+/// ディスク内のファイル
+typedef struct st_l3disk_file {
+	wxUint8 raw_name[L3DISK_NAME_LEN + L3DISK_EXT_LEN];	///< ファイル名と拡張子
+	int    attr;			///< 属性 enL3DiskAttrs
+	int    entry;			///< ディレクトリのエントリの番号
+	int    first_cluster;	///< 最初のクラスタ
+	int    clusters;		///< 使用クラスタ数
+	int    sectors;			///< 使用セクタ数
+	size_t data_len;		///< データの長さ アスキー形式は1Aの前まで
+	bool   broken;			///< FATのつながりが壊れている
+} L3DiskFile;
+
+/// L3/S1のDISK BASICのディスク
+///
+/// 開いたときにFATとディレクトリを読んでファイルの一覧を作る。
+/// 取り出すときはマップしたイメージのセクタから直接書き出す。
+/// 書き込むときはデータ、FAT、ディレクトリの順に変わったセクタだけを書く。
+class L3DiskBasic : public DiskBasicFiles
+{
+private:
+	D88Disk mDisk;			///< イメージ
+	L3DiskLayout mLayout;	///< ディスクの構成
+	wxUint8 mFat[L3DISK_FAT_SIZE];	///< FAT
+	int mClusters;			///< クラスタ数
+	wxMemoryBuffer mFiles;	///< L3DiskFile の並び
+
+	/// FATを読む
+	bool ReadFat();
+	/// ディレクトリを読む
+	bool ReadDirectory();
+	/// ファイルの長さを求める
+	void CountFile(L3DiskFile &file) const;
+	/// ファイルのクラスタを解放する
+	void FreeChain(const L3DiskFile &file, wxUint8 *fat) const;
+	/// ディレクトリのエントリのセクタ
+	const D88Sector *GetEntrySector(int entry, size_t &offset) const;
+	/// 空いているエントリを探す
+	int FindFreeEntry() const;
+	/// FATを書く
+	bool WriteFat(const wxUint8 *fat);
+
+public:
+	L3DiskBasic();
+	~L3DiskBasic() {}
+
+	/// ディスクの構成を設定
+	void SetLayout(const L3DiskLayout &layout) { mLayout = layout; }
+	const L3DiskLayout &GetLayout() const { return mLayout; }
+
+	/// 開く
+	bool Open(const wxString &path, bool writable = false);
+	/// 閉じる
+	void Close();
+
+	/// クラスタのセクタ
+	const D88Sector *GetClusterSector(int cluster, int idx) const;
+
+	size_t Count() const { return mFiles.GetDataLen() / sizeof(L3DiskFile); }
+	const L3DiskFile &Item(size_t idx) const;
+	const L3DiskFile &operator[](size_t idx) const { return Item(idx); }
+	/// 表示用のファイル名
+	wxString GetName(size_t idx) const;
+	/// アスキー形式か
+	bool IsAscii(size_t idx) const;
+	/// 最初のBASICのファイル
+	int FindBasic() const;
+	/// 空きクラスタ数
+	int GetFreeClusters() const;
+	int GetClusterCount() const { return mClusters; }
+	D88Disk &GetDisk() { return mDisk; }
+
+	/// ファイルのデータを書き出す
+	size_t Write(size_t idx, PsFileOutput &out) const;
+	/// ファイルのデータをファイルに書く
+	bool ExtractTo(size_t idx, const wxString &path) const;
+
+	/// ファイル名と拡張子からディレクトリのファイル名を作る
+	static void MakeRawName(const wxString &name, const wxString &ext, wxUint8 *raw_name);
+	/// ファイル名で探す
+	int FindFile(const wxUint8 *raw_name) const;
+	/// ファイルに必要なクラスタ数
+	int GetRequiredClusters(size_t len, bool ascii) const;
+	/// ファイルを書き込む 同じ名前のファイルがあれば置き換える
+	bool SaveFile(const wxUint8 *raw_name, int attr, const wxUint8 *data, size_t len);
+	/// ファイルを削除する
+	bool DeleteFile(size_t idx);
+
+	/// 書き込み禁止か
+	bool IsWriteProtected() const { return mDisk.IsWriteProtected(); }
+	/// 同じ名前のファイルを置き換えると空くクラスタ数
+	int GetReplacedClusters(const wxString &name, const wxString &ext) const;
+	/// BASICのファイルに必要なクラスタ数
+	int GetRequiredBasicClusters(size_t len, bool ascii) const { return GetRequiredClusters(len, ascii); }
+	/// BASICのファイルを書き込む
+	bool SaveBasicFile(const wxString &name, const wxString &ext, const wxUint8 *data, size_t len, bool ascii);
+
+	DECLARE_NO_COPY_CLASS(L3DiskBasic)
+};
+
+#endif /* _L3DISK_H_ */
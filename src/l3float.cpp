@@ -207,14 +207,15 @@ void L3Float::Uint192ToDeciStr(UINT192 &cin, UINT192 &cpo, int limit_digit, Deci
 		}
 	}
 
-	// 小数部を10進表示
-	if (!(cpo == 0)) {
+	// 小数部を10進表示 整数部で有効桁に達していれば表示しない
+	if (!(cpo == 0) && limit <= limit_digit) {
 		UINT192 msk;
 		msk.Sub(1);
 		msk.RShift(8);
 
 		decs.Push('.');
-		over = true;
+		// 整数部があれば小数部の先頭の0も有効桁に数える
+		over = (limit == 0);
 		for(int i=0; i<64; i++) {
 			cpo.Mul10();
 			c1 = cpo.GetByte(UINT192_MAX_BYTE-1);
@@ -232,24 +233,31 @@ void L3Float::Uint192ToDeciStr(UINT192 &cin, UINT192 &cpo, int limit_digit, Deci
 			if (cpo == 0) break;
 		}
 		decs.Trim();
+		// 四捨五入で小数部が0になったら整数にする
+		int len = decs.Length();
+		if (len > 2 && decs.Get(len - 2) == '.' && decs.Get(len - 1) == '0') {
+			decs.Shrink(len - 2);
+		}
 	}
 	
 	conv_to_deciexpstr(decs, limit_digit);
 }
 
-/// 10進文字列→2進に変換
+/// 10進文字列を整数部と小数部に分ける
 /// @param[in] decistr 10進文字列
 /// @param[in] decistr_len 10進文字列の長さ
-/// @param[out] cin 整数部
-/// @param[out] cpo 小数部
-/// @return 1:単精度 2:倍精度
-int L3Float::DeciStrToUint192(const char *decistr, int decistr_len, UINT192 &cin, UINT192 &cpo)
+/// @param[out] type 1:単精度 2:倍精度
+/// @param[out] din 整数部
+/// @param[out] dpo 小数部 0バイト目は'0'
+/// @return false:数値0
+bool L3Float::split_decistr(const char *decistr, int decistr_len, int &type, DeciStr &din, DeciStr &dpo)
 {
 	int pos = -1;
 	int ex = 0;
-	int type = 0;	// 1:単精度 2:倍精度
 	DeciStr decs(decistr, decistr_len);
 
+	type = 0;	// 1:単精度 2:倍精度
+
 	/// 指数表記か
 	pos = decs.Find('E');
 	if (pos >= 0) {
@@ -299,11 +307,11 @@ int L3Float::DeciStrToUint192(const char *decistr, int decistr_len, UINT192 &cin
 
 	// 数値０
 	if (decs.IsZero()) {
-		return type;
+		return false;
 	}
 
-	DeciStr dpo(decs);
-	DeciStr din(decs);
+	dpo = decs;
+	din = decs;
 
 	// 指数の数だけ足す
 	sft = pos + ex;	
@@ -326,6 +334,26 @@ int L3Float::DeciStrToUint192(const char *decistr, int decistr_len, UINT192 &cin
 		din.Shrink(sft);
 	}
 
+	return true;
+}
+
+/// 10進文字列→2進に変換
+/// @param[in] decistr 10進文字列
+/// @param[in] decistr_len 10進文字列の長さ
+/// @param[out] cin 整数部
+/// @param[out] cpo 小数部
+/// @return 1:単精度 2:倍精度
+int L3Float::DeciStrToUint192(const char *decistr, int decistr_len, UINT192 &cin, UINT192 &cpo)
+{
+	int type = 0;	// 1:単精度 2:倍精度
+	DeciStr dpo;
+	DeciStr din;
+
+	// 数値０
+	if (!split_decistr(decistr, decistr_len, type, din, dpo)) {
+		return type;
+	}
+
 	// 小数点以下を2進数にする(192ビット)
 	if (!dpo.IsZero()) {
 		for(int i=0; i<192; i++) {
@@ -355,3 +383,331 @@ int L3Float::DeciStrToUint192(const char *decistr, int decistr_len, UINT192 &cin
 	}
 	return type;
 }
+
+/// 実数から10進文字列にする
+/// 128ビット整数で変換できない値はUINT192で変換する
+/// @param[in] vals 実数
+/// @param[in] vals_size バイト数
+/// @param[in] limit_digit 有効桁数
+/// @param[out] decs 10進文字列
+void L3Float::RealStrToDeciStr(const unsigned char *vals, int vals_size, int limit_digit, DeciStr &decs)
+{
+#ifdef USE_L3FLOAT_INT128
+	if (real_to_decistr_int128(vals, vals_size, limit_digit, decs)) {
+		return;
+	}
+#endif
+	UINT192 cin;
+	UINT192 cpo;
+
+	RealStrToUint192(vals, vals_size, cin, cpo);
+	Uint192ToDeciStr(cin, cpo, limit_digit, decs);
+}
+
+/// 10進文字列から実数にする
+/// 128ビット整数で変換できない値はUINT192で変換する
+/// @param[in] decistr 10進文字列
+/// @param[in] decistr_len 10進文字列の長さ
+/// @param[out] vals 実数(8バイト以上)
+/// @param[out] vals_size バイト数 4:単精度 8:倍精度
+/// @return 0:正常 1:オーバーフロー 2:アンダーフロー
+int L3Float::DeciStrToRealStr(const char *decistr, int decistr_len, unsigned char *vals, int &vals_size)
+{
+#ifdef USE_L3FLOAT_INT128
+	int type = 0;
+	DeciStr dpo;
+	DeciStr din;
+
+	if (!split_decistr(decistr, decistr_len, type, din, dpo)) {
+		// 数値０
+		vals_size = type * 4;
+		memset(vals, 0, vals_size);
+		return 0;
+	}
+	vals_size = type * 4;
+	int rc = 0;
+	if (decistr_to_real_int128(din, dpo, vals, vals_size, rc)) {
+		return rc;
+	}
+#endif
+	UINT192 cin;
+	UINT192 cpo;
+
+	vals_size = DeciStrToUint192(decistr, decistr_len, cin, cpo) * 4;
+	return Uint192ToRealStr(cin, cpo, vals, vals_size);
+}
+
+#ifdef USE_L3FLOAT_INT128
+
+typedef unsigned __int128 l3uint128;
+
+/// 10のべき乗 (上位64ビット, 下位64ビット)
+static const unsigned long long cL3Pow10[39][2] = {
+	{ 0x0000000000000000ULL, 0x0000000000000001ULL },	// 1E0
+	{ 0x0000000000000000ULL, 0x000000000000000aULL },	// 1E1
+	{ 0x0000000000000000ULL, 0x0000000000000064ULL },	// 1E2
+	{ 0x0000000000000000ULL, 0x00000000000003e8ULL },	// 1E3
+	{ 0x0000000000000000ULL, 0x0000000000002710ULL },	// 1E4
+	{ 0x0000000000000000ULL, 0x00000000000186a0ULL },	// 1E5
+	{ 0x0000000000000000ULL, 0x00000000000f4240ULL },	// 1E6
+	{ 0x0000000000000000ULL, 0x0000000000989680ULL },	// 1E7
+	{ 0x0000000000000000ULL, 0x0000000005f5e100ULL },	// 1E8
+	{ 0x0000000000000000ULL, 0x000000003b9aca00ULL },	// 1E9
+	{ 0x0000000000000000ULL, 0x00000002540be400ULL },	// 1E10
+	{ 0x0000000000000000ULL, 0x000000174876e800ULL },	// 1E11
+	{ 0x0000000000000000ULL, 0x000000e8d4a51000ULL },	// 1E12
+	{ 0x0000000000000000ULL, 0x000009184e72a000ULL },	// 1E13
+	{ 0x0000000000000000ULL, 0x00005af3107a4000ULL },	// 1E14
+	{ 0x0000000000000000ULL, 0x00038d7ea4c68000ULL },	// 1E15
+	{ 0x0000000000000000ULL, 0x002386f26fc10000ULL },	// 1E16
+	{ 0x0000000000000000ULL, 0x016345785d8a0000ULL },	// 1E17
+	{ 0x0000000000000000ULL, 0x0de0b6b3a7640000ULL },	// 1E18
+	{ 0x0000000000000000ULL, 0x8ac7230489e80000ULL },	// 1E19
+	{ 0x0000000000000005ULL, 0x6bc75e2d63100000ULL },	// 1E20
+	{ 0x0000000000000036ULL, 0x35c9adc5dea00000ULL },	// 1E21
+	{ 0x000000000000021eULL, 0x19e0c9bab2400000ULL },	// 1E22
+	{ 0x000000000000152dULL, 0x02c7e14af6800000ULL },	// 1E23
+	{ 0x000000000000d3c2ULL, 0x1bcecceda1000000ULL },	// 1E24
+	{ 0x0000000000084595ULL, 0x161401484a000000ULL },	// 1E25
+	{ 0x000000000052b7d2ULL, 0xdcc80cd2e4000000ULL },	// 1E26
+	{ 0x00000000033b2e3cULL, 0x9fd0803ce8000000ULL },	// 1E27
+	{ 0x00000000204fce5eULL, 0x3e25026110000000ULL },	// 1E28
+	{ 0x00000001431e0faeULL, 0x6d7217caa0000000ULL },	// 1E29
+	{ 0x0000000c9f2c9cd0ULL, 0x4674edea40000000ULL },	// 1E30
+	{ 0x0000007e37be2022ULL, 0xc0914b2680000000ULL },	// 1E31
+	{ 0x000004ee2d6d415bULL, 0x85acef8100000000ULL },	// 1E32
+	{ 0x0000314dc6448d93ULL, 0x38c15b0a00000000ULL },	// 1E33
+	{ 0x0001ed09bead87c0ULL, 0x378d8e6400000000ULL },	// 1E34
+	{ 0x0013426172c74d82ULL, 0x2b878fe800000000ULL },	// 1E35
+	{ 0x00c097ce7bc90715ULL, 0xb34b9f1000000000ULL },	// 1E36
+	{ 0x0785ee10d5da46d9ULL, 0x00f436a000000000ULL },	// 1E37
+	{ 0x4b3b4ca85a86c47aULL, 0x098a224000000000ULL },	// 1E38
+};
+
+/// 10のべき乗を返す
+static inline l3uint128 l3pow10(int k)
+{
+	return ((l3uint128)cL3Pow10[k][0] << 64) | cL3Pow10[k][1];
+}
+
+/// 有効ビット数
+static inline int l3bitlen(l3uint128 val)
+{
+	unsigned long long hi = (unsigned long long)(val >> 64);
+	unsigned long long lo = (unsigned long long)val;
+	if (hi) return 128 - __builtin_clzll(hi);
+	if (lo) return 64 - __builtin_clzll(lo);
+	return 0;
+}
+
+/// 実数から10進文字列にする(128ビット整数)
+/// RealStrToUint192 + Uint192ToDeciStr と同じ結果を返す。
+/// 小数部は F / 2^s で持ち、10倍するかわりに F*5, s-1 とする。
+/// @param[in] vals 実数
+/// @param[in] vals_size バイト数 4 or 8
+/// @param[in] limit_digit 有効桁数
+/// @param[out] decs 10進文字列
+/// @return false:128ビットに収まらない
+bool L3Float::real_to_decistr_int128(const unsigned char *vals, int vals_size, int limit_digit, DeciStr &decs)
+{
+	if (vals_size != 4 && vals_size != 8) return false;
+
+	l3uint128 cin = 0;
+	l3uint128 cpo = 0;
+	int s = 0;
+
+	// 指数部
+	int e2 = vals[0];
+	if (e2 != 0) {
+		e2 = e2 - 128;
+
+		// 仮数部 0.1xxxx
+		int mbits = (vals_size - 1) * 8;
+		unsigned long long m = (vals[1] | 0x80);
+		for(int i=2; i<vals_size; i++) {
+			m = (m << 8) | vals[i];
+		}
+
+		// 小数部のビット数 F*5が128ビットに収まること
+		s = mbits - e2;
+		if (s > 124) return false;
+
+		// 整数部
+		if (e2 > 0) {
+			if (e2 >= mbits) cin = ((l3uint128)m << (e2 - mbits));
+			else cin = (m >> (mbits - e2));
+		}
+		// 小数部
+		if (s > 0) {
+			cpo = (s >= mbits ? m : (m & ((1ULL << s) - 1)));
+		}
+	}
+
+	char c1 = 0;
+	bool over = true;
+	int limit = 0;
+
+	// 整数部を10進表示
+	if (cin != 0) {
+		for(int k=38; k>=0; k--) {
+			c1=0;
+			if (limit <= limit_digit) {
+				l3uint128 de = l3pow10(k);
+				for(; c1<10; c1++) {
+					if (de > cin) {
+						break;
+					}
+					cin -= de;
+				}
+			}
+			if (c1 != 0) over = false;
+			if (!over) {
+				decs.Push(c1 | 0x30);
+				limit++;
+				if (limit == (limit_digit + 1)) {
+					decs.Round();
+				}
+			}
+		}
+	}
+
+	// 小数部を10進表示 整数部で有効桁に達していれば表示しない
+	if (cpo != 0 && limit <= limit_digit) {
+		decs.Push('.');
+		// 整数部があれば小数部の先頭の0も有効桁に数える
+		over = (limit == 0);
+		for(int i=0; i<64; i++) {
+			cpo *= 5;
+			s--;
+			c1 = (char)(cpo >> s);
+			cpo &= (((l3uint128)1 << s) - 1);
+			decs.Push(c1 | 0x30);
+			if (c1 != 0) over = false;
+			if (!over) {
+				limit++;
+				if (limit == (limit_digit + 1)) {
+					// 四捨五入して終り
+					decs.Round();
+					break;
+				}
+			}
+			if (cpo == 0) break;
+		}
+		decs.Trim();
+		// 四捨五入で小数部が0になったら整数にする
+		int len = decs.Length();
+		if (len > 2 && decs.Get(len - 2) == '.' && decs.Get(len - 1) == '0') {
+			decs.Shrink(len - 2);
+		}
+	}
+
+	conv_to_deciexpstr(decs, limit_digit);
+
+	return true;
+}
+
+/// 10進文字列から実数にする(128ビット整数)
+/// DeciStrToUint192 + Uint192ToRealStr と同じ結果を返す。
+/// 小数部は192ビットで打ち切った値から仮数部を作る。
+/// @param[in] din 整数部
+/// @param[in] dpo 小数部 0バイト目は'0'
+/// @param[out] vals 実数
+/// @param[in] vals_size バイト数 4 or 8
+/// @param[out] rc 0:正常 1:オーバーフロー 2:アンダーフロー
+/// @return false:128ビットに収まらない
+bool L3Float::decistr_to_real_int128(DeciStr &din, DeciStr &dpo, unsigned char *vals, int vals_size, int &rc)
+{
+	if (vals_size != 4 && vals_size != 8) return false;
+
+	// 整数部 38ケタまで
+	l3uint128 cin = 0;
+	int len = din.Length();
+	if (len > 38) return false;
+	for(int i=0; i<len; i++) {
+		char c = din.Get(i);
+		if (c < '0' || c > '9') return false;
+		cin = cin * 10 + (c & 0xf);
+	}
+
+	// 小数部 cpo / 10^digits 38ケタまで
+	l3uint128 cpo = 0;
+	len = dpo.Length();
+	for(int i=1; i<len; i++) {
+		char c = dpo.Get(i);
+		if (c < '0' || c > '9') return false;
+	}
+	while(len > 1 && dpo.Get(len - 1) == '0') len--;
+	if (len - 1 > 38) return false;
+	for(int i=1; i<len; i++) {
+		cpo = cpo * 10 + (dpo.Get(i) & 0xf);
+	}
+	l3uint128 deno = l3pow10(len - 1);
+
+	// 最上位の1の次から 仮数部 + 四捨五入用の1ビットを取り出す
+	int need = (vals_size - 1) * 8;
+	unsigned long long mant = 0;
+	int got = 0;
+	bool found = false;
+	int ex2 = 0;
+
+	if (cin != 0) {
+		ex2 = l3bitlen(cin) - 1;
+		found = true;
+		for(int b = ex2 - 1; b >= 0 && got < need; b--) {
+			mant = (mant << 1) | (unsigned long long)((cin >> b) & 1);
+			got++;
+		}
+	}
+	// 小数部は192ビットまで
+	for(int j=1; j<=192 && got < need && cpo != 0; j++) {
+		cpo <<= 1;
+		unsigned long long bit = 0;
+		if (cpo >= deno) {
+			cpo -= deno;
+			bit = 1;
+		}
+		if (!found) {
+			if (bit) {
+				found = true;
+				ex2 = -j;
+			}
+			continue;
+		}
+		mant = (mant << 1) | bit;
+		got++;
+	}
+
+	rc = 0;
+	memset(vals, 0, vals_size);
+	if (!found) {
+		// ゼロ
+		return true;
+	}
+	mant <<= (need - got);
+
+	// 四捨五入 桁あふれは符号ビットに入る
+	mant = (mant >> 1) + (mant & 1);
+
+	// 指数部は129たす
+	ex2 += 129;
+	if (ex2 > 255) {
+		// オーバフロー
+		rc = 1;
+		ex2 = 255;
+	} else if (ex2 < 1) {
+		// アンダーフロー
+		rc = 2;
+		ex2 = 1;
+	}
+
+	// 内部形式
+	vals[0] = (ex2 & 0xff);
+	for(int i=vals_size-1; i>=1; i--) {
+		vals[i] = (mant & 0xff);
+		mant >>= 8;
+	}
+
+	return true;
+}
+
+#endif /* USE_L3FLOAT_INT128 */
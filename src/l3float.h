@@ -10,12 +10,26 @@
 #include "uint192.h"
 #include "decistr.h"
 
+#if defined(__SIZEOF_INT128__)
+/// 4バイト、8バイトの実数を128ビット整数で変換する
+/// 128ビットに収まらない値はUINT192で変換する
+#define USE_L3FLOAT_INT128 1
+#endif
+
 /// レベル3の実数内部表現形式を変換
 class L3Float
 {
 private:
 	/// 10進を指数表記
 	static bool conv_to_deciexpstr(DeciStr &decs, int limit_digit);
+	/// 10進文字列を整数部と小数部に分ける
+	static bool split_decistr(const char *decistr, int decistr_len, int &type, DeciStr &din, DeciStr &dpo);
+#ifdef USE_L3FLOAT_INT128
+	/// 実数から10進文字列にする(128ビット整数)
+	static bool real_to_decistr_int128(const unsigned char *vals, int vals_size, int limit_digit, DeciStr &decs);
+	/// 10進文字列から実数にする(128ビット整数)
+	static bool decistr_to_real_int128(DeciStr &din, DeciStr &dpo, unsigned char *vals, int vals_size, int &rc);
+#endif
 public:
 	L3Float() {};
 	~L3Float() {};
@@ -28,6 +42,10 @@ public:
 	static void Uint192ToDeciStr(UINT192 &cin, UINT192 &cpo, int limit_digit, DeciStr &decs);
 	/// 10進文字列→2進に変換
 	static int DeciStrToUint192(const char *decistr, int decistr_len, UINT192 &cin, UINT192 &cpo);
+	/// 実数から10進文字列にする
+	static void RealStrToDeciStr(const unsigned char *vals, int vals_size, int limit_digit, DeciStr &decs);
+	/// 10進文字列から実数にする
+	static int DeciStrToRealStr(const char *decistr, int decistr_len, unsigned char *vals, int &vals_size);
 };
 
 #endif
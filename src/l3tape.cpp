@@ -0,0 +1,403 @@
+﻿/// @file l3tape.cpp
+///
+/// @brief L3/S1のテープイメージのブロック
+///
+///
+#include "l3tape.h"
+#include <wx/file.h>
+#include <string.h>
+
+/// 識別子を探す
+/// @param[in] data 検索範囲の先頭
+/// @param[in] len  検索範囲の長さ
+/// @return 識別子の先頭 ないときNULL
+const wxUint8 *L3TapeBlocks::FindIdent(const wxUint8 *data, size_t len)
+{
+	if (len < L3TAPE_IDENT_LEN) {
+		return NULL;
+	}
+	// 3バイト目の3Cを探す
+	const wxUint8 *p = data + 2;
+	const wxUint8 *end = data + len;
+	while(p < end) {
+		p = (const wxUint8 *)memchr(p, 0x3c, end - p);
+		if (!p) {
+			break;
+		}
+		if (p[-1] == 0x01 && p[-2] == 0xff) {
+			return p - 2;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+/// イメージ全体のブロックを探す
+///
+/// 種類が不明な識別子は読み飛ばす。ブロックのデータの中は探さない。
+/// @param[in] data        イメージ
+/// @param[in] len         イメージの長さ
+/// @param[in] stop_at_end 終端ブロックで止める
+/// @return ブロック数
+size_t L3TapeBlocks::Scan(const wxUint8 *data, size_t len, bool stop_at_end)
+{
+	Clear();
+
+	size_t pos = 0;
+	while(pos < len) {
+		const wxUint8 *p = FindIdent(data + pos, len - pos);
+		if (!p) {
+			break;
+		}
+		size_t offset = (size_t)(p - data);
+		if (offset + L3TAPE_HEADER_LEN > len) {
+			// 種類か長さがない
+			break;
+		}
+		int type = data[offset + 3];
+		if (type != L3TAPE_NAME && type != L3TAPE_DATA && type != L3TAPE_END) {
+			// 不明な種類
+			pos = offset + 2;
+			continue;
+		}
+		L3TapeBlock block;
+		block.type = type;
+		block.offset = offset;
+		block.data_pos = offset + L3TAPE_HEADER_LEN;
+		block.length = data[offset + 4];
+		block.avail = len - block.data_pos;
+		if (block.avail > block.length) block.avail = block.length;
+		block.calc_sum = CheckSum(&data[block.data_pos], block.avail, (wxUint32)type + (wxUint32)block.length);
+		block.stored_sum = (block.avail == block.length && block.data_pos + block.length < len ? data[block.data_pos + block.length] : -1);
+		mBlocks.AppendData(&block, sizeof(block));
+
+		if (type == L3TAPE_END && stop_at_end) {
+			break;
+		}
+		pos = block.data_pos + block.length + L3TAPE_FOOTER_LEN;
+	}
+	return Count();
+}
+
+/// ブロックを返す
+const L3TapeBlock &L3TapeBlocks::Item(size_t idx) const
+{
+	wxASSERT(idx < Count());
+	return ((const L3TapeBlock *)mBlocks.GetData())[idx];
+}
+
+/// バイト列の和の下位8ビット (チェックサム)
+///
+/// 8バイトずつ読み、16ビットごとの4つの和として足していく。
+/// 1回で1つの和に足すのは2バイト(最大510)なので、128回ごとにまとめる。
+/// @param[in] data 先頭
+/// @param[in] len  長さ
+/// @param[in] init 初期値 (種類と長さの和など)
+/// @return チェックサム
+wxUint8 L3TapeBlocks::CheckSum(const wxUint8 *data, size_t len, wxUint32 init)
+{
+	static const wxUint64 mask = wxULL(0x00ff00ff00ff00ff);
+	wxUint32 sum = init;
+
+	while(len >= 8) {
+		size_t n = len / 8;
+		if (n > 128) n = 128;
+		wxUint64 acc = 0;
+		for(size_t i = 0; i < n; i++) {
+			wxUint64 v;
+			memcpy(&v, data, 8);
+			acc += (v & mask) + ((v >> 8) & mask);
+			data += 8;
+		}
+		len -= n * 8;
+		// 4つの和を足す
+		sum += (wxUint32)(acc & 0xffff) + (wxUint32)((acc >> 16) & 0xffff)
+			+ (wxUint32)((acc >> 32) & 0xffff) + (wxUint32)(acc >> 48);
+	}
+	for(size_t i = 0; i < len; i++) {
+		sum += data[i];
+	}
+	return (wxUint8)(sum & 0xff);
+}
+
+/// ブロックのチェックサムが合っているか
+/// @return 途中で切れている場合もfalse
+bool L3TapeBlocks::IsValidSum(const L3TapeBlock &block)
+{
+	return (block.stored_sum >= 0 && block.stored_sum == block.calc_sum);
+}
+
+/// チェックサムが合わないブロックの番号を返す
+/// @param[out] blocks ブロックの番号
+/// @param[in]  start  調べる最初のブロック
+/// @param[in]  count  調べるブロック数
+/// @return 合わないブロック数
+size_t L3TapeBlocks::GetBadBlocks(wxArrayInt &blocks, size_t start, size_t count) const
+{
+	blocks.Empty();
+	size_t end = Count();
+	if (start < end && count < end - start) end = start + count;
+	for(size_t i = start; i < end; i++) {
+		if (!IsValidSum(Item(i))) {
+			blocks.Add((int)i);
+		}
+	}
+	return blocks.Count();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+L3TapeArchive::L3TapeArchive()
+{
+	mOrphans = 0;
+}
+
+/// ファイルを読み込んで一覧を作る
+/// @param[in] path イメージのファイル
+/// @return 読めなかった場合false
+bool L3TapeArchive::Open(const wxString &path)
+{
+	wxFile file;
+	if (!file.Open(path)) {
+		return false;
+	}
+	wxFileOffset len = file.Length();
+	if (len == wxInvalidOffset) {
+		return false;
+	}
+	mImage.SetDataLen(0);
+	void *buf = mImage.GetAppendBuf((size_t)len);
+	ssize_t rlen = file.Read(buf, (size_t)len);
+	if (rlen == wxInvalidOffset || (wxFileOffset)rlen != len) {
+		// 途中までしか読めない
+		mImage.SetDataLen(0);
+		return false;
+	}
+	mImage.UngetAppendBuf((size_t)rlen);
+	Index();
+	return true;
+}
+
+/// メモリ上のイメージから一覧を作る
+/// @param[in] data イメージ
+/// @param[in] len  イメージの長さ
+/// @return ファイル数
+size_t L3TapeArchive::SetImage(const wxUint8 *data, size_t len)
+{
+	mImage.SetDataLen(0);
+	mImage.AppendData(data, len);
+	return Index();
+}
+
+/// 一覧を作る
+///
+/// ファイル名ブロックから終端ブロックまでを1つのファイルとする。
+/// 終端ブロックがないまま次のファイル名ブロックが来た場合はそこで区切る。
+/// @return ファイル数
+size_t L3TapeArchive::Index()
+{
+	const wxUint8 *data = (const wxUint8 *)mImage.GetData();
+	size_t len = mImage.GetDataLen();
+
+	mFiles.SetDataLen(0);
+	mNames.Empty();
+	mOrphans = 0;
+	mBlocks.Scan(data, len, false);
+
+	L3TapeFile file;
+	bool in_file = false;
+	for(size_t i = 0; i < mBlocks.Count(); i++) {
+		const L3TapeBlock &block = mBlocks[i];
+		if (block.type == L3TAPE_NAME) {
+			if (in_file) {
+				// 終端がないまま次のファイル
+				mFiles.AppendData(&file, sizeof(file));
+			}
+			memset(&file, 0, sizeof(file));
+			wxUint8 vals[256];
+			memset(vals, 0, sizeof(vals));
+			memcpy(vals, &data[block.data_pos], block.avail);
+			memcpy(file.raw_name, vals, L3TAPE_NAME_LEN);
+			file.file_type = vals[8];
+			file.ascii = (vals[9] == 0xff && vals[10] == 0xff);
+			file.first_block = i;
+			file.offset = block.offset;
+			in_file = true;
+		} else if (!in_file) {
+			if (block.type == L3TAPE_DATA) {
+				mOrphans++;
+			}
+			continue;
+		} else if (block.type == L3TAPE_DATA) {
+			file.data_blocks++;
+			file.data_len += block.length;
+		} else {
+			file.has_end = true;
+		}
+		file.block_count++;
+		file.end_offset = block.data_pos + block.length + L3TAPE_FOOTER_LEN;
+		if (file.end_offset > len) file.end_offset = len;
+		if (!L3TapeBlocks::IsValidSum(block)) {
+			file.bad_sums++;
+		}
+		if (file.has_end) {
+			mFiles.AppendData(&file, sizeof(file));
+			in_file = false;
+		}
+	}
+	if (in_file) {
+		// イメージの最後で切れている
+		mFiles.AppendData(&file, sizeof(file));
+	}
+
+	for(size_t i = 0; i < Count(); i++) {
+		mNames.Add(wxString::From8BitData((const char *)Item(i).raw_name, L3TAPE_NAME_LEN));
+	}
+	return Count();
+}
+
+/// ファイルを返す
+const L3TapeFile &L3TapeArchive::Item(size_t idx) const
+{
+	wxASSERT(idx < Count());
+	return ((const L3TapeFile *)mFiles.GetData())[idx];
+}
+
+/// ファイルのデータを取り出す
+///
+/// データブロックを順につなげる。途中で切れているブロックは0で埋める。
+/// @param[in]  idx ファイルの番号
+/// @param[out] out データ
+/// @return BASICファイルでない場合false
+bool L3TapeArchive::Extract(size_t idx, wxMemoryBuffer &out) const
+{
+	const L3TapeFile &file = Item(idx);
+	const wxUint8 *data = (const wxUint8 *)mImage.GetData();
+
+	out.SetDataLen(0);
+	wxUint8 *dst = (wxUint8 *)out.GetAppendBuf(file.data_len);
+	memset(dst, 0, file.data_len);
+	size_t pos = 0;
+	for(size_t i = file.first_block; i < file.first_block + file.block_count; i++) {
+		const L3TapeBlock &block = mBlocks[i];
+		if (block.type != L3TAPE_DATA) {
+			continue;
+		}
+		memcpy(&dst[pos], &data[block.data_pos], block.avail);
+		pos += block.length;
+	}
+	out.UngetAppendBuf(file.data_len);
+
+	return (file.file_type == 0);
+}
+
+/// ファイルのデータを取り出してファイルに書く
+/// @param[in] idx  ファイルの番号
+/// @param[in] path 出力先
+/// @return BASICファイルでないか書けなかった場合false BASICファイルでない場合は書かない
+bool L3TapeArchive::ExtractTo(size_t idx, const wxString &path) const
+{
+	wxMemoryBuffer buf;
+	if (!Extract(idx, buf)) {
+		return false;
+	}
+
+	wxFile file;
+	if (!file.Create(path, true)) {
+		return false;
+	}
+	return (file.Write(buf.GetData(), buf.GetDataLen()) == buf.GetDataLen());
+}
+
+/// 複数のファイルを並列で取り出す
+///
+/// 起動できたスレッドだけで残りも取り出す。1つも起動できない場合は呼び出したスレッドで行う。
+/// @param[in]  indexes 取り出すファイルの番号
+/// @param[in]  paths   それぞれの出力先
+/// @param[out] results それぞれ書けたら1、書けなかったら0
+/// @param[in]  threads スレッド数 0:CPU数
+/// @return 書けたファイル数
+size_t L3TapeArchive::ExtractFiles(const wxArrayInt &indexes, const wxArrayString &paths, wxArrayInt &results, int threads) const
+{
+	wxASSERT(indexes.Count() == paths.Count());
+
+	// スレッドは自分の位置だけを書き換える
+	results.Empty();
+	results.Add(0, indexes.Count());
+
+	if (threads <= 0) threads = wxThread::GetCPUCount();
+	if (threads > L3TAPE_EXTRACT_MAX_THREADS) threads = L3TAPE_EXTRACT_MAX_THREADS;
+	if (threads > (int)indexes.Count()) threads = (int)indexes.Count();
+
+	L3TapeExtractJob job(this, &indexes, &paths, &results);
+	L3TapeExtractThread *list[L3TAPE_EXTRACT_MAX_THREADS];
+	int started = 0;
+	if (threads > 1) {
+		for(int i = 0; i < threads; i++) {
+			L3TapeExtractThread *thread = new L3TapeExtractThread(&job);
+			if (thread->Run() != wxTHREAD_NO_ERROR) {
+				delete thread;
+				break;
+			}
+			list[started++] = thread;
+		}
+	}
+	if (started == 0) {
+		job.Run();
+	}
+	for(int i = 0; i < started; i++) {
+		list[i]->Wait();
+		delete list[i];
+	}
+	return job.mWritten;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+L3TapeExtractJob::L3TapeExtractJob(const L3TapeArchive *archive, const wxArrayInt *indexes, const wxArrayString *paths, wxArrayInt *results)
+{
+	pArchive = archive;
+	pIndexes = indexes;
+	pPaths = paths;
+	pResults = results;
+	mNext = 0;
+	mWritten = 0;
+}
+
+/// なくなるまで取り出す
+void L3TapeExtractJob::Run()
+{
+	for(;;) {
+		size_t n;
+		{
+			wxCriticalSectionLocker lock(mLock);
+			if (mNext >= pIndexes->Count()) {
+				break;
+			}
+			n = mNext++;
+		}
+		if (pArchive->ExtractTo((size_t)pIndexes->Item(n), pPaths->Item(n))) {
+			wxCriticalSectionLocker lock(mLock);
+			pResults->Item(n) = 1;
+			mWritten++;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+L3TapeExtractThread::L3TapeExtractThread(L3TapeExtractJob *job)
+	: wxThread(wxTHREAD_JOINABLE)
+{
+	pJob = job;
+}
+
+L3TapeExtractThread::~L3TapeExtractThread()
+{
+}
+
+L3TapeExtractThread::ExitCode L3TapeExtractThread::Entry()
+{
+	pJob->Run();
+	return (L3TapeExtractThread::ExitCode)0;
+}
@@ -0,0 +1,163 @@
+﻿/// @file l3tape.h
+///
+/// @brief L3/S1のテープイメージのブロック
+///
+///
+#ifndef _L3TAPE_H_
+#define _L3TAPE_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+/// テープイメージのブロックの識別子の長さ (FF 01 3C)
+#define L3TAPE_IDENT_LEN	3
+/// 識別子からデータまでの長さ (識別子 + 種類 + 長さ)
+#define L3TAPE_HEADER_LEN	5
+/// データの後ろの長さ (チェックサム + 0 x2)
+#define L3TAPE_FOOTER_LEN	3
+/// 内部ファイル名の長さ
+#define L3TAPE_NAME_LEN		8
+/// 一括で取り出すときの最大スレッド数
+#define L3TAPE_EXTRACT_MAX_THREADS	8
+
+/// テープイメージのブロック
+typedef struct st_l3tape_block {
+	int    type;		///< 種類 enL3TapeBlockTypes
+	size_t offset;		///< 識別子の位置
+	size_t data_pos;	///< データの位置
+	size_t length;		///< ブロックに書いてあるデータの長さ
+	size_t avail;		///< イメージ内にあるデータの長さ 途中で切れている場合はlengthより短い
+	int    stored_sum;	///< ブロックに書いてあるチェックサム イメージの外にある場合-1
+	int    calc_sum;	///< 種類、長さ、データから計算したチェックサム
+} L3TapeBlock;
+
+/// テープイメージのブロックの種類
+enum enL3TapeBlockTypes {
+	L3TAPE_NAME = 0x00,		///< ファイル名
+	L3TAPE_DATA = 0x01,		///< データ
+	L3TAPE_END = 0xff		///< 終端
+};
+
+/// テープイメージのブロックの一覧
+///
+/// メモリ上のイメージ全体から識別子 FF 01 3C を探してブロックの位置を記録する。
+/// ギャップはFFが続くので、まれな3Cをmemchrで探してから前の2バイトを確かめる。
+/// 記録するときにチェックサムも計算する。
+class L3TapeBlocks
+{
+private:
+	wxMemoryBuffer mBlocks;	///< L3TapeBlock の並び
+
+public:
+	L3TapeBlocks() {}
+	~L3TapeBlocks() {}
+
+	/// 識別子を探す
+	static const wxUint8 *FindIdent(const wxUint8 *data, size_t len);
+	/// イメージ全体のブロックを探す
+	size_t Scan(const wxUint8 *data, size_t len, bool stop_at_end = true);
+	/// バイト列の和の下位8ビット (チェックサム)
+	static wxUint8 CheckSum(const wxUint8 *data, size_t len, wxUint32 init = 0);
+	/// ブロックのチェックサムが合っているか
+	static bool IsValidSum(const L3TapeBlock &block);
+	/// チェックサムが合わないブロックの番号を返す
+	size_t GetBadBlocks(wxArrayInt &blocks, size_t start = 0, size_t count = (size_t)-1) const;
+
+	void Clear() { mBlocks.SetDataLen(0); }
+	size_t Count() const { return mBlocks.GetDataLen() / sizeof(L3TapeBlock); }
+	const L3TapeBlock &Item(size_t idx) const;
+	const L3TapeBlock &operator[](size_t idx) const { return Item(idx); }
+};
+
+/// テープイメージ内のファイル
+typedef struct st_l3tape_file {
+	wxUint8 raw_name[L3TAPE_NAME_LEN];	///< 内部ファイル名
+	int    file_type;		///< ファイル種類 0:BASIC
+	bool   ascii;			///< アスキー形式で保存されている
+	size_t first_block;		///< ファイル名ブロックの番号
+	size_t block_count;		///< ファイル名と終端を含むブロック数
+	size_t data_blocks;		///< データブロック数
+	size_t offset;			///< ファイル名ブロックの識別子の位置
+	size_t end_offset;		///< 最後のブロックの後ろの位置
+	size_t data_len;		///< データの合計長さ
+	size_t bad_sums;		///< チェックサムが合わないブロック数
+	bool   has_end;			///< 終端ブロックがある
+} L3TapeFile;
+
+/// 複数のファイルが入ったテープイメージ
+///
+/// イメージ全体を1回走査してファイルごとにブロックをまとめる。
+/// ファイル名ブロックの前にあるデータブロックはどのファイルにも含めない。
+class L3TapeArchive
+{
+private:
+	wxMemoryBuffer mImage;	///< イメージ
+	L3TapeBlocks mBlocks;	///< ブロックの一覧
+	wxMemoryBuffer mFiles;	///< L3TapeFile の並び
+	wxArrayString mNames;	///< 表示用のファイル名
+	size_t mOrphans;		///< どのファイルにも含まれないデータブロック数
+
+public:
+	L3TapeArchive();
+	~L3TapeArchive() {}
+
+	/// ファイルを読み込んで一覧を作る
+	bool Open(const wxString &path);
+	/// メモリ上のイメージから一覧を作る
+	size_t SetImage(const wxUint8 *data, size_t len);
+	/// 一覧を作る
+	size_t Index();
+
+	size_t Count() const { return mFiles.GetDataLen() / sizeof(L3TapeFile); }
+	const L3TapeFile &Item(size_t idx) const;
+	const L3TapeFile &operator[](size_t idx) const { return Item(idx); }
+	const L3TapeBlocks &GetBlocks() const { return mBlocks; }
+	size_t GetOrphanBlocks() const { return mOrphans; }
+
+	/// 表示用のファイル名
+	const wxString &GetName(size_t idx) const { return mNames[idx]; }
+	void SetName(size_t idx, const wxString &name) { mNames[idx] = name; }
+
+	/// ファイルのデータを取り出す
+	bool Extract(size_t idx, wxMemoryBuffer &out) const;
+	/// ファイルのデータを取り出してファイルに書く
+	bool ExtractTo(size_t idx, const wxString &path) const;
+	/// 複数のファイルを並列で取り出す
+	size_t ExtractFiles(const wxArrayInt &indexes, const wxArrayString &paths, wxArrayInt &results, int threads = 0) const;
+
+	DECLARE_NO_COPY_CLASS(L3TapeArchive)
+};
+
+/// 一括で取り出す処理内容
+class L3TapeExtractJob
+{
+public:
+	const L3TapeArchive *pArchive;
+	const wxArrayInt *pIndexes;		///< 取り出すファイルの番号
+	const wxArrayString *pPaths;	///< 出力先
+	wxArrayInt *pResults;			///< それぞれ書けたら1
+	size_t mNext;					///< 次に取り出す位置
+	size_t mWritten;				///< 書いたファイル数
+	wxCriticalSection mLock;		///< mNext, mWrittenの排他用
+
+	L3TapeExtractJob(const L3TapeArchive *archive, const wxArrayInt *indexes, const wxArrayString *paths, wxArrayInt *results);
+
+	/// なくなるまで取り出す
+	void Run();
+};
+
+/// 一括で取り出すスレッド
+class L3TapeExtractThread : public wxThread
+{
+protected:
+	L3TapeExtractJob *pJob;
+
+	virtual ExitCode Entry();
+
+public:
+	L3TapeExtractThread(L3TapeExtractJob *job);
+	~L3TapeExtractThread();
+};
+
+#endif /* _L3TAPE_H_ */
@@ -0,0 +1,473 @@
+﻿/// @file l3wave.cpp
+///
+/// @brief L3/S1のカセットテープの音声(WAV)
+///
+///
+#include "l3wave.h"
+#include <string.h>
+#include <math.h>
+
+/// 既定の形式 600ボー、0:1200Hz、1:2400Hz
+L3WaveParam::L3WaveParam()
+{
+	mSampleRate = 44100;
+	mSampleBits = 8;
+	mBaud = 600;
+	mFreq0 = 1200;
+	mFreq1 = 2400;
+	mStopBits = 2;
+	mLeaderBits = 600;
+	mTrailerBits = 60;
+}
+
+/// 出力できる値か
+///
+/// 1の周波数がサンプリング周波数の1/2未満で、1ビットが1サンプル以上あること。
+bool L3WaveParam::IsValidForOutput() const
+{
+	if (mSampleBits != 8 && mSampleBits != 16) return false;
+	if (mBaud <= 0 || mFreq0 <= 0 || mFreq1 <= 0 || mStopBits < 1) return false;
+	if (mLeaderBits < 0 || mTrailerBits < 0) return false;
+	if (mSampleRate < mBaud || mFreq1 * 2 >= mSampleRate || mFreq0 * 2 >= mSampleRate) return false;
+	return true;
+}
+
+/// 0の1ビットの周期数
+int L3WaveParam::GetCycles0() const
+{
+	int n = (mBaud > 0 ? mFreq0 / mBaud : 0);
+	return (n > 0 ? n : 1);
+}
+
+/// 1の1ビットの周期数
+int L3WaveParam::GetCycles1() const
+{
+	int n = (mBaud > 0 ? mFreq1 / mBaud : 0);
+	return (n > 0 ? n : 1);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// リトルエンディアンの値
+static inline wxUint32 le32(const wxUint8 *p)
+{
+	return (wxUint32)p[0] | ((wxUint32)p[1] << 8) | ((wxUint32)p[2] << 16) | ((wxUint32)p[3] << 24);
+}
+static inline wxUint16 le16(const wxUint8 *p)
+{
+	return (wxUint16)(p[0] | (p[1] << 8));
+}
+
+L3WaveDecoder::L3WaveDecoder(const L3WaveParam &param)
+	: mParam(param)
+	, mSampleBuf(L3WAVE_CHUNK_SAMPLES * sizeof(wxInt16))
+	, mClassBuf(L3WAVE_CHUNK_SAMPLES)
+	, mRawBuf(L3WAVE_CHUNK_SAMPLES * 4)
+{
+	mSamples = (wxInt16 *)mSampleBuf.GetWriteBuf(L3WAVE_CHUNK_SAMPLES * sizeof(wxInt16));
+	mClass = (wxUint8 *)mClassBuf.GetWriteBuf(L3WAVE_CHUNK_SAMPLES);
+	mRaw = (wxUint8 *)mRawBuf.GetWriteBuf(L3WAVE_CHUNK_SAMPLES * 4);
+
+	mChannels = 0;
+	mSampleRate = 0;
+	mSampleBits = 0;
+	mDataLen = 0;
+
+	mLevel = -1;
+	mPos = 0;
+	mLastRise = -1;
+	mThreshold = 0;
+	mMaxPeriod = 0;
+	mRunType = -1;
+	mRunCount = 0;
+	mUartState = UART_IDLE;
+	mUartBits = 0;
+	mUartByte = 0;
+
+	mBytes = 0;
+	mFramingErrors = 0;
+}
+
+/// WAVファイルか
+/// @param[in] head ファイルの先頭
+/// @param[in] len  長さ
+bool L3WaveDecoder::IsWave(const wxUint8 *head, size_t len)
+{
+	return (len >= 12 && memcmp(head, "RIFF", 4) == 0 && memcmp(&head[8], "WAVE", 4) == 0);
+}
+
+/// ヘッダを読む
+///
+/// fmtチャンクを読み、dataチャンクの先頭まで進める。
+/// @return 対応していない形式ならfalse
+bool L3WaveDecoder::ReadHeader(PsFileInput &in)
+{
+	wxUint8 buf[40];
+	if (in.Read(buf, 12) < 12 || !IsWave(buf, 12)) {
+		return false;
+	}
+	bool has_fmt = false;
+	for(;;) {
+		if (in.Read(buf, 8) < 8) {
+			return false;
+		}
+		wxUint32 size = le32(&buf[4]);
+		if (memcmp(buf, "fmt ", 4) == 0) {
+			if (size < 16 || size > sizeof(buf)) {
+				return false;
+			}
+			if (in.Read(buf, size) < size) {
+				return false;
+			}
+			int format = le16(&buf[0]);
+			mChannels = le16(&buf[2]);
+			mSampleRate = (int)le32(&buf[4]);
+			mSampleBits = le16(&buf[14]);
+			// PCM または WAVE_FORMAT_EXTENSIBLE
+			if (format != 1 && format != 0xfffe) {
+				return false;
+			}
+			if (mChannels < 1 || mChannels > 2 || mSampleRate <= 0) {
+				return false;
+			}
+			if (mSampleBits != 8 && mSampleBits != 16) {
+				return false;
+			}
+			has_fmt = true;
+		} else if (memcmp(buf, "data", 4) == 0) {
+			mDataLen = size;
+			break;
+		} else {
+			// 読み飛ばす
+			in.Seek((wxFileOffset)size, wxFromCurrent);
+		}
+		if (size & 1) {
+			in.Seek(1, wxFromCurrent);
+		}
+	}
+	if (!has_fmt) {
+		return false;
+	}
+
+	// 周期の長短の境目 1/16サンプル単位
+	int long_period = mSampleRate * 16 / (mParam.mFreq0 > 0 ? mParam.mFreq0 : 1);
+	int short_period = mSampleRate * 16 / (mParam.mFreq1 > 0 ? mParam.mFreq1 : 1);
+	mThreshold = (long_period + short_period) / 2;
+	mMaxPeriod = long_period * 2;
+	return true;
+}
+
+/// サンプルを分類する
+///
+/// チャンクの最大と最小から中心とヒステリシス幅を決め、
+/// 分岐のないループで高/低/中間に分ける。
+/// @param[in] count サンプル数
+void L3WaveDecoder::ClassifySamples(size_t count)
+{
+	int max_val = -32768;
+	int min_val = 32767;
+	for(size_t i = 0; i < count; i++) {
+		int v = mSamples[i];
+		max_val = (v > max_val ? v : max_val);
+		min_val = (v < min_val ? v : min_val);
+	}
+	int center = (max_val + min_val) / 2;
+	int hyst = (max_val - min_val) / 8;
+	if (hyst < 64) hyst = 64;
+	int high = center + hyst;
+	int low = center - hyst;
+
+	for(size_t i = 0; i < count; i++) {
+		int v = mSamples[i];
+		mClass[i] = (wxUint8)((v > high) | ((v < low) << 1));
+	}
+}
+
+/// 分類したサンプルから周期を測る
+/// @param[in]  count サンプル数
+/// @param[out] out   復調したバイトの出力先
+void L3WaveDecoder::ProcessSamples(size_t count, PsFileOutput &out)
+{
+	int cycles0 = mParam.GetCycles0();
+	int cycles1 = mParam.GetCycles1();
+
+	for(size_t i = 0; i < count; i++) {
+		int c = mClass[i];
+		if (c == 2) {
+			mLevel = 0;
+			continue;
+		}
+		if (c != 1 || mLevel == 1) {
+			continue;
+		}
+		// 立ち上がり
+		wxInt64 rise = mPos + (wxInt64)i;
+		bool first = (mLevel < 0 || mLastRise < 0);
+		mLevel = 1;
+		wxInt64 prev = mLastRise;
+		mLastRise = rise;
+		if (first) {
+			continue;
+		}
+		wxInt64 period = (rise - prev) * 16;
+		if (period > mMaxPeriod) {
+			// 無音のあと
+			mRunType = -1;
+			mRunCount = 0;
+			mUartState = UART_IDLE;
+			continue;
+		}
+		int type = (period < mThreshold ? 1 : 0);
+		if (type != mRunType) {
+			mRunType = type;
+			mRunCount = 0;
+		}
+		mRunCount++;
+		if (mRunCount >= (type ? cycles1 : cycles0)) {
+			mRunCount = 0;
+			PutBit(type, out);
+		}
+	}
+	mPos += (wxInt64)count;
+}
+
+/// 1ビット受け取る
+/// @param[in]  bit 0/1
+/// @param[out] out 復調したバイトの出力先
+void L3WaveDecoder::PutBit(int bit, PsFileOutput &out)
+{
+	switch(mUartState) {
+	case UART_IDLE:
+		if (bit == 0) {
+			// スタートビット
+			mUartState = UART_DATA;
+			mUartBits = 0;
+			mUartByte = 0;
+		}
+		break;
+	case UART_DATA:
+		mUartByte |= (bit << mUartBits);
+		mUartBits++;
+		if (mUartBits >= 8) {
+			mUartState = UART_STOP;
+		}
+		break;
+	default:
+		if (bit == 1) {
+			wxUint8 val = (wxUint8)mUartByte;
+			out.Write(&val, 1);
+			mBytes++;
+		} else {
+			// ストップビットがない
+			mFramingErrors++;
+		}
+		// 2つ目以降のストップビットは待機中に読み捨てる
+		mUartState = UART_IDLE;
+		break;
+	}
+}
+
+/// 復調する
+/// @param[in]  in  WAVファイル
+/// @param[out] out テープイメージ
+/// @return 対応していない形式ならfalse
+bool L3WaveDecoder::Decode(PsFileInput &in, PsFileOutput &out)
+{
+	if (!ReadHeader(in)) {
+		return false;
+	}
+	size_t frame = (size_t)(mChannels * mSampleBits / 8);
+	wxUint32 remain = mDataLen;
+
+	while(remain > 0) {
+		size_t want = L3WAVE_CHUNK_SAMPLES * frame;
+		if (want > remain) want = remain;
+		size_t len = in.Read(mRaw, want);
+		size_t count = len / frame;
+		if (count == 0) {
+			break;
+		}
+		remain -= (wxUint32)len;
+
+		// 1チャンネル目を16ビットにする
+		if (mSampleBits == 8) {
+			for(size_t i = 0; i < count; i++) {
+				mSamples[i] = (wxInt16)(((int)mRaw[i * frame] - 128) << 8);
+			}
+		} else {
+			for(size_t i = 0; i < count; i++) {
+				mSamples[i] = (wxInt16)le16(&mRaw[i * frame]);
+			}
+		}
+		ClassifySamples(count);
+		ProcessSamples(count, out);
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+static const double cL3WavePi = 3.14159265358979323846;
+
+/// リトルエンディアンで入れる
+static inline void set_le32(wxUint8 *p, wxUint32 val)
+{
+	p[0] = (wxUint8)val; p[1] = (wxUint8)(val >> 8); p[2] = (wxUint8)(val >> 16); p[3] = (wxUint8)(val >> 24);
+}
+static inline void set_le16(wxUint8 *p, wxUint16 val)
+{
+	p[0] = (wxUint8)val; p[1] = (wxUint8)(val >> 8);
+}
+
+L3WaveEncoder::L3WaveEncoder(const L3WaveParam &param)
+	: mParam(param)
+	, mOutBuf(L3WAVE_OUT_BUFFER_SIZE)
+{
+	mBufSize = L3WAVE_OUT_BUFFER_SIZE;
+	mBuf = (wxUint8 *)mOutBuf.GetWriteBuf(mBufSize);
+	mFrameBytes = (mParam.mSampleBits == 16 ? 2 : 1);
+	mBitLen = 0;
+	mBitFrac = 0;
+	mFracSum = 0;
+	mBufPos = 0;
+	mBitBytes = 0;
+
+	if (!mParam.IsValidForOutput()) {
+		return;
+	}
+	mBitLen = mParam.mSampleRate / mParam.mBaud;
+	mBitFrac = mParam.mSampleRate % mParam.mBaud;
+	mBitBytes = (size_t)(mBitLen + 1) * mFrameBytes;
+
+	for(int bit = 0; bit < 2; bit++) {
+		MakeWave(bit, mBitLen, mWaves[bit][0]);
+		MakeWave(bit, mBitLen + 1, mWaves[bit][1]);
+	}
+}
+
+/// 1ビット分の波形を作る
+///
+/// 周期数ちょうどで終わるように周波数を合わせるので、ビットの境目で位相が続く。
+/// @param[in]  bit  0/1
+/// @param[in]  len  サンプル数
+/// @param[out] wave 波形
+void L3WaveEncoder::MakeWave(int bit, int len, wxMemoryBuffer &wave)
+{
+	int cycles = (bit ? mParam.GetCycles1() : mParam.GetCycles0());
+	wxUint8 *p = (wxUint8 *)wave.GetWriteBuf(len * mFrameBytes);
+	for(int i = 0; i < len; i++) {
+		double v = sin(2.0 * cL3WavePi * cycles * i / len) * 0.8;
+		if (mFrameBytes == 2) {
+			set_le16(&p[i * 2], (wxUint16)(wxInt16)floor(v * 32767.0 + 0.5));
+		} else {
+			p[i] = (wxUint8)(128 + (int)floor(v * 127.0 + 0.5));
+		}
+	}
+	wave.UngetWriteBuf(len * mFrameBytes);
+}
+
+/// 出力するサンプル数
+/// @param[in] len テープイメージのバイト数
+wxUint32 L3WaveEncoder::CountSamples(size_t len) const
+{
+	if (mBitLen <= 0) {
+		return 0;
+	}
+	wxUint64 bits = (wxUint64)len * (9 + mParam.mStopBits) + mParam.mLeaderBits + mParam.mTrailerBits;
+	return (wxUint32)(bits * mBitLen + bits * mBitFrac / mParam.mBaud);
+}
+
+/// WAVのヘッダを書く
+/// @param[in]  data_len dataチャンクのバイト数
+/// @param[out] out      出力先
+void L3WaveEncoder::WriteHeader(wxUint32 data_len, PsFileOutput &out)
+{
+	wxUint8 head[44];
+	memcpy(&head[0], "RIFF", 4);
+	set_le32(&head[4], 36 + data_len);
+	memcpy(&head[8], "WAVEfmt ", 8);
+	set_le32(&head[16], 16);
+	set_le16(&head[20], 1);	// PCM
+	set_le16(&head[22], 1);	// mono
+	set_le32(&head[24], (wxUint32)mParam.mSampleRate);
+	set_le32(&head[28], (wxUint32)(mParam.mSampleRate * mFrameBytes));
+	set_le16(&head[32], (wxUint16)mFrameBytes);
+	set_le16(&head[34], (wxUint16)mParam.mSampleBits);
+	memcpy(&head[36], "data", 4);
+	set_le32(&head[40], data_len);
+	out.Write(head, sizeof(head));
+}
+
+/// 1ビット分の波形を出力バッファに入れる
+/// @note 呼び出し元でバッファの空きを確保しておく
+inline void L3WaveEncoder::PutBit(int bit)
+{
+	int idx = 0;
+	mFracSum += mBitFrac;
+	if (mFracSum >= mParam.mBaud) {
+		mFracSum -= mParam.mBaud;
+		idx = 1;
+	}
+	const wxMemoryBuffer &wave = mWaves[bit][idx];
+	memcpy(&mBuf[mBufPos], wave.GetData(), wave.GetDataLen());
+	mBufPos += wave.GetDataLen();
+}
+
+/// 1バイト分の波形を出力バッファに入れる
+///
+/// スタートビット、データ8ビット(下位から)、ストップビットの順。
+void L3WaveEncoder::PutByte(wxUint8 val, PsFileOutput &out)
+{
+	if (mBufPos + mBitBytes * (9 + mParam.mStopBits) > mBufSize) {
+		Flush(out);
+	}
+	PutBit(0);
+	for(int i = 0; i < 8; i++) {
+		PutBit((val >> i) & 1);
+	}
+	for(int i = 0; i < mParam.mStopBits; i++) {
+		PutBit(1);
+	}
+}
+
+/// 出力バッファを書き出す
+void L3WaveEncoder::Flush(PsFileOutput &out)
+{
+	if (mBufPos > 0) {
+		out.Write(mBuf, mBufPos);
+		mBufPos = 0;
+	}
+}
+
+/// テープイメージを音声にして書き出す
+///
+/// 先頭と末尾には1のビットを続けて入れる。
+/// ブロック間のギャップ(0xff)もテープイメージのとおりに音声にする。
+/// @param[in]  data テープイメージ
+/// @param[in]  len  長さ
+/// @param[out] out  出力先
+/// @return 出力できない形式ならfalse
+bool L3WaveEncoder::Encode(const wxUint8 *data, size_t len, PsFileOutput &out)
+{
+	if (mBitLen <= 0 || mBufSize < mBitBytes * (9 + mParam.mStopBits)) {
+		return false;
+	}
+	wxUint32 samples = CountSamples(len);
+	WriteHeader(samples * mFrameBytes, out);
+
+	mFracSum = 0;
+	mBufPos = 0;
+	for(int i = 0; i < mParam.mLeaderBits; i++) {
+		if (mBufPos + mBitBytes > mBufSize) Flush(out);
+		PutBit(1);
+	}
+	for(size_t i = 0; i < len; i++) {
+		PutByte(data[i], out);
+	}
+	for(int i = 0; i < mParam.mTrailerBits; i++) {
+		if (mBufPos + mBitBytes > mBufSize) Flush(out);
+		PutBit(1);
+	}
+	Flush(out);
+	return true;
+}
@@ -0,0 +1,167 @@
+﻿/// @file l3wave.h
+///
+/// @brief L3/S1のカセットテープの音声(WAV)
+///
+///
+#ifndef _L3WAVE_H_
+#define _L3WAVE_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include "fileinfo.h"
+
+/// 一度に処理するサンプル数
+#define L3WAVE_CHUNK_SAMPLES	16384
+/// 出力バッファのバイト数
+#define L3WAVE_OUT_BUFFER_SIZE	65536
+
+/// カセットテープの音声の形式
+///
+/// 0は低い周波数、1は高い周波数で、1ビットの周期数は 周波数/ボーレート になる。
+/// 1バイトはスタートビット(0)、データ8ビット(下位から)、ストップビット(1)で送る。
+class L3WaveParam
+{
+public:
+	int mSampleRate;	///< サンプリング周波数 (出力時)
+	int mSampleBits;	///< 量子化ビット数 8/16 (出力時)
+	int mBaud;			///< ボーレート
+	int mFreq0;			///< 0の周波数
+	int mFreq1;			///< 1の周波数
+	int mStopBits;		///< ストップビット数 (出力時)
+	int mLeaderBits;	///< 先頭に入れる1のビット数 (出力時)
+	int mTrailerBits;	///< 末尾に入れる1のビット数 (出力時)
+
+	L3WaveParam();
+
+	/// 出力できる値か
+	bool IsValidForOutput() const;
+
+	/// 0の1ビットの周期数
+	int GetCycles0() const;
+	/// 1の1ビットの周期数
+	int GetCycles1() const;
+};
+
+/// WAVファイルからテープイメージに復調する
+///
+/// 一定のサンプル数ずつ読み、立ち上がりの間隔(周期)が長いか短いかで0/1を決める。
+/// 読み込み用のバッファは固定長なので長い録音でもメモリは増えない。
+/// バッファはヒープに取るのでスタックに置いて使ってよい。
+class L3WaveDecoder
+{
+private:
+	L3WaveParam mParam;
+
+	/// @name WAVの形式
+	//@{
+	int mChannels;
+	int mSampleRate;
+	int mSampleBits;
+	wxUint32 mDataLen;
+	//@}
+
+	/// @name 復調の状態
+	//@{
+	int mLevel;			///< 今のレベル 1:高 0:低 -1:不明
+	wxInt64 mPos;		///< 処理したサンプル数
+	wxInt64 mLastRise;	///< 直前の立ち上がり位置 -1:なし
+	int mThreshold;		///< 周期の長短を分ける値 (1/16サンプル単位)
+	int mMaxPeriod;		///< これより長い周期は無音とみなす (1/16サンプル単位)
+	int mRunType;		///< 続いている周期の種類 0:長 1:短 -1:なし
+	int mRunCount;		///< 続いている周期の数
+	int mUartState;		///< enUartStates
+	int mUartBits;		///< 受け取ったデータビット数
+	int mUartByte;		///< 受け取り中のバイト
+	//@}
+
+	/// @name 結果
+	//@{
+	size_t mBytes;			///< 復調したバイト数
+	size_t mFramingErrors;	///< ストップビットがなかった数
+	//@}
+
+	/// @name 作業用バッファ (大きいのでヒープに置く)
+	//@{
+	wxMemoryBuffer mSampleBuf;
+	wxMemoryBuffer mClassBuf;
+	wxMemoryBuffer mRawBuf;
+	wxInt16 *mSamples;	///< 1チャンネル目のサンプル
+	wxUint8 *mClass;	///< サンプルの分類 1:高 2:低 0:中間
+	wxUint8 *mRaw;		///< 読み込んだデータ
+	//@}
+
+	enum enUartStates {
+		UART_IDLE = -1,
+		UART_DATA = 0,
+		UART_STOP
+	};
+
+	/// ヘッダを読む
+	bool ReadHeader(PsFileInput &in);
+	/// サンプルを分類する
+	void ClassifySamples(size_t count);
+	/// 分類したサンプルから周期を測る
+	void ProcessSamples(size_t count, PsFileOutput &out);
+	/// 1ビット受け取る
+	void PutBit(int bit, PsFileOutput &out);
+
+public:
+	L3WaveDecoder(const L3WaveParam &param);
+	~L3WaveDecoder() {}
+
+	/// WAVファイルか
+	static bool IsWave(const wxUint8 *head, size_t len);
+	/// 復調する
+	bool Decode(PsFileInput &in, PsFileOutput &out);
+
+	size_t GetBytes() const { return mBytes; }
+	size_t GetFramingErrors() const { return mFramingErrors; }
+	int GetSampleRate() const { return mSampleRate; }
+
+	DECLARE_NO_COPY_CLASS(L3WaveDecoder)
+};
+
+/// テープイメージからWAVファイルを作る
+///
+/// 0/1それぞれ1ビット分の波形をあらかじめ作っておき、出力バッファにそのままコピーする。
+/// 1ビットのサンプル数の端数は次のビットに持ち越すので、長さが1サンプル違う波形を2つずつ用意する。
+/// 出力はモノラルで、サンプル数はデータの長さから先に決まる。
+class L3WaveEncoder
+{
+private:
+	L3WaveParam mParam;
+	int mFrameBytes;		///< 1サンプルのバイト数
+	int mBitLen;			///< 1ビットのサンプル数 (短い方)
+	int mBitFrac;			///< 1ビットのサンプル数の端数 (1/ボーレート単位)
+	int mFracSum;			///< 持ち越した端数
+	wxMemoryBuffer mWaves[2][2];	///< 1ビットの波形 [ビット][0:短い 1:長い]
+	wxMemoryBuffer mOutBuf;	///< 出力バッファの実体 (ヒープ)
+	wxUint8 *mBuf;			///< 出力バッファ
+	size_t mBufSize;		///< 出力バッファのバイト数
+	size_t mBufPos;			///< 出力バッファの使用量
+	size_t mBitBytes;		///< 1ビットの最大バイト数
+
+	/// 1ビット分の波形を作る
+	void MakeWave(int bit, int len, wxMemoryBuffer &wave);
+	/// WAVのヘッダを書く
+	void WriteHeader(wxUint32 data_len, PsFileOutput &out);
+	/// 1ビット分の波形を出力バッファに入れる
+	void PutBit(int bit);
+	/// 1バイト分の波形を出力バッファに入れる
+	void PutByte(wxUint8 val, PsFileOutput &out);
+	/// 出力バッファを書き出す
+	void Flush(PsFileOutput &out);
+
+public:
+	L3WaveEncoder(const L3WaveParam &param);
+	~L3WaveEncoder() {}
+
+	/// 出力するサンプル数
+	wxUint32 CountSamples(size_t len) const;
+	/// テープイメージを音声にして書き出す
+	bool Encode(const wxUint8 *data, size_t len, PsFileOutput &out);
+
+	DECLARE_NO_COPY_CLASS(L3WaveEncoder)
+};
+
+#endif /* _L3WAVE_H_ */
@@ -8,9 +8,7 @@
 #include "fontminibox.h"
 #include "chartypebox.h"
 #include "tapebox.h"
-#include <wx/cmdline.h>
 #include <wx/filename.h>
-#include <wx/regex.h>
 #include "mymenu.h"
 #include "config.h"
 #include "parse_l3s1basic.h"
@@ -35,6 +33,23 @@ BasicApp::BasicApp()
 	frame = NULL;
 }
 
+/// 変換エンジンのエラーをメッセージBOXで知らせる
+/// @param[in] info エラー情報
+/// @param[in] win  親ウィンドウ
+static void ShowErrorMsgBox(const PsErrInfo &info, wxWindow *win)
+{
+	switch(info.GetType()) {
+		case psError:
+			wxMessageBox(info.GetMessage(), _("Error"), wxOK | wxICON_ERROR, win);
+			break;
+		case psWarning:
+			wxMessageBox(info.GetMessage(), _("Warning"), wxOK | wxICON_WARNING, win);
+			break;
+		default:
+			break;
+	}
+}
+
 bool BasicApp::OnInit()
 {
 	SetAppPath();
@@ -45,31 +60,18 @@ bool BasicApp::OnInit()
 	}
 
 	// load ini file
-	gConfig.Load(ini_path + GetAppName() + _T(".ini"));
+	wxString ini_file = ini_path + GetAppName() + _T(".ini");
+	gConfig.Load(ini_file);
+	mBatch.SetPaths(ini_file, res_path);
 
 	// set locale search path and catalog name
-	wxString locale_name = gConfig.GetLanguage();
-	int lang_num = 0;
-	if (locale_name.IsEmpty()) {
-		lang_num = wxLocale::GetSystemLanguage();
-	} else {
-		const wxLanguageInfo * const lang = wxLocale::FindLanguageInfo(locale_name);
-		if (lang) {
-			lang_num = lang->Language;
-		} else {
-			lang_num = wxLANGUAGE_UNKNOWN;
-		}
-	}
-	if (mLocale.Init(lang_num, wxLOCALE_LOAD_DEFAULT)) {
-		mLocale.AddCatalogLookupPathPrefix(res_path + _T("lang"));
-		mLocale.AddCatalogLookupPathPrefix(_T("lang"));
-		mLocale.AddCatalog(_T(APPLICATION_NAME));
-	}
-	if (mLocale.IsLoaded(_T(APPLICATION_NAME))) {
-		locale_name = mLocale.GetCanonicalName();
-	} else {
-		locale_name = wxT("");
+	BasicBatch::InitLocale(mLocale, res_path);
+
+	if (mBatch.IsBatchMode()) {
+		// ウィンドウは作らずにOnRunで変換する エラーは標準エラーへ出力
+		return true;
 	}
+	PsErrInfo::SetHandler(ShowErrorMsgBox);
 
 	frame = new BasicFrame(GetAppName(), wxSize(720, 600));
 	if (!frame->IsOk()) {
@@ -85,50 +87,27 @@ bool BasicApp::OnInit()
 	return true;
 }
 
-#define OPTION_VERBOSE "verbose"
+int BasicApp::OnRun()
+{
+	if (mBatch.IsBatchMode()) {
+		return mBatch.Run();
+	}
+	return wxApp::OnRun();
+}
 
 void BasicApp::OnInitCmdLine(wxCmdLineParser &parser)
 {
-	// the standard command line options
-	static const wxCmdLineEntryDesc cmdLineDesc[] = {
-		{
-			wxCMD_LINE_SWITCH, "h", "help",
-			"show this help message",
-			wxCMD_LINE_VAL_NONE,
-			wxCMD_LINE_OPTION_HELP
-		},
-
-#if wxUSE_LOG
-		{
-			wxCMD_LINE_SWITCH, NULL, OPTION_VERBOSE,
-			"generate verbose log messages",
-			wxCMD_LINE_VAL_NONE,
-			0x0
-		},
-#endif // wxUSE_LOG
-	    {
-			wxCMD_LINE_PARAM, NULL, NULL,
-			"input file",
-			wxCMD_LINE_VAL_STRING,
-			wxCMD_LINE_PARAM_OPTIONAL
-		},
-
-		// terminator
-		wxCMD_LINE_DESC_END
-	};
-
-	parser.SetDesc(cmdLineDesc);
+	BasicBatch::InitCmdLine(parser);
 }
 
 bool BasicApp::OnCmdLineParsed(wxCmdLineParser &parser)
 {
-#if wxUSE_LOG
-	if ( parser.Found(OPTION_VERBOSE) ) {
-		wxLog::SetVerbose(true);
+	if (!mBatch.CmdLineParsed(parser)) {
+		return false;
 	}
-#endif // wxUSE_LOG
-	if (parser.GetParamCount() > 0) {
-		in_file = parser.GetParam(0);
+	const wxArrayString &in_files = mBatch.GetInFiles();
+	if (in_files.Count() > 0) {
+		in_file = in_files[0];
 	}
 	return true;
 }
@@ -150,28 +129,16 @@ void BasicApp::MacOpenFiles(const wxArrayString &fileNames)
 int BasicApp::OnExit()
 {
 	// save ini file
-	gConfig.Save();
+	if (!mBatch.IsBatchMode()) {
+		gConfig.Save();
+	}
 
 	return 0;
 }
 
 void BasicApp::SetAppPath()
 {
-	app_path = wxFileName::FileName(argv[0]).GetPath(wxPATH_GET_SEPARATOR);
-#ifdef __WXOSX__
-	if (app_path.Find(_T("MacOS")) >= 0) {
-		wxFileName file = wxFileName::FileName(app_path+"../../../");
-		file.Normalize(wxPATH_NORM_ALL);
-		ini_path = file.GetPath(wxPATH_GET_SEPARATOR);
-		file = wxFileName::FileName(app_path+"../../Contents/Resources/");
-		file.Normalize(wxPATH_NORM_ALL);
-		res_path = file.GetPath(wxPATH_GET_SEPARATOR);
-	} else
-#endif
-	{
-		ini_path = app_path;
-		res_path = app_path;
-	}
+	BasicBatch::GetAppPaths(argv[0], app_path, ini_path, res_path);
 }
 
 const wxString &BasicApp::GetAppPath()
@@ -696,7 +663,17 @@ void BasicFrame::ExportFile(int id)
 	if (rc == wxID_OK) {
 		wxString basic_type = panel->GetBasicType(2);
 		file_type.SetMachineAndBasicType(ps->GetMachineType(basic_type), basic_type, ps->IsExtendedBasic(basic_type));
-		if (!ps->OpenOutFile(path, file_type)) {
+		// テープイメージの拡張子がwavなら音声で出力
+		if (file_type.GetTypeFlag(psTapeImage) && ps->CanExportTapeAudio() && wxFileName(path).GetExt().CmpNoCase(_T("wav")) == 0) {
+			file_type.SetTypeFlag(psWaveAudio, true);
+		}
+		if (file_type.GetTypeFlag(psDiskImage) && ps->CanExportDiskImage() && wxFileName(path).GetExt().CmpNoCase(ps->GetDiskImageFileExtension()) == 0) {
+			// ディスクイメージの拡張子(d88/dsk)なら既存のイメージの中に書き込む
+			file_type.SetInternalName(ps->GetFileNameBase());
+			if (!ps->OpenOutDiskImage(path, file_type)) {
+				return;
+			}
+		} else if (!ps->OpenOutFile(path, file_type)) {
 			return;
 		}
 		panel->SetTextInfo(_("Now Processing..."));
@@ -13,6 +13,7 @@
 #include "mytextctrl.h"
 #include "parse.h"
 #include "config.h"
+#include "batch.h"
 
 class BasicApp;
 class BasicFrame;
@@ -36,10 +37,13 @@ private:
 	BasicFrame *frame;
 	wxString in_file;
 
+	BasicBatch mBatch;	///< バッチモード
+
 	void SetAppPath();
 public:
 	BasicApp();
 	bool OnInit();
+	int  OnRun();
 	void OnInitCmdLine(wxCmdLineParser &parser);
 	bool OnCmdLineParsed(wxCmdLineParser &parser);
 	void MacOpenFile(const wxString &fileName);
@@ -324,6 +324,9 @@ WX_DEFINE_OBJARRAY(CodeMapSections);
 CodeMapTable::CodeMapTable() {
 	sections.Empty();
 	current_section = NULL;
+#ifdef USE_PARSE_STATS
+	lookup_count = 0;
+#endif
 }
 /// セクションを追加
 void CodeMapTable::AddSection(const wxString &section_name, int type_number) {
@@ -387,12 +390,14 @@ void CodeMapTable::AddItem(const wxUint8 *new_code, size_t new_code_len, const w
 /// アイテムを探す(code)(前方一致 & 最長一致)
 CodeMapItem *CodeMapTable::FindByCode(const wxUint8 *code, int attr, bool matching) {
 	CodeMapItem *item = NULL;
+	PARSE_STATS_LOOKUP(lookup_count);
 	if (current_section != NULL) item = current_section->FindByCode(code, attr, matching);
 	return item;
 }
 /// アイテムを探す(str)(前方一致 & 最長一致)
 CodeMapItem *CodeMapTable::FindByStr(const wxString &str, bool case_insensitive, int attr, bool matching) {
 	CodeMapItem *item = NULL;
+	PARSE_STATS_LOOKUP(lookup_count);
 	wxString n_str;
 	if (case_insensitive) n_str = str.Upper(); else n_str = str;
 	if (current_section != NULL) item = current_section->FindByStr(n_str, case_insensitive, attr, matching);
@@ -401,12 +406,14 @@ CodeMapItem *CodeMapTable::FindByStr(const wxString &str, bool case_insensitive,
 /// アイテムを探す(bytes)(前方一致 & 最長一致)
 CodeMapItem *CodeMapTable::FindByBytes(const wxUint8 *bytes, int attr, bool matching) {
 	CodeMapItem *item = NULL;
+	PARSE_STATS_LOOKUP(lookup_count);
 	if (current_section != NULL) item = current_section->FindByBytes(bytes, attr, matching);
 	return item;
 }
 /// 全セクションでアイテムを探す(code)
 CodeMapItem *CodeMapTable::FindByCodeInAllSections(const wxUint8 *code, int attr, bool matching) {
 	CodeMapItem *item = NULL;
+	PARSE_STATS_LOOKUP(lookup_count);
 	size_t i;
 	for (i = 0; i < sections.GetCount(); i++) {
 		item = sections.Item(i).FindByCode(code, attr, matching);
@@ -417,6 +424,7 @@ CodeMapItem *CodeMapTable::FindByCodeInAllSections(const wxUint8 *code, int attr
 /// 全セクションでアイテムを探す(str)(前方一致 & 最長一致)
 CodeMapItem *CodeMapTable::FindByStrInAllSections(const wxString &str, bool case_insensitive, int attr, bool matching) {
 	CodeMapItem *item = NULL;
+	PARSE_STATS_LOOKUP(lookup_count);
 //	wxString n_str;
 //	if (case_insensitive) n_str = str.Upper(); else n_str = str;
 	size_t i;
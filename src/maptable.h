@@ -8,6 +8,7 @@
 #include "common.h"
 #include <wx/wx.h>
 #include <wx/dynarray.h>
+#include "parsestats.h"
 
 //////////////////////////////////////////////////////////////////////
 /// マッピングテーブルItem
@@ -131,8 +132,19 @@ class CodeMapTable
 private:
 	CodeMapSections sections;
 	CodeMapSection *current_section;
+#ifdef USE_PARSE_STATS
+	wxUint64 lookup_count;	///< アイテムの検索回数
+#endif
 public:
 	CodeMapTable();
+#ifdef USE_PARSE_STATS
+	/// 検索回数を返す
+	wxUint64 GetLookupCount() const { return lookup_count; }
+	/// 検索回数を加算
+	void AddLookupCount(wxUint64 val) { lookup_count += val; }
+	/// 検索回数をクリア
+	void ResetLookupCount() { lookup_count = 0; }
+#endif
 	/// セクションを追加
 	void AddSection(const wxString &section_name, int type_number);
 	/// セクションを探す
@@ -0,0 +1,258 @@
+﻿/// @file msxbcd.cpp
+///
+/// @brief MSXの実数内部表現形式(BCD)
+///
+///
+#include "msxbcd.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// 1バイトのBCDを2桁の文字にする
+/// 10以上の値は '0'+値 (':'～'?')
+static const char cBcdToAscii[256][2] = {
+	{'0','0'}, {'0','1'}, {'0','2'}, {'0','3'}, {'0','4'}, {'0','5'}, {'0','6'}, {'0','7'}, {'0','8'}, {'0','9'}, {'0',':'}, {'0',';'}, {'0','<'}, {'0','='}, {'0','>'}, {'0','?'},	// 0x00
+	{'1','0'}, {'1','1'}, {'1','2'}, {'1','3'}, {'1','4'}, {'1','5'}, {'1','6'}, {'1','7'}, {'1','8'}, {'1','9'}, {'1',':'}, {'1',';'}, {'1','<'}, {'1','='}, {'1','>'}, {'1','?'},	// 0x10
+	{'2','0'}, {'2','1'}, {'2','2'}, {'2','3'}, {'2','4'}, {'2','5'}, {'2','6'}, {'2','7'}, {'2','8'}, {'2','9'}, {'2',':'}, {'2',';'}, {'2','<'}, {'2','='}, {'2','>'}, {'2','?'},	// 0x20
+	{'3','0'}, {'3','1'}, {'3','2'}, {'3','3'}, {'3','4'}, {'3','5'}, {'3','6'}, {'3','7'}, {'3','8'}, {'3','9'}, {'3',':'}, {'3',';'}, {'3','<'}, {'3','='}, {'3','>'}, {'3','?'},	// 0x30
+	{'4','0'}, {'4','1'}, {'4','2'}, {'4','3'}, {'4','4'}, {'4','5'}, {'4','6'}, {'4','7'}, {'4','8'}, {'4','9'}, {'4',':'}, {'4',';'}, {'4','<'}, {'4','='}, {'4','>'}, {'4','?'},	// 0x40
+	{'5','0'}, {'5','1'}, {'5','2'}, {'5','3'}, {'5','4'}, {'5','5'}, {'5','6'}, {'5','7'}, {'5','8'}, {'5','9'}, {'5',':'}, {'5',';'}, {'5','<'}, {'5','='}, {'5','>'}, {'5','?'},	// 0x50
+	{'6','0'}, {'6','1'}, {'6','2'}, {'6','3'}, {'6','4'}, {'6','5'}, {'6','6'}, {'6','7'}, {'6','8'}, {'6','9'}, {'6',':'}, {'6',';'}, {'6','<'}, {'6','='}, {'6','>'}, {'6','?'},	// 0x60
+	{'7','0'}, {'7','1'}, {'7','2'}, {'7','3'}, {'7','4'}, {'7','5'}, {'7','6'}, {'7','7'}, {'7','8'}, {'7','9'}, {'7',':'}, {'7',';'}, {'7','<'}, {'7','='}, {'7','>'}, {'7','?'},	// 0x70
+	{'8','0'}, {'8','1'}, {'8','2'}, {'8','3'}, {'8','4'}, {'8','5'}, {'8','6'}, {'8','7'}, {'8','8'}, {'8','9'}, {'8',':'}, {'8',';'}, {'8','<'}, {'8','='}, {'8','>'}, {'8','?'},	// 0x80
+	{'9','0'}, {'9','1'}, {'9','2'}, {'9','3'}, {'9','4'}, {'9','5'}, {'9','6'}, {'9','7'}, {'9','8'}, {'9','9'}, {'9',':'}, {'9',';'}, {'9','<'}, {'9','='}, {'9','>'}, {'9','?'},	// 0x90
+	{':','0'}, {':','1'}, {':','2'}, {':','3'}, {':','4'}, {':','5'}, {':','6'}, {':','7'}, {':','8'}, {':','9'}, {':',':'}, {':',';'}, {':','<'}, {':','='}, {':','>'}, {':','?'},	// 0xA0
+	{';','0'}, {';','1'}, {';','2'}, {';','3'}, {';','4'}, {';','5'}, {';','6'}, {';','7'}, {';','8'}, {';','9'}, {';',':'}, {';',';'}, {';','<'}, {';','='}, {';','>'}, {';','?'},	// 0xB0
+	{'<','0'}, {'<','1'}, {'<','2'}, {'<','3'}, {'<','4'}, {'<','5'}, {'<','6'}, {'<','7'}, {'<','8'}, {'<','9'}, {'<',':'}, {'<',';'}, {'<','<'}, {'<','='}, {'<','>'}, {'<','?'},	// 0xC0
+	{'=','0'}, {'=','1'}, {'=','2'}, {'=','3'}, {'=','4'}, {'=','5'}, {'=','6'}, {'=','7'}, {'=','8'}, {'=','9'}, {'=',':'}, {'=',';'}, {'=','<'}, {'=','='}, {'=','>'}, {'=','?'},	// 0xD0
+	{'>','0'}, {'>','1'}, {'>','2'}, {'>','3'}, {'>','4'}, {'>','5'}, {'>','6'}, {'>','7'}, {'>','8'}, {'>','9'}, {'>',':'}, {'>',';'}, {'>','<'}, {'>','='}, {'>','>'}, {'>','?'},	// 0xE0
+	{'?','0'}, {'?','1'}, {'?','2'}, {'?','3'}, {'?','4'}, {'?','5'}, {'?','6'}, {'?','7'}, {'?','8'}, {'?','9'}, {'?',':'}, {'?',';'}, {'?','<'}, {'?','='}, {'?','>'}, {'?','?'},	// 0xF0
+};
+
+/// 文字を数値にする 数字以外は0
+static const unsigned char cAsciiToNibble[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/// 1桁出力 10以上の値は2桁になる
+static inline char *put_digit(char *p, char c)
+{
+	if (c <= '9') {
+		*p++ = c;
+	} else {
+		*p++ = '1';
+		*p++ = (char)(c - 10);
+	}
+	return p;
+}
+
+/// 実数(BCD)を10進文字列にする
+/// @param[in]  src     実数(BCD) 1バイト目は指数部
+/// @param[in]  src_len srcの長さ 4 or 8
+/// @param[out] dst     10進文字列 MSXBCD_STR_MAX以上のバッファ
+/// @return     文字列の長さ
+int MSXBcd::BytesToStr(const unsigned char *src, int src_len, char *dst)
+{
+	char *p = dst;
+
+	// 指数部が0の時は"0"
+	if ((src[0] & 0x7f) == 0) {
+		*p++ = '0';
+		*p = '\0';
+		return 1;
+	}
+
+	// 指数表記にするか
+	bool expview = true;
+	// 指数
+	int ex = (int)(src[0] & 0x7f) - 64;
+	if (-1 <= ex && ex <= 13) {
+		expview = false;
+	} else {
+		ex--;
+	}
+
+	// 符号
+	if (src[0] & 0x80) {
+		*p++ = '-';
+	}
+
+	// 仮数部(BCD)を数字にする 2桁目から
+	char digits[MSXBCD_STR_MAX / 2];
+	if (src_len > MSXBCD_STR_MAX / 4) src_len = MSXBCD_STR_MAX / 4;
+	for(int i=1; i<src_len; i++) {
+		digits[i * 2] = cBcdToAscii[src[i]][0];
+		digits[i * 2 + 1] = cBcdToAscii[src[i]][1];
+	}
+
+	// 仮数部の0をトリミング
+	int len = src_len * 2 - 1;
+	for(;len >= 2; len--) {
+		if (digits[len] != '0') break;
+	}
+
+	if (expview) {
+		// 指数表記
+		for(int i=2; i <= len; i++) {
+			if (i == 3) *p++ = '.';
+			p = put_digit(p, digits[i]);
+		}
+		*p++ = 'E';
+		*p++ = (ex < 0 ? '-' : '+');
+		int aex = (ex < 0 ? -ex : ex);
+		if (aex >= 100) *p++ = (char)('0' + aex / 100);
+		*p++ = (char)('0' + (aex / 10) % 10);
+		*p++ = (char)('0' + aex % 10);
+	} else {
+		// 実数表記
+		int imin = ex < 0 ? ex + 2 : 2;
+		int imax = ex >= len ? ex + 1 : len;
+		for(int i=imin; i <= imax; i++) {
+			if (i == (ex + 2)) *p++ = '.';
+			if (2 <= i && i <= len) {
+				p = put_digit(p, digits[i]);
+			} else {
+				*p++ = '0';
+			}
+		}
+		// 倍精度 or 単精度
+		*p++ = (src_len == 8 ? '#' : '!');
+	}
+	*p = '\0';
+
+	return (int)(p - dst);
+}
+
+/// 10進文字列を実数(BCD)にする
+/// 符号はつけないこと
+/// @param[in]  src     10進文字列(大文字)
+/// @param[in]  src_len srcの長さ
+/// @param[out] dst     実数(BCD) 8バイト以上のバッファ
+/// @param[out] dst_len 書き込んだ長さ 4 or 8 (ゼロ、オーバーフローは0)
+/// @return     BCD_SINGLE/BCD_DOUBLE/BCD_ZERO/BCD_OVERFLOW
+int MSXBcd::StrToBytes(const char *src, int src_len, unsigned char *dst, int &dst_len)
+{
+	int len = src_len;
+	dst_len = 0;
+
+	// 型を示す文字は除く
+	if (len > 0 && (src[len - 1] == '!' || src[len - 1] == '#')) {
+		len--;
+	}
+
+	// 指数部
+	int vlen = len;
+	long exval = 0;
+	for(int i=0; i<len; i++) {
+		if (src[i] == 'E') {
+			char buf[MSXBCD_STR_MAX];
+			int n = len - i - 1;
+			if (n > MSXBCD_STR_MAX - 1) n = MSXBCD_STR_MAX - 1;
+			memcpy(buf, &src[i + 1], n);
+			buf[n] = '\0';
+			exval = strtol(buf, NULL, 10);
+			vlen = i;
+			break;
+		}
+	}
+
+	// 小数点の位置だけ指数をずらす 小数点は飛ばして読む
+	int ppos = -1;
+	for(int i=0; i<vlen; i++) {
+		if (src[i] == '.') {
+			ppos = i;
+			break;
+		}
+	}
+	int dlen = vlen;
+	if (ppos < 0) {
+		exval += vlen;
+	} else {
+		exval += ppos;
+		dlen--;
+	}
+#define MSXBCD_DIGIT(k) src[(ppos >= 0 && (k) >= ppos) ? (k) + 1 : (k)]
+
+	// trim left zero
+	int start = 0;
+	while(start < dlen) {
+		if (MSXBCD_DIGIT(start) != '0') break;
+		exval--;
+		start++;
+		if (exval <= -63) break;
+	}
+	// trim right zero
+	int end = dlen;
+	while(end > start) {
+		if (MSXBCD_DIGIT(end - 1) != '0') break;
+		end--;
+	}
+
+	// "0"の場合
+	if (end - start == 1 && MSXBCD_DIGIT(start) == '0') {
+		return BCD_ZERO;
+	}
+
+	int type;
+	int cols;
+	if (end - start <= 6) {
+		// 単精度
+		type = BCD_SINGLE;
+		cols = 6;
+	} else if (end - start <= 14) {
+		// 倍精度
+		type = BCD_DOUBLE;
+		cols = 14;
+	} else {
+		// オーバーフロー
+		return BCD_OVERFLOW;
+	}
+
+	char digits[14];
+	int n = 0;
+	for(int k=start; k<end; k++) {
+		digits[n++] = MSXBCD_DIGIT(k);
+	}
+#undef MSXBCD_DIGIT
+
+	// 指数部
+	dst[0] = (exval + 64) & 0xff;
+	// 仮数部(BCD)
+	PackDigits(digits, n, &dst[1], cols / 2);
+	dst_len = cols / 2 + 1;
+
+	return type;
+}
+
+/// 数字を2桁ずつBCDにする
+/// 足りない桁は0 数字以外の文字は0とする
+/// @param[in]  digits     数字
+/// @param[in]  digits_len 桁数
+/// @param[out] dst        BCD
+/// @param[in]  dst_len    dstのバイト数 (8バイトまで)
+void MSXBcd::PackDigits(const char *digits, int digits_len, unsigned char *dst, int dst_len)
+{
+	char pad[16];
+	if (dst_len > 8) dst_len = 8;
+	if (digits_len > dst_len * 2) digits_len = dst_len * 2;
+	if (digits_len < 0) digits_len = 0;
+	memset(pad, '0', sizeof(pad));
+	memcpy(pad, digits, digits_len);
+	for(int i=0; i<dst_len; i++) {
+		dst[i] = (unsigned char)((cAsciiToNibble[(unsigned char)pad[i * 2]] << 4) | cAsciiToNibble[(unsigned char)pad[i * 2 + 1]]);
+	}
+}
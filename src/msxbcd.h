@@ -0,0 +1,38 @@
+﻿/// @file msxbcd.h
+///
+/// @brief MSXの実数内部表現形式(BCD)
+///
+///
+#ifndef _MSXBCD_H_
+#define _MSXBCD_H_
+
+/// 10進文字列の最大長さ
+#define MSXBCD_STR_MAX	64
+
+/// MSXの実数内部表現形式(BCD)を変換
+///
+/// 1バイト目: bit7 符号 bit6-0 指数(+64)
+/// 2バイト目以降: 仮数部 1バイトに2桁 (0.dddd...)
+class MSXBcd
+{
+public:
+	/// 数値の型
+	enum enBcdTypes {
+		BCD_OVERFLOW = -1,
+		BCD_ZERO = 0,
+		BCD_SINGLE = 1,
+		BCD_DOUBLE = 2
+	};
+
+	MSXBcd() {};
+	~MSXBcd() {};
+
+	/// 実数(BCD)を10進文字列にする
+	static int BytesToStr(const unsigned char *src, int src_len, char *dst);
+	/// 10進文字列を実数(BCD)にする
+	static int StrToBytes(const char *src, int src_len, unsigned char *dst, int &dst_len);
+	/// 数字を2桁ずつBCDにする
+	static void PackDigits(const char *digits, int digits_len, unsigned char *dst, int dst_len);
+};
+
+#endif /* _MSXBCD_H_ */
@@ -0,0 +1,641 @@
+﻿/// @file msxdisk.cpp
+///
+/// @brief MSX-DOS(FAT12)のディスクイメージ
+///
+///
+#include "msxdisk.h"
+#include <wx/file.h>
+#include <wx/datetime.h>
+#include <string.h>
+
+/// リトルエンディアンの値
+static inline wxUint16 msxdisk_le16(const wxUint8 *p)
+{
+	return (wxUint16)(p[0] | (p[1] << 8));
+}
+static inline void msxdisk_set_le16(wxUint8 *p, wxUint32 val)
+{
+	p[0] = (wxUint8)(val & 0xff);
+	p[1] = (wxUint8)((val >> 8) & 0xff);
+}
+
+/// 2のべき乗か
+static inline bool msxdisk_is_pow2(int val)
+{
+	return (val > 0 && (val & (val - 1)) == 0);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// 2DDの720KB
+MsxDiskBpb::MsxDiskBpb()
+{
+	mBytesPerSector = 512;
+	mSectorsPerCluster = 2;
+	mReservedSectors = 1;
+	mFats = 2;
+	mRootEntries = 112;
+	mTotalSectors = 1440;
+	mMedia = 0xf9;
+	mSectorsPerFat = 3;
+}
+
+/// ブートセクタから読む
+/// @param[in] boot ブートセクタ (0x1eバイト以上)
+void MsxDiskBpb::Read(const wxUint8 *boot)
+{
+	mBytesPerSector = msxdisk_le16(&boot[0x0b]);
+	mSectorsPerCluster = boot[0x0d];
+	mReservedSectors = msxdisk_le16(&boot[0x0e]);
+	mFats = boot[0x10];
+	mRootEntries = msxdisk_le16(&boot[0x11]);
+	mTotalSectors = msxdisk_le16(&boot[0x13]);
+	mMedia = boot[0x15];
+	mSectorsPerFat = msxdisk_le16(&boot[0x16]);
+}
+
+/// 正しい値か
+/// @param[in] file_size イメージの長さ
+bool MsxDiskBpb::IsValid(size_t file_size) const
+{
+	if (mBytesPerSector < 128 || mBytesPerSector > 1024 || !msxdisk_is_pow2(mBytesPerSector)) return false;
+	if (!msxdisk_is_pow2(mSectorsPerCluster) || mSectorsPerCluster > 128) return false;
+	if (mReservedSectors < 1 || mFats < 1 || mFats > 4) return false;
+	if (mRootEntries <= 0 || mTotalSectors <= 0 || mSectorsPerFat <= 0) return false;
+	if (mMedia < 0xf0) return false;
+	size_t disk_size = (size_t)mTotalSectors * mBytesPerSector;
+	if (disk_size > file_size || GetDataPos() >= disk_size) return false;
+	return (GetClusterCount() > 0 && GetClusterCount() <= MSXDISK_FAT_SIZE - 2);
+}
+
+/// BPBがないイメージの構成をイメージの長さから決める
+///
+/// MSX-DOS 1の既定値で、720KB(2DD)と360KB(1DD)に対応する。
+/// @param[in] file_size イメージの長さ
+/// @return 対応していない長さの場合false
+bool MsxDiskBpb::SetDefault(size_t file_size)
+{
+	*this = MsxDiskBpb();
+	if (file_size == 368640) {
+		mTotalSectors = 720;
+		mMedia = 0xf8;
+		mSectorsPerFat = 2;
+		return true;
+	}
+	return (file_size == 737280);
+}
+
+/// FATの位置
+/// @param[in] idx FATの番号
+size_t MsxDiskBpb::GetFatPos(int idx) const
+{
+	return (size_t)(mReservedSectors + idx * mSectorsPerFat) * mBytesPerSector;
+}
+
+/// ルートディレクトリの位置
+size_t MsxDiskBpb::GetRootPos() const
+{
+	return GetFatPos(mFats);
+}
+
+/// データ領域の位置
+size_t MsxDiskBpb::GetDataPos() const
+{
+	size_t root_len = (size_t)mRootEntries * MSXDISK_ENTRY_SIZE;
+	root_len = (root_len + mBytesPerSector - 1) / mBytesPerSector * mBytesPerSector;
+	return GetRootPos() + root_len;
+}
+
+/// クラスタの長さ
+size_t MsxDiskBpb::GetClusterSize() const
+{
+	return (size_t)mSectorsPerCluster * mBytesPerSector;
+}
+
+/// クラスタ数
+int MsxDiskBpb::GetClusterCount() const
+{
+	size_t disk_size = (size_t)mTotalSectors * mBytesPerSector;
+	size_t data_pos = GetDataPos();
+	if (data_pos >= disk_size) {
+		return 0;
+	}
+	return (int)((disk_size - data_pos) / GetClusterSize());
+}
+
+//////////////////////////////////////////////////////////////////////
+
+MsxDisk::MsxDisk()
+{
+	memset(mFat, 0, sizeof(mFat));
+	mClusters = 0;
+}
+
+/// MSX-DOSのディスクイメージか
+///
+/// ブートセクタのジャンプ命令を見て、BPBが正しいかBPBがなくても既定の長さなら対象とする。
+/// @param[in] data      ファイルの先頭
+/// @param[in] len       長さ
+/// @param[in] file_size ファイルの長さ
+bool MsxDisk::IsMsxDisk(const wxUint8 *data, size_t len, size_t file_size)
+{
+	if (len < 0x1e || (data[0] != 0xeb && data[0] != 0xe9)) {
+		return false;
+	}
+	MsxDiskBpb bpb;
+	bpb.Read(data);
+	if (bpb.IsValid(file_size)) {
+		return true;
+	}
+	return bpb.SetDefault(file_size);
+}
+
+/// 開く
+/// @param[in] path     イメージのファイル
+/// @param[in] writable 書き込みもする
+/// @return MSX-DOSのディスクでない場合false
+bool MsxDisk::Open(const wxString &path, bool writable)
+{
+	Close();
+	if (!mFile.Open(path, writable)) {
+		return false;
+	}
+	const wxUint8 *data = mFile.GetData();
+	size_t size = mFile.GetSize();
+	if (!IsMsxDisk(data, size, size)) {
+		Close();
+		return false;
+	}
+	mBpb.Read(data);
+	if (!mBpb.IsValid(size)) {
+		// BPBがないときはFATの先頭のメディアの種類で確かめる
+		mBpb.SetDefault(size);
+		if (data[mBpb.GetFatPos(0)] != mBpb.mMedia) {
+			Close();
+			return false;
+		}
+	}
+	if (!ReadFat() || !ReadDirectory()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+/// 閉じる
+void MsxDisk::Close()
+{
+	mFile.Close();
+	mBpb = MsxDiskBpb();
+	memset(mFat, 0, sizeof(mFat));
+	mClusters = 0;
+	mFiles.SetDataLen(0);
+}
+
+/// FATを読む
+///
+/// 最初のFATを12ビットずつ展開しておく。
+/// @return FATがクラスタ数に足りない場合false
+bool MsxDisk::ReadFat()
+{
+	mClusters = mBpb.GetClusterCount() + 2;
+	size_t fat_len = (size_t)mBpb.mSectorsPerFat * mBpb.mBytesPerSector;
+	if ((size_t)mClusters * 3 / 2 + 2 > fat_len) {
+		return false;
+	}
+	const wxUint8 *p = mFile.GetData() + mBpb.GetFatPos(0);
+	for(int n = 0; n < mClusters; n++) {
+		wxUint16 val = msxdisk_le16(&p[n * 3 / 2]);
+		mFat[n] = ((n & 1) ? (val >> 4) : (val & 0xfff));
+	}
+	return true;
+}
+
+/// ルートディレクトリを読む
+///
+/// 先頭が00のエントリで終わり、E5のエントリは削除されたものとして飛ばす。
+/// ボリュームラベルとサブディレクトリは一覧に入れない。
+/// @return 常にtrue
+bool MsxDisk::ReadDirectory()
+{
+	mFiles.SetDataLen(0);
+
+	const wxUint8 *p = mFile.GetData() + mBpb.GetRootPos();
+	MsxDiskFile file;
+	for(int entry = 0; entry < mBpb.mRootEntries; entry++) {
+		const wxUint8 *e = &p[entry * MSXDISK_ENTRY_SIZE];
+		if (e[0] == 0x00) {
+			break;
+		}
+		if (e[0] == 0xe5 || (e[0x0b] & (MSXDISK_ATTR_VOLUME | MSXDISK_ATTR_DIR)) != 0) {
+			continue;
+		}
+		memset(&file, 0, sizeof(file));
+		memcpy(file.raw_name, e, MSXDISK_NAME_LEN + MSXDISK_EXT_LEN);
+		file.attr = e[0x0b];
+		file.entry = entry;
+		file.first_cluster = msxdisk_le16(&e[0x1a]);
+		file.size = (size_t)msxdisk_le16(&e[0x1c]) | ((size_t)msxdisk_le16(&e[0x1e]) << 16);
+		CountFile(file);
+		mFiles.AppendData(&file, sizeof(file));
+	}
+	return true;
+}
+
+/// ファイルのクラスタを数えて種類を決める
+/// @param[in,out] file ファイル
+void MsxDisk::CountFile(MsxDiskFile &file) const
+{
+	int cluster = file.first_cluster;
+	bool ended = (file.size == 0 && cluster == 0);
+	while(!ended) {
+		if (cluster < 2 || cluster >= mClusters || file.clusters >= mClusters - 2) {
+			// 範囲外か循環している
+			file.broken = true;
+			break;
+		}
+		file.clusters++;
+		int next = mFat[cluster];
+		if (next >= MSXDISK_FAT_LAST) {
+			ended = true;
+		}
+		cluster = next;
+	}
+	if ((size_t)file.clusters * mBpb.GetClusterSize() < file.size) {
+		file.broken = true;
+	}
+
+	file.file_type = MSXDISK_OTHER;
+	if (file.size > 0 && file.clusters > 0) {
+		wxUint8 c = mFile.GetData()[GetClusterPos(file.first_cluster)];
+		if (c == 0xff) {
+			file.file_type = MSXDISK_BASIC;
+		} else if (c == 0xfe) {
+			file.file_type = MSXDISK_MACHINE;
+		} else if (c >= 0x20 || c == 0x09 || c == 0x0a || c == 0x0d) {
+			file.file_type = MSXDISK_ASCII;
+		}
+	}
+}
+
+/// クラスタの位置
+size_t MsxDisk::GetClusterPos(int cluster) const
+{
+	return mBpb.GetDataPos() + (size_t)(cluster - 2) * mBpb.GetClusterSize();
+}
+
+/// ファイルを返す
+const MsxDiskFile &MsxDisk::Item(size_t idx) const
+{
+	wxASSERT(idx < Count());
+	return ((const MsxDiskFile *)mFiles.GetData())[idx];
+}
+
+/// 表示用のファイル名
+/// @return 名前.拡張子 拡張子が空白のときは名前だけ
+wxString MsxDisk::GetName(size_t idx) const
+{
+	const MsxDiskFile &file = Item(idx);
+	wxString name = wxString::From8BitData((const char *)file.raw_name, MSXDISK_NAME_LEN);
+	wxString ext = wxString::From8BitData((const char *)&file.raw_name[MSXDISK_NAME_LEN], MSXDISK_EXT_LEN);
+	name.Trim();
+	ext.Trim();
+	if (!ext.IsEmpty()) {
+		name += _T(".");
+		name += ext;
+	}
+	return name;
+}
+
+/// 最初のBASICのファイル
+/// @return ファイルの番号 ないとき-1
+int MsxDisk::FindBasic() const
+{
+	for(size_t i = 0; i < Count(); i++) {
+		const MsxDiskFile &file = Item(i);
+		if (!file.broken && (file.file_type == MSXDISK_BASIC || file.file_type == MSXDISK_ASCII)) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/// 空きクラスタ数
+int MsxDisk::GetFreeClusters() const
+{
+	int count = 0;
+	for(int i = 2; i < mClusters; i++) {
+		if (mFat[i] == MSXDISK_FAT_FREE) count++;
+	}
+	return count;
+}
+
+/// ファイルのデータを書き出す
+///
+/// 番号が続いているクラスタはイメージ上でも連続しているので、まとめて1回で書く。
+/// @param[in]  idx ファイルの番号
+/// @param[out] out 出力先
+/// @return 書いたバイト数
+size_t MsxDisk::Write(size_t idx, PsFileOutput &out) const
+{
+	const MsxDiskFile &file = Item(idx);
+	const wxUint8 *data = mFile.GetData();
+	size_t csize = mBpb.GetClusterSize();
+	size_t remain = file.size;
+	int cluster = file.first_cluster;
+	while(remain > 0 && cluster >= 2 && cluster < mClusters) {
+		int start = cluster;
+		size_t run = csize;
+		while(run < remain && mFat[cluster] == cluster + 1 && cluster + 1 < mClusters) {
+			cluster++;
+			run += csize;
+		}
+		size_t len = (run < remain ? run : remain);
+		if (out.Write(&data[GetClusterPos(start)], len) != len) {
+			break;
+		}
+		remain -= len;
+		cluster = mFat[cluster];
+	}
+	return file.size - remain;
+}
+
+/// ファイルのデータをファイルに書く
+/// @param[in] idx  ファイルの番号
+/// @param[in] path 出力先
+/// @return 書けなかった場合false
+bool MsxDisk::ExtractTo(size_t idx, const wxString &path) const
+{
+	wxFile file;
+	if (!file.Create(path, true)) {
+		return false;
+	}
+	PsFileFsOutput out(file);
+	return (Write(idx, out) == Item(idx).size);
+}
+
+/// ファイル名と拡張子からディレクトリのファイル名を作る
+///
+/// 英小文字は大文字にし、足りない分は空白で埋める。
+/// @param[in]  name     ファイル名 (8ビットの文字)
+/// @param[in]  ext      拡張子
+/// @param[out] raw_name ディレクトリのファイル名 (11バイト)
+void MsxDisk::MakeRawName(const wxString &name, const wxString &ext, wxUint8 *raw_name)
+{
+	memset(raw_name, ' ', MSXDISK_NAME_LEN + MSXDISK_EXT_LEN);
+	for(size_t i = 0; i < name.Len() && i < MSXDISK_NAME_LEN; i++) {
+		wxUint8 c = (wxUint8)(name[i].GetValue() & 0xff);
+		if (c >= 'a' && c <= 'z') c -= 0x20;
+		raw_name[i] = c;
+	}
+	for(size_t i = 0; i < ext.Len() && i < MSXDISK_EXT_LEN; i++) {
+		wxUint8 c = (wxUint8)(ext[i].GetValue() & 0xff);
+		if (c >= 'a' && c <= 'z') c -= 0x20;
+		raw_name[MSXDISK_NAME_LEN + i] = c;
+	}
+	// 先頭のE5は05で表す
+	if (raw_name[0] == 0xe5) raw_name[0] = 0x05;
+}
+
+/// ファイル名で探す
+/// @param[in] raw_name ディレクトリのファイル名 (11バイト)
+/// @return ファイルの番号 ないとき-1
+int MsxDisk::FindFile(const wxUint8 *raw_name) const
+{
+	for(size_t i = 0; i < Count(); i++) {
+		if (memcmp(Item(i).raw_name, raw_name, MSXDISK_NAME_LEN + MSXDISK_EXT_LEN) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/// ファイルに必要なクラスタ数
+/// @param[in] len データの長さ
+int MsxDisk::GetRequiredClusters(size_t len) const
+{
+	size_t csize = mBpb.GetClusterSize();
+	return (int)((len + csize - 1) / csize);
+}
+
+/// ファイルのクラスタを解放する
+///
+/// FATのつながりが壊れているファイルは解放しない。
+/// @param[in]     file ファイル
+/// @param[in,out] fat  FAT
+void MsxDisk::FreeChain(const MsxDiskFile &file, wxUint16 *fat) const
+{
+	if (file.broken) {
+		return;
+	}
+	int cluster = file.first_cluster;
+	for(int c = 0; c < file.clusters && cluster >= 2 && cluster < mClusters; c++) {
+		int next = fat[cluster];
+		fat[cluster] = MSXDISK_FAT_FREE;
+		cluster = next;
+	}
+}
+
+/// 空いているエントリを探す
+/// @return エントリの番号 ないとき-1
+int MsxDisk::FindFreeEntry() const
+{
+	const wxUint8 *p = mFile.GetData() + mBpb.GetRootPos();
+	for(int entry = 0; entry < mBpb.mRootEntries; entry++) {
+		wxUint8 c = p[entry * MSXDISK_ENTRY_SIZE];
+		if (c == 0x00 || c == 0xe5) {
+			return entry;
+		}
+	}
+	return -1;
+}
+
+/// FATを書く
+///
+/// 12ビットに詰めなおし、最初のFATと内容が変わったセクタだけをすべてのFATに書く。
+/// @param[in] fat FAT
+/// @return 書けなかった場合false
+bool MsxDisk::WriteFat(const wxUint16 *fat)
+{
+	size_t bps = (size_t)mBpb.mBytesPerSector;
+	size_t fat_len = (size_t)mBpb.mSectorsPerFat * bps;
+	const wxUint8 *cur = mFile.GetData() + mBpb.GetFatPos(0);
+
+	wxMemoryBuffer buf;
+	wxUint8 *p = (wxUint8 *)buf.GetWriteBuf(fat_len);
+	memcpy(p, cur, fat_len);
+	for(int n = 2; n < mClusters; n++) {
+		wxUint8 *q = &p[n * 3 / 2];
+		wxUint16 val = msxdisk_le16(q);
+		if (n & 1) {
+			val = (wxUint16)((val & 0x000f) | ((fat[n] & 0xfff) << 4));
+		} else {
+			val = (wxUint16)((val & 0xf000) | (fat[n] & 0xfff));
+		}
+		msxdisk_set_le16(q, val);
+	}
+	buf.UngetWriteBuf(fat_len);
+
+	for(size_t pos = 0; pos < fat_len; pos += bps) {
+		if (memcmp(&p[pos], &cur[pos], bps) == 0) {
+			continue;
+		}
+		for(int i = mBpb.mFats - 1; i >= 0; i--) {
+			// 最初のFATは比べるのに使うので最後に書く
+			if (!mFile.WriteAt(mBpb.GetFatPos(i) + pos, &p[pos], bps)) {
+				return false;
+			}
+		}
+	}
+	memcpy(mFat, fat, sizeof(mFat));
+	return true;
+}
+
+/// ファイルを書き込む
+///
+/// 同じ名前のファイルがあればそのエントリを使って置き換える。
+/// 空きクラスタは先頭から順に使い、置き換えるファイルのクラスタは最後に使う。
+/// @param[in] raw_name ディレクトリのファイル名 (11バイト)
+/// @param[in] data     データ
+/// @param[in] len      長さ
+/// @return 空きがないか書けなかった場合false
+bool MsxDisk::SaveFile(const wxUint8 *raw_name, const wxUint8 *data, size_t len)
+{
+	if (!mFile.IsWritable()) {
+		return false;
+	}
+	wxUint16 fat[MSXDISK_FAT_SIZE];
+	memcpy(fat, mFat, sizeof(fat));
+
+	// 置き換えるファイルのクラスタを空ける
+	int idx = FindFile(raw_name);
+	int entry;
+	if (idx >= 0) {
+		FreeChain(Item(idx), fat);
+		entry = Item(idx).entry;
+	} else {
+		entry = FindFreeEntry();
+		if (entry < 0) {
+			return false;
+		}
+	}
+
+	// クラスタを割り当てる
+	int need = GetRequiredClusters(len);
+	wxMemoryBuffer chain_buf;
+	int *chain = (int *)chain_buf.GetWriteBuf(sizeof(int) * (need + 1));
+	int count = 0;
+	for(int i = 2; i < mClusters && count < need; i++) {
+		if (mFat[i] == MSXDISK_FAT_FREE) {
+			chain[count++] = i;
+		}
+	}
+	for(int i = 2; i < mClusters && count < need; i++) {
+		if (fat[i] == MSXDISK_FAT_FREE && mFat[i] != MSXDISK_FAT_FREE) {
+			chain[count++] = i;
+		}
+	}
+	if (count < need) {
+		return false;
+	}
+	for(int i = 0; i < count; i++) {
+		fat[chain[i]] = (wxUint16)(i + 1 < count ? chain[i + 1] : 0xfff);
+	}
+
+	// データを書く 続いているクラスタはまとめて書く
+	size_t csize = mBpb.GetClusterSize();
+	size_t pos = 0;
+	for(int i = 0; i < count; ) {
+		int start = i;
+		while(i + 1 < count && chain[i + 1] == chain[i] + 1) i++;
+		i++;
+		size_t run = (size_t)(i - start) * csize;
+		if (run > len - pos) run = len - pos;
+		if (!mFile.WriteAt(GetClusterPos(chain[start]), &data[pos], run)) {
+			return false;
+		}
+		pos += run;
+	}
+
+	// FATを書く
+	if (!WriteFat(fat)) {
+		return false;
+	}
+
+	// ディレクトリを書く
+	size_t epos = mBpb.GetRootPos() + (size_t)entry * MSXDISK_ENTRY_SIZE;
+	wxUint8 e[MSXDISK_ENTRY_SIZE];
+	if (idx >= 0) {
+		memcpy(e, mFile.GetData() + epos, sizeof(e));
+	} else {
+		memset(e, 0, sizeof(e));
+	}
+	memcpy(e, raw_name, MSXDISK_NAME_LEN + MSXDISK_EXT_LEN);
+	wxDateTime now = wxDateTime::Now();
+	msxdisk_set_le16(&e[0x16], (now.GetHour() << 11) | (now.GetMinute() << 5) | (now.GetSecond() / 2));
+	msxdisk_set_le16(&e[0x18], ((now.GetYear() - 1980) << 9) | (((int)now.GetMonth() + 1) << 5) | now.GetDay());
+	msxdisk_set_le16(&e[0x1a], count > 0 ? chain[0] : 0);
+	msxdisk_set_le16(&e[0x1c], (wxUint32)(len & 0xffff));
+	msxdisk_set_le16(&e[0x1e], (wxUint32)((len >> 16) & 0xffff));
+	if (!mFile.WriteAt(epos, e, sizeof(e))) {
+		return false;
+	}
+	return ReadDirectory();
+}
+
+/// ファイルを削除する
+///
+/// エントリの先頭をE5にしてクラスタを空ける。
+/// @param[in] idx ファイルの番号
+/// @return 書けなかった場合false
+bool MsxDisk::DeleteFile(size_t idx)
+{
+	if (!mFile.IsWritable()) {
+		return false;
+	}
+	const MsxDiskFile &file = Item(idx);
+	wxUint16 fat[MSXDISK_FAT_SIZE];
+	memcpy(fat, mFat, sizeof(fat));
+	FreeChain(file, fat);
+
+	static const wxUint8 deleted = 0xe5;
+	if (!mFile.WriteAt(mBpb.GetRootPos() + (size_t)file.entry * MSXDISK_ENTRY_SIZE, &deleted, 1)) {
+		return false;
+	}
+	if (!WriteFat(fat)) {
+		return false;
+	}
+	return ReadDirectory();
+}
+
+/// 同じ名前のファイルを置き換えると空くクラスタ数
+/// @param[in] name ファイル名
+/// @param[in] ext  拡張子
+/// @return クラスタ数 ないかFATが壊れている場合0
+int MsxDisk::GetReplacedClusters(const wxString &name, const wxString &ext) const
+{
+	wxUint8 raw_name[MSXDISK_NAME_LEN + MSXDISK_EXT_LEN];
+	MakeRawName(name, ext, raw_name);
+	int idx = FindFile(raw_name);
+	if (idx < 0 || Item(idx).broken) {
+		return 0;
+	}
+	return Item(idx).clusters;
+}
+
+/// BASICのファイルを書き込む
+///
+/// 同じ名前のファイルがあれば置き換える。
+/// 中間言語とアスキー形式はデータの先頭で区別するので形式は使わない。
+/// @param[in] name  ファイル名
+/// @param[in] ext   拡張子
+/// @param[in] data  データ
+/// @param[in] len   データの長さ
+/// @param[in] ascii アスキー形式か
+/// @return 書けなかった場合false
+bool MsxDisk::SaveBasicFile(const wxString &name, const wxString &ext, const wxUint8 *data, size_t len, bool WXUNUSED(ascii))
+{
+	wxUint8 raw_name[MSXDISK_NAME_LEN + MSXDISK_EXT_LEN];
+	MakeRawName(name, ext, raw_name);
+	return SaveFile(raw_name, data, len);
+}
@@ -0,0 +1,175 @@
+﻿/// @file msxdisk.h
+///
+/// @brief MSX-DOS(FAT12)のディスクイメージ
+///
+///
+#ifndef _MSXDISK_H_
+#define _MSXDISK_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include "fileinfo.h"
+#include "diskimage.h"
+
+/// ディレクトリのエントリの長さ
+#define MSXDISK_ENTRY_SIZE		32
+/// ファイル名の長さ
+#define MSXDISK_NAME_LEN		8
+/// 拡張子の長さ
+#define MSXDISK_EXT_LEN			3
+/// FAT12の最大クラスタ番号+1
+#define MSXDISK_FAT_SIZE		4086
+
+/// ファイルの種類
+enum enMsxDiskFileTypes {
+	MSXDISK_BASIC = 0,	///< 中間言語 (先頭がFF)
+	MSXDISK_ASCII,		///< アスキー形式
+	MSXDISK_MACHINE,	///< 機械語 (先頭がFE)
+	MSXDISK_OTHER		///< その他
+};
+
+/// ディレクトリエントリの属性
+enum enMsxDiskAttrs {
+	MSXDISK_ATTR_READONLY = 0x01,
+	MSXDISK_ATTR_HIDDEN = 0x02,
+	MSXDISK_ATTR_SYSTEM = 0x04,
+	MSXDISK_ATTR_VOLUME = 0x08,
+	MSXDISK_ATTR_DIR = 0x10,
+	MSXDISK_ATTR_ARCHIVE = 0x20
+};
+
+/// FATの値
+enum enMsxDiskFatValues {
+	MSXDISK_FAT_FREE = 0x000,	///< 未使用
+	MSXDISK_FAT_BAD = 0xff7,	///< 不良クラスタ
+	MSXDISK_FAT_LAST = 0xff8	///< これ以上は最後のクラスタ
+};
+
+/// ブートセクタのディスクの構成 (BPB)
+class MsxDiskBpb
+{
+public:
+	int mBytesPerSector;	///< セクタの長さ
+	int mSectorsPerCluster;	///< 1クラスタのセクタ数
+	int mReservedSectors;	///< 予約セクタ数
+	int mFats;				///< FATの数
+	int mRootEntries;		///< ルートディレクトリのエントリ数
+	int mTotalSectors;		///< 総セクタ数
+	int mMedia;				///< メディアの種類
+	int mSectorsPerFat;		///< 1つのFATのセクタ数
+
+	MsxDiskBpb();
+
+	/// ブートセクタから読む
+	void Read(const wxUint8 *boot);
+	/// 正しい値か
+	bool IsValid(size_t file_size) const;
+	/// BPBがないイメージの構成をイメージの長さから決める
+	bool SetDefault(size_t file_size);
+
+	/// FATの位置
+	size_t GetFatPos(int idx) const;
+	/// ルートディレクトリの位置
+	size_t GetRootPos() const;
+	/// データ領域の位置
+	size_t GetDataPos() const;
+	/// クラスタの長さ
+	size_t GetClusterSize() const;
+	/// クラスタ数
+	int GetClusterCount() const;
+};
+
+/// ディスク内のファイル
+typedef struct st_msxdisk_file {
+	wxUint8 raw_name[MSXDISK_NAME_LEN + MSXDISK_EXT_LEN];	///< ファイル名と拡張子
+	int    attr;			///< 属性 enMsxDiskAttrs
+	int    entry;			///< ルートディレクトリのエントリの番号
+	int    first_cluster;	///< 最初のクラスタ
+	int    clusters;		///< 使用クラスタ数
+	size_t size;			///< ファイルの長さ
+	int    file_type;		///< 種類 enMsxDiskFileTypes
+	bool   broken;			///< FATのつながりが壊れているか長さが足りない
+} MsxDiskFile;
+
+/// MSX-DOS(FAT12)のディスクイメージ
+///
+/// 720KBなどのベタのイメージを扱う。開いたときにブートセクタ、FAT、ルートディレクトリを
+/// 読んでおき、ファイルのデータはマップしたイメージから連続するクラスタごとに直接書き出す。
+/// 書き込むときはデータ、変わったFATのセクタ、ディレクトリのエントリだけを書く。
+class MsxDisk : public DiskBasicFiles
+{
+private:
+	DiskImageFile mFile;	///< イメージ
+	MsxDiskBpb mBpb;		///< ディスクの構成
+	wxUint16 mFat[MSXDISK_FAT_SIZE];	///< FAT
+	int mClusters;			///< FATの最大クラスタ番号+1
+	wxMemoryBuffer mFiles;	///< MsxDiskFile の並び
+
+	/// FATを読む
+	bool ReadFat();
+	/// ルートディレクトリを読む
+	bool ReadDirectory();
+	/// ファイルのクラスタを数えて種類を決める
+	void CountFile(MsxDiskFile &file) const;
+	/// クラスタの位置
+	size_t GetClusterPos(int cluster) const;
+	/// ファイルのクラスタを解放する
+	void FreeChain(const MsxDiskFile &file, wxUint16 *fat) const;
+	/// 空いているエントリを探す
+	int FindFreeEntry() const;
+	/// FATを書く
+	bool WriteFat(const wxUint16 *fat);
+
+public:
+	MsxDisk();
+	~MsxDisk() {}
+
+	/// MSX-DOSのディスクイメージか
+	static bool IsMsxDisk(const wxUint8 *data, size_t len, size_t file_size);
+
+	/// 開く
+	bool Open(const wxString &path, bool writable = false);
+	/// 閉じる
+	void Close();
+
+	const MsxDiskBpb &GetBpb() const { return mBpb; }
+	DiskImageFile &GetFile() { return mFile; }
+
+	size_t Count() const { return mFiles.GetDataLen() / sizeof(MsxDiskFile); }
+	const MsxDiskFile &Item(size_t idx) const;
+	const MsxDiskFile &operator[](size_t idx) const { return Item(idx); }
+	/// 表示用のファイル名
+	wxString GetName(size_t idx) const;
+	/// 最初のBASICのファイル
+	int FindBasic() const;
+	/// 空きクラスタ数
+	int GetFreeClusters() const;
+	int GetClusterCount() const { return mClusters - 2; }
+
+	/// ファイルのデータを書き出す
+	size_t Write(size_t idx, PsFileOutput &out) const;
+	/// ファイルのデータをファイルに書く
+	bool ExtractTo(size_t idx, const wxString &path) const;
+
+	/// ファイル名と拡張子からディレクトリのファイル名を作る
+	static void MakeRawName(const wxString &name, const wxString &ext, wxUint8 *raw_name);
+	/// ファイル名で探す
+	int FindFile(const wxUint8 *raw_name) const;
+	/// ファイルに必要なクラスタ数
+	int GetRequiredClusters(size_t len) const;
+	/// ファイルを書き込む 同じ名前のファイルがあれば置き換える
+	bool SaveFile(const wxUint8 *raw_name, const wxUint8 *data, size_t len);
+	/// ファイルを削除する
+	bool DeleteFile(size_t idx);
+
+	/// 同じ名前のファイルを置き換えると空くクラスタ数
+	int GetReplacedClusters(const wxString &name, const wxString &ext) const;
+	/// BASICのファイルに必要なクラスタ数 形式によらない
+	int GetRequiredBasicClusters(size_t len, bool WXUNUSED(ascii)) const { return GetRequiredClusters(len); }
+	/// BASICのファイルを書き込む 形式はデータの先頭で決まる
+	bool SaveBasicFile(const wxString &name, const wxString &ext, const wxUint8 *data, size_t len, bool ascii);
+
+	DECLARE_NO_COPY_CLASS(MsxDisk)
+};
+
+#endif /* _MSXDISK_H_ */
@@ -0,0 +1,280 @@
+﻿/// @file msxtape.cpp
+///
+/// @brief MSXのテープイメージ(fMSXの.cas)のブロック
+///
+///
+#include "msxtape.h"
+#include <wx/file.h>
+#include <string.h>
+
+/// ファイルヘッダの種類 (enMsxTapeFileTypes の順)
+static const char *cMsxTapeTypes[] = { CAS_HEADER_BASIC, CAS_HEADER_ASCII, CAS_HEADER_MACHINE };
+
+/// 区切りを探す
+/// @param[in] data 検索範囲の先頭
+/// @param[in] len  検索範囲の長さ
+/// @return 区切りの先頭 ないときNULL
+const wxUint8 *MsxTapeBlocks::FindSeparator(const wxUint8 *data, size_t len)
+{
+	if (len < MSXTAPE_SEP_LEN) {
+		return NULL;
+	}
+	wxUint64 sep;
+	memcpy(&sep, FMSX_HEADER, sizeof(sep));
+
+	const wxUint8 *p = data;
+	const wxUint8 *last = data + len - MSXTAPE_SEP_LEN;
+	while(p <= last) {
+		p = (const wxUint8 *)memchr(p, (wxUint8)FMSX_HEADER[0], last - p + 1);
+		if (!p) {
+			break;
+		}
+		wxUint64 val;
+		memcpy(&val, p, sizeof(val));
+		if (val == sep) {
+			return p;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+/// イメージ全体のブロックを探す
+///
+/// 区切りから次の区切りまでを1ブロックとする。最初の区切りの前は含めない。
+/// @param[in] data イメージ
+/// @param[in] len  イメージの長さ
+/// @return ブロック数
+size_t MsxTapeBlocks::Scan(const wxUint8 *data, size_t len)
+{
+	Clear();
+
+	MsxTapeBlock block;
+	const wxUint8 *p = FindSeparator(data, len);
+	while(p) {
+		block.offset = (size_t)(p - data);
+		block.data_pos = block.offset + MSXTAPE_SEP_LEN;
+		p = FindSeparator(data + block.data_pos, len - block.data_pos);
+		block.length = (p ? (size_t)(p - data) : len) - block.data_pos;
+		mBlocks.AppendData(&block, sizeof(block));
+	}
+	return Count();
+}
+
+/// ブロックを返す
+const MsxTapeBlock &MsxTapeBlocks::Item(size_t idx) const
+{
+	wxASSERT(idx < Count());
+	return ((const MsxTapeBlock *)mBlocks.GetData())[idx];
+}
+
+//////////////////////////////////////////////////////////////////////
+
+MsxTapeArchive::MsxTapeArchive()
+{
+	mOrphans = 0;
+}
+
+/// ファイルを読み込んで一覧を作る
+/// @param[in] path イメージのファイル
+/// @return 読めなかった場合false
+bool MsxTapeArchive::Open(const wxString &path)
+{
+	wxFile file;
+	if (!file.Open(path)) {
+		return false;
+	}
+	wxFileOffset len = file.Length();
+	if (len == wxInvalidOffset) {
+		return false;
+	}
+	mImage.SetDataLen(0);
+	void *buf = mImage.GetAppendBuf((size_t)len);
+	ssize_t rlen = file.Read(buf, (size_t)len);
+	if (rlen == wxInvalidOffset || (wxFileOffset)rlen != len) {
+		// 途中までしか読めない
+		mImage.SetDataLen(0);
+		return false;
+	}
+	mImage.UngetAppendBuf((size_t)rlen);
+	Index();
+	return true;
+}
+
+/// ストリームから読み込んで一覧を作る
+/// @param[in] in_data イメージ
+/// @return ファイル数
+size_t MsxTapeArchive::Load(PsFileInput &in_data)
+{
+	mImage.SetDataLen(0);
+	in_data.ReadAll(mImage);
+	return Index();
+}
+
+/// メモリ上のイメージから一覧を作る
+/// @param[in] data イメージ
+/// @param[in] len  イメージの長さ
+/// @return ファイル数
+size_t MsxTapeArchive::SetImage(const wxUint8 *data, size_t len)
+{
+	mImage.SetDataLen(0);
+	mImage.AppendData(data, len);
+	return Index();
+}
+
+/// ファイルヘッダの種類
+/// @param[in] data ブロックのデータ
+/// @param[in] len  ブロックの長さ
+/// @return enMsxTapeFileTypes ファイルヘッダでなければ-1
+int MsxTapeArchive::GetHeaderType(const wxUint8 *data, size_t len)
+{
+	if (len < MSXTAPE_TYPE_LEN + MSXTAPE_NAME_LEN) {
+		return -1;
+	}
+	for(int type = 0; type < (int)(sizeof(cMsxTapeTypes) / sizeof(cMsxTapeTypes[0])); type++) {
+		if (memcmp(data, cMsxTapeTypes[type], MSXTAPE_TYPE_LEN) == 0) {
+			return type;
+		}
+	}
+	return -1;
+}
+
+/// 一覧を作る
+/// @return ファイル数
+size_t MsxTapeArchive::Index()
+{
+	const wxUint8 *data = (const wxUint8 *)mImage.GetData();
+	size_t len = mImage.GetDataLen();
+
+	mFiles.SetDataLen(0);
+	mOrphans = 0;
+	mBlocks.Scan(data, len);
+
+	MsxTapeFile file;
+	bool in_file = false;
+	for(size_t i = 0; i < mBlocks.Count(); i++) {
+		const MsxTapeBlock &block = mBlocks[i];
+		const wxUint8 *p = &data[block.data_pos];
+		int type = GetHeaderType(p, block.length);
+		if (type >= 0) {
+			if (in_file) {
+				// データがないまま次のファイル
+				mFiles.AppendData(&file, sizeof(file));
+			}
+			memset(&file, 0, sizeof(file));
+			memcpy(file.raw_name, &p[MSXTAPE_TYPE_LEN], MSXTAPE_NAME_LEN);
+			file.file_type = type;
+			file.header_block = i;
+			file.first_block = i + 1;
+			file.offset = block.offset;
+			in_file = true;
+			continue;
+		}
+		if (!in_file) {
+			mOrphans++;
+			continue;
+		}
+		file.data_blocks++;
+		if (file.file_type == MSXTAPE_ASCII) {
+			const wxUint8 *eof = (const wxUint8 *)memchr(p, 0x1a, block.length);
+			if (!eof) {
+				// 続きがある
+				file.data_len += block.length;
+				continue;
+			}
+			file.data_len += (size_t)(eof - p);
+			file.has_end = true;
+		} else if (file.file_type == MSXTAPE_MACHINE && block.length >= 6) {
+			// 開始、終了アドレスから長さを決める 後ろの詰め物は含めない
+			size_t start = p[0] | (p[1] << 8);
+			size_t end = p[2] | (p[3] << 8);
+			size_t len = 6 + (end >= start ? end - start + 1 : 0);
+			file.data_len = (len < block.length ? len : block.length);
+		} else {
+			file.data_len = block.length;
+		}
+		mFiles.AppendData(&file, sizeof(file));
+		in_file = false;
+	}
+	if (in_file) {
+		// イメージの最後で切れている
+		mFiles.AppendData(&file, sizeof(file));
+	}
+	return Count();
+}
+
+/// ファイルを返す
+const MsxTapeFile &MsxTapeArchive::Item(size_t idx) const
+{
+	wxASSERT(idx < Count());
+	return ((const MsxTapeFile *)mFiles.GetData())[idx];
+}
+
+/// 内部ファイル名
+wxString MsxTapeArchive::GetName(size_t idx) const
+{
+	return wxString::From8BitData((const char *)Item(idx).raw_name, MSXTAPE_NAME_LEN);
+}
+
+/// 最初の中間言語かアスキー形式のファイル
+/// @return ファイルの番号 ないとき-1
+int MsxTapeArchive::FindBasic() const
+{
+	for(size_t i = 0; i < Count(); i++) {
+		if (Item(i).file_type != MSXTAPE_MACHINE) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/// ファイルのデータを書き出す
+///
+/// データブロックをイメージからそのまま書く。アスキー形式は1Aの前までにする。
+/// @param[in]  idx ファイルの番号
+/// @param[out] out 出力先
+/// @return 書いたバイト数
+size_t MsxTapeArchive::Write(size_t idx, PsFileOutput &out) const
+{
+	const MsxTapeFile &file = Item(idx);
+	const wxUint8 *data = (const wxUint8 *)mImage.GetData();
+
+	size_t remain = file.data_len;
+	for(size_t i = file.first_block; i < file.first_block + file.data_blocks && remain > 0; i++) {
+		const MsxTapeBlock &block = mBlocks[i];
+		size_t len = (block.length < remain ? block.length : remain);
+		out.Write(&data[block.data_pos], len);
+		remain -= len;
+	}
+	return file.data_len - remain;
+}
+
+/// ファイルのデータをディスクと同じ形式でファイルに書く
+///
+/// 中間言語は先頭にFF、機械語はFEを付ける。アスキー形式はそのまま書く。
+/// @param[in] idx  ファイルの番号
+/// @param[in] path 出力先
+/// @return 書けなかった場合false
+bool MsxTapeArchive::ExtractTo(size_t idx, const wxString &path) const
+{
+	const MsxTapeFile &file = Item(idx);
+	const wxUint8 *data = (const wxUint8 *)mImage.GetData();
+
+	wxFile out;
+	if (!out.Create(path, true)) {
+		return false;
+	}
+	bool rc = true;
+	if (file.file_type != MSXTAPE_ASCII) {
+		wxUint8 id = (file.file_type == MSXTAPE_BASIC ? 0xff : 0xfe);
+		rc = (out.Write(&id, 1) == 1);
+	}
+	size_t remain = file.data_len;
+	for(size_t i = file.first_block; i < file.first_block + file.data_blocks && remain > 0 && rc; i++) {
+		const MsxTapeBlock &block = mBlocks[i];
+		size_t len = (block.length < remain ? block.length : remain);
+		rc = (out.Write(&data[block.data_pos], len) == len);
+		remain -= len;
+	}
+	return rc;
+}
@@ -0,0 +1,126 @@
+﻿/// @file msxtape.h
+///
+/// @brief MSXのテープイメージ(fMSXの.cas)のブロック
+///
+///
+#ifndef _MSXTAPE_H_
+#define _MSXTAPE_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include "fileinfo.h"
+
+/// casetteヘッダ種類
+#define CAS_HEADER_BASIC	"\xD3\xD3\xD3\xD3\xD3\xD3\xD3\xD3\xD3\xD3"
+#define CAS_HEADER_ASCII	"\xEA\xEA\xEA\xEA\xEA\xEA\xEA\xEA\xEA\xEA"
+#define CAS_HEADER_MACHINE	"\xD0\xD0\xD0\xD0\xD0\xD0\xD0\xD0\xD0\xD0"
+
+/// fMSX-DOS Casetteヘッダ
+#define FMSX_HEADER "\x1F\xA6\xDE\xBA\xCC\x13\x7D\x74"
+
+/// fMSXのブロックの区切り(FMSX_HEADER)の長さ
+#define MSXTAPE_SEP_LEN		8
+/// ファイルヘッダの種類を表す部分(CAS_HEADER_xxx)の長さ
+#define MSXTAPE_TYPE_LEN	10
+/// 内部ファイル名の長さ
+#define MSXTAPE_NAME_LEN	6
+
+/// テープイメージのブロック
+typedef struct st_msxtape_block {
+	size_t offset;		///< 区切りの位置
+	size_t data_pos;	///< データの位置
+	size_t length;		///< 次の区切りかイメージの終わりまでの長さ
+} MsxTapeBlock;
+
+/// テープイメージのファイルの種類
+enum enMsxTapeFileTypes {
+	MSXTAPE_BASIC = 0,		///< 中間言語 (CSAVE)
+	MSXTAPE_ASCII,			///< アスキー形式 (SAVE)
+	MSXTAPE_MACHINE			///< 機械語 (BSAVE)
+};
+
+/// テープイメージのブロックの一覧
+///
+/// メモリ上のイメージ全体から区切り 1F A6 DE BA CC 13 7D 74 を探して位置を記録する。
+/// 先頭の1Fをmemchrで探し、8バイトを1回で比べる。
+class MsxTapeBlocks
+{
+private:
+	wxMemoryBuffer mBlocks;	///< MsxTapeBlock の並び
+
+public:
+	MsxTapeBlocks() {}
+	~MsxTapeBlocks() {}
+
+	/// 区切りを探す
+	static const wxUint8 *FindSeparator(const wxUint8 *data, size_t len);
+	/// イメージ全体のブロックを探す
+	size_t Scan(const wxUint8 *data, size_t len);
+
+	void Clear() { mBlocks.SetDataLen(0); }
+	size_t Count() const { return mBlocks.GetDataLen() / sizeof(MsxTapeBlock); }
+	const MsxTapeBlock &Item(size_t idx) const;
+	const MsxTapeBlock &operator[](size_t idx) const { return Item(idx); }
+};
+
+/// テープイメージ内のファイル
+typedef struct st_msxtape_file {
+	wxUint8 raw_name[MSXTAPE_NAME_LEN];	///< 内部ファイル名
+	int    file_type;		///< ファイル種類 enMsxTapeFileTypes
+	size_t header_block;	///< ファイルヘッダのブロックの番号
+	size_t first_block;		///< 最初のデータブロックの番号
+	size_t data_blocks;		///< データブロック数
+	size_t offset;			///< ファイルヘッダの区切りの位置
+	size_t data_len;		///< データの合計長さ アスキー形式は1Aの前まで
+	bool   has_end;			///< アスキー形式で1Aがある
+} MsxTapeFile;
+
+/// 複数のファイルが入ったテープイメージ
+///
+/// イメージ全体を1回走査してファイルヘッダのブロックごとにデータブロックをまとめる。
+/// 中間言語と機械語はヘッダの次の1ブロック、アスキー形式は1Aがあるブロックまでをデータとする。
+/// 区切りは8バイト境界に置かれるので、中間言語のデータには後ろに0の詰め物が付くことがある。
+/// 取り出すときはイメージ上のデータをそのまま書き出す。
+class MsxTapeArchive
+{
+private:
+	wxMemoryBuffer mImage;	///< イメージ
+	MsxTapeBlocks mBlocks;	///< ブロックの一覧
+	wxMemoryBuffer mFiles;	///< MsxTapeFile の並び
+	size_t mOrphans;		///< どのファイルにも含まれないブロック数
+
+	/// ファイルヘッダの種類
+	static int GetHeaderType(const wxUint8 *data, size_t len);
+
+public:
+	MsxTapeArchive();
+	~MsxTapeArchive() {}
+
+	/// ファイルを読み込んで一覧を作る
+	bool Open(const wxString &path);
+	/// ストリームから読み込んで一覧を作る
+	size_t Load(PsFileInput &in_data);
+	/// メモリ上のイメージから一覧を作る
+	size_t SetImage(const wxUint8 *data, size_t len);
+	/// 一覧を作る
+	size_t Index();
+
+	size_t Count() const { return mFiles.GetDataLen() / sizeof(MsxTapeFile); }
+	const MsxTapeFile &Item(size_t idx) const;
+	const MsxTapeFile &operator[](size_t idx) const { return Item(idx); }
+	const MsxTapeBlocks &GetBlocks() const { return mBlocks; }
+	size_t GetOrphanBlocks() const { return mOrphans; }
+	/// 内部ファイル名
+	wxString GetName(size_t idx) const;
+	/// 最初の中間言語かアスキー形式のファイル
+	int FindBasic() const;
+
+	/// ファイルのデータを書き出す
+	size_t Write(size_t idx, PsFileOutput &out) const;
+	/// ファイルのデータをディスクと同じ形式でファイルに書く
+	bool ExtractTo(size_t idx, const wxString &path) const;
+
+	DECLARE_NO_COPY_CLASS(MsxTapeArchive)
+};
+
+#endif /* _MSXTAPE_H_ */
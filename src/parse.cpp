@@ -9,7 +9,7 @@
 #include <wx/wfstream.h>
 #include <wx/arrimpl.cpp>
 #include "bsstring.h"
-#include "main.h"
+#include "diskimage.h"
 
 #define DATA_DIR _T("data")
 
@@ -43,6 +43,14 @@ Parse::Parse(ParseCollection *collection, ConfigParam *config)
 	mNextAddress = 0;
 	mPrevLineNumber = -1;
 	mMachineType = 0;
+
+	pResultSink = NULL;
+	mResultLimit = -1;
+
+	mIsWorker = false;
+	mHomeCol = 0;
+	mThreadCount = 0;
+	mUsePipeline = false;
 }
 
 Parse::~Parse()
@@ -51,6 +59,25 @@ Parse::~Parse()
 
 /// 初期化
 bool Parse::Init()
+{
+	if (!InitTables()) {
+		return false;
+	}
+
+	// スタートアドレスが範囲外ならクリア
+	if (pConfig->GetStartAddr() >= GetStartAddrCount()) {
+		pConfig->SetStartAddr(0);
+	}
+	if (!pConfig->IsLoaded()) {
+		// 初期設定値をセット
+		SetDefaultConfigParam();
+	}
+
+	return true;
+}
+
+/// 変換表の読み込みと正規表現の設定
+bool Parse::InitTables()
 {
 	// 文字コード変換テーブルの読み込み
 	if (LoadCharCodeTable() != psOK) {
@@ -79,18 +106,24 @@ bool Parse::Init()
 
 	reVariEnd.Compile(_T("[%$#!]"));
 
-	// スタートアドレスが範囲外ならクリア
-	if (pConfig->GetStartAddr() >= GetStartAddrCount()) {
-		pConfig->SetStartAddr(0);
-	}
-	if (!pConfig->IsLoaded()) {
-		// 初期設定値をセット
-		SetDefaultConfigParam();
-	}
-
 	return true;
 }
 
+/// 並列変換用に同じ種類のパーサーを作成
+/// @return 並列変換しない場合NULL
+Parse *Parse::NewWorker() const
+{
+	return NULL;
+}
+
+/// 並列変換のワーカーとして初期化
+/// 設定は呼び出し元と共有するので変更しない
+bool Parse::InitWorker()
+{
+	mIsWorker = true;
+	return InitTables();
+}
+
 /// 指定したファイルを開く
 /// @param[in] in_file_name 入力ファイルのパス
 /// @param[in] file_type 入力ファイルの種類
@@ -157,7 +190,7 @@ bool Parse::CheckBinaryDataFormat(PsFileInput &in_data)
 	}
 
 	mParsedData.Empty();
-	Report(result, mParsedData.GetData());
+	Report(result, mParsedData);
 
 	// UTF-8に変換
 	mParsedData.SetType(out_data);
@@ -219,7 +252,7 @@ bool Parse::CheckAsciiDataFormat(PsFileInput &in_data)
 		}
 		out_data.Empty();
 		st = ParseAsciiToColored(tmp_data, out_data, &result);
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 		mParsedData.SetType(in_data.GetType());
 		mParsedData.SetCharType(out_data.GetCharType());
 		in_data.SetCharType(out_data.GetCharType());
@@ -235,7 +268,7 @@ bool Parse::CheckAsciiDataFormat(PsFileInput &in_data)
 		mParsedData.Empty();
 		ReadAsciiText(in_data, tmp_data, false);
 		st = ParseAsciiToColored(tmp_data, out_data, &result);
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 		// interace 文字に変換する
 		mParsedData.SetTypeFlag(psAscii | psUTF8, true);
 		mParsedData.SetCharType(GetCharType(0));
@@ -392,12 +425,12 @@ bool Parse::ReloadBinaryData(PsFileInput &in_file, PsFileType &out_type)
 		ReadBinaryToAscii(in_file, tmp_data, &result);
 		// 色付け
 		ParseAsciiToColored(tmp_data, out_data, &result);
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 	} else {
 		// 同じBASICのとき
 		// 解析＆色付け
 		ReadBinaryToAsciiColored(in_file, out_data, &result);
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 	}
 	// interace or noninterace 文字に変換する
 	mParsedData.SetType(out_type);
@@ -435,13 +468,13 @@ bool Parse::ReloadAsciiData(PsFileInput &in_file, PsFileType &out_type)
 		ConvUTF8ToAscii(in_data, &tmp_data, &result);
 		out_data.SetType(out_type);
 		ParseAsciiToColored(tmp_data, out_data, &result);
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 	} else {
 		// ASCIIテキスト
 		ReadAsciiText(in_file, in_data, false);
 		out_data.SetType(out_type);
 		ParseAsciiToColored(in_data, out_data, &result);
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 	}
 	// interace or noninterace 文字に変換する
 	mParsedData.SetType(out_type);
@@ -520,18 +553,46 @@ bool Parse::OpenOutFile(const wxString &out_file_name, PsFileType &file_type)
 	return true;
 }
 
+/// 出力先に既存のディスクイメージを指定する
+///
+/// イメージは作り直さず、エクスポート時に中のファイルとして書き込む。
+/// @param[in] image_path     ディスクイメージのパス
+/// @param[in] file_type      出力データの形式 内部ファイル名をファイル名にする
+/// @return true/false
+bool Parse::OpenOutDiskImage(const wxString &image_path, PsFileType &file_type)
+{
+	// 入力ファイルと同じファイルはダメ
+	wxFileName out_file(image_path);
+	if (mInFile.IsSameFile(out_file)) {
+		mErrInfo.SetInfo(__LINE__, psError, pwErrSameFile);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	if (!CanExportDiskImage() || !out_file.FileExists()) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	mOutFile.SetType(file_type);
+	mOutDiskImage = image_path;
+
+	return true;
+}
+
 // 出力ファイルを閉じる
 void Parse::CloseOutFile()
 {
 	if (mOutFile.IsOpened()) {
 		mOutFile.Close();
 	}
+	mOutDiskImage.Empty();
 }
 
 // エクスポート
 bool Parse::ExportData()
 {
 	bool st = false;
+	bool piped = false;
 
 	if (!mInFile.Exist()) {
 		mParsedData.Empty();
@@ -549,6 +610,11 @@ bool Parse::ExportData()
 	in_data.Empty();
 	out_data.Empty();
 	result.Empty();
+	result.SetSink(pResultSink);
+	result.SetLimit(mResultLimit);
+	if (pResultSink) {
+		pResultSink->SetSource(mInFile.GetFileFullPath());
+	}
 
 	mInFile.SeekStartPos();
 
@@ -603,15 +669,20 @@ bool Parse::ExportData()
 	} else {
 		if (mOutFile.GetTypeFlag(psAscii)) {
 			// 中間言語からアスキー形式/UTF-8テキストに変換
-			in_data.SetType(mInFile.GetType());
-			st = ReadBinaryToAscii(mInFile, in_data, &result);
-			if (mOutFile.GetTypeFlag(psUTF8)) {
-				// UTF-8テキストの場合
-				st = ConvAsciiToUTF8(in_data, &out_data);
-			} else {
-				out_data = in_data;
+#ifdef USE_PARSE_PIPELINE
+			piped = ExportBinaryToTextPipeline(&result, st);
+#endif
+			if (!piped) {
+				in_data.SetType(mInFile.GetType());
+				st = ReadBinaryToAscii(mInFile, in_data, &result);
+				if (mOutFile.GetTypeFlag(psUTF8)) {
+					// UTF-8テキストの場合
+					st = ConvAsciiToUTF8(in_data, &out_data);
+				} else {
+					out_data = in_data;
+				}
+				st = WriteText(out_data, out_file);
 			}
-			st = WriteText(out_data, out_file);
 		} else {
 			// 中間言語からアスキー形式にしてまた中間言語に変換
 			mOutFile.SetTypeFlag(psUTF8, false);
@@ -622,24 +693,32 @@ bool Parse::ExportData()
 		}
 	}
 
-	// ファイルに出力
-	PsFileStrInput in_file(out_file);
-	PsFileFsOutput out(mOutFile.GetFile());
-	out.SetType(mOutFile.GetType());
-	if (mOutFile.GetTypeFlag(psTapeImage)) {
-		// テープイメージに変換して出力
-		if (WriteTapeFromRealData(in_file, out)) {
-			// 内部ファイル名を入力側に反映
-			mInFile.SetInternalName(mOutFile.GetInternalName());
+	// ファイルに出力 (パイプラインでは出力済み)
+	if (!piped && !mOutDiskImage.IsEmpty()) {
+		// ディスクイメージの中に書き込む
+		PsFileStrInput in_file(out_file);
+		if (!WriteDiskImageFromRealData(in_file, mOutDiskImage)) {
+			st = false;
+		}
+	} else if (!piped) {
+		PsFileStrInput in_file(out_file);
+		PsFileFsOutput out(mOutFile.GetFile());
+		out.SetType(mOutFile.GetType());
+		if (mOutFile.GetTypeFlag(psTapeImage)) {
+			// テープイメージに変換して出力
+			if (WriteTapeFromRealData(in_file, out)) {
+				// 内部ファイル名を入力側に反映
+				mInFile.SetInternalName(mOutFile.GetInternalName());
+			}
+		} else {
+			// そのまま出力
+			out.Write(in_file);
 		}
-	} else {
-		// そのまま出力
-		out.Write(in_file);
 	}
 
 	mParsedData.Empty();
 	if (result.GetCount() > 0) {
-		Report(result, mParsedData.GetData());
+		Report(result, mParsedData);
 		st = false;
 	} else {
 		mParsedData.Add(_("Complete."));
@@ -648,6 +727,39 @@ bool Parse::ExportData()
 	return st;
 }
 
+#ifdef USE_PARSE_PIPELINE
+/// 中間言語からテキストへのエクスポートをパイプラインで行う
+///
+/// 解析、文字コード変換、出力を段階ごとのスレッドで行い、出力ファイルに直接書く。
+/// テープイメージとディスクイメージへの出力は全体がそろってから変換するので対象外。
+/// @param[in,out] result 結果格納用
+/// @param[out]    rc     解析の結果
+/// @return パイプラインで行わなかった場合false このとき出力ファイルは変更しない
+bool Parse::ExportBinaryToTextPipeline(ParseResult *result, bool &rc)
+{
+	if (!mUsePipeline || mIsWorker || mOutFile.GetTypeFlag(psTapeImage) || !mOutDiskImage.IsEmpty()) {
+		return false;
+	}
+	// 文字コード変換と出力の整形でワーカーを1つずつ使う
+	if (mWorkers.Prepare(this, 2) < 2) {
+		return false;
+	}
+
+	PsFileType in_type;
+	in_type.SetType(mInFile.GetType());
+	PsFileFsOutput out(mOutFile.GetFile());
+	out.SetType(mOutFile.GetType());
+
+	ParsePipeline pipeline(this, mWorkers.Get(0), mWorkers.Get(1), out);
+	if (!pipeline.Run(mInFile, in_type, result, rc)) {
+		return false;
+	}
+	MergeWorkerStats();
+	mPipeStats.Add(pipeline.GetStats());
+	return true;
+}
+#endif
+
 /// 中間言語からアスキー形式テキストに変換
 /// @param[in]  in_file  入力ファイル
 /// @param[out] out_data 変換後データ
@@ -655,8 +767,22 @@ bool Parse::ExportData()
 /// @return true/false
 bool Parse::ReadBinaryToAscii(PsFileInput &in_file, PsFileData &out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE_INPUT(mStats, psStageDecode, in_file);
+
 	mPos.Empty();
 	mPos.SetName(_("Binary->Ascii"));
+	mLineNumbers.Empty();
+
+#ifdef USE_PARSE_PARALLEL
+	size_t start_count = out_data.GetCount();
+	bool parsed = false;
+	bool rc = ReadBinaryToAsciiParallel(in_file, out_data, result, parsed);
+	MergeWorkerStats();
+	if (parsed) {
+		PARSE_STATS_COUNT(0, out_data.GetCount() - start_count);
+		return rc;
+	}
+#endif
 
 	PsSymbolSentence sentence;
 
@@ -669,12 +795,13 @@ bool Parse::ReadBinaryToAscii(PsFileInput &in_file, PsFileData &out_data, ParseR
 		if (phase == PHASE_EOL) {
 			// end of line
 			out_data.Add(sentence.JoinAscStr());
+			PARSE_STATS_COUNT(0, 1);
 
 			// next phase
 			sentence.Empty();
 			phase = PHASE_LINE_NUMBER;
 		}
-		if (result && result->GetCount() > ERROR_STOPPED_COUNT) {
+		if (result && result->IsOverLimit()) {
 			// エラーが多いので中止
 			phase = PHASE_STOPPED;
 			break;
@@ -696,8 +823,11 @@ bool Parse::ReadBinaryToAscii(PsFileInput &in_file, PsFileData &out_data, ParseR
 /// @return true/false
 bool Parse::ReadBinaryToAsciiColored(PsFileInput &in_file, PsFileData &out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE_INPUT(mStats, psStageDecode, in_file);
+
 	mPos.Empty();
 	mPos.SetName(_("Parse Binary"));
+	mLineNumbers.Empty();
 
 	PsSymbolSentence sentence;
 
@@ -712,12 +842,13 @@ bool Parse::ReadBinaryToAsciiColored(PsFileInput &in_file, PsFileData &out_data,
 			wxString body;
 			DecorateSentenceToColored(sentence, body, pConfig->EnableAddSpaceAfterColon());
 			out_data.Add(body);
+			PARSE_STATS_COUNT(0, 1);
 
 			// next phase
 			sentence.Empty();
 			phase = PHASE_LINE_NUMBER;
 		}
-		if (result && result->GetCount() > ERROR_STOPPED_COUNT) {
+		if (result && result->IsOverLimit()) {
 			// エラーが多いので中止
 			phase = PHASE_STOPPED;
 			break;
@@ -733,6 +864,514 @@ bool Parse::ReadBinaryToAsciiColored(PsFileInput &in_file, PsFileData &out_data,
 	return true;
 }
 
+/// 行をまたいで持つ状態をクリア
+void Parse::ResetLineState()
+{
+	mPrevLineNumber = -1;
+}
+
+/// 行頭の行番号の重複と順序をチェック
+/// @note mPosに行、列、行番号をセットしてから呼ぶ
+/// @note ワーカーでは列を覚えるだけで、チェックは呼び出し元で行順に行う
+/// @param[in,out] result 結果格納用
+void Parse::CheckHomeLineNumber(ParseResult *result)
+{
+	if (mIsWorker) {
+		mHomeCol = mPos.mCol;
+		return;
+	}
+	int exists = mLineNumbers.Add(mPos.GetLineNumber(), mPos.mRow);
+	if (exists >= 0){
+		// 同じ行番号がある
+		if (result) result->Add(mPos, prErrDuplicateLineNumber, exists + 1);
+	} else if (exists == LineNumberIndex::LINE_NUMBER_INVALID) {
+		// 16bitに収まらない行番号
+		if (result) result->Add(mPos, prErrInvalidLineNumber);
+	}
+	if (mPos.GetLineNumber() < mPrevLineNumber) {
+		// 行番号が前行より小さい
+		if (result) result->Add(mPos, prErrDiscontLineNumber);
+	}
+	mPrevLineNumber = mPos.GetLineNumber();
+}
+
+/// 中間言語の行番号の重複をチェック
+/// @note mPosに行、列、行番号をセットしてから呼ぶ
+/// @note ワーカーではチェックせず、呼び出し元で行順に行う
+/// @param[in,out] result 結果格納用
+void Parse::CheckBinaryLineNumber(ParseResult *result)
+{
+	if (mIsWorker) {
+		return;
+	}
+	int exists = mLineNumbers.Add(mPos.GetLineNumber(), mPos.mRow);
+	if (exists >= 0) {
+		// 同じ行番号がある
+		if (result) result->Add(mPos, prErrDuplicateLineNumber, exists + 1);
+	}
+}
+
+/// アスキー形式の全行を中間言語に変換
+/// @note mNextAddressに先頭行の前の次アドレスをセットしてから呼ぶ
+/// @param[in]  in_data  入力データ
+/// @param[out] out_data 変換後データ
+/// @param[in,out] result 結果格納用
+/// @return true/false
+bool Parse::ParseAsciiToBinaryLines(PsFileData &in_data, PsFileData &out_data, ParseResult *result)
+{
+	ResetLineState();
+
+#ifdef USE_PARSE_PARALLEL
+	bool parsed = ParseAsciiToBinaryParallel(in_data, out_data, result);
+	MergeWorkerStats();
+	if (parsed) {
+		return true;
+	}
+#endif
+
+	wxString line;
+	for(mPos.mRow = 0; mPos.mRow < in_data.GetCount(); mPos.mRow++) {
+		line = in_data[mPos.mRow];
+		if (!ParseAsciiToBinaryOneLine(in_data.GetType(), line, out_data, result)) {
+			break;
+		}
+		if (result && result->IsOverLimit()) {
+			// エラーが多いので中止
+			result->Add(mPos, prErrStopInvalidBasicCode);
+			break;
+		}
+	}
+	return true;
+}
+
+#ifdef USE_PARSE_PARALLEL
+/// アスキー形式の全行を並列で中間言語に変換
+///
+/// 1. ワーカーがかたまりごとに行を変換する (次アドレスは未定のまま)
+/// 2. 行順に行番号のチェックと解析結果の結合を行い、出力する行を決める
+/// 3. かたまりごとの合計バイト数の累積和から各かたまりの次アドレスと出力位置を決める
+/// 4. ワーカーがかたまりごとに次アドレスを埋めて出力先にコピーする
+///
+/// 出力と解析結果は1スレッドで変換した場合と同じになる。
+/// @param[in]  in_data  入力データ
+/// @param[out] out_data 変換後データ
+/// @param[in,out] result 結果格納用
+/// @return 並列で変換しなかった場合false このとき出力先と結果は変更しない
+bool Parse::ParseAsciiToBinaryParallel(PsFileData &in_data, PsFileData &out_data, ParseResult *result)
+{
+	size_t rows = in_data.GetCount();
+	if (mIsWorker || rows < PARSE_PARALLEL_MIN_LINES) {
+		return false;
+	}
+	int threads = (mThreadCount > 0 ? mThreadCount : ParseWorkerPool::GetThreadCount());
+	if (threads < 2) {
+		return false;
+	}
+	threads = mWorkers.Prepare(this, threads);
+	if (threads < 2) {
+		return false;
+	}
+	for(int i=0; i<mWorkers.GetCount(); i++) {
+		mWorkers.Get(i)->mPos.SetName(mPos.GetName());
+	}
+
+	// かたまりに分ける
+	size_t block_count = (rows + PARSE_PARALLEL_BLOCK_LINES - 1) / PARSE_PARALLEL_BLOCK_LINES;
+	ParseLineBlock **blocks = new ParseLineBlock *[block_count];
+	for(size_t b=0; b<block_count; b++) {
+		size_t start = b * PARSE_PARALLEL_BLOCK_LINES;
+		size_t end = start + PARSE_PARALLEL_BLOCK_LINES;
+		if (end > rows) end = rows;
+		blocks[b] = new ParseLineBlock(start, end);
+	}
+
+	// 1. 行を変換
+	ParseLineJob encode(ParseLineJob::JOB_ENCODE, blocks, block_count);
+	encode.pInData = &in_data;
+	mWorkers.Run(encode, threads, in_data.GetType(), out_data);
+
+	// 2. 行順に行番号をチェックして解析結果を結合
+	bool stopped = false;
+	bool has_code_fe = false;
+	for(size_t b=0; b<block_count && !stopped; b++) {
+		ParseLineBlock *block = blocks[b];
+		size_t result_pos = 0;
+		for(size_t i=0; i<block->GetInfoCount(); i++) {
+			const ParseLineBlock::line_info_t &info = block->GetInfo(i);
+			mPos.mRow = block->mStartRow + i;
+			if (info.flags & ParseLineBlock::LINE_HAS_HOME) {
+				mPos.mCol = info.home_col;
+				mPos.SetLineNumber(info.line_number);
+				CheckHomeLineNumber(result);
+			}
+			for(; result && result_pos < info.result_end; result_pos++) {
+				const ParseResultItem &item = block->mResult.Item(result_pos);
+				if (item.GetErrorCode() == prErrEraseCodeFE) {
+					// かたまりごとに出ているので最初の1件のみ
+					if (has_code_fe) continue;
+					has_code_fe = true;
+				}
+				ParsePosition pos(item.GetRow(), item.GetCol(), item.GetLineNumber(), block->mResult.GetItemName(result_pos));
+				result->Add(pos, item.GetErrorCode(), item.GetValue());
+			}
+			mPos.mCol = info.end_col;
+			block->mUsedLines = i + 1;
+			if (info.flags & ParseLineBlock::LINE_STOPPED) {
+				stopped = true;
+				break;
+			}
+			if (result && result->IsOverLimit()) {
+				// エラーが多いので中止
+				result->Add(mPos, prErrStopInvalidBasicCode);
+				stopped = true;
+				break;
+			}
+		}
+	}
+
+	// 3. かたまりごとの合計バイト数の累積和
+	size_t used_blocks = 0;
+	size_t out_pos = 0;
+	wxMemoryBuffer lens;
+	for(size_t b=0; b<block_count; b++) {
+		ParseLineBlock *block = blocks[b];
+		if (block->mUsedLines == 0) {
+			break;
+		}
+		block->mBytes = 0;
+		for(size_t i=0; i<block->mUsedLines; i++) {
+			wxUint32 len = (wxUint32)block->mLines.GetLineLen(i);
+			lens.AppendData(&len, sizeof(len));
+			block->mBytes += len;
+		}
+		block->mBaseAddress = mNextAddress + (int)out_pos;
+		block->mOutPos = out_pos;
+		out_pos += block->mBytes;
+		used_blocks++;
+	}
+	mNextAddress += (int)out_pos;
+
+	// 4. 次アドレスを埋めて出力先にコピー
+	if (used_blocks > 0) {
+		ParseLineJob link(ParseLineJob::JOB_LINK, blocks, used_blocks);
+		link.pOutBuf = out_data.AddBufs((const wxUint32 *)lens.GetData(), lens.GetDataLen() / sizeof(wxUint32));
+		mWorkers.Run(link, threads, in_data.GetType(), out_data);
+	}
+
+	for(size_t b=0; b<block_count; b++) {
+		delete blocks[b];
+	}
+	delete [] blocks;
+
+	return true;
+}
+
+/// 並列変換 かたまり内の行を変換
+///
+/// 次アドレスは埋めずに、行ごとの情報と解析結果をかたまりに入れる。
+/// @param[in]     in_file_type 入力ファイル形式
+/// @param[in]     in_data      入力データ
+/// @param[in]     out_type     出力データ形式
+/// @param[in,out] block        かたまり
+void Parse::EncodeLineBlock(PsFileType &in_file_type, PsFileData &in_data, PsFileType &out_type, ParseLineBlock &block)
+{
+	PsSymbolSentence &sentence = mSentence;
+	ParseLineBlock::line_info_t info;
+	wxString line;
+
+	ResetLineState();
+
+	for(mPos.mRow = block.mStartRow; mPos.mRow < block.mEndRow; mPos.mRow++) {
+		line = in_data[mPos.mRow];
+		sentence.Empty();
+
+		bool rc = ParseAsciiToSymbolsOneLine(in_file_type, line, out_type, sentence, &block.mResult);
+
+		// 行末の0も同じ行に入れる
+		size_t len = sentence.SelectedStrLen();
+		wxUint8 *dst = block.mLines.AddBuf(len + 1);
+		sentence.CopySelectedStr(dst);
+		dst[len] = 0;
+		block.mBytes += (len + 1);
+
+		info.line_number = mPos.GetLineNumber();
+		info.home_col = (wxUint32)mHomeCol;
+		info.end_col = (wxUint32)mPos.mCol;
+		info.result_end = (wxUint32)block.mResult.GetCount();
+		info.flags = 0;
+		if (sentence.Count() > 0) info.flags |= ParseLineBlock::LINE_HAS_HOME;
+		if (!rc) info.flags |= ParseLineBlock::LINE_STOPPED;
+		block.AddInfo(info);
+
+		if (!rc) {
+			break;
+		}
+	}
+}
+
+/// 並列変換 かたまり内の行に次アドレスを埋めて出力先にコピー
+/// @param[in]  block かたまり
+/// @param[out] dst   出力先 かたまりの合計バイト数以上の長さが必要
+void Parse::LinkLineBlock(ParseLineBlock &block, wxUint8 *dst)
+{
+	int next_address = block.mBaseAddress;
+	for(size_t i=0; i<block.mUsedLines; i++) {
+		size_t len = block.mLines.GetLineLen(i);
+		memcpy(dst, block.mLines.GetLinePtr(i), len);
+
+		// 次アドレスを更新
+		next_address += (int)len;
+
+		const ParseLineBlock::line_info_t &info = block.GetInfo(i);
+		if (info.flags & ParseLineBlock::LINE_HAS_HOME) {
+			BinString home = HomeLineNumToBinStr(info.line_number, next_address);
+			for(size_t n=0; n<home.Len() && n<len; n++) {
+				dst[n] = home.At(n);
+			}
+		}
+		dst += len;
+	}
+}
+
+/// 中間言語の全行を並列でアスキー形式に変換
+///
+/// 1. 先頭行を変換して長さを求める
+/// 2. 次アドレスの差をたどって各行の開始位置を求め、かたまりに分ける
+/// 3. ワーカーがかたまりごとに行を変換する
+/// 4. 各かたまりの終了位置が次のかたまりの開始位置と一致するか確かめる
+/// 5. 行順に行番号のチェックと解析結果の結合を行い、出力する
+///
+/// 次アドレスが壊れていて4.で一致しない場合は並列で変換しない。
+/// 出力と解析結果は1スレッドで変換した場合と同じになる。
+/// @param[in]  in_file  入力ファイル
+/// @param[out] out_data 変換後データ
+/// @param[in,out] result 結果格納用
+/// @param[out] parsed   並列で変換したか falseのときは出力先と結果、入力位置は変更しない
+/// @return true/false
+bool Parse::ReadBinaryToAsciiParallel(PsFileInput &in_file, PsFileData &out_data, ParseResult *result, bool &parsed)
+{
+	parsed = false;
+	if (mIsWorker || in_file.Eof()) {
+		return false;
+	}
+	int threads = (mThreadCount > 0 ? mThreadCount : ParseWorkerPool::GetThreadCount());
+	if (threads < 2) {
+		return false;
+	}
+	wxFileOffset base_pos = in_file.Seek(0, wxFromCurrent);
+	wxFileOffset total_len = in_file.GetLength();
+	if (base_pos == wxInvalidOffset || total_len == wxInvalidOffset || total_len - base_pos < (wxFileOffset)(PARSE_PARALLEL_MIN_LINES * 5)) {
+		return false;
+	}
+	threads = mWorkers.Prepare(this, threads);
+	if (threads < 2) {
+		return false;
+	}
+	for(int i=0; i<mWorkers.GetCount(); i++) {
+		mWorkers.Get(i)->mPos.SetName(mPos.GetName());
+	}
+
+	// 残りをまとめて読む
+	size_t len = (size_t)(total_len - base_pos);
+	wxMemoryBuffer data;
+	len = in_file.Read((const wxUint8 *)data.GetWriteBuf(len), len);
+	data.UngetWriteBuf(len);
+	in_file.Seek(base_pos);
+	const wxUint8 *buf = (const wxUint8 *)data.GetData();
+
+	// 1. 先頭行
+	PsFileType out_type(out_data);
+	ParseLineBlock *first = new ParseLineBlock(0, 0);
+	first->mEndPos = 1;
+	{
+		PsFileStrInput first_file(wxString::From8BitData((const char *)buf, len));
+		mWorkers.Get(0)->DecodeLineBlock(first_file, out_type, *first);
+	}
+	if (first->GetInfoCount() != 1 || (first->GetInfo(0).flags & ParseLineBlock::LINE_EOL) == 0 || len < 2) {
+		delete first;
+		return false;
+	}
+
+	// 2. 次アドレスの差が行の長さになる
+	wxMemoryBuffer starts;	// かたまりの開始行と開始位置
+	size_t line_count = 1;
+	size_t line_pos = first->mReadEnd;
+	long prev_addr = BytesToLong(buf, 2);
+	for(;;) {
+		if (((line_count - 1) % PARSE_PARALLEL_BLOCK_LINES) == 0) {
+			size_t start[2] = { line_count, line_pos };
+			starts.AppendData(start, sizeof(start));
+		}
+		if (line_pos + 4 > len) {
+			break;
+		}
+		long addr = BytesToLong(&buf[line_pos], 2);
+		if (addr == 0) {
+			// 終端
+			break;
+		}
+		size_t line_len = (size_t)((addr - prev_addr) & 0xffff);
+		if (line_len < 5 || line_pos + line_len > len || buf[line_pos + line_len - 1] != 0) {
+			// 次アドレスがおかしいので以降は1つのかたまりで変換する
+			break;
+		}
+		prev_addr = addr;
+		line_pos += line_len;
+		line_count++;
+	}
+	if (line_count < PARSE_PARALLEL_MIN_LINES) {
+		delete first;
+		return false;
+	}
+
+	size_t block_count = starts.GetDataLen() / (sizeof(size_t) * 2) + 1;
+	const size_t *start = (const size_t *)starts.GetData();
+	ParseLineBlock **blocks = new ParseLineBlock *[block_count];
+	blocks[0] = first;
+	for(size_t b=1; b<block_count; b++) {
+		blocks[b] = new ParseLineBlock(start[0], start[0]);
+		blocks[b]->mStartPos = start[1];
+		start += 2;
+	}
+	for(size_t b=1; b<block_count - 1; b++) {
+		blocks[b]->mEndPos = blocks[b + 1]->mStartPos;
+	}
+
+	// 3. 行を変換
+	ParseLineJob decode(ParseLineJob::JOB_DECODE, &blocks[1], block_count - 1);
+	decode.pInBuf = buf;
+	decode.mInLen = len;
+	mWorkers.Run(decode, threads, in_file, out_type);
+
+	// 4. かたまりの境界が行の境界と一致するか
+	bool matched = true;
+	for(size_t b=0; b<block_count; b++) {
+		ParseLineBlock *block = blocks[b];
+		size_t count = block->GetInfoCount();
+		if (count > 0 && (block->GetInfo(count - 1).flags & (ParseLineBlock::LINE_STOPPED | ParseLineBlock::LINE_END)) != 0) {
+			// ここで終わるので以降は使わない
+			break;
+		}
+		if (b + 1 < block_count && block->mReadEnd != blocks[b + 1]->mStartPos) {
+			matched = false;
+			break;
+		}
+	}
+
+	// 5. 行順に行番号をチェックして解析結果を結合
+	bool stopped = false;
+	bool finished = false;
+	size_t read_end = 0;
+	for(size_t b=0; matched && b<block_count && !stopped && !finished; b++) {
+		ParseLineBlock *block = blocks[b];
+		size_t result_pos = 0;
+		size_t used_lines = 0;
+		for(size_t i=0; i<block->GetInfoCount(); i++) {
+			const ParseLineBlock::line_info_t &info = block->GetInfo(i);
+			mPos.mRow = block->mStartRow + i;
+			if (info.flags & ParseLineBlock::LINE_HAS_HOME) {
+				mPos.mRow++;
+				mPos.mCol = 0;
+				mPos.SetLineNumber(info.line_number);
+				CheckBinaryLineNumber(result);
+			}
+			for(; result && result_pos < info.result_end; result_pos++) {
+				const ParseResultItem &item = block->mResult.Item(result_pos);
+				ParsePosition pos(item.GetRow(), item.GetCol(), item.GetLineNumber(), block->mResult.GetItemName(result_pos));
+				result->Add(pos, item.GetErrorCode(), item.GetValue());
+			}
+			mPos.mCol = info.end_col;
+			if (info.flags & ParseLineBlock::LINE_EOL) {
+				used_lines++;
+			}
+			if (result && result->IsOverLimit()) {
+				// エラーが多いので中止
+				stopped = true;
+				break;
+			}
+			if (info.flags & ParseLineBlock::LINE_STOPPED) {
+				stopped = true;
+				break;
+			}
+			if (info.flags & ParseLineBlock::LINE_END) {
+				finished = true;
+				break;
+			}
+		}
+		out_data.AddLines(block->mLines, 0, used_lines);
+		read_end = block->mReadEnd;
+	}
+
+	for(size_t b=0; b<block_count; b++) {
+		delete blocks[b];
+	}
+	delete [] blocks;
+
+	if (!matched) {
+		return false;
+	}
+	parsed = true;
+	in_file.Seek(base_pos + (wxFileOffset)read_end);
+
+	if (stopped) {
+		if (result) {
+			result->Add(mPos, prErrStopInvalidBasicCode);
+		}
+		return false;
+	}
+	return true;
+}
+
+/// 並列変換 かたまり内の中間言語の行をアスキー形式に変換
+///
+/// 行番号の重複チェックは行わずに、行ごとの情報と解析結果をかたまりに入れる。
+/// 終了位置を越えた行か、終端、エラーで止める。
+/// @param[in]     in_file  入力ファイル 開始位置に移動して読む
+/// @param[in]     out_type 出力データ形式
+/// @param[in,out] block    かたまり
+void Parse::DecodeLineBlock(PsFileInput &in_file, PsFileType &out_type, ParseLineBlock &block)
+{
+	PsSymbolSentence &sentence = mSentence;
+	ParseLineBlock::line_info_t info;
+
+	in_file.Seek((wxFileOffset)block.mStartPos);
+	mPos.mRow = block.mStartRow;
+	mPos.mCol = 0;
+
+	int phase = PHASE_LINE_NUMBER;
+	while(!in_file.Eof() && phase >= PHASE_NONE) {
+		size_t row = mPos.mRow;
+		sentence.Empty();
+		phase = ReadBinaryToSymbolsOneLine(in_file, out_type, phase, sentence, &block.mResult);
+
+		info.line_number = mPos.GetLineNumber();
+		info.home_col = 0;
+		info.end_col = (wxUint32)mPos.mCol;
+		info.result_end = (wxUint32)block.mResult.GetCount();
+		info.flags = 0;
+		if (mPos.mRow != row) info.flags |= ParseLineBlock::LINE_HAS_HOME;
+		if (phase == PHASE_EOL) {
+			block.mLines.Add(sentence.JoinAscStr());
+			info.flags |= ParseLineBlock::LINE_EOL;
+		} else if (phase == PHASE_STOPPED) {
+			info.flags |= ParseLineBlock::LINE_STOPPED;
+		} else {
+			info.flags |= ParseLineBlock::LINE_END;
+		}
+		block.AddInfo(info);
+
+		if (phase != PHASE_EOL) {
+			break;
+		}
+		phase = PHASE_LINE_NUMBER;
+		if (block.mEndPos > 0 && (size_t)in_file.Seek(0, wxFromCurrent) >= block.mEndPos) {
+			break;
+		}
+	}
+	block.mReadEnd = (size_t)in_file.Seek(0, wxFromCurrent);
+}
+#endif
+
 /// アスキー形式1行を中間言語に変換して出力
 /// @param[in]  in_file_type 入力ファイル形式
 /// @param[in]  in_data      入力データ
@@ -741,7 +1380,8 @@ bool Parse::ReadBinaryToAsciiColored(PsFileInput &in_file, PsFileData &out_data,
 /// @return true/false
 bool Parse::ParseAsciiToBinaryOneLine(PsFileType &in_file_type, wxString &in_data, PsFileData &out_data, ParseResult *result)
 {
-	PsSymbolSentence sentence;
+	PsSymbolSentence &sentence = mSentence;
+	sentence.Empty();
 
 	bool rc = ParseAsciiToSymbolsOneLine(in_file_type, in_data, out_data, sentence, result);
 
@@ -753,9 +1393,11 @@ bool Parse::ParseAsciiToBinaryOneLine(PsFileType &in_file_type, wxString &in_dat
 		sentence[0].SetBinStr(HomeLineNumToBinStr(mPos.GetLineNumber(), mNextAddress));
 	}
 
-	// ファイルに出力
-	out_data.Add(sentence.JoinSelectedStr());
-	out_data.Add("\0", 1);
+	// ファイルに出力 行末の0も同じ行に入れる
+	size_t len = sentence.SelectedStrLen();
+	wxUint8 *dst = out_data.AddBuf(len + 1);
+	sentence.CopySelectedStr(dst);
+	dst[len] = 0;
 
 	return rc;
 }
@@ -768,7 +1410,8 @@ bool Parse::ParseAsciiToBinaryOneLine(PsFileType &in_file_type, wxString &in_dat
 /// @return true/false
 bool Parse::ParseAsciiToColoredOneLine(PsFileType &in_file_type, wxString &in_data, PsFileData &out_data, ParseResult *result)
 {
-	PsSymbolSentence sentence;
+	PsSymbolSentence &sentence = mSentence;
+	sentence.Empty();
 
 	bool rc = ParseAsciiToSymbolsOneLine(in_file_type, in_data, out_data, sentence, result);
 
@@ -836,6 +1479,8 @@ void Parse::DecorateSentenceToColored(const PsSymbolSentence &sentence, wxString
 /// @return 2:7bit文字のみ 1: utf8に変換できる 0: utf8に変換できない
 int Parse::ReadAsciiText(PsFileInput &in_data, PsFileData &out_data, bool to_utf8)
 {
+	PARSE_STATS_STAGE_INPUT(mStats, psStageReadText, in_data);
+
 	int rc = 2;	// utf8に変換できない場合 0
 
 	wxUint8 vals[VALS_SIZE + 1];
@@ -945,6 +1590,7 @@ int Parse::ReadAsciiText(PsFileInput &in_data, PsFileData &out_data, bool to_utf
 
 
 	out_data.SetType(in_data.GetType());
+	PARSE_STATS_COUNT(0, out_data.GetCount());
 
 	return rc;
 }
@@ -955,22 +1601,59 @@ int Parse::ReadAsciiText(PsFileInput &in_data, PsFileData &out_data, bool to_utf
 /// @return true/false
 bool Parse::WriteText(PsFileData &in_data, PsFileOutput &out_file)
 {
-	wxArrayString *inlines = &in_data.GetData();
-	for(size_t row = 0; row < inlines->GetCount(); row++) {
-		out_file.Write(inlines->Item(row));
+	PARSE_STATS_STAGE(mStats, psStageWrite);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
+	if (!out_file.IsOpened()) {
+		return true;
 	}
+
+	WriteTextHead(in_data, out_file);
+	WriteTextLines(in_data, out_file);
+	WriteTextTail(out_file);
 	return true;
 }
 
+/// テキストの先頭を出力
+/// @param[in]  in_data      入力データ 先頭の行を見る
+/// @param[out] out_file     出力ファイル
+void Parse::WriteTextHead(PsFileData &in_data, PsFileOutput &out_file)
+{
+}
+
+/// テキストの行を出力
+/// @note 続けて呼んで行を分けて出力できる
+/// @param[in]  in_data      入力データ
+/// @param[out] out_file     出力ファイル
+void Parse::WriteTextLines(PsFileData &in_data, PsFileOutput &out_file)
+{
+	for(size_t row = 0; row < in_data.GetCount(); row++) {
+		out_file.WriteLine(in_data, row);
+	}
+}
+
+/// テキストの末尾を出力
+/// @param[out] out_file     出力ファイル
+void Parse::WriteTextTail(PsFileOutput &out_file)
+{
+}
+
 /// バイナリを出力
 /// @param[in]  in_data      入力データ
 /// @param[out] out_file     出力ファイル
 /// @return true/false
 bool Parse::WriteBinary(PsFileData &in_data, PsFileOutput &out_file)
 {
-	wxArrayString *inlines = &in_data.GetData();
-	for(size_t row = 0; row < inlines->GetCount(); row++) {
-		out_file.Write(inlines->Item(row));
+	PARSE_STATS_STAGE(mStats, psStageWrite);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
+	if (in_data.Is8Bit()) {
+		// 連続しているのでまとめて出力
+		out_file.Write(in_data.GetBuffer(), in_data.GetBufferLen());
+		return true;
+	}
+	for(size_t row = 0; row < in_data.GetCount(); row++) {
+		out_file.WriteLine(in_data, row);
 	}
 	return true;
 }
@@ -978,10 +1661,69 @@ bool Parse::WriteBinary(PsFileData &in_data, PsFileOutput &out_file)
 /// 実データをテープイメージにして出力
 bool Parse::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &out_file)
 {
+	PARSE_STATS_STAGE_INPUT(mStats, psStageWrite, in_file);
+
 	out_file.Write(in_file);
 	return true;
 }
 
+/// 実データをディスクイメージの中のファイルとして書き込む
+/// @note ディスクイメージに対応する機種で実装する
+bool Parse::WriteDiskImageFromRealData(PsFileInput &in_file, const wxString &image_path)
+{
+	mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+	mErrInfo.ShowMsgBox();
+	return false;
+}
+
+/// 実データを機種ごとのディスクの中のファイルとして書き込む
+///
+/// 内部ファイル名をファイル名、拡張子をBASにする。同じ名前のファイルは置き換える。
+/// イメージは作り直さず、ディスクが変わったところだけを書く。
+/// @param[in] in_file    実データ
+/// @param[in] image_path ディスクイメージ
+/// @param[in] disk       機種ごとのディスク
+/// @return 書き込めなかった場合false
+bool Parse::WriteDiskImageFile(PsFileInput &in_file, const wxString &image_path, DiskBasicFiles &disk)
+{
+	PARSE_STATS_STAGE_INPUT(mStats, psStageWrite, in_file);
+
+	// データを読み込む
+	wxMemoryBuffer data;
+	in_file.ReadAll(data);
+
+	if (!disk.Open(image_path, true)) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	if (disk.IsWriteProtected()) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskWrite);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+
+	wxString name = mOutFile.GetInternalName();
+	if (name.IsEmpty()) {
+		name = GetFileNameBase();
+	}
+	bool ascii = mOutFile.GetTypeFlag(psAscii);
+
+	// 置き換えるファイルの分も空きに数える
+	int avail = disk.GetFreeClusters() + disk.GetReplacedClusters(name, _T("BAS"));
+	if (disk.GetRequiredBasicClusters(data.GetDataLen(), ascii) > avail) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFull);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	if (!disk.SaveBasicFile(name, _T("BAS"), (const wxUint8 *)data.GetData(), data.GetDataLen(), ascii)) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskWrite);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	return true;
+}
+
 /// アスキー文字列を出力
 /// @param[in]  len          長さ
 /// @param[in]  in_line      入力文字列
@@ -1001,6 +1743,9 @@ size_t Parse::WriteAsciiString(size_t len, const wxString &in_line, wxFile *out_
 /// @return true/false
 bool Parse::ConvAsciiToUTF8(PsFileData &in_data, PsFileData *out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE(mStats, psStageUTF8);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
 	// 変換タイプ設定
 	wxString out_char_type;
 	if (out_data->GetTypeFlag(psUTF8)) {
@@ -1014,16 +1759,18 @@ bool Parse::ConvAsciiToUTF8(PsFileData &in_data, PsFileData *out_data, ParseResu
 	int error_count = 0;
 	bool stopped = false;
 
+	wxString line;
 	wxString body;
 
 	for(mPos.mRow = 0; mPos.mRow < (size_t)in_data.GetCount(); mPos.mRow++) {
-		if (error_count > 100) {
+		if (result ? result->IsOverLimit(error_count, ERROR_STOPPED_CHAR_COUNT) : error_count > ERROR_STOPPED_CHAR_COUNT) {
 			stopped = true;
 			break;
 		}
-		mPos.SetLineNumber(GetLineNumber(in_data[mPos.mRow]));
+		line = in_data[mPos.mRow];
+		mPos.SetLineNumber(GetLineNumber(line));
 
-		error_count += ConvAsciiToUTF8OneLine(in_data[mPos.mRow], out_char_type, body, result);
+		error_count += ConvAsciiToUTF8OneLine(line, out_char_type, body, result);
 
 		if (out_data) out_data->Add(body);
 	}
@@ -1102,6 +1849,9 @@ int Parse::ConvAsciiToUTF8OneLine(const wxString &in_line, const wxString &out_t
 /// @return true/false
 bool Parse::ConvUTF8ToAscii(PsFileData &in_data, PsFileData *out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE(mStats, psStageUTF8);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
 	// 変換タイプ設定
 	wxString in_char_type;
 	if (in_data.GetTypeFlag(psUTF8)) {
@@ -1112,19 +1862,21 @@ bool Parse::ConvUTF8ToAscii(PsFileData &in_data, PsFileData *out_data, ParseResu
 	mPos.Empty();
 	mPos.SetName(_("UTF8->Ascii"));
 
+	wxString line;
 	wxString body;
 
 	int error_count = 0;
 	bool stopped = false;
 
 	for(mPos.mRow = 0; mPos.mRow < in_data.GetCount(); mPos.mRow++) {
-		if (error_count > 100) {
+		if (result ? result->IsOverLimit(error_count, ERROR_STOPPED_CHAR_COUNT) : error_count > ERROR_STOPPED_CHAR_COUNT) {
 			stopped = true;
 			break;
 		}
-		mPos.SetLineNumber(GetLineNumber(in_data[mPos.mRow]));
+		line = in_data[mPos.mRow];
+		mPos.SetLineNumber(GetLineNumber(line));
 
-		error_count += ConvUTF8ToAsciiOneLine(in_char_type, in_data[mPos.mRow], body, result);
+		error_count += ConvUTF8ToAsciiOneLine(in_char_type, line, body, result);
 
 		if (out_data) out_data->Add(body);
 	}
@@ -1416,9 +2168,7 @@ wxString &Parse::GetOpenedBasicType()
 /// 画面表示用データを返す
 wxString &Parse::GetParsedData(wxArrayString &lines)
 {
-	for(size_t i=0; i<mParsedData.GetCount(); i++) {
-		lines.Add(mParsedData[i]);
-	}
+	mParsedData.GetData(lines);
 	return mParsedData.GetCharType();
 }
 
@@ -1457,7 +2207,7 @@ long Parse::GetLineNumber(const wxString &line, size_t *next_pos)
 }
 
 /// レポート
-void Parse::Report(ParseResult &result, wxArrayString &line)
+void Parse::Report(ParseResult &result, PsFileData &line)
 {
 	wxArrayString arr;
 	result.Report(arr);
@@ -1666,12 +2416,96 @@ int Parse::GetInternalNameSize() const
 	return 0;
 }
 
+/// テープイメージを音声(WAV)で出力できるか
+bool Parse::CanExportTapeAudio() const
+{
+	return false;
+}
+
+/// ディスクイメージの中に書き込めるか
+bool Parse::CanExportDiskImage() const
+{
+	return false;
+}
+
+/// 中に書き込むディスクイメージの拡張子を返す
+const wxChar *Parse::GetDiskImageFileExtension() const
+{
+	return wxT("");
+}
+
 /// 設定パラメータを返す
 ConfigParam *Parse::GetConfigParam()
 {
 	return pConfig;
 }
 
+/// エクスポート時の解析結果の出力先と中止件数を設定
+/// @param[in] sink  出力先 NULLなら画面表示用に保持する
+/// @param[in] limit 中止するエラー件数 -1:既定値 0:中止しない
+void Parse::SetResultSink(ParseResultSink *sink, int limit)
+{
+	pResultSink = sink;
+	mResultLimit = limit;
+}
+
+/// 並列変換のスレッド数を設定
+/// @param[in] count スレッド数 0:CPU数 1:並列にしない
+void Parse::SetThreadCount(int count)
+{
+	mThreadCount = (count < 0 ? 0 : count);
+}
+
+/// 中間言語からテキストへのエクスポートをパイプラインで行うか
+/// @param[in] enable trueならテープイメージ以外のテキストに出力するときパイプラインで行う
+void Parse::SetPipelineMode(bool enable)
+{
+	mUsePipeline = enable;
+}
+
+#ifdef USE_PARSE_PARALLEL
+/// ワーカーのテーブル検索回数を呼び出し元に移す
+/// @note ワーカーのスレッドが終わってから呼ぶ
+void Parse::MergeWorkerStats()
+{
+#ifdef USE_PARSE_STATS
+	for(int i=0; i<mWorkers.GetCount(); i++) {
+		Parse *worker = mWorkers.Get(i);
+		mCharCodeTbl.AddLookupCount(worker->mCharCodeTbl.GetLookupCount());
+		mBasicCodeTbl.AddLookupCount(worker->mBasicCodeTbl.GetLookupCount());
+		worker->mCharCodeTbl.ResetLookupCount();
+		worker->mBasicCodeTbl.ResetLookupCount();
+	}
+#endif
+}
+#endif
+
+#ifdef USE_PARSE_STATS
+/// 処理段階ごとの計測結果を返す
+const ParseStats &Parse::GetStats()
+{
+	mStats.SetLookups(mCharCodeTbl.GetLookupCount(), mBasicCodeTbl.GetLookupCount());
+	return mStats;
+}
+#endif
+
+/// 計測結果をクリア
+void Parse::ResetStats()
+{
+#ifdef USE_PARSE_STATS
+	mStats.Empty();
+	mCharCodeTbl.ResetLookupCount();
+	mBasicCodeTbl.ResetLookupCount();
+#endif
+	mPipeStats.Empty();
+}
+
+/// パイプラインの計測結果を返す
+const ParsePipelineStats &Parse::GetPipelineStats() const
+{
+	return mPipeStats;
+}
+
 /// ファイルオープン時の拡張子リストを返す
 const wxChar *Parse::GetOpenFileExtensions() const
 {
@@ -1797,3 +2631,56 @@ const wxString &ParseCollection::GetAppPath() const
 {
 	return mAppPath;
 }
+
+/// 出力形式の名前
+static const struct st_type_names {
+	const char *name;
+	int flags;
+} cTypeNames[] = {
+	{ "bin",		psBinary },
+	{ "bintape",	psBinary | psTapeImage },
+	{ "binwav",		psBinary | psTapeImage | psWaveAudio },
+	{ "bindisk",	psBinary | psDiskImage },
+	{ "ascii",		psAscii },
+	{ "asciitape",	psAscii | psTapeImage },
+	{ "asciiwav",	psAscii | psTapeImage | psWaveAudio },
+	{ "asciidisk",	psAscii | psDiskImage },
+	{ "utf8",		psAscii | psUTF8 },
+	{ NULL, 0 }
+};
+
+/// 機種の名前
+static const char *cMachineKeys[eMachineCount] = {
+	"l3s1",
+	"msx"
+};
+
+/// 機種の名前から番号を返す
+/// @return 見つからない場合-1
+int ParseCollection::FindMachine(const wxString &name)
+{
+	for(int i=0; i<eMachineCount; i++) {
+		if (name.CmpNoCase(cMachineKeys[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/// 機種の名前を返す
+const char *ParseCollection::GetMachineKey(int idx)
+{
+	return cMachineKeys[idx];
+}
+
+/// 出力形式の名前からフラグを返す
+/// @return 見つからない場合-1
+int ParseCollection::FindTypeFlags(const wxString &name)
+{
+	for(int i=0; cTypeNames[i].name != NULL; i++) {
+		if (name.CmpNoCase(cTypeNames[i].name) == 0) {
+			return cTypeNames[i].flags;
+		}
+	}
+	return -1;
+}
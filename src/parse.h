@@ -15,6 +15,9 @@
 #include "maptable.h"
 #include "fileinfo.h"
 #include "parseresult.h"
+#include "parsestats.h"
+#include "parseworker.h"
+#include "parsepipeline.h"
 #include "pssymbol.h"
 #include "config.h"
 
@@ -44,13 +47,16 @@ public:
 };
 #endif
 
-#define ERROR_STOPPED_COUNT		50
-
 class ParseCollection;
+class DiskBasicFiles;
 
 /// パーサークラス
 class Parse
 {
+	friend class ParseWorkerThread;
+	friend class ParseWorkerPool;
+	friend class ParsePipeline;
+
 public:
 	enum enParseAttrs {
 		QUOTED_AREA		= 0x01,
@@ -84,17 +90,37 @@ protected:
 
 	PsFileInputInfo  mInFile;		///< 入力ファイル情報
 	PsFileOutputInfo mOutFile;		///< 出力ファイル情報
+	wxString mOutDiskImage;			///< 書き込み先のディスクイメージ 空なら出力ファイルに書く
 
 	int mNextAddress;		///< 次アドレス
 
 	ParsePosition mPos;		///< 処理中の位置情報
+	LineNumberIndex mLineNumbers;	///< 行番号の重複チェック用
 	long mPrevLineNumber;	///< 1つ前のBASIC行番号
 	int mMachineType;		///< 処理中のマシンタイプ
 
 	PsFileData mParsedData;	///< 画面表示用データバッファ
 
+	PsSymbolSentence mSentence;	///< 1行分の解析文字列 変換中は領域を使いまわす
+
 	ConfigParam *pConfig;	///< 設定
 
+	ParseResultSink *pResultSink;	///< エクスポート時の解析結果の出力先
+	int mResultLimit;				///< エクスポートを中止するエラー件数 -1:既定値 0:中止しない
+
+#ifdef USE_PARSE_STATS
+	ParseStats mStats;		///< 処理段階ごとの計測結果
+#endif
+
+	bool mIsWorker;			///< 並列変換のワーカーか 行番号のチェックは呼び出し元で行う
+	size_t mHomeCol;		///< ワーカーで行番号の後の列
+	int mThreadCount;		///< 並列変換のスレッド数 0:CPU数 1:並列にしない
+#ifdef USE_PARSE_PARALLEL
+	ParseWorkerPool mWorkers;	///< 並列変換用のワーカー
+#endif
+	bool mUsePipeline;		///< 中間言語からテキストへのエクスポートをパイプラインで行うか
+	ParsePipelineStats mPipeStats;	///< パイプラインの計測結果
+
 	CodeMapTable mCharCodeTbl;	///< 文字コード変換テーブル
 	CodeMapTable mBasicCodeTbl;	///< BASICコード変換テーブル
 
@@ -121,6 +147,16 @@ protected:
 	virtual wxString GetBasicCodeTableFileName() const = 0;
 	/// 初期設定値をセット
 	virtual void SetDefaultConfigParam() = 0;
+	/// 変換表の読み込みと正規表現の設定
+	virtual bool InitTables();
+	/// 並列変換用に同じ種類のパーサーを作成
+	virtual Parse *NewWorker() const;
+	/// 並列変換のワーカーとして初期化
+	virtual bool InitWorker();
+#ifdef USE_PARSE_PARALLEL
+	/// ワーカーのテーブル検索回数を呼び出し元に移す
+	void MergeWorkerStats();
+#endif
 
 	/// 入力データのフォーマットチェック
 	virtual bool CheckDataFormat(PsFileInputInfo &in_file_info) = 0;
@@ -158,6 +194,26 @@ protected:
 	virtual void ParseLineNumberString(const wxString &in_data, wxRegEx &re_int, PsSymbol &body, ParseResult *result = NULL) = 0;
 	/// 8進or16進文字列を文字に変換
 	virtual void ParseOctHexString(const wxString &in_data, const wxString &octhexhed, const wxString &octhexcode, int base, wxRegEx &re, PsSymbol &body, ParseResult *result = NULL) = 0;
+	/// 行をまたいで持つ状態をクリア
+	virtual void ResetLineState();
+	/// 行頭の行番号の重複と順序をチェック
+	virtual void CheckHomeLineNumber(ParseResult *result);
+	/// 中間言語の行番号の重複をチェック
+	virtual void CheckBinaryLineNumber(ParseResult *result);
+	/// アスキー形式の全行を中間言語に変換
+	virtual bool ParseAsciiToBinaryLines(PsFileData &in_data, PsFileData &out_data, ParseResult *result = NULL);
+#ifdef USE_PARSE_PARALLEL
+	/// アスキー形式の全行を並列で中間言語に変換
+	virtual bool ParseAsciiToBinaryParallel(PsFileData &in_data, PsFileData &out_data, ParseResult *result = NULL);
+	/// 並列変換 かたまり内の行を変換
+	virtual void EncodeLineBlock(PsFileType &in_file_type, PsFileData &in_data, PsFileType &out_type, ParseLineBlock &block);
+	/// 並列変換 かたまり内の行に次アドレスを埋めて出力先にコピー
+	virtual void LinkLineBlock(ParseLineBlock &block, wxUint8 *dst);
+	/// 中間言語の全行を並列でアスキー形式に変換
+	virtual bool ReadBinaryToAsciiParallel(PsFileInput &in_file, PsFileData &out_data, ParseResult *result, bool &parsed);
+	/// 並列変換 かたまり内の中間言語の行をアスキー形式に変換
+	virtual void DecodeLineBlock(PsFileInput &in_file, PsFileType &out_type, ParseLineBlock &block);
+#endif
 	/// アスキー形式1行を中間言語に変換
 	virtual bool ParseAsciiToBinaryOneLine(PsFileType &in_file_type, wxString &in_data, PsFileData &out_data, ParseResult *result = NULL);
 	/// アスキー形式1行を解析して色付けする
@@ -168,10 +224,24 @@ protected:
 	virtual size_t WriteAsciiString(size_t len, const wxString &in_line, wxFile *out_data);
 	/// テキストを出力
 	virtual bool WriteText(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの先頭を出力
+	virtual void WriteTextHead(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの行を出力
+	virtual void WriteTextLines(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの末尾を出力
+	virtual void WriteTextTail(PsFileOutput &out_file);
+#ifdef USE_PARSE_PIPELINE
+	/// 中間言語からテキストへのエクスポートをパイプラインで行う
+	virtual bool ExportBinaryToTextPipeline(ParseResult *result, bool &rc);
+#endif
 	/// バイナリを出力
 	virtual bool WriteBinary(PsFileData &in_data, PsFileOutput &out_file);
 	/// 実データをテープイメージにして出力
 	virtual bool WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &out_file);
+	/// 実データをディスクイメージの中のファイルとして書き込む
+	virtual bool WriteDiskImageFromRealData(PsFileInput &in_file, const wxString &image_path);
+	/// 実データを機種ごとのディスクの中のファイルとして書き込む
+	bool WriteDiskImageFile(PsFileInput &in_file, const wxString &image_path, DiskBasicFiles &disk);
 	/// アスキー形式からUTF-8テキストに変換
 	virtual bool ConvAsciiToUTF8(PsFileData &in_data, PsFileData *out_data, ParseResult *result = NULL);
 	/// UTF-8テキストからアスキー形式に変換
@@ -231,10 +301,28 @@ public:
 	virtual wxString GetFileNameBase() const;
 	/// 出力ファイルを開く
 	virtual bool OpenOutFile(const wxString &out_file_name, PsFileType &file_type);
+	/// 出力先に既存のディスクイメージを指定する
+	virtual bool OpenOutDiskImage(const wxString &image_path, PsFileType &file_type);
 	/// 出力ファイルを閉じる
 	virtual void CloseOutFile();
 	/// エクスポート
 	virtual bool ExportData();
+	/// エクスポート時の解析結果の出力先と中止件数を設定
+	virtual void SetResultSink(ParseResultSink *sink, int limit = -1);
+	/// 並列変換のスレッド数を設定 0:CPU数 1:並列にしない
+	virtual void SetThreadCount(int count);
+	/// 中間言語からテキストへのエクスポートをパイプラインで行うか
+	virtual void SetPipelineMode(bool enable);
+	/// エラー情報を返す
+	PsErrInfo &GetErrInfo() { return mErrInfo; }
+#ifdef USE_PARSE_STATS
+	/// 処理段階ごとの計測結果を返す
+	virtual const ParseStats &GetStats();
+#endif
+	/// 計測結果をクリア
+	virtual void ResetStats();
+	/// パイプラインの計測結果を返す
+	virtual const ParsePipelineStats &GetPipelineStats() const;
 	/// 画面表示用データを返す
 	virtual wxString &GetParsedData(wxArrayString &lines);
 	/// 文字種類を返す
@@ -264,7 +352,7 @@ public:
 	/// 行番号を返す
 	virtual long GetLineNumber(const wxString &line, size_t *next_pos = NULL);
 	/// レポート
-	virtual void Report(ParseResult &result, wxArrayString &line);
+	virtual void Report(ParseResult &result, PsFileData &line);
 	/// アスキー形式1行からUTF-8テキストに変換
 	virtual int  ConvAsciiToUTF8OneLine(const wxString &in_line, const wxString &out_type, wxString &out_line, ParseResult *result = NULL);
 	/// UTF-8テキスト1行からアスキー形式に変換
@@ -275,6 +363,12 @@ public:
 	virtual const wxString &GetInternalName();
 	/// テープイメージの内部ファイル名の最大文字数を返す
 	virtual int GetInternalNameSize() const;
+	/// テープイメージを音声(WAV)で出力できるか
+	virtual bool CanExportTapeAudio() const;
+	/// ディスクイメージの中に書き込めるか
+	virtual bool CanExportDiskImage() const;
+	/// 中に書き込むディスクイメージの拡張子を返す
+	virtual const wxChar *GetDiskImageFileExtension() const;
 	/// BASICが拡張BASICかどうか
 	virtual bool IsExtendedBasic(const wxString &basic_type) = 0;
 	/// マシンタイプの判別
@@ -331,6 +425,13 @@ public:
 
 	void SetAppPath(const wxString &path);
 	const wxString &GetAppPath() const;
+
+	/// 機種の名前(l3s1,msx)から番号を返す
+	static int FindMachine(const wxString &name);
+	/// 機種の名前を返す
+	static const char *GetMachineKey(int idx);
+	/// 出力形式の名前(bin,ascii,utf8など)からフラグを返す
+	static int FindTypeFlags(const wxString &name);
 };
 
 #endif /* _PARSE_H_ */
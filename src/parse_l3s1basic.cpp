@@ -8,7 +8,6 @@
 #include <wx/filename.h>
 #include <wx/wfstream.h>
 #include <wx/arrimpl.cpp>
-#include "main.h"
 #include "config.h"
 #include "l3float.h"
 //#include "l3specs.h"
@@ -74,17 +73,31 @@ void ParseL3S1Basic::SetDefaultConfigParam()
 	pConfig->SetStartAddr(eL3DefaultStartAddr);
 }
 
+/// 並列変換用に同じ種類のパーサーを作成
+Parse *ParseL3S1Basic::NewWorker() const
+{
+	return new ParseL3S1Basic(pColl);
+}
+
+/// 行をまたいで持つ状態をクリア
+void ParseL3S1Basic::ResetLineState()
+{
+	Parse::ResetLineState();
+	mHasCodeFe = false;
+}
+
 /// 入力データのフォーマットチェック
 /// @param[in] in_file_info : 入力ファイルの情報
 /// @return true/false
 bool ParseL3S1Basic::CheckDataFormat(PsFileInputInfo &in_file_info)
 {
 	wxUint8 hsign[6];
+	wxUint8 head[512];
 	bool st = true;
 	PsFileFsInput in_file(in_file_info);
 	PsFileStrOutput out_data;
 
-	size_t len = in_file.Read(hsign, 3);
+	size_t len = in_file.Read(head, sizeof(head));
 
 	if (len == 0) {
 		// file is empty
@@ -94,17 +107,17 @@ bool ParseL3S1Basic::CheckDataFormat(PsFileInputInfo &in_file_info)
 	}
 
 	// テープイメージヘッダがあるか先頭から512バイトを検索
-	bool is_tape = false;
-	for(;!in_file.Eof() && len < 512; ) {
-		if (memcmp(hsign, CMT_HEADER_GAP, 3) == 0) {
-			is_tape = true;
-			break;
-		}
-		in_file.Seek(-2, wxFromCurrent);
-		in_file.Read(hsign, 3);
-		len++;
-	}
-	if (is_tape) {
+	bool is_tape = (L3TapeBlocks::FindIdent(head, len) != NULL);
+	if (D88Disk::IsD88(head, len, (size_t)in_file_info.GetFile().Length())) {
+		// ディスクイメージから最初のBASICのファイルを取り出す
+		st = CheckDiskDataFormat(in_file_info.GetFileFullPath(), out_data);
+		if (!st) return st;
+	} else if (L3WaveDecoder::IsWave(head, len)) {
+		// テープの音声を復調して実データを取り出す
+		in_file.SeekStartPos(0);
+		st = CheckWaveDataFormat(in_file, out_data);
+		if (!st) return st;
+	} else if (is_tape) {
 		// テープイメージから実データを取り出してバッファに入れる
 		in_file.SeekStartPos(0);
 		st = CheckTapeDataFormat(in_file, out_data);
@@ -176,7 +189,6 @@ int ParseL3S1Basic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType
 
 	// body
 	long next_addr;				// next address
-	int exists;
 	wxUint8 vals[10];
 	long vall;
 	wxUint32 area = 0;
@@ -188,7 +200,7 @@ int ParseL3S1Basic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType
 	wxString chrstr;
 	CodeMapItem *item;
 	int error_count = 0;	// エラー発生数
-	PsSymbol word;
+	PsSymbol word(sentence.GetArena());
 
 	while(!in_file.Eof() && phase >= PHASE_NONE) {
 		memset(vals, 0, sizeof(vals));
@@ -214,11 +226,8 @@ int ParseL3S1Basic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType
 			area &= ~STATEMENT_AREA;
 
 			// get line number
-			exists = mPos.SetLineNumber(BytesToLong(&vals[2], 2));
-			if (exists >= 0) {
-				// 同じ行番号がある
-				if (result) result->Add(mPos, prErrDuplicateLineNumber, exists + 1);
-			}
+			mPos.SetLineNumber(BytesToLong(&vals[2], 2));
+			CheckBinaryLineNumber(result);
 
 			word.Set(wxString::Format(_T("%ld "), mPos.GetLineNumber()),
 				BinString(vals, 4));
@@ -603,8 +612,12 @@ int ParseL3S1Basic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType
 /// @return true/false
 bool ParseL3S1Basic::ParseAsciiToBinary(PsFileData &in_data, PsFileData &out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE(mStats, psStageEncode);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
 	mPos.Empty();
 	mPos.SetName(_("Ascii->Binary"));
+	mLineNumbers.Empty();
 
 	mNextAddress = (out_data.GetMachineType() == MACHINE_TYPE_L3 ? iStartAddr[pConfig->GetStartAddr()] : 1);
 
@@ -612,18 +625,7 @@ bool ParseL3S1Basic::ParseAsciiToBinary(PsFileData &in_data, PsFileData &out_dat
 	out_data.Add("\xff\xff\xff", 3);
 
 	// body
-	mHasCodeFe = false;
-	mPrevLineNumber = -1;
-	for(mPos.mRow = 0; mPos.mRow < in_data.GetCount(); mPos.mRow++) {
-		if (!ParseAsciiToBinaryOneLine(in_data.GetType(), in_data[mPos.mRow], out_data, result)) {
-			break;
-		}
-		if (result && result->GetCount() > ERROR_STOPPED_COUNT) {
-			// エラーが多いので中止
-			result->Add(mPos, prErrStopInvalidBasicCode);
-			break;
-		}
-	}
+	ParseAsciiToBinaryLines(in_data, out_data, result);
 
 	// footer
 	out_data.Add("\x00\x00", 2);
@@ -644,14 +646,19 @@ bool ParseL3S1Basic::ParseAsciiToBinary(PsFileData &in_data, PsFileData &out_dat
 /// @return true/false
 bool ParseL3S1Basic::ParseAsciiToColored(PsFileData &in_data, PsFileData &out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE(mStats, psStageTokenize);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
 	mPos.Empty();
 	mPos.SetName(_("Parse Ascii"));
+	mLineNumbers.Empty();
 
 	// body
-	mHasCodeFe = false;
-	mPrevLineNumber = -1;
+	ResetLineState();
+	wxString line;
 	for(mPos.mRow = 0; mPos.mRow < in_data.GetCount(); mPos.mRow++) {
-		if (!ParseAsciiToColoredOneLine(in_data.GetType(), in_data[mPos.mRow], out_data, result)) {
+		line = in_data[mPos.mRow];
+		if (!ParseAsciiToColoredOneLine(in_data.GetType(), line, out_data, result)) {
 			break;
 		}
 	}
@@ -863,23 +870,15 @@ bool ParseL3S1Basic::ParseAsciiToSymbolsOneLine(PsFileType &in_file_type, wxStri
 
 	CodeMapItem *item;
 
-	PsSymbol word;
+	PsSymbol word(sentence.GetArena());
 
 	BinString in_str;
 	wxUint8 in_chr;
 	mPos.mCol = 0;
 
 	// line number
-	int exists = mPos.SetLineNumber(GetLineNumber(in_data, &mPos.mCol));
-	if (exists >= 0){
-		// 同じ行番号がある
-		if (result) result->Add(mPos, prErrDuplicateLineNumber, exists + 1);
-	}
-	if (mPos.GetLineNumber() < mPrevLineNumber) {
-		// 行番号が前行より小さい
-		if (result) result->Add(mPos, prErrDiscontLineNumber);
-	}
-	mPrevLineNumber = mPos.GetLineNumber();
+	mPos.SetLineNumber(GetLineNumber(in_data, &mPos.mCol));
+	CheckHomeLineNumber(result);
 
 	word.AppendAscStr(in_data.Left(mPos.mCol));
 	word.AppendBinStr(HomeLineNumToBinStr(mPos.GetLineNumber(), mNextAddress));
@@ -1169,46 +1168,59 @@ bool ParseL3S1Basic::ParseAsciiToSymbolsOneLine(PsFileType &in_file_type, wxStri
 	return true;
 }
 
-/// テキストを出力
-/// @param[in]  in_data      入力データ
+/// テキストの先頭を出力
+/// @param[in]  in_data      入力データ 先頭の行を見る
 /// @param[out] out_file     出力ファイル
-/// @return true/false
-bool ParseL3S1Basic::WriteText(PsFileData &in_data, PsFileOutput &out_file)
+void ParseL3S1Basic::WriteTextHead(PsFileData &in_data, PsFileOutput &out_file)
 {
-	// UTF-8に変換するか
-	bool utf8_mode = out_file.GetTypeFlag(psUTF8);
-	wxArrayString *inlines = &in_data.GetData();
-
-	if (!out_file.IsOpened()) {
-		return true;
-	}
-
-	if (!utf8_mode) {
-		// テープイメージの場合CR固定。ディスクイメージの場合CR+LF固定
-		int nl = (out_file.GetTypeFlag(psTapeImage) ? 0 : (out_file.GetTypeFlag(psDiskImage) ? 2 : pConfig->GetNewLineAscii()));
-//		size_t len = 0;
-		if (inlines->GetCount() > 0 && !inlines->Item(0).IsEmpty()) {
-			out_file.Write(cNLChr[nl]); // 1行目は必ず改行
-		}
-		for(size_t row = 0; row < inlines->GetCount(); row++) {
-			out_file.Write(inlines->Item(row));	// 変換しない
-			out_file.Write(cNLChr[nl]); // 改行
-		}
-		// ファイル終端コードを出力
-		if ((!out_file.GetTypeFlag(psTapeImage) && pConfig->GetEofAscii())) {
-			out_file.Write((const wxUint8 *)EOF_CODE, 1);
+	if (!out_file.GetTypeFlag(psUTF8)) {
+		if (in_data.GetCount() > 0 && in_data.GetLineLen(0) > 0) {
+			out_file.Write(cNLChr[GetNewLineText(out_file)]); // 1行目は必ず改行
 		}
 	} else {
 		if (out_file.GetTypeFlag(psUTF8BOM)) {
 			out_file.Write((const wxUint8 *)BOM_CODE, 3); // BOM
 		}
+	}
+}
 
-		for(size_t row = 0; row < inlines->GetCount(); row++) {
-			out_file.WriteUTF8(inlines->Item(row));	// UTF-8に変換して出力
+/// テキストの行を出力
+/// @note 続けて呼んで行を分けて出力できる
+/// @param[in]  in_data      入力データ
+/// @param[out] out_file     出力ファイル
+void ParseL3S1Basic::WriteTextLines(PsFileData &in_data, PsFileOutput &out_file)
+{
+	if (!out_file.GetTypeFlag(psUTF8)) {
+		int nl = GetNewLineText(out_file);
+		for(size_t row = 0; row < in_data.GetCount(); row++) {
+			out_file.WriteLine(in_data, row);	// 変換しない
+			out_file.Write(cNLChr[nl]); // 改行
+		}
+	} else {
+		for(size_t row = 0; row < in_data.GetCount(); row++) {
+			out_file.WriteLineUTF8(in_data, row);	// UTF-8に変換して出力
 			out_file.Write(cNLChr[pConfig->GetNewLineUtf8()]);	// 改行
 		}
 	}
-	return true;
+}
+
+/// テキストの末尾を出力
+/// @param[out] out_file     出力ファイル
+void ParseL3S1Basic::WriteTextTail(PsFileOutput &out_file)
+{
+	if (!out_file.GetTypeFlag(psUTF8)) {
+		// ファイル終端コードを出力
+		if ((!out_file.GetTypeFlag(psTapeImage) && pConfig->GetEofAscii())) {
+			out_file.Write((const wxUint8 *)EOF_CODE, 1);
+		}
+	}
+}
+
+/// アスキー形式テキストの改行コード
+/// @note テープイメージの場合CR固定。ディスクイメージの場合CR+LF固定
+int ParseL3S1Basic::GetNewLineText(PsFileOutput &out_file) const
+{
+	return (out_file.GetTypeFlag(psTapeImage) ? 0 : (out_file.GetTypeFlag(psDiskImage) ? 2 : pConfig->GetNewLineAscii()));
 }
 
 /// バイナリを出力
@@ -1217,15 +1229,21 @@ bool ParseL3S1Basic::WriteText(PsFileData &in_data, PsFileOutput &out_file)
 /// @return true/false
 bool ParseL3S1Basic::WriteBinary(PsFileData &in_data, PsFileOutput &out_file)
 {
-	wxArrayString *inlines = &in_data.GetData();
+	PARSE_STATS_STAGE(mStats, psStageWrite);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
 
 	if (!out_file.IsOpened()) {
 		return true;
 	}
 
 	// body
-	for(size_t row = 0; row < inlines->GetCount(); row++) {
-		out_file.Write(inlines->Item(row));
+	if (in_data.Is8Bit()) {
+		// 連続しているのでまとめて出力
+		out_file.Write(in_data.GetBuffer(), in_data.GetBufferLen());
+		return true;
+	}
+	for(size_t row = 0; row < in_data.GetCount(); row++) {
+		out_file.WriteLine(in_data, row);
 	}
 
 	return true;
@@ -1256,12 +1274,9 @@ wxString ParseL3S1Basic::GetStartAddrTitle() const
 /// @return     true
 bool ParseL3S1Basic::FloatBytesToStr(const wxUint8 *src, size_t src_len, wxString &dst)
 {
-	UINT192 cin;
-	UINT192 cpo;
 	DeciStr decs;
 
-	L3Float::RealStrToUint192(src, (int)src_len, cin, cpo);
-	L3Float::Uint192ToDeciStr(cin, cpo, src_len > 4 ? 16 : 6, decs);
+	L3Float::RealStrToDeciStr(src, (int)src_len, src_len > 4 ? 16 : 6, decs);
 
 	dst = wxString::From8BitData(decs.GetStr(0), decs.Length());
 	return true;
@@ -1342,14 +1357,10 @@ int ParseL3S1Basic::NumStrToBytes(const wxString &src, wxUint8 *dst, size_t dst_
 		buf[len] = 0xfe;
 		len++;
 
-		UINT192 cin;
-		UINT192 cpo;
-		int bytes = L3Float::DeciStrToUint192(str, (int)str.Length(), cin, cpo);
-		bytes *= 4;
+		int bytes = 0;
+		int rc = L3Float::DeciStrToRealStr(str, (int)str.Length(), &buf[len+1], bytes);
 		buf[len] = (bytes & 0xf);
 		len++;
-
-		int rc = L3Float::Uint192ToRealStr(cin, cpo, &buf[len], bytes);
 		len += bytes;
 		if (rc != 0) {
 			// オーバーフロー or アンダーフロー
@@ -1520,6 +1531,24 @@ int ParseL3S1Basic::GetInternalNameSize() const
 	return 8;
 }
 
+/// テープイメージを音声(WAV)で出力できるか
+bool ParseL3S1Basic::CanExportTapeAudio() const
+{
+	return true;
+}
+
+/// ディスクイメージ(D88)の中に書き込めるか
+bool ParseL3S1Basic::CanExportDiskImage() const
+{
+	return true;
+}
+
+/// 中に書き込むディスクイメージの拡張子を返す
+const wxChar *ParseL3S1Basic::GetDiskImageFileExtension() const
+{
+	return wxT("d88");
+}
+
 /// BASICが拡張BASICかどうか
 bool ParseL3S1Basic::IsExtendedBasic(const wxString &basic_type)
 {
@@ -1548,9 +1577,9 @@ wxString ParseL3S1Basic::GetMachineName() const
 const wxChar *ParseL3S1Basic::GetOpenFileExtensions() const
 {
 #if defined(__WXMSW__)
-	return _("Supported files|*.bin;*.bas;*.txt;*.dat;*.l3|All files|*.*");
+	return _("Supported files|*.bin;*.bas;*.txt;*.dat;*.l3;*.d88;*.wav|All files|*.*");
 #else
-	return _("Supported files|*.bin;*.BIN;*.bas;*.BAS;*.txt;*.TXT;*.dat;*.DAT;*.l3;*.L3|All files|*.*");
+	return _("Supported files|*.bin;*.BIN;*.bas;*.BAS;*.txt;*.TXT;*.dat;*.DAT;*.l3;*.L3;*.d88;*.D88;*.wav;*.WAV|All files|*.*");
 #endif
 }
 
@@ -1563,5 +1592,13 @@ const wxChar *ParseL3S1Basic::GetExportBasicBinaryTapeImageExtension() const
 /// BASICバイナリテープイメージエクスポート時の拡張子リストを返す
 const wxChar *ParseL3S1Basic::GetExportBasicBinaryTapeImageExtensions() const
 {
-	return _("Tape Image (*.l3)|*.l3|All Files (*.*)|*.*");
+	return _("Tape Image (*.l3)|*.l3|WAV Audio (*.wav)|*.wav|All Files (*.*)|*.*");
+}
+
+/// BASICバイナリディスクイメージエクスポート時の拡張子リストを返す
+///
+/// D88を選ぶと既存のイメージの中にファイルとして書き込む。
+const wxChar *ParseL3S1Basic::GetExportBasicBinaryDiskImageExtensions() const
+{
+	return _("DISK BASIC File (*.BAS)|*.BAS|DISK BASIC File (*.bas)|*.bas|D88 Disk Image (*.d88)|*.d88|All Files (*.*)|*.*");
 }
@@ -18,6 +18,9 @@
 #include "parseresult.h"
 #include "parseparam.h"
 #include "parse.h"
+#include "l3tape.h"
+#include "l3wave.h"
+#include "l3disk.h"
 
 // テープのギャップ
 #define CMT_HEADER_GAP "\xff\x01\x3c"
@@ -27,6 +30,8 @@ class ParseL3S1Basic : public Parse
 {
 protected:
 	bool mHasCodeFe;	// コード0xfeが入っている
+	wxArrayInt mTapeBadBlocks;	///< 読み込んだテープイメージでチェックサムが合わないブロック
+	L3WaveParam mWaveParam;		///< カセットテープの音声の形式
 
 	/// 初期設定
 	enum enL3DefaultConfigs {
@@ -47,11 +52,17 @@ protected:
 	wxString GetBasicCodeTableFileName() const;
 	/// 初期設定値をセット
 	void SetDefaultConfigParam();
+	/// 並列変換用に同じ種類のパーサーを作成
+	Parse *NewWorker() const;
 
 	/// 入力データのフォーマットチェック
 	bool CheckDataFormat(PsFileInputInfo &in_file_info);
 	/// テープイメージのフォーマットチェック
 	bool CheckTapeDataFormat(PsFileInput &in_data, PsFileOutput &out_data);
+	/// WAVファイルのフォーマットチェック
+	bool CheckWaveDataFormat(PsFileInput &in_data, PsFileOutput &out_data);
+	/// ディスクイメージのフォーマットチェック
+	bool CheckDiskDataFormat(const wxString &path, PsFileOutput &out_data);
 //	/// 中間言語形式データのフォーマットチェック
 //	bool CheckBinaryDataFormat(PsFileInput &in_data);
 //	/// アスキー形式データのフォーマットチェック
@@ -84,18 +95,28 @@ protected:
 //	bool ParseAsciiToBinaryOneLine(PsFileType &in_file_type, wxString &in_data, PsFileData &out_data, ParseResult *result = NULL);
 //	/// アスキー形式1行を解析して色付けする
 //	bool ParseAsciiToColoredOneLine(PsFileType &in_file_type, wxString &in_data, PsFileData &out_data, ParseResult *result = NULL);
+	/// 行をまたいで持つ状態をクリア
+	void ResetLineState();
 	/// アスキー形式1行を解析する
 	bool ParseAsciiToSymbolsOneLine(PsFileType &in_file_type, wxString &in_data, PsFileType &out_type, PsSymbolSentence &sentence, ParseResult *result = NULL);
 //	/// アスキー形式テキストを読む
 //	int  ReadAsciiText(PsFileInput &in_data, PsFileData &out_data, bool to_utf8 = false);
 //	/// アスキー文字列を出力
 //	size_t WriteAsciiString(size_t len, const wxString &in_line, wxFile *out_data);
-	/// テキストを出力
-	bool WriteText(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの先頭を出力
+	void WriteTextHead(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの行を出力
+	void WriteTextLines(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの末尾を出力
+	void WriteTextTail(PsFileOutput &out_file);
+	/// アスキー形式テキストの改行コード
+	int  GetNewLineText(PsFileOutput &out_file) const;
 	/// バイナリを出力
 	bool WriteBinary(PsFileData &in_data, PsFileOutput &out_file);
 	/// 実データをテープイメージにして出力
 	bool WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &out_file);
+	/// 実データをディスクイメージの中のファイルとして書き込む
+	bool WriteDiskImageFromRealData(PsFileInput &in_file, const wxString &image_path);
 //	/// アスキー形式からUTF-8テキストに変換
 //	bool ConvAsciiToUTF8(PsFileData &in_data, PsFileData *out_data, ParseResult *result = NULL);
 //	/// UTF-8テキストからアスキー形式に変換
@@ -198,6 +219,22 @@ public:
 //	int  ConvUTF8ToAsciiOneLine(const wxString &in_type, size_t row, const wxString &in_line, wxString &out_line, ParseResult *result = NULL);
 	/// テープイメージの内部ファイル名の最大文字数を返す
 	int GetInternalNameSize() const;
+	/// テープイメージを音声(WAV)で出力できるか
+	bool CanExportTapeAudio() const;
+	/// ディスクイメージの中に書き込めるか
+	bool CanExportDiskImage() const;
+	/// 中に書き込むディスクイメージの拡張子を返す
+	const wxChar *GetDiskImageFileExtension() const;
+	/// 複数のファイルが入ったテープイメージを開く
+	bool OpenTapeArchive(const wxString &path, L3TapeArchive &archive);
+	/// テープイメージのチェックサムだけを調べる
+	bool VerifyTapeImage(const wxString &path, L3TapeArchive &archive, wxArrayInt &bad_blocks);
+	/// DISK BASICのディスクイメージを開く
+	bool OpenDiskImage(const wxString &path, L3DiskBasic &disk, bool writable = false);
+	/// カセットテープの音声の形式を設定
+	void SetWaveParam(const L3WaveParam &param) { mWaveParam = param; }
+	/// カセットテープの音声の形式
+	const L3WaveParam &GetWaveParam() const { return mWaveParam; }
 	/// BASICが拡張BASICかどうか
 	bool IsExtendedBasic(const wxString &basic_type);
 	/// マシンタイプの判別
@@ -210,6 +247,8 @@ public:
 	const wxChar *GetExportBasicBinaryTapeImageExtension() const;
 	/// BASICバイナリテープイメージエクスポート時の拡張子リストを返す
 	const wxChar *GetExportBasicBinaryTapeImageExtensions() const;
+	/// BASICバイナリディスクイメージエクスポート時の拡張子リストを返す
+	const wxChar *GetExportBasicBinaryDiskImageExtensions() const;
 };
 
 #endif /* _PARSE_L3S1BASIC_H_ */
@@ -8,10 +8,10 @@
 #include <wx/filename.h>
 #include <wx/wfstream.h>
 #include <wx/arrimpl.cpp>
-#include "main.h"
 #include "config.h"
 //#include "msxspecs.h"
 #include "pssymbol.h"
+#include "msxbcd.h"
 
 /// マシンタイプ
 #define MACHINE_TYPE_MSX 1
@@ -70,6 +70,12 @@ void ParseMSXBasic::SetDefaultConfigParam()
 	pConfig->SetStartAddr(eMSXDefaultStartAddr);
 }
 
+/// 並列変換用に同じ種類のパーサーを作成
+Parse *ParseMSXBasic::NewWorker() const
+{
+	return new ParseMSXBasic(pColl);
+}
+
 /// 入力データのフォーマットチェック
 /// @param[in] in_file_info : 入力ファイルの情報
 /// @return true/false
@@ -92,6 +98,9 @@ bool ParseMSXBasic::CheckDataFormat(PsFileInputInfo &in_file_info)
 
 	in_file.SetTypeFlag(psAscii, true);
 
+	// ディスクイメージか
+	bool is_disk = MsxDisk::IsMsxDisk(hsign, len, (size_t)in_file_info.GetFile().Length());
+
 	// テープイメージヘッダがあるか先頭から8バイトを検索
 	hp = hsign;
 	bool is_tape = false;
@@ -115,7 +124,11 @@ bool ParseMSXBasic::CheckDataFormat(PsFileInputInfo &in_file_info)
 	}
 
 	out_data.SetType(in_file.GetType());
-	if (is_tape) {
+	if (is_disk) {
+		// ディスクイメージから最初のBASICのファイルを取り出す
+		st = CheckDiskDataFormat(in_file_info.GetFileFullPath(), out_data);
+		if (!st) return st;
+	} else if (is_tape) {
 		// テープイメージから実データを取り出してバッファに入れる
 		in_file.SeekStartPos(0);
 		st = CheckTapeDataFormat(in_file, out_data);
@@ -191,7 +204,6 @@ int ParseMSXBasic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType &
 
 	// body
 	long next_addr;				// next address
-	int exists;
 	wxUint8 vals[10];
 	long vall;
 	wxUint32 area = 0;
@@ -203,7 +215,7 @@ int ParseMSXBasic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType &
 	wxString chrstr;
 	CodeMapItem *item;
 	int error_count = 0;	// エラー発生数
-	PsSymbol word;
+	PsSymbol word(sentence.GetArena());
 
 	while(!in_file.Eof() && phase >= PHASE_NONE) {
 		memset(vals, 0, sizeof(vals));
@@ -229,11 +241,8 @@ int ParseMSXBasic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType &
 			area &= ~STATEMENT_AREA;
 
 			// get line number
-			exists = mPos.SetLineNumber(BytesToLong(&vals[2], 2));
-			if (exists >= 0) {
-				// 同じ行番号がある
-				if (result) result->Add(mPos, prErrDuplicateLineNumber, exists + 1);
-			}
+			mPos.SetLineNumber(BytesToLong(&vals[2], 2));
+			CheckBinaryLineNumber(result);
 
 			word.Set(wxString::Format(_T("%ld "), mPos.GetLineNumber()),
 				BinString(vals, 4));
@@ -648,8 +657,12 @@ int ParseMSXBasic::ReadBinaryToSymbolsOneLine(PsFileInput &in_file, PsFileType &
 /// @return true/false
 bool ParseMSXBasic::ParseAsciiToBinary(PsFileData &in_data, PsFileData &out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE(mStats, psStageEncode);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
 	mPos.Empty();
 	mPos.SetName(_("Ascii->Binary"));
+	mLineNumbers.Empty();
 
 	mNextAddress = iStartAddr[pConfig->GetStartAddr()];
 
@@ -658,17 +671,7 @@ bool ParseMSXBasic::ParseAsciiToBinary(PsFileData &in_data, PsFileData &out_data
 	mNextAddress += 1;
 
 	// body
-	mPrevLineNumber = -1;
-	for(mPos.mRow = 0; mPos.mRow < in_data.GetCount(); mPos.mRow++) {
-		if (!ParseAsciiToBinaryOneLine(in_data.GetType(), in_data[mPos.mRow], out_data, result)) {
-			break;
-		}
-		if (result && result->GetCount() > ERROR_STOPPED_COUNT) {
-			// エラーが多いので中止
-			result->Add(mPos, prErrStopInvalidBasicCode);
-			break;
-		}
-	}
+	ParseAsciiToBinaryLines(in_data, out_data, result);
 
 	// footer
 	out_data.Add("\x00\x00", 2);
@@ -689,13 +692,19 @@ bool ParseMSXBasic::ParseAsciiToBinary(PsFileData &in_data, PsFileData &out_data
 /// @return true/false
 bool ParseMSXBasic::ParseAsciiToColored(PsFileData &in_data, PsFileData &out_data, ParseResult *result)
 {
+	PARSE_STATS_STAGE(mStats, psStageTokenize);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
+
 	mPos.Empty();
 	mPos.SetName(_("Parse Ascii"));
+	mLineNumbers.Empty();
 
 	// body
-	mPrevLineNumber = -1;
+	ResetLineState();
+	wxString line;
 	for(mPos.mRow = 0; mPos.mRow < in_data.GetCount(); mPos.mRow++) {
-		if (!ParseAsciiToColoredOneLine(in_data.GetType(), in_data[mPos.mRow], out_data, result)) {
+		line = in_data[mPos.mRow];
+		if (!ParseAsciiToColoredOneLine(in_data.GetType(), line, out_data, result)) {
 			break;
 		}
 	}
@@ -882,23 +891,15 @@ bool ParseMSXBasic::ParseAsciiToSymbolsOneLine(PsFileType &in_file_type, wxStrin
 
 	CodeMapItem *item;
 
-	PsSymbol word;
+	PsSymbol word(sentence.GetArena());
 
 	BinString in_str;
 	wxUint8 in_chr;
 	mPos.mCol = 0;
 
 	// line number
-	int exists = mPos.SetLineNumber(GetLineNumber(in_data, &mPos.mCol));
-	if (exists >= 0){
-		// 同じ行番号がある
-		if (result) result->Add(mPos, prErrDuplicateLineNumber, exists + 1);
-	}
-	if (mPos.GetLineNumber() < mPrevLineNumber) {
-		// 行番号が前行より小さい
-		if (result) result->Add(mPos, prErrDiscontLineNumber);
-	}
-	mPrevLineNumber = mPos.GetLineNumber();
+	mPos.SetLineNumber(GetLineNumber(in_data, &mPos.mCol));
+	CheckHomeLineNumber(result);
 
 	word.AppendAscStr(in_data.Left(mPos.mCol));
 	word.AppendBinStr(HomeLineNumToBinStr(mPos.GetLineNumber(), mNextAddress));
@@ -1186,39 +1187,36 @@ bool ParseMSXBasic::ParseAsciiToSymbolsOneLine(PsFileType &in_file_type, wxStrin
 	return true;
 }
 
-/// テキストを出力
+/// テキストの先頭を出力
 /// @param[in]  in_data      入力データ
 /// @param[out] out_file     出力ファイル
-/// @return true/false
-bool ParseMSXBasic::WriteText(PsFileData &in_data, PsFileOutput &out_file)
+void ParseMSXBasic::WriteTextHead(PsFileData &in_data, PsFileOutput &out_file)
 {
-	// UTF-8に変換するか
-	bool utf8_mode = out_file.GetTypeFlag(psUTF8);
-	wxArrayString *inlines = &in_data.GetData();
-
-	if (!out_file.IsOpened()) {
-		return true;
+	if (out_file.GetTypeFlag(psUTF8) && out_file.GetTypeFlag(psUTF8BOM)) {
+		out_file.Write((const wxUint8 *)BOM_CODE, 3); // BOM
 	}
+}
 
-	if (!utf8_mode) {
+/// テキストの行を出力
+/// @note 続けて呼んで行を分けて出力できる
+/// @param[in]  in_data      入力データ
+/// @param[out] out_file     出力ファイル
+void ParseMSXBasic::WriteTextLines(PsFileData &in_data, PsFileOutput &out_file)
+{
+	if (!out_file.GetTypeFlag(psUTF8)) {
 		// アスキー そのまま出力
-		for(size_t row = 0; row < inlines->GetCount(); row++) {
-			out_file.Write(inlines->Item(row));	// 変換しない
+		for(size_t row = 0; row < in_data.GetCount(); row++) {
+			out_file.WriteLine(in_data, row);	// 変換しない
 			out_file.Write(cNLChr[pConfig->GetNewLineAscii()]); // 改行
 		}
 
 	} else {
 		// UTF-8
-		if (out_file.GetTypeFlag(psUTF8BOM)) {
-			out_file.Write((const wxUint8 *)BOM_CODE, 3); // BOM
-		}
-
-		for(size_t row = 0; row < inlines->GetCount(); row++) {
-			out_file.WriteUTF8(inlines->Item(row));	// UTF-8に変換して出力
+		for(size_t row = 0; row < in_data.GetCount(); row++) {
+			out_file.WriteLineUTF8(in_data, row);	// UTF-8に変換して出力
 			out_file.Write(cNLChr[pConfig->GetNewLineUtf8()]);	// 改行
 		}
 	}
-	return true;
 }
 
 /// バイナリを出力
@@ -1227,15 +1225,21 @@ bool ParseMSXBasic::WriteText(PsFileData &in_data, PsFileOutput &out_file)
 /// @return true/false
 bool ParseMSXBasic::WriteBinary(PsFileData &in_data, PsFileOutput &out_file)
 {
-	wxArrayString *inlines = &in_data.GetData();
+	PARSE_STATS_STAGE(mStats, psStageWrite);
+	PARSE_STATS_COUNT(in_data.GetBufferLen(), in_data.GetCount());
 
 	if (!out_file.IsOpened()) {
 		return true;
 	}
 
 	// body
-	for(size_t row = 0; row < inlines->GetCount(); row++) {
-		out_file.Write(inlines->Item(row));
+	if (in_data.Is8Bit()) {
+		// 連続しているのでまとめて出力
+		out_file.Write(in_data.GetBuffer(), in_data.GetBufferLen());
+		return true;
+	}
+	for(size_t row = 0; row < in_data.GetCount(); row++) {
+		out_file.WriteLine(in_data, row);
 	}
 
 	return true;
@@ -1260,62 +1264,9 @@ int ParseMSXBasic::GetStartAddrCount() const
 /// @return     true
 bool ParseMSXBasic::FloatBytesToStr(const wxUint8 *src, size_t src_len, wxString &dst)
 {
-	// 指数部が0の時は"0"
-	if ((src[0] & 0x7f) == 0) {
-		dst = _T("0");
-		return true;
-	}
-
-	// 指数表記にするか
-	bool expview = true;
-	// 指数
-	int ex = (int)(src[0] & 0x7f) - 64;
-	if (-1 <= ex && ex <= 13) {
-		expview = false;
-	} else {
-		ex--;
-	}
-
-	dst = _T("");
-	// 符号
-	if (src[0] & 0x80) {
-		dst += _T("-");
-	}
-	
-	// 仮数部の0をトリミング
-	int len = (int)src_len * 2 - 1;
-	for(;len >= 2; len--) {
-		if (src[len >> 1] & (0xf0 >> ((len & 1) << 2))) break; 
-	}
-
-	if (expview) {
-		// 指数表記
-		// 仮数部(BCD)
-		for(int i=2; i <= len; i++) {
-			if (i == 3) dst += _T(".");
-			dst += wxString::Format(_T("%d"), (src[i >> 1] & (0xf0 >> ((i & 1) << 2))) >> ((1 - (i & 1)) << 2));
-		}
-		dst += _T("E");
-		dst += wxString::Format(_T("%+03d"), ex);
-	} else {
-		// 実数表記
-		// 仮数部(BCD)
-		int imin = ex < 0 ? ex + 2 : 2;
-		int imax = ex >= len ? ex + 1 : len;
-		for(int i=imin; i <= imax; i++) {
-			if (i == (ex + 2)) dst += _T(".");
-			if (2 <= i && i <= len) {
-				dst += wxString::Format(_T("%d"), (src[i >> 1] & (0xf0 >> ((i & 1) << 2))) >> ((1 - (i & 1)) << 2));
-			} else {
-				dst += _T("0");
-			}
-		}
-		if (src_len == 8) {
-			dst += _T("#");	// 倍精度
-		} else {
-			dst += _T("!");	// 単精度
-		}
-	}
+	char buf[MSXBCD_STR_MAX];
+	int len = MSXBcd::BytesToStr(src, (int)src_len, buf);
+	dst = wxString::From8BitData(buf, len);
 	return true;
 }
 
@@ -1397,79 +1348,33 @@ int ParseMSXBasic::NumStrToBytes(const wxString &src, wxUint8 *dst, size_t dst_l
 		}
 	} else {
 		// 実数
-		if (str.Right(1) == _T("!") || str.Right(1) == _T("#")) {
-			str = str.Left(str.Len()-1);
-		}
-
-		int epos = str.Find(_T("E"));
-		wxString vtval;
-		long exval;
-		if (epos != wxNOT_FOUND) {
-			vtval = str.Left(epos);
-			str.Mid(epos+1).ToLong(&exval);
-		} else {
-			vtval = str;
-			exval = 0;
-		}
-		// shift point
-		int ppos = vtval.Find(_T("."));
-		if (ppos == wxNOT_FOUND) {
-			exval += str.Len();
-		} else {
-			exval += ppos;
-			if (ppos > 0) vtval = vtval.Left(ppos) + vtval.Mid(ppos+1);
-			else vtval = vtval.Mid(ppos+1);
-		}
-		// trim left zero
-		while(vtval.Len() > 0) {
-			if (vtval.Left(1) != _T("0")) break;
-			exval--;
-			vtval = vtval.Mid(1);
-			if (exval <= -63) break;
-		}
-		// trim right zero
-		while(vtval.Len() > 0) {
-			if (vtval.Right(1) != _T("0")) break;
-			vtval = vtval.Left(vtval.Len()-1);
-		}
-
-		// "0"の場合
-		if (vtval == _T("0")) {
+		wxScopedCharBuffer sbuf = str.To8BitData();
+		wxUint8 bcd[8];
+		int bcd_len = 0;
+		switch(MSXBcd::StrToBytes(sbuf.data(), (int)str.Len(), bcd, bcd_len)) {
+		case MSXBcd::BCD_ZERO:
 			// 整数の0で表記
 			buf[len] = CODE_NUMBER0;
 			len++;
-			goto FIN;
-		}
-
-		size_t cols = 0;
-		if (vtval.Len() <= 6) {
+			break;
+		case MSXBcd::BCD_SINGLE:
 			// 単精度
 			buf[len] = CODE_FLOAT;
 			len++;
-			cols = 6;
-		} else if (vtval.Len() <= 14) {
+			break;
+		case MSXBcd::BCD_DOUBLE:
 			// 倍精度
 			buf[len] = CODE_DOUBLE;
 			len++;
-			cols = 14;
-		} else {
+			break;
+		default:
 			// オーバーフロー
 			return 0;
 		}
-		// 指数部
-		buf[len] = (exval+64) & 0xff;
-		len++;
-		// 仮数部(BCD)
-		for(size_t i=0; i<cols; i+=2) {
-			long v1 = 0;
-			long v2 = 0;
-			if (i < vtval.Len()) vtval.Mid(i,1).ToLong(&v1); 
-			if (i+1 < vtval.Len()) vtval.Mid(i+1,1).ToLong(&v2); 
-			buf[len] = (v1 * 16 + v2) & 0xff;
-			len++;
-		}
+		// 指数部と仮数部(BCD)
+		memcpy(&buf[len], bcd, bcd_len);
+		len += bcd_len;
 	}
-FIN:
 	if ((size_t)len > dst_len) {
 		// buffer overflow
 		return 0;
@@ -1637,6 +1542,18 @@ int ParseMSXBasic::GetInternalNameSize() const
 	return 6;
 }
 
+/// ディスクイメージ(DSK)の中に書き込めるか
+bool ParseMSXBasic::CanExportDiskImage() const
+{
+	return true;
+}
+
+/// 中に書き込むディスクイメージの拡張子を返す
+const wxChar *ParseMSXBasic::GetDiskImageFileExtension() const
+{
+	return wxT("dsk");
+}
+
 /// BASICが拡張BASICかどうか
 bool ParseMSXBasic::IsExtendedBasic(const wxString &basic_type)
 {
@@ -1659,8 +1576,16 @@ wxString ParseMSXBasic::GetMachineName() const
 const wxChar *ParseMSXBasic::GetOpenFileExtensions() const
 {
 #if defined(__WXMSW__)
-	return _("Supported files|*.cas;*.bin;*.bas;*.txt;*.dat|All files|*.*");
+	return _("Supported files|*.cas;*.bin;*.bas;*.txt;*.dat;*.dsk|All files|*.*");
 #else
-	return _("Supported files|*.cas;*.CAS;*.bin;*.BIN;*.bas;*.BAS;*.txt;*.TXT;*.dat;*.DAT|All files|*.*");
+	return _("Supported files|*.cas;*.CAS;*.bin;*.BIN;*.bas;*.BAS;*.txt;*.TXT;*.dat;*.DAT;*.dsk;*.DSK|All files|*.*");
 #endif
 }
+
+/// BASICバイナリディスクイメージエクスポート時の拡張子リストを返す
+///
+/// DSKを選ぶと既存のイメージの中にファイルとして書き込む。
+const wxChar *ParseMSXBasic::GetExportBasicBinaryDiskImageExtensions() const
+{
+	return _("DISK BASIC File (*.BAS)|*.BAS|DISK BASIC File (*.bas)|*.bas|DSK Disk Image (*.dsk)|*.dsk|All Files (*.*)|*.*");
+}
@@ -18,14 +18,8 @@
 #include "parseresult.h"
 #include "parseparam.h"
 #include "parse.h"
-
-/// casetteヘッダ種類
-#define CAS_HEADER_BASIC	"\xD3\xD3\xD3\xD3\xD3\xD3\xD3\xD3\xD3\xD3"
-#define CAS_HEADER_ASCII	"\xEA\xEA\xEA\xEA\xEA\xEA\xEA\xEA\xEA\xEA"
-#define CAS_HEADER_MACHINE	"\xD0\xD0\xD0\xD0\xD0\xD0\xD0\xD0\xD0\xD0"
-
-/// fMSX-DOS Casetteヘッダ
-#define FMSX_HEADER "\x1F\xA6\xDE\xBA\xCC\x13\x7D\x74"
+#include "msxtape.h"
+#include "msxdisk.h"
 
 /// パーサークラス
 class ParseMSXBasic : public Parse
@@ -49,11 +43,15 @@ protected:
 	wxString GetBasicCodeTableFileName() const;
 	/// 初期設定値をセット
 	void SetDefaultConfigParam();
+	/// 並列変換用に同じ種類のパーサーを作成
+	Parse *NewWorker() const;
 
 	/// 入力データのフォーマットチェック
 	bool CheckDataFormat(PsFileInputInfo &in_file_info);
 	/// テープイメージのフォーマットチェック
 	bool CheckTapeDataFormat(PsFileInput &in_data, PsFileOutput &out_data);
+	/// ディスクイメージのフォーマットチェック
+	bool CheckDiskDataFormat(const wxString &path, PsFileOutput &out_data);
 //	/// 中間言語形式データのフォーマットチェック
 //	bool CheckBinaryDataFormat(PsFileInput &in_data);
 //	/// アスキー形式データのフォーマットチェック
@@ -92,12 +90,16 @@ protected:
 //	int  ReadAsciiText(PsFileInput &in_data, PsFileData &out_data, bool to_utf8 = false);
 //	/// アスキー文字列を出力
 //	size_t WriteAsciiString(size_t len, const wxString &in_line, wxFile *out_data);
-	/// テキストを出力
-	bool WriteText(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの先頭を出力
+	void WriteTextHead(PsFileData &in_data, PsFileOutput &out_file);
+	/// テキストの行を出力
+	void WriteTextLines(PsFileData &in_data, PsFileOutput &out_file);
 	/// バイナリを出力
 	bool WriteBinary(PsFileData &in_data, PsFileOutput &out_file);
 	/// 実データをテープイメージにして出力
 	bool WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &out_file);
+	/// 実データをディスクイメージの中のファイルとして書き込む
+	bool WriteDiskImageFromRealData(PsFileInput &in_file, const wxString &image_path);
 //	/// アスキー形式からUTF-8テキストに変換
 //	bool ConvAsciiToUTF8(PsFileData &in_data, PsFileData *out_data, ParseResult *result = NULL);
 //	/// UTF-8テキストからアスキー形式に変換
@@ -196,6 +198,12 @@ public:
 //	int  ConvUTF8ToAsciiOneLine(const wxString &in_type, size_t row, const wxString &in_line, wxString &out_line, ParseResult *result = NULL);
 	/// テープイメージの内部ファイル名の最大文字数を返す
 	int GetInternalNameSize() const;
+	/// ディスクイメージの中に書き込めるか
+	bool CanExportDiskImage() const;
+	/// 中に書き込むディスクイメージの拡張子を返す
+	const wxChar *GetDiskImageFileExtension() const;
+	/// MSX-DOSのディスクイメージを開く
+	bool OpenDiskImage(const wxString &path, MsxDisk &disk, bool writable = false);
 	/// BASICが拡張BASICかどうか
 	bool IsExtendedBasic(const wxString &basic_type);
 	/// マシンタイプの判別
@@ -204,6 +212,8 @@ public:
 	wxString GetMachineName() const;
 	/// ファイルオープン時の拡張子リストを返す
 	const wxChar *GetOpenFileExtensions() const;
+	/// BASICバイナリディスクイメージエクスポート時の拡張子リストを返す
+	const wxChar *GetExportBasicBinaryDiskImageExtensions() const;
 };
 
 #endif /* _PARSE_MSXBASIC_H_ */
@@ -0,0 +1,59 @@
+﻿/// @file parsedisk_l3s1basic.cpp
+///
+/// @brief ディスクイメージパーサー
+///
+#include "parse_l3s1basic.h"
+
+/// ディスクイメージのフォーマットチェック
+///
+/// D88のイメージをマップしてディレクトリの最初のBASICのファイルを取り出す。
+/// @param[in]  path     イメージのファイル
+/// @param[out] out_data 取り出したファイルのデータ
+/// @return 読めない場合false
+bool ParseL3S1Basic::CheckDiskDataFormat(const wxString &path, PsFileOutput &out_data)
+{
+	L3DiskBasic disk;
+	if (!OpenDiskImage(path, disk)) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	int idx = disk.FindBasic();
+	if (idx < 0) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskNoBasic);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	const L3DiskFile &file = disk[idx];
+	out_data.SetInternalName(file.raw_name, L3DISK_NAME_LEN);
+	out_data.SetTypeFlag(psAscii, disk.IsAscii(idx));
+	if (disk.Write(idx, out_data) != file.data_len) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	out_data.SetTypeFlag(psDiskImage, true);
+	return true;
+}
+
+/// 実データをディスクイメージの中のファイルとして書き込む
+///
+/// D88のDISK BASICのディスクとしてParse::WriteDiskImageFileで書く。
+/// @param[in] in_file    実データ
+/// @param[in] image_path D88のイメージ
+/// @return 書き込めなかった場合false
+bool ParseL3S1Basic::WriteDiskImageFromRealData(PsFileInput &in_file, const wxString &image_path)
+{
+	L3DiskBasic disk;
+	return WriteDiskImageFile(in_file, image_path, disk);
+}
+
+/// DISK BASICのディスクイメージを開く
+/// @param[in]  path     イメージのファイル
+/// @param[out] disk     ディスク
+/// @param[in]  writable ファイルを書き込むか
+/// @return D88でないかディレクトリを読めない場合false
+bool ParseL3S1Basic::OpenDiskImage(const wxString &path, L3DiskBasic &disk, bool writable)
+{
+	return disk.Open(path, writable);
+}
@@ -0,0 +1,59 @@
+﻿/// @file parsedisk_msxbasic.cpp
+///
+/// @brief ディスクイメージパーサー
+///
+#include "parse_msxbasic.h"
+
+/// ディスクイメージのフォーマットチェック
+///
+/// MSX-DOSのイメージをマップしてルートディレクトリの最初のBASICのファイルを取り出す。
+/// 中間言語のファイルは先頭のFFも含めて取り出すので、形式はデータの先頭で判定する。
+/// @param[in]  path     イメージのファイル
+/// @param[out] out_data 取り出したファイルのデータ
+/// @return 読めない場合false
+bool ParseMSXBasic::CheckDiskDataFormat(const wxString &path, PsFileOutput &out_data)
+{
+	MsxDisk disk;
+	if (!OpenDiskImage(path, disk)) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	int idx = disk.FindBasic();
+	if (idx < 0) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskNoBasic);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	const MsxDiskFile &file = disk[idx];
+	out_data.SetInternalName(file.raw_name, MSXDISK_NAME_LEN);
+	if (disk.Write(idx, out_data) != file.size) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrDiskFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	out_data.SetTypeFlag(psDiskImage, true);
+	return true;
+}
+
+/// 実データをディスクイメージの中のファイルとして書き込む
+///
+/// MSX-DOSのディスクとしてParse::WriteDiskImageFileで書く。
+/// @param[in] in_file    実データ
+/// @param[in] image_path DSKのイメージ
+/// @return 書き込めなかった場合false
+bool ParseMSXBasic::WriteDiskImageFromRealData(PsFileInput &in_file, const wxString &image_path)
+{
+	MsxDisk disk;
+	return WriteDiskImageFile(in_file, image_path, disk);
+}
+
+/// MSX-DOSのディスクイメージを開く
+/// @param[in]  path     イメージのファイル
+/// @param[out] disk     ディスク
+/// @param[in]  writable ファイルを書き込むか
+/// @return MSX-DOSのディスクでないかFATを読めない場合false
+bool ParseMSXBasic::OpenDiskImage(const wxString &path, MsxDisk &disk, bool writable)
+{
+	return disk.Open(path, writable);
+}
@@ -0,0 +1,535 @@
+﻿/// @file parsepipeline.cpp
+///
+/// @brief 中間言語からテキストへのエクスポートを段階ごとのスレッドで行う
+///
+#include "parsepipeline.h"
+#include "parse.h"
+
+/// 段階の名称
+static const char *cPipeStageNames[ppStageCount] = {
+	"decode",
+	"convert",
+	"write",
+};
+
+//////////////////////////////////////////////////////////////////////
+
+ParsePipelineStats::ParsePipelineStats()
+{
+	Empty();
+}
+
+void ParsePipelineStats::Empty()
+{
+	mRuns = 0;
+	for(int i=0; i<ppStageCount; i++) {
+		mBusy[i] = 0;
+		mWaitIn[i] = 0;
+		mWaitOut[i] = 0;
+		mBatches[i] = 0;
+		mLines[i] = 0;
+		mBytes[i] = 0;
+	}
+	mLatencyCount = 0;
+	mLatencySum = 0;
+	mLatencyMax = 0;
+}
+
+/// 計測結果を加算
+void ParsePipelineStats::Add(const ParsePipelineStats &src)
+{
+	mRuns += src.mRuns;
+	for(int i=0; i<ppStageCount; i++) {
+		mBusy[i] += src.mBusy[i];
+		mWaitIn[i] += src.mWaitIn[i];
+		mWaitOut[i] += src.mWaitOut[i];
+		mBatches[i] += src.mBatches[i];
+		mLines[i] += src.mLines[i];
+		mBytes[i] += src.mBytes[i];
+	}
+	mLatencyCount += src.mLatencyCount;
+	mLatencySum += src.mLatencySum;
+	if (mLatencyMax < src.mLatencyMax) mLatencyMax = src.mLatencyMax;
+}
+
+/// 1かたまりの処理時間と処理量を加算
+void ParsePipelineStats::AddBusy(PipeStage stage, wxLongLong usec, wxUint64 lines, wxUint64 bytes)
+{
+	mBusy[stage] += usec;
+	mBatches[stage]++;
+	mLines[stage] += lines;
+	mBytes[stage] += bytes;
+}
+
+/// 待ち時間を加算
+void ParsePipelineStats::AddWait(PipeStage stage, wxLongLong wait_in, wxLongLong wait_out)
+{
+	mWaitIn[stage] += wait_in;
+	mWaitOut[stage] += wait_out;
+}
+
+/// かたまりの遅延を加算
+void ParsePipelineStats::AddLatency(wxLongLong usec)
+{
+	mLatencyCount++;
+	mLatencySum += usec;
+	if (mLatencyMax < usec) mLatencyMax = usec;
+}
+
+const char *ParsePipelineStats::StageName(PipeStage stage)
+{
+	return cPipeStageNames[stage];
+}
+
+/// 平均遅延(usec)
+double ParsePipelineStats::GetLatencyAverage() const
+{
+	return mLatencyCount > 0 ? mLatencySum.ToDouble() / (double)mLatencyCount : 0.0;
+}
+
+/// 表形式の文字列にする
+void ParsePipelineStats::Report(wxArrayString &lines) const
+{
+	lines.Add(wxString::Format(_T("%-10s %8s %10s %12s %13s %10s"),
+		"pipeline", "batches", "busy(ms)", "wait in(ms)", "wait out(ms)", "lines"));
+	for(int i=0; i<ppStageCount; i++) {
+		lines.Add(wxString::Format(_T("%-10s %8llu %10.3f %12.3f %13.3f %10llu"),
+			cPipeStageNames[i], (unsigned long long)mBatches[i],
+			mBusy[i].ToDouble() / 1000.0, mWaitIn[i].ToDouble() / 1000.0, mWaitOut[i].ToDouble() / 1000.0,
+			(unsigned long long)mLines[i]));
+	}
+	lines.Add(wxString::Format(_T("batch latency(ms): avg %.3f max %.3f"),
+		GetLatencyAverage() / 1000.0, mLatencyMax.ToDouble() / 1000.0));
+}
+
+#ifdef USE_PARSE_PIPELINE
+
+//////////////////////////////////////////////////////////////////////
+
+/// 待つ 最初はスレッドを譲るだけで、長くなったら眠る
+static void PipeWait(int &spins)
+{
+	if (spins < PARSE_PIPELINE_SPINS) {
+		spins++;
+		wxThread::Yield();
+	} else {
+		wxMilliSleep(1);
+	}
+}
+
+ParsePipeRing::ParsePipeRing()
+	: mHead(0)
+	, mTail(0)
+	, mClosed(false)
+{
+	for(int i=0; i<PARSE_PIPELINE_RING_SIZE; i++) {
+		mItems[i] = NULL;
+	}
+}
+
+ParsePipeRing::~ParsePipeRing()
+{
+	ParsePipeBatch *item;
+	while((item = TryPop()) != NULL) {
+		delete item;
+	}
+}
+
+#ifdef USE_PARSE_PIPELINE_ATOMIC
+/// 空きがあれば入れる
+/// @return 入れたらtrue
+bool ParsePipeRing::TryPush(ParsePipeBatch *item)
+{
+	size_t head = mHead.load(std::memory_order_relaxed);
+	size_t tail = mTail.load(std::memory_order_acquire);
+	if (head - tail >= PARSE_PIPELINE_RING_SIZE) {
+		return false;
+	}
+	mItems[head & (PARSE_PIPELINE_RING_SIZE - 1)] = item;
+	mHead.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+/// あれば取り出す
+/// @return 空ならNULL
+ParsePipeBatch *ParsePipeRing::TryPop()
+{
+	size_t tail = mTail.load(std::memory_order_relaxed);
+	size_t head = mHead.load(std::memory_order_acquire);
+	if (tail == head) {
+		return NULL;
+	}
+	ParsePipeBatch *item = mItems[tail & (PARSE_PIPELINE_RING_SIZE - 1)];
+	mTail.store(tail + 1, std::memory_order_release);
+	return item;
+}
+
+/// 書き終わった
+void ParsePipeRing::Close()
+{
+	mClosed.store(true, std::memory_order_release);
+}
+
+/// 書き終わったか
+bool ParsePipeRing::IsClosed()
+{
+	return mClosed.load(std::memory_order_acquire);
+}
+#else
+/// 空きがあれば入れる
+/// @return 入れたらtrue
+bool ParsePipeRing::TryPush(ParsePipeBatch *item)
+{
+	wxCriticalSectionLocker lock(mLock);
+	if (mHead - mTail >= PARSE_PIPELINE_RING_SIZE) {
+		return false;
+	}
+	mItems[mHead & (PARSE_PIPELINE_RING_SIZE - 1)] = item;
+	mHead++;
+	return true;
+}
+
+/// あれば取り出す
+/// @return 空ならNULL
+ParsePipeBatch *ParsePipeRing::TryPop()
+{
+	wxCriticalSectionLocker lock(mLock);
+	if (mTail == mHead) {
+		return NULL;
+	}
+	ParsePipeBatch *item = mItems[mTail & (PARSE_PIPELINE_RING_SIZE - 1)];
+	mTail++;
+	return item;
+}
+
+/// 書き終わった
+void ParsePipeRing::Close()
+{
+	wxCriticalSectionLocker lock(mLock);
+	mClosed = true;
+}
+
+/// 書き終わったか
+bool ParsePipeRing::IsClosed()
+{
+	wxCriticalSectionLocker lock(mLock);
+	return mClosed;
+}
+#endif
+
+/// 空きができるまで待って入れる
+/// @param[in]     item      かたまり
+/// @param[in,out] wait_usec 待った時間を加算
+void ParsePipeRing::Push(ParsePipeBatch *item, wxLongLong &wait_usec)
+{
+	if (TryPush(item)) {
+		return;
+	}
+	wxStopWatch sw;
+	int spins = 0;
+	do {
+		PipeWait(spins);
+	} while(!TryPush(item));
+	wait_usec += sw.TimeInMicro();
+}
+
+/// 入るまで待って取り出す
+/// @param[in,out] wait_usec 待った時間を加算
+/// @return 書き手が終了していて空ならNULL
+ParsePipeBatch *ParsePipeRing::Pop(wxLongLong &wait_usec)
+{
+	ParsePipeBatch *item = TryPop();
+	if (item) {
+		return item;
+	}
+	wxStopWatch sw;
+	int spins = 0;
+	for(;;) {
+		if (IsClosed()) {
+			// 閉じる前に入れた分が残っているかもしれない
+			item = TryPop();
+			break;
+		}
+		PipeWait(spins);
+		item = TryPop();
+		if (item) {
+			break;
+		}
+	}
+	wait_usec += sw.TimeInMicro();
+	return item;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParsePipeThread::ParsePipeThread(ParsePipeline *pipeline, PipeStage stage)
+	: wxThread(wxTHREAD_JOINABLE)
+{
+	pPipeline = pipeline;
+	mStage = stage;
+}
+
+ParsePipeThread::~ParsePipeThread()
+{
+}
+
+ParsePipeThread::ExitCode ParsePipeThread::Entry()
+{
+	switch(mStage) {
+	case ppStageConvert:
+		pPipeline->RunConvert();
+		break;
+	case ppStageWrite:
+		pPipeline->RunWrite();
+		break;
+	default:
+		break;
+	}
+	return (ParsePipeThread::ExitCode)0;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// @param[in] owner     呼び出し元のパーサー
+/// @param[in] converter 文字コード変換に使うワーカー
+/// @param[in] writer    出力の整形に使うワーカー 呼び出し元は解析中なので使わない
+/// @param[in] out_file  出力先 出力形式をセットしておく
+ParsePipeline::ParsePipeline(Parse *owner, Parse *converter, Parse *writer, PsFileOutput &out_file)
+{
+	pOwner = owner;
+	pConverter = converter;
+	pWriter = writer;
+	pOutFile = &out_file;
+	mConvert = out_file.GetTypeFlag(psUTF8);
+	if (mConvert) {
+		// インターレースなどのUTF-8文字
+		mCharType = out_file.GetCharType();
+	}
+	mConvErrors = 0;
+	mOutBytes = 0;
+	mWriteOk = true;
+}
+
+ParsePipeline::~ParsePipeline()
+{
+}
+
+/// 実行する
+///
+/// 解析は呼び出したスレッドで行い、文字コード変換と出力はスレッドを作って行う。
+/// @param[in]     in_file 入力ファイル
+/// @param[in]     in_type 入力データの形式
+/// @param[in,out] result  結果格納用
+/// @param[out]    rc      出力の結果 順番に変換する場合のWriteTextと同じで、書けなかったらfalse
+/// @return スレッドが作れず実行しなかった場合false このとき出力先は変更しない
+bool ParsePipeline::Run(PsFileInput &in_file, PsFileType &in_type, ParseResult *result, bool &rc)
+{
+	if (!pOutFile->IsOpened()) {
+		return false;
+	}
+	mWatch.Start();
+
+	ParsePipeThread *converter = new ParsePipeThread(this, ppStageConvert);
+	if (converter->Run() != wxTHREAD_NO_ERROR) {
+		delete converter;
+		return false;
+	}
+	ParsePipeThread *writer = new ParsePipeThread(this, ppStageWrite);
+	if (writer->Run() != wxTHREAD_NO_ERROR) {
+		delete writer;
+		// 何も渡さずに終わらせる
+		mDecoded.Close();
+		converter->Wait();
+		delete converter;
+		return false;
+	}
+
+#ifdef USE_PARSE_STATS
+	wxFileOffset start_pos = in_file.Seek(0, wxFromCurrent);
+#endif
+	// 解析のエラーは結果に入る
+	RunDecode(in_file, in_type, result);
+#ifdef USE_PARSE_STATS
+	wxFileOffset end_pos = in_file.Seek(0, wxFromCurrent);
+#endif
+
+	converter->Wait();
+	delete converter;
+	writer->Wait();
+	delete writer;
+
+	rc = mWriteOk;
+
+	mStats.AddRun();
+
+#ifdef USE_PARSE_STATS
+	// 処理段階ごとの計測結果にも入れる
+	wxUint64 in_bytes = 0;
+	if (start_pos != wxInvalidOffset && end_pos != wxInvalidOffset && end_pos > start_pos) {
+		in_bytes = (wxUint64)(end_pos - start_pos);
+	}
+	ParseStats &stats = pOwner->mStats;
+	stats.Add(psStageDecode, mStats.GetBusy(ppStageDecode), in_bytes, mStats.GetLines(ppStageDecode));
+	if (mConvert) {
+		stats.Add(psStageUTF8, mStats.GetBusy(ppStageConvert), mStats.GetBytes(ppStageConvert), mStats.GetLines(ppStageConvert));
+	}
+	stats.Add(psStageWrite, mStats.GetBusy(ppStageWrite), mOutBytes, mStats.GetLines(ppStageWrite));
+#endif
+
+	return true;
+}
+
+/// 解析
+///
+/// Parse::ReadBinaryToAscii と同じ順番で解析し、かたまりごとに次の段階へ渡す。
+/// @param[in]     in_file 入力ファイル
+/// @param[in]     in_type 入力データの形式
+/// @param[in,out] result  結果格納用
+/// @return true/false
+bool ParsePipeline::RunDecode(PsFileInput &in_file, PsFileType &in_type, ParseResult *result)
+{
+	Parse *ps = pOwner;
+	wxLongLong wait_out = 0;
+
+	ps->mPos.Empty();
+	ps->mPos.SetName(_("Binary->Ascii"));
+	ps->mLineNumbers.Empty();
+
+	PsSymbolSentence sentence;
+
+	int phase = Parse::PHASE_LINE_NUMBER;
+	ParsePipeBatch *batch = new ParsePipeBatch(mWatch.TimeInMicro());
+
+	while(!in_file.Eof() && phase >= Parse::PHASE_NONE) {
+		phase = ps->ReadBinaryToSymbolsOneLine(in_file, in_type, phase, sentence, result);
+		if (phase == Parse::PHASE_EOL) {
+			// end of line
+			batch->mLines.Add(sentence.JoinAscStr());
+
+			// next phase
+			sentence.Empty();
+			phase = Parse::PHASE_LINE_NUMBER;
+
+			if (batch->mLines.GetCount() >= PARSE_PIPELINE_BATCH_LINES) {
+				mStats.AddBusy(ppStageDecode, mWatch.TimeInMicro() - batch->mCreated, batch->mLines.GetCount(), batch->mLines.GetBufferLen());
+				mDecoded.Push(batch, wait_out);
+				batch = new ParsePipeBatch(mWatch.TimeInMicro());
+			}
+		}
+		if (result && result->IsOverLimit()) {
+			// エラーが多いので中止
+			phase = Parse::PHASE_STOPPED;
+			break;
+		}
+	}
+	if (batch->mLines.GetCount() > 0) {
+		mStats.AddBusy(ppStageDecode, mWatch.TimeInMicro() - batch->mCreated, batch->mLines.GetCount(), batch->mLines.GetBufferLen());
+		mDecoded.Push(batch, wait_out);
+	} else {
+		delete batch;
+	}
+	mDecoded.Close();
+	mStats.AddWait(ppStageDecode, 0, wait_out);
+
+	if (phase == Parse::PHASE_STOPPED) {
+		if (result) {
+			result->Add(ps->mPos, prErrStopInvalidBasicCode);
+		}
+		return false;
+	}
+	return true;
+}
+
+/// 文字コード変換
+///
+/// Parse::ConvAsciiToUTF8 と同じくエラーが多い場合は以降の行を変換しない。
+void ParsePipeline::RunConvert()
+{
+	wxLongLong wait_in = 0;
+	wxLongLong wait_out = 0;
+	wxString line;
+	wxString body;
+
+	ParsePipeBatch *batch;
+	while((batch = mDecoded.Pop(wait_in)) != NULL) {
+		wxLongLong start = mWatch.TimeInMicro();
+		if (mConvert) {
+			for(size_t row = 0; row < batch->mLines.GetCount(); row++) {
+				if (mConvErrors > ERROR_STOPPED_CHAR_COUNT) {
+					// エラーが多いので中止
+					break;
+				}
+				line = batch->mLines[row];
+				mConvErrors += pConverter->ConvAsciiToUTF8OneLine(line, mCharType, body, NULL);
+				batch->mConverted.Add(body);
+			}
+		}
+		mStats.AddBusy(ppStageConvert, mWatch.TimeInMicro() - start, batch->mLines.GetCount(), batch->mLines.GetBufferLen());
+		mConverted.Push(batch, wait_out);
+	}
+	mConverted.Close();
+	mStats.AddWait(ppStageConvert, wait_in, wait_out);
+}
+
+/// 出力
+///
+/// かたまりごとにメモリ上で整形してからファイルに書く。
+/// 整形は専用のワーカーで行い、このスレッドからは出力ファイルのほかに触らない。
+void ParsePipeline::RunWrite()
+{
+	wxLongLong wait_in = 0;
+	bool head = false;
+
+	ParsePipeBatch *batch;
+	while((batch = mConverted.Pop(wait_in)) != NULL) {
+		wxLongLong start = mWatch.TimeInMicro();
+		PsFileData &lines = (mConvert ? batch->mConverted : batch->mLines);
+
+		PsFileStrOutput chunk;
+		chunk.SetType(pOutFile->GetType());
+		if (!head) {
+			pWriter->WriteTextHead(lines, chunk);
+			head = true;
+		}
+		pWriter->WriteTextLines(lines, chunk);
+		size_t bytes = Flush(chunk);
+
+		wxLongLong end = mWatch.TimeInMicro();
+		mStats.AddBusy(ppStageWrite, end - start, lines.GetCount(), bytes);
+		mStats.AddLatency(end - batch->mCreated);
+		delete batch;
+	}
+
+	PsFileStrOutput chunk;
+	chunk.SetType(pOutFile->GetType());
+	if (!head) {
+		// 1行もない
+		PsFileData empty;
+		pWriter->WriteTextHead(empty, chunk);
+	}
+	pWriter->WriteTextTail(chunk);
+	Flush(chunk);
+
+	mStats.AddWait(ppStageWrite, wait_in, 0);
+}
+
+/// 出力用にためた分をファイルに書く
+///
+/// 書けなかった分があれば失敗として覚えておく。
+/// @return 書いたバイト数
+size_t ParsePipeline::Flush(PsFileStrOutput &chunk)
+{
+	const wxString &data = chunk.GetString();
+	size_t len = data.Length();
+	if (len == 0) {
+		return 0;
+	}
+	size_t written = pOutFile->Write(data);
+	if (written != len) {
+		mWriteOk = false;
+	}
+	mOutBytes += written;
+	return written;
+}
+
+#endif /* USE_PARSE_PIPELINE */
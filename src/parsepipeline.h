@@ -0,0 +1,211 @@
+﻿/// @file parsepipeline.h
+///
+/// @brief 中間言語からテキストへのエクスポートを段階ごとのスレッドで行う
+///
+#ifndef _PARSEPIPELINE_H_
+#define _PARSEPIPELINE_H_
+
+#include "parseworker.h"
+
+#ifdef USE_PARSE_PARALLEL
+/// パイプラインでのエクスポートを組み込む 文字コード変換に並列変換用のワーカーを使う
+#define USE_PARSE_PIPELINE 1
+#endif
+
+/// 1つのかたまりの行数
+#define PARSE_PIPELINE_BATCH_LINES	256
+/// 段階の間でためておけるかたまりの数 (2のべき乗)
+#define PARSE_PIPELINE_RING_SIZE	16
+/// 待つときにスレッドを譲る回数 これを超えたら眠る
+#define PARSE_PIPELINE_SPINS		64
+
+#if (defined(__cplusplus) && __cplusplus >= 201103L) || (defined(_MSC_VER) && _MSC_VER >= 1700)
+/// std::atomicでリングバッファの位置をやりとりする 使えない場合はクリティカルセクションを使う
+#define USE_PARSE_PIPELINE_ATOMIC 1
+#endif
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <wx/stopwatch.h>
+#ifdef USE_PARSE_PIPELINE_ATOMIC
+#include <atomic>
+#endif
+#include "fileinfo.h"
+#include "parseresult.h"
+
+class Parse;
+class ParsePipeline;
+
+/// パイプラインの段階
+typedef enum enumPipeStage {
+	ppStageDecode = 0,	///< 中間言語を解析
+	ppStageConvert,		///< 文字コード変換
+	ppStageWrite,		///< 出力
+	ppStageCount
+} PipeStage;
+
+/// パイプラインの段階ごとの計測結果
+///
+/// 各段階のスレッドは自分の段階の値だけを更新する。
+class ParsePipelineStats
+{
+private:
+	wxUint32 mRuns;						///< 実行回数
+	wxLongLong mBusy[ppStageCount];		///< 処理していた時間(usec)
+	wxLongLong mWaitIn[ppStageCount];	///< 前の段階を待った時間(usec)
+	wxLongLong mWaitOut[ppStageCount];	///< 次の段階の空きを待った時間(usec)
+	wxUint64 mBatches[ppStageCount];	///< 処理したかたまりの数
+	wxUint64 mLines[ppStageCount];		///< 処理した行数
+	wxUint64 mBytes[ppStageCount];		///< 処理したバイト数
+	wxUint64 mLatencyCount;				///< 出力し終えたかたまりの数
+	wxLongLong mLatencySum;				///< 解析を始めてから出力し終わるまでの時間の合計(usec)
+	wxLongLong mLatencyMax;				///< 同最大(usec)
+
+public:
+	ParsePipelineStats();
+
+	void Empty();
+	/// 計測結果を加算
+	void Add(const ParsePipelineStats &src);
+	/// 実行回数を加算
+	void AddRun() { mRuns++; }
+	/// 1かたまりの処理時間と処理量を加算
+	void AddBusy(PipeStage stage, wxLongLong usec, wxUint64 lines, wxUint64 bytes);
+	/// 待ち時間を加算
+	void AddWait(PipeStage stage, wxLongLong wait_in, wxLongLong wait_out);
+	/// かたまりの遅延を加算
+	void AddLatency(wxLongLong usec);
+
+	static const char *StageName(PipeStage stage);
+
+	wxUint32 GetRuns() const { return mRuns; }
+	wxLongLong GetBusy(PipeStage stage) const { return mBusy[stage]; }
+	wxLongLong GetWaitIn(PipeStage stage) const { return mWaitIn[stage]; }
+	wxLongLong GetWaitOut(PipeStage stage) const { return mWaitOut[stage]; }
+	wxUint64 GetBatches(PipeStage stage) const { return mBatches[stage]; }
+	wxUint64 GetLines(PipeStage stage) const { return mLines[stage]; }
+	wxUint64 GetBytes(PipeStage stage) const { return mBytes[stage]; }
+	wxUint64 GetLatencyCount() const { return mLatencyCount; }
+	wxLongLong GetLatencyMax() const { return mLatencyMax; }
+	/// 平均遅延(usec)
+	double GetLatencyAverage() const;
+
+	/// 表形式の文字列にする
+	void Report(wxArrayString &lines) const;
+};
+
+#ifdef USE_PARSE_PIPELINE
+
+/// 段階の間で受け渡す行のかたまり
+class ParsePipeBatch
+{
+public:
+	PsFileData mLines;		///< 解析した行
+	PsFileData mConverted;	///< 文字コード変換した行
+	wxLongLong mCreated;	///< 解析を始めた時刻(usec)
+
+	ParsePipeBatch(wxLongLong created) : mCreated(created) {}
+};
+
+/// 1つの書き手と1つの読み手の間のリングバッファ
+///
+/// いっぱいのときは書き手が、空のときは読み手が待つ。
+/// 書き手は最後にCloseを呼ぶ。読み手は閉じていて空ならNULLを受け取る。
+class ParsePipeRing
+{
+private:
+	ParsePipeBatch *mItems[PARSE_PIPELINE_RING_SIZE];
+#ifdef USE_PARSE_PIPELINE_ATOMIC
+	std::atomic<size_t> mHead;	///< 次に書く位置 書き手のみ更新
+	std::atomic<size_t> mTail;	///< 次に読む位置 読み手のみ更新
+	std::atomic<bool> mClosed;	///< 書き手が終了した
+#else
+	size_t mHead;
+	size_t mTail;
+	bool mClosed;
+	wxCriticalSection mLock;
+#endif
+
+public:
+	ParsePipeRing();
+	~ParsePipeRing();
+
+	/// 空きがあれば入れる
+	bool TryPush(ParsePipeBatch *item);
+	/// あれば取り出す
+	ParsePipeBatch *TryPop();
+	/// 空きができるまで待って入れる
+	void Push(ParsePipeBatch *item, wxLongLong &wait_usec);
+	/// 入るまで待って取り出す
+	ParsePipeBatch *Pop(wxLongLong &wait_usec);
+	/// 書き終わった
+	void Close();
+	/// 書き終わったか
+	bool IsClosed();
+
+	DECLARE_NO_COPY_CLASS(ParsePipeRing)
+};
+
+/// パイプラインの段階のスレッド
+class ParsePipeThread : public wxThread
+{
+protected:
+	ParsePipeline *pPipeline;
+	PipeStage mStage;
+
+	virtual ExitCode Entry();
+
+public:
+	ParsePipeThread(ParsePipeline *pipeline, PipeStage stage);
+	~ParsePipeThread();
+};
+
+/// 中間言語からテキストへのエクスポートのパイプライン
+///
+/// 解析(呼び出したスレッド) → 文字コード変換 → 出力 をそれぞれのスレッドで行い、
+/// 段階の間はリングバッファで行のかたまりを受け渡す。
+/// 出力と解析結果は順番に変換した場合と同じになる。
+class ParsePipeline
+{
+private:
+	Parse *pOwner;				///< 呼び出し元 解析を行う
+	Parse *pConverter;			///< 文字コード変換を行うワーカー
+	Parse *pWriter;				///< 出力の整形を行うワーカー
+	PsFileOutput *pOutFile;		///< 出力先
+	bool mConvert;				///< UTF-8に変換するか
+	wxString mCharType;			///< 変換先の文字種類
+	int mConvErrors;			///< 文字コード変換のエラー数
+	wxUint64 mOutBytes;			///< 出力したバイト数
+	bool mWriteOk;				///< すべて書けたか
+	ParsePipeRing mDecoded;		///< 解析→文字コード変換
+	ParsePipeRing mConverted;	///< 文字コード変換→出力
+	ParsePipelineStats mStats;	///< 計測結果
+	wxStopWatch mWatch;			///< 開始からの時刻
+
+	/// 解析
+	bool RunDecode(PsFileInput &in_file, PsFileType &in_type, ParseResult *result);
+	/// 文字コード変換
+	void RunConvert();
+	/// 出力
+	void RunWrite();
+	/// 出力用にためた分をファイルに書く
+	size_t Flush(PsFileStrOutput &chunk);
+
+	friend class ParsePipeThread;
+
+public:
+	ParsePipeline(Parse *owner, Parse *converter, Parse *writer, PsFileOutput &out_file);
+	~ParsePipeline();
+
+	/// 実行する
+	bool Run(PsFileInput &in_file, PsFileType &in_type, ParseResult *result, bool &rc);
+	/// 計測結果
+	const ParsePipelineStats &GetStats() const { return mStats; }
+
+	DECLARE_NO_COPY_CLASS(ParsePipeline)
+};
+
+#endif /* USE_PARSE_PIPELINE */
+
+#endif /* _PARSEPIPELINE_H_ */
@@ -3,10 +3,57 @@
 /// @brief 解析結果保存クラス
 ///
 #include "parseresult.h"
+#include <wx/filename.h>
 #include <wx/arrimpl.cpp>
 
 //////////////////////////////////////////////////////////////////////
 
+LineNumberIndex::LineNumberIndex()
+{
+	mUsed = NULL;
+	mRows = NULL;
+}
+
+LineNumberIndex::~LineNumberIndex()
+{
+	delete [] mRows;
+	delete [] mUsed;
+}
+
+void LineNumberIndex::Empty()
+{
+	if (mUsed) memset(mUsed, 0, sizeof(wxUint32) * (LINE_NUMBER_COUNT / 32));
+}
+
+/// 行番号を登録
+/// 同時に重複しているかチェック
+/// @note 行番号は16bitで格納されるので範囲外の行番号は登録しない
+/// @return >=0 : すでに存在する場合行を返す
+/// @return LINE_NUMBER_INVALID : 行番号が範囲外
+int LineNumberIndex::Add(long line_number, size_t row)
+{
+	if (line_number < 0 || line_number >= LINE_NUMBER_COUNT) {
+		return LINE_NUMBER_INVALID;
+	}
+	if (!mUsed) {
+		mUsed = new wxUint32[LINE_NUMBER_COUNT / 32];
+		mRows = new wxUint32[LINE_NUMBER_COUNT];
+		memset(mUsed, 0, sizeof(wxUint32) * (LINE_NUMBER_COUNT / 32));
+	}
+	int exists_row = -1;
+	wxUint32 num = (wxUint32)line_number;
+	wxUint32 bit = (1U << (num & 31));
+	if (mUsed[num >> 5] & bit) {
+		// already exists
+		exists_row = (int)mRows[num];
+	}
+	mUsed[num >> 5] |= bit;
+	mRows[num] = (wxUint32)row;
+	return exists_row;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 ParsePosition::ParsePosition()
 {
 	mLineNumber = 0;
@@ -18,7 +65,6 @@ ParsePosition::ParsePosition(size_t row, size_t col, long line_number, const wxS
 {
 	mName = name;
 	mLineNumber = line_number;
-	mLineNumberMap[line_number] = (int)mRow;
 	mRow = row;
 	mCol = col;
 }
@@ -31,7 +77,6 @@ void ParsePosition::Empty()
 {
 	mName.Empty();
 	mLineNumber = 0;
-	mLineNumberMap.clear();
 	mRow = 0;
 	mCol = 0;
 }
@@ -47,19 +92,10 @@ void ParsePosition::SetCol(size_t val)
 }
 
 /// 行番号をセット
-/// 同時に重複しているかチェック
-/// @return >=0 : すでに存在する場合行を返す
-int ParsePosition::SetLineNumber(long val)
+/// @note 重複チェックはLineNumberIndexで行う
+void ParsePosition::SetLineNumber(long val)
 {
-	int exists_row = -1;
 	mLineNumber = val;
-	LineNumberMap::const_iterator cit = mLineNumberMap.find(val);
-	if (cit != mLineNumberMap.end()) {
-		// already exists
-		exists_row = mLineNumberMap[val];
-	}
-	mLineNumberMap[val] = (int)mRow;
-	return exists_row;
 }
 
 void ParsePosition::SetName(const wxString &val)
@@ -89,34 +125,26 @@ const wxString &ParsePosition::GetName() const
 
 //////////////////////////////////////////////////////////////////////
 
-ParseResultItem::ParseResultItem() : ParsePosition()
+ParseResultItem::ParseResultItem()
 {
+	mRow = 0;
+	mCol = 0;
+	mLineNumber = 0;
 	mErrorCode = prErrNone;
 	mValue = -1;
-	mName.Empty();
-}
-
-ParseResultItem::ParseResultItem(const ParsePosition &pos, PrErrCode error_code)
-	: ParsePosition(pos)
-{
-	mErrorCode = error_code;
-	mValue = -1;
+	mNameIndex = 0;
 }
 
-ParseResultItem::ParseResultItem(const ParsePosition &pos, PrErrCode error_code, int value)
-	: ParsePosition(pos)
+ParseResultItem::ParseResultItem(const ParsePosition &pos, size_t name_index, PrErrCode error_code, int value)
 {
+	mRow = (wxUint32)pos.GetRow();
+	mCol = (wxUint32)pos.GetCol();
+	mLineNumber = pos.GetLineNumber();
 	mErrorCode = error_code;
 	mValue = value;
+	mNameIndex = name_index;
 }
 
-#if 0
-ParseResultItem::ParseResultItem(size_t row, size_t col, long line_number, const wxString &name, PrErrCode error_code)
-	: ParsePosition(row, col, line_number, name)
-{
-	mErrorCode = error_code;
-}
-#endif
 wxString ParseResultItem::GetValueString() const
 {
 	return wxString::Format(_T("%d"), mValue);
@@ -130,32 +158,77 @@ WX_DEFINE_OBJARRAY(ParseResultItems);
 
 ParseResult::ParseResult()
 {
+	pSink = NULL;
+	mLimit = -1;
 	Empty();
 }
-void ParseResult::Add(const ParsePosition &pos, PrErrCode error_code)
+/// 名称を登録して位置を返す
+/// 直前と同じ名称なら登録済みのものを使う
+size_t ParseResult::AddName(const wxString &name)
 {
-	ParseResultItem *item = new ParseResultItem(pos, error_code);
-	mItems.Add(item);
+	size_t count = mNames.GetCount();
+	if (count > 0 && mNames[count - 1] == name) {
+		return count - 1;
+	}
+	mNames.Add(name);
+	return count;
 }
-void ParseResult::Add(const ParsePosition &pos, PrErrCode error_code, int value)
+void ParseResult::Add(const ParsePosition &pos, PrErrCode error_code)
 {
-	ParseResultItem *item = new ParseResultItem(pos, error_code, value);
-	mItems.Add(item);
+	Add(pos, error_code, -1);
 }
-#if 0
-void ParseResult::Add(size_t row, size_t col, size_t line_number, const wxString &name, PrErrCode error_code)
+void ParseResult::Add(const ParsePosition &pos, PrErrCode error_code, int value)
 {
-	ParseResultItem *item = new ParseResultItem(row, col, line_number, name, error_code);
+	mCount++;
+	if (error_code >= 0 && error_code < prErrCodeCount) {
+		mCodeCounts[error_code]++;
+	}
+	if (pSink) {
+		// 保持せずに出力する
+		pSink->Add(ParseResultItem(pos, 0, error_code, value), pos.GetName());
+		return;
+	}
+	ParseResultItem *item = new ParseResultItem(pos, AddName(pos.GetName()), error_code, value);
 	mItems.Add(item);
 }
-#endif
 void ParseResult::Empty()
 {
 	mItems.Empty();
+	mNames.Empty();
+	mCount = 0;
+	memset(mCodeCounts, 0, sizeof(mCodeCounts));
 }
+/// 全件数
+/// @note 出力先を設定している場合は保持していない分も含む
 size_t ParseResult::GetCount()
 {
-	return mItems.GetCount();
+	return mCount;
+}
+/// エラーコードごとの件数
+size_t ParseResult::GetCodeCount(PrErrCode code) const
+{
+	if (code < 0 || code >= prErrCodeCount) return 0;
+	return mCodeCounts[code];
+}
+/// 中止する件数を返す
+/// @param[in] default_limit 設定していない場合の件数
+/// @return 0なら中止しない
+int ParseResult::GetLimit(int default_limit) const
+{
+	return (mLimit < 0 ? default_limit : mLimit);
+}
+/// 中止する件数を超えたか
+bool ParseResult::IsOverLimit() const
+{
+	return IsOverLimit((int)mCount, ERROR_STOPPED_COUNT);
+}
+/// 中止する件数を超えたか
+/// @param[in] count         件数
+/// @param[in] default_limit 設定していない場合の件数
+bool ParseResult::IsOverLimit(int count, int default_limit) const
+{
+	int limit = GetLimit(default_limit);
+	return (limit > 0 && count > limit);
 }
 
 /// エラーメッセージ
@@ -240,7 +313,7 @@ void ParseResult::Report(wxArrayString &lines)
 		msg += _T(" ") + _("Col:");
 		numstr.Printf(_T("%lu"), (wxUint32)(itm->GetCol() + 1));
 		msg += numstr;
-		msg += _T(") [") + itm->GetName() + _T("] ");
+		msg += _T(") [") + mNames[itm->GetNameIndex()] + _T("] ");
 		msg += ErrMsg(itm->GetErrorCode());
 		if (itm->GetValue() >= 0) {
 			msg += itm->GetValueString();
@@ -248,4 +321,191 @@ void ParseResult::Report(wxArrayString &lines)
 
 		lines.Add(msg);
 	}
+	if (pSink) {
+		// 出力先に渡した分は件数のみ
+		for(int code = 0; code < prErrCodeCount; code++) {
+			if (mCodeCounts[code] == 0) continue;
+			msg = ErrMsg((PrErrCode)code);
+			numstr.Printf(_T(" (%lu)"), (unsigned long)mCodeCounts[code]);
+			msg += numstr;
+			lines.Add(msg);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// エラーコードの名称
+static const char *cCodeNames[prErrCodeCount] = {
+	"None",
+	"InvalidChar",
+	"InvalidUTF8Code",
+	"InvalidToUTF8Code",
+	"InvalidBasicCode",
+	"StopInvalidUTF8Code",
+	"StopInvalidToUTF8Code",
+	"StopInvalidBasicCode",
+	"Overflow",
+	"InvalidNumber",
+	"InvalidLineNumber",
+	"DiscontLineNumber",
+	"DuplicateLineNumber",
+	"EraseCodeFE",
+};
+
+/// JSON文字列のエスケープ
+static wxString EscapeJson(const wxString &str)
+{
+	wxString dst;
+	for(wxString::const_iterator it = str.begin(); it != str.end(); ++it) {
+		wxUniChar ch = *it;
+		if (ch == wxT('"') || ch == wxT('\\')) {
+			dst += wxT('\\');
+			dst += ch;
+		} else if (ch.GetValue() < 0x20) {
+			dst += wxString::Format(_T("\\u%04x"), (int)ch.GetValue());
+		} else {
+			dst += ch;
+		}
+	}
+	return dst;
+}
+
+/// CSVの項目のエスケープ
+static wxString EscapeCsv(const wxString &str)
+{
+	if (str.find_first_of(_T(",\"\r\n")) == wxString::npos) {
+		return str;
+	}
+	wxString dst = str;
+	dst.Replace(_T("\""), _T("\"\""));
+	return _T("\"") + dst + _T("\"");
+}
+
+ParseResultSink::ParseResultSink()
+{
+	mCount = 0;
+	memset(mCodeCounts, 0, sizeof(mCodeCounts));
+}
+
+ParseResultSink::~ParseResultSink()
+{
+	Close();
+}
+
+/// 拡張子に応じた出力先を作成
+/// @param[in] path 出力ファイル .csvならCSV それ以外はJSON Lines
+/// @return 開けない場合NULL
+ParseResultSink *ParseResultSink::Create(const wxString &path)
+{
+	ParseResultSink *sink;
+	if (path.Lower().EndsWith(_T(".csv"))) {
+		sink = new ParseResultCsvSink();
+	} else {
+		sink = new ParseResultJsonSink();
+	}
+	if (!sink->Open(path)) {
+		delete sink;
+		sink = NULL;
+	}
+	return sink;
+}
+
+/// エラーコードの名称
+const char *ParseResultSink::CodeName(PrErrCode code)
+{
+	if (code < 0 || code >= prErrCodeCount) return "Unknown";
+	return cCodeNames[code];
+}
+
+bool ParseResultSink::Open(const wxString &path)
+{
+	return mFile.Open(path, _T("w"));
+}
+
+void ParseResultSink::Close()
+{
+	if (mFile.IsOpened()) {
+		mFile.Close();
+	}
+}
+
+/// 1件追加
+void ParseResultSink::Add(const ParseResultItem &item, const wxString &name)
+{
+	mCount++;
+	PrErrCode code = item.GetErrorCode();
+	if (code >= 0 && code < prErrCodeCount) {
+		mCodeCounts[code]++;
+	}
+	if (IsWritable()) {
+		Write(item, name);
+	}
+}
+
+/// 件数をクリア
+void ParseResultSink::ResetCounts()
+{
+	mCount = 0;
+	memset(mCodeCounts, 0, sizeof(mCodeCounts));
+}
+
+/// エラーコードごとの件数
+size_t ParseResultSink::GetCodeCount(PrErrCode code) const
+{
+	if (code < 0 || code >= prErrCodeCount) return 0;
+	return mCodeCounts[code];
+}
+
+/// 1件をJSON Lines形式の1行にする
+/// @param[in] source 入力ファイル名
+/// @param[in] item   解析結果
+/// @param[in] name   処理の名称
+/// @return 改行を含む1行
+wxString ParseResultJsonSink::Format(const wxString &source, const ParseResultItem &item, const wxString &name)
+{
+	return wxString::Format(
+		_T("{\"source\":\"%s\",\"phase\":\"%s\",\"row\":%lu,\"col\":%lu,\"line\":%ld,\"code\":\"%s\",\"value\":%d}\n"),
+		EscapeJson(source), EscapeJson(name),
+		(unsigned long)(item.GetRow() + 1), (unsigned long)(item.GetCol() + 1),
+		item.GetLineNumber(), CodeName(item.GetErrorCode()), item.GetValue());
+}
+
+/// 1件をJSON Lines形式で出力
+void ParseResultJsonSink::Write(const ParseResultItem &item, const wxString &name)
+{
+	mFile.Write(Format(mSource, item, name), wxConvUTF8);
+}
+
+/// 出力と件数をクリア
+void ParseResultBufferSink::Clear()
+{
+	mBuffer.SetDataLen(0);
+	ResetCounts();
+}
+
+/// 1件をJSON Lines形式でメモリに出力
+void ParseResultBufferSink::Write(const ParseResultItem &item, const wxString &name)
+{
+	wxString source = mSource.AfterLast(wxFileName::GetPathSeparator());
+	wxScopedCharBuffer rec = ParseResultJsonSink::Format(source, item, name).utf8_str();
+	mBuffer.AppendData(rec.data(), rec.length());
+}
+
+bool ParseResultCsvSink::Open(const wxString &path)
+{
+	if (!ParseResultSink::Open(path)) return false;
+	mFile.Write(_T("source,phase,row,col,line,code,value\n"), wxConvUTF8);
+	return true;
+}
+
+/// 1件をCSV形式で出力
+void ParseResultCsvSink::Write(const ParseResultItem &item, const wxString &name)
+{
+	wxString rec = wxString::Format(
+		_T("%s,%s,%lu,%lu,%ld,%s,%d\n"),
+		EscapeCsv(mSource), EscapeCsv(name),
+		(unsigned long)(item.GetRow() + 1), (unsigned long)(item.GetCol() + 1),
+		item.GetLineNumber(), CodeName(item.GetErrorCode()), item.GetValue());
+	mFile.Write(rec, wxConvUTF8);
 }
@@ -8,7 +8,12 @@
 #include "common.h"
 #include <wx/wx.h>
 #include <wx/dynarray.h>
-#include <wx/hashmap.h>
+#include <wx/ffile.h>
+
+/// エラーが多い場合に変換を中止する件数
+#define ERROR_STOPPED_COUNT			50
+/// 変換できない文字が多い場合に変換を中止する件数
+#define ERROR_STOPPED_CHAR_COUNT	100
 
 /// エラーコード
 typedef enum enumPrErrCode {
@@ -26,9 +31,34 @@ typedef enum enumPrErrCode {
 	prErrDiscontLineNumber,
 	prErrDuplicateLineNumber,
 	prErrEraseCodeFE,
+	prErrCodeCount
 } PrErrCode;
 
-WX_DECLARE_HASH_MAP(int, int, wxIntegerHash, wxIntegerEqual, LineNumberMap);
+/// 行番号の重複チェック用索引
+///
+/// 行番号(16bit)ごとに出現済みフラグと最後に出現した行を持つ。
+/// 表は最初にAdd()したときにヒープに確保する。
+/// 変換ごとにEmpty()する。
+class LineNumberIndex
+{
+public:
+	enum {
+		LINE_NUMBER_COUNT = 65536,
+		LINE_NUMBER_INVALID = -2	///< Add()の戻り値 範囲外の行番号
+	};
+private:
+	wxUint32 *mUsed;	///< 出現済みフラグ
+	wxUint32 *mRows;	///< 出現した行
+
+	LineNumberIndex(const LineNumberIndex &);
+	LineNumberIndex &operator=(const LineNumberIndex &);
+
+public:
+	LineNumberIndex();
+	~LineNumberIndex();
+	void Empty();
+	int  Add(long line_number, size_t row);
+};
 
 /// 位置情報
 class ParsePosition
@@ -36,7 +66,6 @@ class ParsePosition
 protected:
 	wxString mName;			///< 名称
 	long mLineNumber;		///< BASIC行番号
-	LineNumberMap mLineNumberMap;	///< 重複チェック用
 
 public:
 	size_t mRow;			///< 行
@@ -49,7 +78,7 @@ public:
 	void Empty();
 	void SetRow(size_t val);
 	void SetCol(size_t val);
-	int  SetLineNumber(long val);
+	void SetLineNumber(long val);
 	void SetName(const wxString &val);
 	size_t GetRow() const;
 	size_t GetCol() const;
@@ -58,16 +87,24 @@ public:
 };
 
 /// 解析結果保存アイテムクラス
-class ParseResultItem : public ParsePosition
+///
+/// 位置は行、列、行番号のみ保持する。名称はParseResult側に持つ。
+class ParseResultItem
 {
 protected:
+	wxUint32 mRow;			///< 行
+	wxUint32 mCol;			///< 列
+	long mLineNumber;		///< BASIC行番号
 	PrErrCode mErrorCode;
 	int mValue;
+	size_t mNameIndex;		///< 名称の位置
 public:
 	ParseResultItem();
-	ParseResultItem(const ParsePosition &pos, PrErrCode error_code);
-	ParseResultItem(const ParsePosition &pos, PrErrCode error_code, int value);
-//	ParseResultItem(size_t row, size_t col, long line_number, const wxString &name, PrErrCode error_code);
+	ParseResultItem(const ParsePosition &pos, size_t name_index, PrErrCode error_code, int value = -1);
+	size_t GetRow() const { return mRow; }
+	size_t GetCol() const { return mCol; }
+	long GetLineNumber() const { return mLineNumber; }
+	size_t GetNameIndex() const { return mNameIndex; }
 	void SetErrorCode(PrErrCode val) { mErrorCode = val; }
 	PrErrCode GetErrorCode() const { return mErrorCode; }
 	int GetValue() const { return mValue; }
@@ -75,11 +112,88 @@ public:
 };
 WX_DECLARE_OBJARRAY(ParseResultItem, ParseResultItems);
 
+/// 解析結果の出力先
+///
+/// 解析結果を保持せずに逐次出力する。エラーコードごとの件数を数える。
+class ParseResultSink
+{
+protected:
+	wxFFile mFile;		///< 出力ファイル
+	wxString mSource;	///< 入力ファイル名
+	size_t mCount;		///< 全件数
+	size_t mCodeCounts[prErrCodeCount];	///< エラーコードごとの件数
+
+	/// 1件出力
+	virtual void Write(const ParseResultItem &item, const wxString &name) = 0;
+	/// 出力できるか
+	virtual bool IsWritable() const { return mFile.IsOpened(); }
+
+public:
+	ParseResultSink();
+	virtual ~ParseResultSink();
+
+	/// 拡張子(.csv or .jsonl)に応じた出力先を作成
+	static ParseResultSink *Create(const wxString &path);
+	/// エラーコードの名称
+	static const char *CodeName(PrErrCode code);
+
+	virtual bool Open(const wxString &path);
+	virtual void Close();
+	void SetSource(const wxString &val) { mSource = val; }
+	void Add(const ParseResultItem &item, const wxString &name);
+	size_t GetCount() const { return mCount; }
+	size_t GetCodeCount(PrErrCode code) const;
+	/// 件数をクリア
+	void ResetCounts();
+};
+
+/// 解析結果をJSON Lines形式で出力
+class ParseResultJsonSink : public ParseResultSink
+{
+protected:
+	void Write(const ParseResultItem &item, const wxString &name);
+public:
+	/// 1件をJSON Lines形式の1行にする
+	static wxString Format(const wxString &source, const ParseResultItem &item, const wxString &name);
+};
+
+/// 解析結果をJSON Lines形式でメモリに出力
+///
+/// ファイルに書かずに返す場合に使う。入力ファイル名はディレクトリを除いて出力する。
+class ParseResultBufferSink : public ParseResultSink
+{
+protected:
+	wxMemoryBuffer mBuffer;	///< 出力したJSON Lines (UTF-8)
+
+	void Write(const ParseResultItem &item, const wxString &name);
+	bool IsWritable() const { return true; }
+public:
+	/// 出力と件数をクリア
+	void Clear();
+	const wxMemoryBuffer &GetBuffer() const { return mBuffer; }
+};
+
+/// 解析結果をCSV形式で出力
+class ParseResultCsvSink : public ParseResultSink
+{
+protected:
+	void Write(const ParseResultItem &item, const wxString &name);
+public:
+	bool Open(const wxString &path);
+};
+
 /// 解析結果保存クラス
 class ParseResult
 {
 private:
 	ParseResultItems mItems;
+	wxArrayString mNames;	///< 処理の名称
+	ParseResultSink *pSink;	///< 出力先 NULLなら保持する
+	int mLimit;				///< 中止する件数 -1:既定値 0:中止しない
+	size_t mCount;			///< 全件数
+	size_t mCodeCounts[prErrCodeCount];	///< エラーコードごとの件数
+
+	size_t AddName(const wxString &name);
 public:
 	ParseResult();
 	void Add(const ParsePosition &pos, PrErrCode error_code);
@@ -87,6 +201,18 @@ public:
 //	void Add(size_t row, size_t col, size_t line_number, const wxString &name, PrErrCode error_code);
 	void Empty();
 	size_t GetCount();
+	size_t GetCodeCount(PrErrCode code) const;
+	/// 保持している1件を返す (出力先を設定していない場合)
+	const ParseResultItem &Item(size_t index) const { return mItems.Item(index); }
+	/// 保持している1件の処理の名称
+	const wxString &GetItemName(size_t index) const { return mNames[mItems.Item(index).GetNameIndex()]; }
+	/// 出力先を設定
+	void SetSink(ParseResultSink *sink) { pSink = sink; }
+	/// 中止する件数を設定
+	void SetLimit(int val) { mLimit = val; }
+	int  GetLimit(int default_limit = ERROR_STOPPED_COUNT) const;
+	bool IsOverLimit() const;
+	bool IsOverLimit(int count, int default_limit) const;
 	/// エラーメッセージ
 	wxString ErrMsg(PrErrCode code);
 	/// レポート出力
@@ -0,0 +1,860 @@
+﻿/// @file parseserver.cpp
+///
+/// @brief 変換サーバー
+///
+///
+#include "parseserver.h"
+
+#ifdef USE_PARSE_SERVER
+
+#include <wx/filename.h>
+#include <wx/file.h>
+#include "parse_l3s1basic.h"
+#include "parse_msxbasic.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+//////////////////////////////////////////////////////////////////////
+
+void ParseServerRequest::Empty()
+{
+	mMachine.Empty();
+	mBasicType.Empty();
+	mFrom.Empty();
+	mTo.Empty();
+	mCharType.Empty();
+	mName.Empty();
+	mData.SetDataLen(0);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseServerResponse::ParseServerResponse()
+{
+	Empty();
+}
+
+void ParseServerResponse::Empty()
+{
+	mStatus = PARSE_SERVER_OK;
+	mError.Empty();
+	mMachine.Empty();
+	mBasicType.Empty();
+	mCharType.Empty();
+	mData.SetDataLen(0);
+	mDiag.SetDataLen(0);
+	mDiagCount = 0;
+}
+
+/// エラーにする
+/// @param[in] status enParseServerStatus
+/// @param[in] msg    エラーメッセージ
+void ParseServerResponse::SetError(int status, const wxString &msg)
+{
+	mStatus = status;
+	mError = msg;
+	// ヘッダに入れるので改行は空白にする
+	mError.Replace(_T("\r"), _T(""));
+	mError.Replace(_T("\n"), _T(" "));
+	mData.SetDataLen(0);
+}
+
+/// 状態の説明
+const char *ParseServerResponse::StatusText(int status)
+{
+	switch(status) {
+	case PARSE_SERVER_OK:
+		return "OK";
+	case PARSE_SERVER_BAD_REQUEST:
+		return "Bad Request";
+	case PARSE_SERVER_TOO_LARGE:
+		return "Request Too Large";
+	case PARSE_SERVER_UNSUPPORTED:
+		return "Unsupported Format";
+	case PARSE_SERVER_FAILED:
+		return "Conversion Failed";
+	default:
+		return "Internal Error";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseServerSlot::ParseServerSlot()
+{
+	mDefaultMachine = eL3S1Basic;
+	mDefaultFlags = psAscii | psUTF8;
+	mDiagLimit = -1;
+}
+
+ParseServerSlot::~ParseServerSlot()
+{
+	Clear();
+}
+
+/// パーサーを初期化する
+///
+/// 変換表を読み込むのでメインスレッドで呼ぶ。
+/// @param[in] app_path 変換表のあるパス
+/// @param[in] dir      一時ファイルを置くディレクトリ
+/// @return 初期化できない場合false
+bool ParseServerSlot::Init(const wxString &app_path, const wxString &dir)
+{
+	mDir = dir;
+	if (!wxFileName::Mkdir(wxFileName(mDir, _T("in")).GetFullPath(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+		return false;
+	}
+	mColl.SetAppPath(app_path);
+	mColl.Set(eL3S1Basic, new ParseL3S1Basic(&mColl));
+	mColl.Set(eMSXBasic, new ParseMSXBasic(&mColl));
+	for(int i=0; i<eMachineCount; i++) {
+		if (!(mColl.Get(i)->Init())) {
+			return false;
+		}
+		// 要求ごとにスレッドを分けているので1つの変換は並列にしない
+		mColl.Get(i)->SetThreadCount(1);
+	}
+	return true;
+}
+
+/// 一時ファイルを消す
+void ParseServerSlot::Clear()
+{
+	if (mDir.IsEmpty()) return;
+	wxString in_dir = wxFileName(mDir, _T("in")).GetFullPath();
+	if (wxFileName::DirExists(in_dir)) {
+		wxFileName::Rmdir(in_dir, wxPATH_RMDIR_RECURSIVE);
+	}
+	wxString out_path = wxFileName(mDir, _T("out")).GetFullPath();
+	if (wxFileName::FileExists(out_path)) {
+		wxRemoveFile(out_path);
+	}
+	wxFileName::Rmdir(mDir);
+	mDir.Empty();
+}
+
+/// 既定値を設定
+/// @param[in] machine    機種
+/// @param[in] flags      出力形式
+/// @param[in] diag_limit 中止する件数 -1:既定値 0:中止しない
+void ParseServerSlot::SetDefaults(int machine, int flags, int diag_limit)
+{
+	mDefaultMachine = machine;
+	mDefaultFlags = flags;
+	mDiagLimit = diag_limit;
+}
+
+/// テープの音声の形式を設定
+void ParseServerSlot::SetWaveParam(const L3WaveParam &param)
+{
+	((ParseL3S1Basic *)mColl.Get(eL3S1Basic))->SetWaveParam(param);
+}
+
+/// 要求のファイル名から一時ファイル名を作る
+///
+/// ディレクトリを除き、制御文字とパスの区切りを使わないようにする。
+/// 内部ファイル名になるので日本語はそのまま残す。
+wxString ParseServerSlot::MakeSafeName(const wxString &name)
+{
+	wxString base = name.AfterLast(wxT('/')).AfterLast(wxT('\\'));
+	wxString dst;
+	for(wxString::const_iterator it = base.begin(); it != base.end(); ++it) {
+		wxUniChar ch = *it;
+		if (ch.GetValue() < 0x20 || ch == wxT(':')) {
+			dst += wxT('_');
+		} else {
+			dst += ch;
+		}
+	}
+	while(dst.StartsWith(_T("."))) {
+		dst.Remove(0, 1);
+	}
+	if (dst.Length() > 64) {
+		dst = dst.Left(64);
+	}
+	if (dst.IsEmpty()) {
+		dst = _T("input");
+	}
+	return dst;
+}
+
+/// ファイルに書く
+bool ParseServerSlot::WriteFile(const wxString &path, const wxMemoryBuffer &data)
+{
+	wxFile file;
+	if (!file.Create(path, true)) {
+		return false;
+	}
+	if (data.GetDataLen() > 0 && file.Write(data.GetData(), data.GetDataLen()) != data.GetDataLen()) {
+		return false;
+	}
+	return file.Close();
+}
+
+/// ファイルを読む
+bool ParseServerSlot::ReadFile(const wxString &path, wxMemoryBuffer &data)
+{
+	wxFile file;
+	if (!file.Open(path, wxFile::read)) {
+		return false;
+	}
+	wxFileOffset len = file.Length();
+	if (len < 0) {
+		return false;
+	}
+	void *buf = data.GetWriteBuf((size_t)len);
+	ssize_t rlen = file.Read(buf, (size_t)len);
+	if (rlen != (ssize_t)len) {
+		data.UngetWriteBuf(0);
+		return false;
+	}
+	data.UngetWriteBuf((size_t)len);
+	return true;
+}
+
+/// パーサーのエラーを結果にする
+void ParseServerSlot::SetParseError(Parse *ps, int status, ParseServerResponse &res)
+{
+	const PsErrInfo &err = ps->GetErrInfo();
+	if (err.GetType() == psOK || err.GetMessage().IsEmpty()) {
+		res.SetError(status, _("Cannot convert."));
+	} else {
+		res.SetError(status, err.GetMessage());
+	}
+}
+
+/// 変換する
+///
+/// 入力データを一時ファイルにして、バッチモードと同じ手順で変換する。
+/// 入力の形式は内容で判別し、指定があれば判別した形式と比べる。
+/// テキストはUTF-8かどうかを区別せず、音声はテープイメージとして比べる。
+/// @param[in]  req 要求
+/// @param[out] res 結果
+void ParseServerSlot::Convert(const ParseServerRequest &req, ParseServerResponse &res)
+{
+	res.Empty();
+
+	// 機種
+	int machine = mDefaultMachine;
+	if (!req.mMachine.IsEmpty()) {
+		machine = ParseCollection::FindMachine(req.mMachine);
+		if (machine < 0) {
+			res.SetError(PARSE_SERVER_BAD_REQUEST, _("Unknown machine") + _T(": ") + req.mMachine);
+			return;
+		}
+	}
+	Parse *ps = mColl.Get(machine);
+	res.mMachine = wxString(ParseCollection::GetMachineKey(machine));
+
+	// 出力形式
+	int out_flags = mDefaultFlags;
+	if (!req.mTo.IsEmpty()) {
+		out_flags = ParseCollection::FindTypeFlags(req.mTo);
+		if (out_flags < 0) {
+			res.SetError(PARSE_SERVER_BAD_REQUEST, _("Unknown output type") + _T(": ") + req.mTo);
+			return;
+		}
+	}
+	if (out_flags & psDiskImage) {
+		res.SetError(PARSE_SERVER_BAD_REQUEST, _("Disk image output is not supported") + _T(": ") + req.mTo);
+		return;
+	}
+	if ((out_flags & psWaveAudio) && !ps->CanExportTapeAudio()) {
+		res.SetError(PARSE_SERVER_BAD_REQUEST, _("Audio output is not supported") + _T(": ") + ps->GetMachineName());
+		return;
+	}
+
+	// 入力形式
+	int from_flags = -1;
+	if (!req.mFrom.IsEmpty() && req.mFrom.CmpNoCase(_T("auto")) != 0) {
+		from_flags = ParseCollection::FindTypeFlags(req.mFrom);
+		if (from_flags < 0) {
+			res.SetError(PARSE_SERVER_BAD_REQUEST, _("Unknown input type") + _T(": ") + req.mFrom);
+			return;
+		}
+	}
+
+	// BASIC種類と文字種類
+	// 大文字小文字を区別せずに探して表の名前にそろえる
+	wxArrayString basic_types;
+	ps->GetBasicTypes(basic_types);
+	wxString basic_type;
+	if (!req.mBasicType.IsEmpty()) {
+		int idx = basic_types.Index(req.mBasicType, false);
+		if (idx == wxNOT_FOUND) {
+			res.SetError(PARSE_SERVER_BAD_REQUEST, _("Unknown BASIC type") + _T(": ") + req.mBasicType);
+			return;
+		}
+		basic_type = basic_types[idx];
+	}
+	wxArrayString char_types;
+	ps->GetCharTypes(char_types);
+	wxString req_char_type;
+	if (!req.mCharType.IsEmpty()) {
+		int idx = char_types.Index(req.mCharType, false);
+		if (idx == wxNOT_FOUND) {
+			res.SetError(PARSE_SERVER_BAD_REQUEST, _("Unknown character type") + _T(": ") + req.mCharType);
+			return;
+		}
+		req_char_type = char_types[idx];
+	}
+	wxString in_basic_type = basic_type;
+	if (in_basic_type.IsEmpty() && basic_types.Count() > 0) {
+		in_basic_type = basic_types[0];
+	}
+
+	wxString in_path = wxFileName(wxFileName(mDir, _T("in")).GetFullPath(), MakeSafeName(req.mName)).GetFullPath();
+	wxString out_path = wxFileName(mDir, _T("out")).GetFullPath();
+	if (!WriteFile(in_path, req.mData)) {
+		res.SetError(PARSE_SERVER_INTERNAL, _("Cannot write file."));
+		wxRemoveFile(in_path);
+		return;
+	}
+
+	mSink.Clear();
+	ps->GetErrInfo().Clear();
+	ps->SetResultSink(&mSink, mDiagLimit);
+
+	do {
+		PsFileType in_type;
+		in_type.SetMachineAndBasicType(ps->GetMachineType(in_basic_type), in_basic_type, ps->IsExtendedBasic(in_basic_type));
+		if (!ps->OpenDataFile(in_path, in_type)) {
+			SetParseError(ps, PARSE_SERVER_FAILED, res);
+			break;
+		}
+
+		PsFileType *opened_flags = ps->GetOpenedDataTypePtr();
+		if (from_flags >= 0) {
+			const int bits[] = { psAscii, psTapeImage, psDiskImage, 0 };
+			bool match = true;
+			for(int i=0; bits[i] != 0; i++) {
+				if (((from_flags & bits[i]) != 0) != opened_flags->GetTypeFlag(bits[i])) {
+					match = false;
+				}
+			}
+			if (!match) {
+				res.SetError(PARSE_SERVER_UNSUPPORTED, _("The data is not in the specified format") + _T(": ") + req.mFrom);
+				ps->CloseDataFile();
+				break;
+			}
+		}
+		if (!req_char_type.IsEmpty() && opened_flags->GetTypeFlag(psUTF8)) {
+			// 指定した文字種類で読み直す
+			if (!ps->ReloadOpendAsciiData(0, 0, req_char_type)) {
+				SetParseError(ps, PARSE_SERVER_FAILED, res);
+				ps->CloseDataFile();
+				break;
+			}
+			opened_flags = ps->GetOpenedDataTypePtr();
+		}
+
+		// 内部ファイル名
+		if (opened_flags->GetInternalName().IsEmpty()) {
+			opened_flags->SetInternalName(wxFileName::FileName(in_path).GetName());
+		}
+		wxArrayString lines;
+		wxString char_type = ps->GetParsedData(lines);
+		if (!req_char_type.IsEmpty()) {
+			char_type = req_char_type;
+		}
+
+		PsFileType file_type;
+		file_type.SetTypeFlag(out_flags, true);
+		if (out_flags & psTapeImage) {
+			file_type.SetInternalName(opened_flags->GetInternalName());
+		}
+		if (out_flags & psUTF8) {
+			file_type.SetCharType(char_type);
+		}
+		wxString out_basic_type = basic_type.IsEmpty() ? ps->GetOpenedBasicType() : basic_type;
+		file_type.SetMachineAndBasicType(ps->GetMachineType(out_basic_type), out_basic_type, ps->IsExtendedBasic(out_basic_type));
+		res.mBasicType = ps->GetOpenedBasicType();
+		res.mCharType = char_type;
+		if (!ps->OpenOutFile(out_path, file_type)) {
+			SetParseError(ps, PARSE_SERVER_INTERNAL, res);
+			ps->CloseDataFile();
+			break;
+		}
+
+		bool st = ps->ExportData();
+		ps->CloseOutFile();
+		ps->CloseDataFile();
+		if (!st) {
+			SetParseError(ps, PARSE_SERVER_FAILED, res);
+		} else if (!ReadFile(out_path, res.mData)) {
+			res.SetError(PARSE_SERVER_INTERNAL, _("Cannot read file."));
+		}
+	} while(0);
+
+	ps->SetResultSink(NULL);
+	res.mDiag = mSink.GetBuffer();
+	res.mDiagCount = mSink.GetCount();
+
+	wxRemoveFile(in_path);
+	if (wxFileName::FileExists(out_path)) {
+		wxRemoveFile(out_path);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseServerThread::ParseServerThread(ParseServerSlot *slot, wxMessageQueue<int> *queue)
+	: wxThread(wxTHREAD_JOINABLE)
+{
+	pSlot = slot;
+	pQueue = queue;
+}
+
+ParseServerThread::~ParseServerThread()
+{
+}
+
+/// 接続を受け取って処理する 負の値を受け取ったら終わる
+ParseServerThread::ExitCode ParseServerThread::Entry()
+{
+	int fd;
+	while(pQueue->Receive(fd) == wxMSGQUEUE_NO_ERROR) {
+		if (fd < 0) {
+			break;
+		}
+		Serve(fd);
+		close(fd);
+	}
+	return (ParseServerThread::ExitCode)0;
+}
+
+/// 1つの接続を処理する
+///
+/// 相手が切るか、一定時間要求がないか、要求に誤りがあるまで続ける。
+void ParseServerThread::Serve(int fd)
+{
+	wxMemoryBuffer buf;
+	ParseServerRequest req;
+	ParseServerResponse res;
+	for(;;) {
+		wxString msg;
+		req.Empty();
+		res.Empty();
+		int st = ParseServer::ReadRequest(fd, buf, req, msg);
+		if (st == 0) {
+			break;
+		}
+		if (st != PARSE_SERVER_OK) {
+			// 続きを読めないので応答して切る
+			res.SetError(st, msg);
+			ParseServer::WriteResponse(fd, res);
+			break;
+		}
+		pSlot->Convert(req, res);
+		if (!ParseServer::WriteResponse(fd, res)) {
+			break;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/// 受信してバッファに足す
+/// @return 受信した長さ 0:切断 -1:エラーか時間切れ
+static int RecvMore(int fd, wxMemoryBuffer &buf)
+{
+	char *p = (char *)buf.GetAppendBuf(4096);
+	ssize_t len;
+	do {
+		len = recv(fd, p, 4096, 0);
+	} while(len < 0 && errno == EINTR);
+	buf.UngetAppendBuf(len > 0 ? (size_t)len : 0);
+	return (int)len;
+}
+
+/// バッファの先頭を捨てる
+static void Consume(wxMemoryBuffer &buf, size_t len)
+{
+	size_t rest = buf.GetDataLen() - len;
+	char *p = (char *)buf.GetData();
+	memmove(p, p + len, rest);
+	buf.SetDataLen(rest);
+}
+
+/// 1行読む
+/// @param[in]     fd   ソケット
+/// @param[in,out] buf  受信済みのデータ
+/// @param[out]    line 行 (改行を除く)
+/// @return 1:読めた 0:何も受信せずに切断 -1:エラーか長すぎる
+static int ReadLine(int fd, wxMemoryBuffer &buf, wxString &line)
+{
+	size_t pos = 0;
+	for(;;) {
+		const char *p = (const char *)buf.GetData();
+		size_t len = buf.GetDataLen();
+		for(; pos < len; pos++) {
+			if (p[pos] == '\n') {
+				size_t end = pos;
+				if (end > 0 && p[end - 1] == '\r') end--;
+				line = wxString::FromUTF8(p, end);
+				Consume(buf, pos + 1);
+				return 1;
+			}
+		}
+		if (len > PARSE_SERVER_MAX_LINE) {
+			return -1;
+		}
+		int rlen = RecvMore(fd, buf);
+		if (rlen <= 0) {
+			return (rlen == 0 && buf.GetDataLen() == 0 ? 0 : -1);
+		}
+	}
+}
+
+/// 全部送る
+static bool SendAll(int fd, const void *data, size_t len)
+{
+	const char *p = (const char *)data;
+	while(len > 0) {
+		ssize_t wlen = send(fd, p, len, MSG_NOSIGNAL);
+		if (wlen < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		p += wlen;
+		len -= (size_t)wlen;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseServer::ParseServer()
+{
+	mFd = -1;
+	for(int i=0; i<PARSE_SERVER_MAX_THREADS; i++) {
+		mSlots[i] = NULL;
+		mThreads[i] = NULL;
+	}
+	mCount = 0;
+}
+
+ParseServer::~ParseServer()
+{
+	Close();
+}
+
+/// パーサーを初期化してソケットを開く
+///
+/// パーサーの組はスレッドの数だけメインスレッドで作る。
+/// 同じパスに前回のソケットが残っていて誰も待ち受けていなければ消してから作る。
+/// @param[in] path     ソケットのパス
+/// @param[in] count    スレッド数 0:CPU数
+/// @param[in] app_path 変換表のあるパス
+/// @return 開けない場合false
+bool ParseServer::Open(const wxString &path, int count, const wxString &app_path)
+{
+	Close();
+
+	if (count <= 0) count = wxThread::GetCPUCount();
+	if (count <= 0) count = 1;
+	if (count > PARSE_SERVER_MAX_THREADS) count = PARSE_SERVER_MAX_THREADS;
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	wxScopedCharBuffer fn = path.fn_str();
+	if (fn.length() == 0 || fn.length() >= sizeof(addr.sun_path)) {
+		return false;
+	}
+	memcpy(addr.sun_path, fn.data(), fn.length());
+
+	// 一時ファイルを置くディレクトリ
+	wxScopedCharBuffer tmpl = wxFileName(wxFileName::GetTempDir(), _T("l3s1basic-XXXXXX")).GetFullPath().fn_str();
+	wxCharBuffer dir(tmpl.data());
+	if (!mkdtemp(dir.data())) {
+		return false;
+	}
+	mTempDir = wxString(dir.data(), wxConvFile);
+
+	for(int i=0; i<count; i++) {
+		ParseServerSlot *slot = new ParseServerSlot();
+		mSlots[i] = slot;
+		mCount = i + 1;
+		if (!slot->Init(app_path, wxFileName(mTempDir, wxString::Format(_T("%d"), i)).GetFullPath())) {
+			Close();
+			return false;
+		}
+	}
+
+	// 残っているソケット
+	struct stat st;
+	if (lstat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0) {
+			bool used = (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+			close(fd);
+			if (used) {
+				Close();
+				return false;
+			}
+			unlink(addr.sun_path);
+		}
+	}
+
+	mFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (mFd < 0) {
+		Close();
+		return false;
+	}
+	fcntl(mFd, F_SETFD, FD_CLOEXEC);
+	if (bind(mFd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(mFd);
+		mFd = -1;
+		Close();
+		return false;
+	}
+	mPath = path;
+	if (listen(mFd, count * 4) != 0) {
+		Close();
+		return false;
+	}
+
+	// 相手が先に切っても止まらないようにする
+	signal(SIGPIPE, SIG_IGN);
+
+	return true;
+}
+
+/// スレッドを止めてソケットを閉じる
+///
+/// 受け付け済みの接続は処理してから止める。
+void ParseServer::Close()
+{
+	int started = 0;
+	for(int i=0; i<mCount; i++) {
+		if (mThreads[i]) {
+			mQueue.Post(-1);
+			started++;
+		}
+	}
+	for(int i=0; i<mCount; i++) {
+		if (mThreads[i]) {
+			mThreads[i]->Wait();
+			delete mThreads[i];
+			mThreads[i] = NULL;
+		}
+	}
+	if (started == 0) {
+		// 処理されずに残った接続
+		int fd;
+		while(mQueue.ReceiveTimeout(0, fd) == wxMSGQUEUE_NO_ERROR) {
+			if (fd >= 0) close(fd);
+		}
+	}
+	if (mFd >= 0) {
+		close(mFd);
+		mFd = -1;
+	}
+	if (!mPath.IsEmpty()) {
+		wxRemoveFile(mPath);
+		mPath.Empty();
+	}
+	for(int i=0; i<mCount; i++) {
+		delete mSlots[i];
+		mSlots[i] = NULL;
+	}
+	mCount = 0;
+	if (!mTempDir.IsEmpty()) {
+		wxFileName::Rmdir(mTempDir);
+		mTempDir.Empty();
+	}
+}
+
+/// 既定値を設定
+/// @param[in] machine    要求で指定しない場合の機種
+/// @param[in] flags      要求で指定しない場合の出力形式
+/// @param[in] diag_limit 中止する件数 -1:既定値 0:中止しない
+void ParseServer::SetDefaults(int machine, int flags, int diag_limit)
+{
+	for(int i=0; i<mCount; i++) {
+		mSlots[i]->SetDefaults(machine, flags, diag_limit);
+	}
+}
+
+/// テープの音声の形式を設定
+void ParseServer::SetWaveParam(const L3WaveParam &param)
+{
+	for(int i=0; i<mCount; i++) {
+		mSlots[i]->SetWaveParam(param);
+	}
+}
+
+/// スレッドを起動する
+/// @return 1つも起動できない場合false
+bool ParseServer::Start()
+{
+	int started = 0;
+	for(int i=0; i<mCount; i++) {
+		ParseServerThread *thread = new ParseServerThread(mSlots[i], &mQueue);
+		if (thread->Run() != wxTHREAD_NO_ERROR) {
+			delete thread;
+			continue;
+		}
+		mThreads[i] = thread;
+		started++;
+	}
+	return (started > 0);
+}
+
+/// 接続を待って受け付ける
+///
+/// 受け付けた接続は待ち行列に入れ、空いたスレッドが処理する。
+/// @param[in] timeout_msec 待つ時間
+/// @return ソケットが使えなくなった場合false
+bool ParseServer::Accept(int timeout_msec)
+{
+	struct pollfd pfd;
+	pfd.fd = mFd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int rc = poll(&pfd, 1, timeout_msec);
+	if (rc < 0) {
+		return (errno == EINTR);
+	}
+	if (rc == 0 || (pfd.revents & POLLIN) == 0) {
+		return true;
+	}
+	int fd = accept(mFd, NULL, NULL);
+	if (fd < 0) {
+		return (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED);
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	// 要求がないまま待ち続けないようにする
+	struct timeval tv;
+	tv.tv_sec = PARSE_SERVER_IDLE_SEC;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	if (mQueue.Post(fd) != wxMSGQUEUE_NO_ERROR) {
+		close(fd);
+	}
+	return true;
+}
+
+/// 要求を読む
+/// @param[in]     fd  ソケット
+/// @param[in,out] buf 受信済みで使っていないデータ
+/// @param[out]    req 要求
+/// @param[out]    msg エラーメッセージ
+/// @return PARSE_SERVER_OK:読めた 0:切断 それ以外:enParseServerStatus
+int ParseServer::ReadRequest(int fd, wxMemoryBuffer &buf, ParseServerRequest &req, wxString &msg)
+{
+	wxString line;
+	int rc = ReadLine(fd, buf, line);
+	if (rc <= 0) {
+		return 0;
+	}
+	if (line != _T(PARSE_SERVER_PROTOCOL " CONVERT")) {
+		msg = _("Invalid request") + _T(": ") + line.Left(64);
+		return PARSE_SERVER_BAD_REQUEST;
+	}
+
+	long length = -1;
+	int headers = 0;
+	for(;;) {
+		if (ReadLine(fd, buf, line) <= 0) {
+			msg = _("Invalid request");
+			return PARSE_SERVER_BAD_REQUEST;
+		}
+		if (line.IsEmpty()) {
+			break;
+		}
+		if (++headers > PARSE_SERVER_MAX_HEADERS) {
+			msg = _("Too many headers");
+			return PARSE_SERVER_BAD_REQUEST;
+		}
+		int pos = line.Find(wxT(':'));
+		if (pos == wxNOT_FOUND) {
+			msg = _("Invalid header") + _T(": ") + line.Left(64);
+			return PARSE_SERVER_BAD_REQUEST;
+		}
+		wxString key = line.Left(pos).Trim().Lower();
+		wxString val = line.Mid(pos + 1).Trim(false).Trim();
+		if (key == _T("machine")) {
+			req.mMachine = val;
+		} else if (key == _T("basic")) {
+			req.mBasicType = val;
+		} else if (key == _T("from")) {
+			req.mFrom = val;
+		} else if (key == _T("to")) {
+			req.mTo = val;
+		} else if (key == _T("char")) {
+			req.mCharType = val;
+		} else if (key == _T("name")) {
+			req.mName = val;
+		} else if (key == _T("length")) {
+			if (!val.ToLong(&length) || length < 0) {
+				msg = _("Invalid header") + _T(": ") + line.Left(64);
+				return PARSE_SERVER_BAD_REQUEST;
+			}
+		}
+		// 知らないヘッダは無視する
+	}
+	if (length < 0) {
+		msg = _("No length header");
+		return PARSE_SERVER_BAD_REQUEST;
+	}
+	if (length > PARSE_SERVER_MAX_LENGTH) {
+		msg = wxString::Format(_T("%s: %ld"), _("Input data is too large"), length);
+		return PARSE_SERVER_TOO_LARGE;
+	}
+
+	// 入力データ
+	while(buf.GetDataLen() < (size_t)length) {
+		if (RecvMore(fd, buf) <= 0) {
+			msg = _("Input data is too short");
+			return PARSE_SERVER_BAD_REQUEST;
+		}
+	}
+	req.mData.SetDataLen(0);
+	req.mData.AppendData(buf.GetData(), (size_t)length);
+	Consume(buf, (size_t)length);
+
+	return PARSE_SERVER_OK;
+}
+
+/// 応答を書く
+/// @param[in] fd  ソケット
+/// @param[in] res 結果
+/// @return 送れない場合false
+bool ParseServer::WriteResponse(int fd, const ParseServerResponse &res)
+{
+	wxString head = wxString::Format(_T("%s %d %s\n"),
+		_T(PARSE_SERVER_PROTOCOL), res.mStatus, ParseServerResponse::StatusText(res.mStatus));
+	if (!res.mMachine.IsEmpty()) head += _T("machine: ") + res.mMachine + _T("\n");
+	if (!res.mBasicType.IsEmpty()) head += _T("basic: ") + res.mBasicType + _T("\n");
+	if (!res.mCharType.IsEmpty()) head += _T("char: ") + res.mCharType + _T("\n");
+	if (!res.mError.IsEmpty()) head += _T("error: ") + res.mError + _T("\n");
+	head += wxString::Format(_T("count: %lu\n"), (unsigned long)res.mDiagCount);
+	head += wxString::Format(_T("length: %lu\n"), (unsigned long)res.mData.GetDataLen());
+	head += wxString::Format(_T("diagnostics: %lu\n"), (unsigned long)res.mDiag.GetDataLen());
+	head += _T("\n");
+
+	wxScopedCharBuffer hbuf = head.utf8_str();
+	if (!SendAll(fd, hbuf.data(), hbuf.length())) return false;
+	if (!SendAll(fd, res.mData.GetData(), res.mData.GetDataLen())) return false;
+	if (!SendAll(fd, res.mDiag.GetData(), res.mDiag.GetDataLen())) return false;
+	return true;
+}
+
+#endif /* USE_PARSE_SERVER */
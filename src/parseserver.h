@@ -0,0 +1,192 @@
+﻿/// @file parseserver.h
+///
+/// @brief 変換サーバー
+///
+///
+#ifndef _PARSESERVER_H_
+#define _PARSESERVER_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include "parse.h"
+#include "parseresult.h"
+#include "l3wave.h"
+
+#if defined(__UNIX__)
+/// Unixドメインソケットで変換要求を受け付ける コメントアウトするとサーバーモードを使わない
+#define USE_PARSE_SERVER 1
+#endif
+
+#ifdef USE_PARSE_SERVER
+
+/// プロトコルの名前
+#define PARSE_SERVER_PROTOCOL		"L3S1BASIC/1"
+/// 最大スレッド数
+#define PARSE_SERVER_MAX_THREADS	16
+/// 入力データの最大の長さ
+#define PARSE_SERVER_MAX_LENGTH		(16 * 1024 * 1024)
+/// ヘッダ1行の最大の長さ
+#define PARSE_SERVER_MAX_LINE		1024
+/// ヘッダの最大行数
+#define PARSE_SERVER_MAX_HEADERS	32
+/// 次の要求を待つ時間(秒) 過ぎたら接続を切る
+#define PARSE_SERVER_IDLE_SEC		30
+
+/// 応答の状態
+enum enParseServerStatus {
+	PARSE_SERVER_OK = 200,				///< 変換した
+	PARSE_SERVER_BAD_REQUEST = 400,		///< 要求の誤り
+	PARSE_SERVER_TOO_LARGE = 413,		///< 入力が長すぎる
+	PARSE_SERVER_UNSUPPORTED = 415,		///< 入力の形式が指定と違う
+	PARSE_SERVER_FAILED = 422,			///< 変換できなかった
+	PARSE_SERVER_INTERNAL = 500			///< 一時ファイルを使えないなど
+};
+
+/// 変換要求
+class ParseServerRequest
+{
+public:
+	wxString mMachine;		///< 機種 (l3s1,msx) 空なら既定の機種
+	wxString mBasicType;	///< BASIC種類 空なら最初の種類
+	wxString mFrom;			///< 入力の形式 空かautoなら判別に任せる
+	wxString mTo;			///< 出力の形式 (bin,ascii,utf8など) 空なら既定の形式
+	wxString mCharType;		///< 文字種類 空なら判別に任せる
+	wxString mName;			///< ファイル名 内部ファイル名と解析結果に使う
+	wxMemoryBuffer mData;	///< 入力データ
+
+	void Empty();
+};
+
+/// 変換結果
+class ParseServerResponse
+{
+public:
+	int mStatus;			///< enParseServerStatus
+	wxString mError;		///< エラーメッセージ
+	wxString mMachine;		///< 変換した機種
+	wxString mBasicType;	///< 入力のBASIC種類
+	wxString mCharType;		///< 文字種類
+	wxMemoryBuffer mData;	///< 出力データ
+	wxMemoryBuffer mDiag;	///< 解析結果 (JSON Lines)
+	size_t mDiagCount;		///< 解析結果の件数
+
+	ParseServerResponse();
+	void Empty();
+	void SetError(int status, const wxString &msg);
+	/// 状態の説明
+	static const char *StatusText(int status);
+};
+
+/// 変換するパーサーの組
+///
+/// 初期化した全機種のパーサーと一時ファイルを置くディレクトリを持ち、1つのスレッドが使う。
+/// パーサーは変換表の読み込み位置を持つので、変換表はスレッド間で共有せずに組ごとに持つ。
+class ParseServerSlot
+{
+private:
+	ParseCollection mColl;		///< パーサー
+	ParseResultBufferSink mSink;	///< 解析結果の出力先
+	wxString mDir;				///< 一時ファイルを置くディレクトリ
+	int mDefaultMachine;		///< 既定の機種
+	int mDefaultFlags;			///< 既定の出力形式
+	int mDiagLimit;				///< 中止する件数
+
+	/// 要求のファイル名から一時ファイル名を作る
+	static wxString MakeSafeName(const wxString &name);
+	/// ファイルに書く
+	static bool WriteFile(const wxString &path, const wxMemoryBuffer &data);
+	/// ファイルを読む
+	static bool ReadFile(const wxString &path, wxMemoryBuffer &data);
+	/// パーサーのエラーを結果にする
+	static void SetParseError(Parse *ps, int status, ParseServerResponse &res);
+
+public:
+	ParseServerSlot();
+	~ParseServerSlot();
+
+	/// パーサーを初期化する
+	bool Init(const wxString &app_path, const wxString &dir);
+	/// 一時ファイルを消す
+	void Clear();
+	/// 既定値を設定
+	void SetDefaults(int machine, int flags, int diag_limit);
+	/// テープの音声の形式を設定
+	void SetWaveParam(const L3WaveParam &param);
+	/// 変換する
+	void Convert(const ParseServerRequest &req, ParseServerResponse &res);
+
+	DECLARE_NO_COPY_CLASS(ParseServerSlot)
+};
+
+/// 接続を処理するスレッド
+///
+/// 待ち行列から接続を受け取り、相手が切るまで要求を順に変換する。
+class ParseServerThread : public wxThread
+{
+protected:
+	ParseServerSlot *pSlot;
+	wxMessageQueue<int> *pQueue;
+
+	virtual ExitCode Entry();
+
+	/// 1つの接続を処理する
+	void Serve(int fd);
+
+public:
+	ParseServerThread(ParseServerSlot *slot, wxMessageQueue<int> *queue);
+	~ParseServerThread();
+};
+
+/// 変換サーバー
+///
+/// Unixドメインソケットで接続を受け付け、変換はスレッドの数だけ用意したパーサーの組で並行して行う。
+/// 入力の形式は内容で判別し、出力データと解析結果(JSON Lines)を返す。
+///
+/// 要求: "L3S1BASIC/1 CONVERT" の行、"名前: 値" のヘッダ(machine, basic, from, to, char, name, length)、
+/// 空行、lengthバイトの入力データ。
+/// 応答: "L3S1BASIC/1 200 OK" の行、ヘッダ(length, diagnostics, count, errorなど)、空行、
+/// lengthバイトの出力データとdiagnosticsバイトの解析結果。
+/// 1つの接続で続けて要求できる。
+class ParseServer
+{
+private:
+	int mFd;					///< 待ち受けのソケット
+	wxString mPath;				///< ソケットのパス
+	wxString mTempDir;			///< 一時ファイルを置くディレクトリ
+	ParseServerSlot *mSlots[PARSE_SERVER_MAX_THREADS];
+	ParseServerThread *mThreads[PARSE_SERVER_MAX_THREADS];
+	int mCount;					///< スレッド数
+	wxMessageQueue<int> mQueue;	///< 受け付けた接続
+
+public:
+	ParseServer();
+	~ParseServer();
+
+	/// パーサーを初期化してソケットを開く
+	bool Open(const wxString &path, int count, const wxString &app_path);
+	/// スレッドを止めてソケットを閉じる
+	void Close();
+	/// 既定値を設定
+	void SetDefaults(int machine, int flags, int diag_limit);
+	/// テープの音声の形式を設定
+	void SetWaveParam(const L3WaveParam &param);
+	/// 接続を待って受け付ける
+	bool Accept(int timeout_msec);
+	/// スレッドを起動する
+	bool Start();
+
+	int GetCount() const { return mCount; }
+
+	/// 要求を読む
+	static int ReadRequest(int fd, wxMemoryBuffer &buf, ParseServerRequest &req, wxString &msg);
+	/// 応答を書く
+	static bool WriteResponse(int fd, const ParseServerResponse &res);
+
+	DECLARE_NO_COPY_CLASS(ParseServer)
+};
+
+#endif /* USE_PARSE_SERVER */
+
+#endif /* _PARSESERVER_H_ */
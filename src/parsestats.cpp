@@ -0,0 +1,100 @@
+﻿/// @file parsestats.cpp
+///
+/// @brief 変換処理の計測
+///
+#include "parsestats.h"
+#include "fileinfo.h"
+
+/// 処理段階の名称
+static const char *cStageNames[psStageCount] = {
+	"tape",
+	"read text",
+	"utf-8",
+	"decode",
+	"tokenize",
+	"encode",
+	"write",
+};
+
+ParseStats::ParseStats()
+{
+	Empty();
+}
+
+void ParseStats::Empty()
+{
+	for(int i=0; i<psStageCount; i++) {
+		mCalls[i] = 0;
+		mTime[i] = 0;
+		mBytes[i] = 0;
+		mLines[i] = 0;
+	}
+	mCharLookups = 0;
+	mBasicLookups = 0;
+}
+
+/// 計測結果を加算
+void ParseStats::Add(ParseStage stage, wxLongLong usec, wxUint64 bytes, wxUint64 lines)
+{
+	mCalls[stage]++;
+	mTime[stage] += usec;
+	mBytes[stage] += bytes;
+	mLines[stage] += lines;
+}
+
+#ifdef USE_PARSE_STATS
+/// テーブル検索回数をセット
+void ParseStats::SetLookups(wxUint64 char_lookups, wxUint64 basic_lookups)
+{
+	mCharLookups = char_lookups;
+	mBasicLookups = basic_lookups;
+}
+#endif
+
+const char *ParseStats::StageName(ParseStage stage)
+{
+	return cStageNames[stage];
+}
+
+/// 表形式の文字列にする
+void ParseStats::Report(wxArrayString &lines) const
+{
+	lines.Add(wxString::Format(_T("%-10s %8s %10s %12s %10s %9s %11s"),
+		"stage", "calls", "time(ms)", "bytes", "lines", "MB/s", "lines/s"));
+	for(int i=0; i<psStageCount; i++) {
+		if (mCalls[i] == 0) continue;
+		double sec = mTime[i].ToDouble() / 1000000.0;
+		double mbps = sec > 0.0 ? (double)mBytes[i] / sec / 1000000.0 : 0.0;
+		double lps = sec > 0.0 ? (double)mLines[i] / sec : 0.0;
+		lines.Add(wxString::Format(_T("%-10s %8u %10.3f %12llu %10llu %9.2f %11.0f"),
+			cStageNames[i], (unsigned)mCalls[i], sec * 1000.0,
+			(unsigned long long)mBytes[i], (unsigned long long)mLines[i], mbps, lps));
+	}
+	lines.Add(wxString::Format(_T("char code lookups:  %llu"), (unsigned long long)mCharLookups));
+	lines.Add(wxString::Format(_T("basic code lookups: %llu"), (unsigned long long)mBasicLookups));
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseStatsTimer::ParseStatsTimer(ParseStats &stats, ParseStage stage, PsFileInput *input)
+	: mStats(stats)
+{
+	mStage = stage;
+	pInput = input;
+	mStartPos = input ? input->Seek(0, wxFromCurrent) : wxInvalidOffset;
+	mBytes = 0;
+	mLines = 0;
+	mWatch.Start();
+}
+
+ParseStatsTimer::~ParseStatsTimer()
+{
+	wxLongLong usec = mWatch.TimeInMicro();
+	if (pInput && mStartPos != wxInvalidOffset) {
+		wxFileOffset pos = pInput->Seek(0, wxFromCurrent);
+		if (pos != wxInvalidOffset && pos > mStartPos) {
+			mBytes += (wxUint64)(pos - mStartPos);
+		}
+	}
+	mStats.Add(mStage, usec, mBytes, mLines);
+}
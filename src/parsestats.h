@@ -0,0 +1,101 @@
+﻿/// @file parsestats.h
+///
+/// @brief 変換処理の計測
+///
+#ifndef _PARSESTATS_H_
+#define _PARSESTATS_H_
+
+/// 計測を行う コメントアウトすると計測処理は組み込まれない
+#define USE_PARSE_STATS 1
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/stopwatch.h>
+
+class PsFileInput;
+
+/// 処理段階
+typedef enum enumParseStage {
+	psStageTape = 0,	///< テープイメージから実データを取り出す
+	psStageReadText,	///< テキストを読む
+	psStageUTF8,		///< UTF-8との変換
+	psStageDecode,		///< 中間言語を解析
+	psStageTokenize,	///< アスキー形式を解析(色付け)
+	psStageEncode,		///< アスキー形式を中間言語に変換
+	psStageWrite,		///< 出力
+	psStageCount
+} ParseStage;
+
+/// 処理段階ごとの時間と処理量
+class ParseStats
+{
+private:
+	wxUint32 mCalls[psStageCount];	///< 呼び出し回数
+	wxLongLong mTime[psStageCount];	///< 経過時間(usec)
+	wxUint64 mBytes[psStageCount];	///< 処理バイト数
+	wxUint64 mLines[psStageCount];	///< 処理行数
+	wxUint64 mCharLookups;			///< 文字コード変換テーブルの検索回数
+	wxUint64 mBasicLookups;			///< BASICコード変換テーブルの検索回数
+
+public:
+	ParseStats();
+
+	void Empty();
+	/// 計測結果を加算
+	void Add(ParseStage stage, wxLongLong usec, wxUint64 bytes, wxUint64 lines);
+#ifdef USE_PARSE_STATS
+	/// テーブル検索回数をセット
+	void SetLookups(wxUint64 char_lookups, wxUint64 basic_lookups);
+#endif
+
+	static const char *StageName(ParseStage stage);
+
+	wxUint32 GetCalls(ParseStage stage) const { return mCalls[stage]; }
+	wxLongLong GetTime(ParseStage stage) const { return mTime[stage]; }
+	wxUint64 GetBytes(ParseStage stage) const { return mBytes[stage]; }
+	wxUint64 GetLines(ParseStage stage) const { return mLines[stage]; }
+	wxUint64 GetCharLookups() const { return mCharLookups; }
+	wxUint64 GetBasicLookups() const { return mBasicLookups; }
+
+	/// 表形式の文字列にする
+	void Report(wxArrayString &lines) const;
+};
+
+/// 処理段階の計測
+///
+/// スコープを抜けるときに経過時間を加算する。
+/// 入力ストリームを渡した場合は読み進めたバイト数も加算する。
+class ParseStatsTimer
+{
+private:
+	ParseStats &mStats;
+	ParseStage mStage;
+	PsFileInput *pInput;
+	wxFileOffset mStartPos;
+	wxUint64 mBytes;
+	wxUint64 mLines;
+	wxStopWatch mWatch;
+
+public:
+	ParseStatsTimer(ParseStats &stats, ParseStage stage, PsFileInput *input = NULL);
+	~ParseStatsTimer();
+
+	/// 処理量を加算
+	void Count(wxUint64 bytes, wxUint64 lines) { mBytes += bytes; mLines += lines; }
+
+	DECLARE_NO_COPY_CLASS(ParseStatsTimer)
+};
+
+#ifdef USE_PARSE_STATS
+#define PARSE_STATS_STAGE(stats, stage)			ParseStatsTimer parse_stats_timer(stats, stage)
+#define PARSE_STATS_STAGE_INPUT(stats, stage, input)	ParseStatsTimer parse_stats_timer(stats, stage, &(input))
+#define PARSE_STATS_COUNT(bytes, lines)			parse_stats_timer.Count(bytes, lines)
+#define PARSE_STATS_LOOKUP(counter)				(counter)++
+#else
+#define PARSE_STATS_STAGE(stats, stage)
+#define PARSE_STATS_STAGE_INPUT(stats, stage, input)
+#define PARSE_STATS_COUNT(bytes, lines)
+#define PARSE_STATS_LOOKUP(counter)
+#endif
+
+#endif /* _PARSESTATS_H_ */
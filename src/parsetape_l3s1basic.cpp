@@ -26,83 +26,73 @@ bool ParseL3S1Basic::CheckTapeDataFormat(PsFileInput &in_data, PsFileOutput &out
 		mErrInfo.ShowMsgBox();
 		return false;
 	}
+	if (mTapeBadBlocks.Count() > 0) {
+		// チェックサムが合わないブロックがある 取り出したデータはそのまま使う
+		wxString blocks = _T("blocks:");
+		for(size_t i = 0; i < mTapeBadBlocks.Count(); i++) {
+			if (i >= 8) {
+				blocks += _T(" ...");
+				break;
+			}
+			blocks += wxString::Format(_T(" %d"), mTapeBadBlocks[i] + 1);
+		}
+		mErrInfo.SetInfo(__LINE__, psWarning, psErrTapeChecksum, blocks);
+		mErrInfo.ShowMsgBox();
+	}
 	return true;
 }
 
+/// WAVファイルのフォーマットチェック
+///
+/// 音声をテープイメージに復調してからテープイメージとして調べる。
+bool ParseL3S1Basic::CheckWaveDataFormat(PsFileInput &in_data, PsFileOutput &out_data)
+{
+	PsFileStrOutput tape_data;
+	L3WaveDecoder decoder(mWaveParam);
+	if (!decoder.Decode(in_data, tape_data)) {
+		mErrInfo.SetInfo(__LINE__, psError, psErrWaveFormat);
+		mErrInfo.ShowMsgBox();
+		return false;
+	}
+	PsFileStrInput tape_in(tape_data);
+	tape_in.SetType(in_data.GetType());
+	return CheckTapeDataFormat(tape_in, out_data);
+}
+
 /// テープイメージから実ファイルを取り出す
+///
+/// イメージ全体をメモリに読み込み、ブロックの一覧を作ってからデータをつなげる。
 bool ParseL3S1Basic::ReadTapeToRealData(PsFileInput &in_data, PsFileOutput &out_data)
 {
-	wxString name = _("Tape->RealData");
+	PARSE_STATS_STAGE_INPUT(mStats, psStageTape, in_data);
 
-	wxUint8 vals[260];
+	// イメージを読み込む
+	wxMemoryBuffer image;
+	in_data.ReadAll(image);
+	const wxUint8 *data = (const wxUint8 *)image.GetData();
 
-	int vlen = 0;
+	L3TapeBlocks blocks;
+	blocks.Scan(data, image.GetDataLen());
+	blocks.GetBadBlocks(mTapeBadBlocks);
 
-	int phase = 0;
-
-	int header_type;
-	int data_len;
-
-	wxString file_name;	///< イメージ内のファイル名
+	static const wxUint8 zeros[256] = { 0 };
+	wxUint8 vals[256];
 
 	// parse start
 	bool rc = true;
-	while(!in_data.Eof() && phase >= 0) {
-		memset(vals, 0, sizeof(vals));
-		switch(phase) {
-		case 0:
-			// find indentifier
-			vlen = (int)in_data.Read(vals, 3);
-			if (vlen < 3) {
-				// end
-				phase = -1;
-				break;
-			}
-			if (memcmp(vals, cmt_ident, 3) == 0) {
-				// found
-				in_data.Read(&vals[3], 1);
-				header_type = vals[3];
-				switch(header_type) {
-					case 0:
-						// file name section
-						phase = 1;
-						break;
-					case 1:
-						// body data section
-						phase = 2;
-						break;
-					case 0xff:
-						// footer data section
-						phase = 3;
-						break;
-					default:
-						// ?? error?
-						break;
-				}
-			}
-			if (phase == 0) {
-				// continue reading
-				in_data.Seek(-2, wxFromCurrent);
-			}
-			break;
-
-		case 1:
+	for(size_t i = 0; i < blocks.Count() && rc; i++) {
+		const L3TapeBlock &block = blocks[i];
+		switch(block.type) {
+		case L3TAPE_NAME:
 			// file name section
-			vlen = (int)in_data.Read(vals, 1);
-			if (vlen == 0) {
-				// end
-				phase = -1;
-				break;
-			}
-			data_len = vals[0];
-			vlen = (int)in_data.Read(vals, data_len);
+			memset(vals, 0, sizeof(vals));
+			memcpy(vals, &data[block.data_pos], block.avail);
 			// file name pos0-7
 			out_data.SetInternalName(vals, 8);
 			// file type pos8
 			if (vals[8] != 0) {
 				// This is not BASIC file.
 				rc = false;
-				phase = -1;
 				break;
 			}
 			// file type2 pos9,10
@@ -115,54 +105,25 @@ bool ParseL3S1Basic::ReadTapeToRealData(PsFileInput &in_data, PsFileOutput &out_
 			} else {
 				// Invalid parameter.
 				rc = false;
-				phase = -1;
-				break;
 			}
-
-			vlen = (int)in_data.Read(vals, 3);
-			// crc 0 ignore
+			// crc is checked by scanning
 			// footer 1-2
-
-			// read next section
-			phase = 0;
 			break;
 
-		case 2:
+		case L3TAPE_DATA:
 			// body data section
-			vlen = (int)in_data.Read(vals, 1);
-			if (vlen == 0) {
-				// end
-				phase = -1;
-				break;
+			out_data.Write(&data[block.data_pos], block.avail);
+			if (block.avail < block.length) {
+				// 途中で切れている
+				out_data.Write(zeros, block.length - block.avail);
 			}
-			data_len = vals[0];
-			vlen = (int)in_data.Read(vals, data_len);
-			// datas
-			out_data.Write(vals, data_len);
-
-			vlen = (int)in_data.Read(vals, 3);
-			// crc 0 ignore
+			// crc is checked by scanning
 			// footer 1-2
-
-			// read next section
-			phase = 0;
 			break;
 
-		case 3:
+		default:
 			// footer data section
-			vlen = (int)in_data.Read(vals, 1);
-			if (vlen == 0) {
-				// end
-				phase = -1;
-				break;
-			}
-
-			vlen = (int)in_data.Read(vals, 3);
-			// crc 0 ignore
-			// footer 1-2
-
 			// end of reading file
-			phase = -1;
 			break;
 		}
 	}
@@ -173,12 +134,16 @@ bool ParseL3S1Basic::ReadTapeToRealData(PsFileInput &in_data, PsFileOutput &out_
 }
 
 /// 実データをテープイメージにして出力
+///
+/// 出力先にpsWaveAudioがあればテープイメージを音声(WAV)にして出力する。
 bool ParseL3S1Basic::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &out_file)
 {
+	PARSE_STATS_STAGE_INPUT(mStats, psStageWrite, in_file);
+
 	bool rc = true;
 	int hlen = 0x5a;
 	int dlen = 0;
-	int chk_sum = 0;
+	int type_pos = 0;
 	int phase = 0;
 	wxString sdata;
 	const char *cdata;
@@ -187,22 +152,25 @@ bool ParseL3S1Basic::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &o
 	wxUint8 odata[520];
 	int opos;
 
+	// 音声で出力する場合はテープイメージをためておく
+	bool to_wave = out_file.GetTypeFlag(psWaveAudio);
+	PsFileStrOutput tape_data;
+	PsFileOutput *tape_out = (to_wave ? (PsFileOutput *)&tape_data : &out_file);
+
 	while (phase >= 0) {
 		switch(phase) {
 			case 0:
 				// file name section
-				chk_sum = 0;
 				opos = 0;
 
 				memset(&odata[opos], 0xff, hlen); opos += hlen;
 				memcpy(&odata[opos], &cmt_ident[1], 2); opos += 2;
 				// header_type
+				type_pos = opos;
 				odata[opos++] = 0;
-				chk_sum += 0;
 				// 20バイト
 				dlen = 20;
 				odata[opos++] = (dlen & 0xff);
-				chk_sum += dlen;
 				// file name
 				sdata = out_file.GetInternalName();
 				if (sdata.Length() < 8) {
@@ -211,41 +179,36 @@ bool ParseL3S1Basic::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &o
 				cdata = sdata.To8BitData();
 				for(int i=0; i<8; i++) {
 					odata[opos++] = (cdata[i] & 0xff);
-					chk_sum += cdata[i];
 				}
 				// file type (BASIC)
 				odata[opos++] = 0;
-				chk_sum += 0;
 				// file type 2
 				if (in_file.GetTypeFlag(psAscii)) {
 					memset(&odata[opos], 0xff, 2); opos += 2;
-					chk_sum += 0xff + 0xff;
 				} else {
 					memset(&odata[opos], 0, 2); opos += 2;
-					chk_sum += 0;
 				}
 				memset(&odata[opos], 0, dlen - 11); opos += (dlen - 11);
-				chk_sum += 0;
 				// chk sum
-				odata[opos++] = (chk_sum & 0xff);
+				odata[opos] = L3TapeBlocks::CheckSum(&odata[type_pos], opos - type_pos);
+				opos++;
 				// 0 x4
 				memset(&odata[opos], 0, 4); opos += 4;
 
-				out_file.Write(odata, opos);
+				tape_out->Write(odata, opos);
 
 				phase = 1;
 				break;
 
 			case 1:
 				// body data
-				chk_sum = 0;
 				opos = 0;
 
 				memset(&odata[opos], 0xff, hlen); opos += hlen;
 				memcpy(&odata[opos], &cmt_ident[1], 2); opos += 2;
 				// header_type
+				type_pos = opos;
 				odata[opos++] = 1;
-				chk_sum += 1;
 				// 255バイト最大
 				dlen = (int)in_file.Read(buf, 255);
 				if (dlen == 0) {
@@ -254,17 +217,14 @@ bool ParseL3S1Basic::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &o
 					break;
 				}
 				odata[opos++] = (dlen & 0xff);
-				chk_sum += dlen;
-				for(int i=0; i<dlen; i++) {
-					odata[opos++] = buf[i];
-					chk_sum += buf[i];
-				}
+				memcpy(&odata[opos], buf, dlen); opos += dlen;
 				// chk sum
-				odata[opos++] = (chk_sum & 0xff);
+				odata[opos] = L3TapeBlocks::CheckSum(&odata[type_pos], opos - type_pos);
+				opos++;
 				// 0 x4
 				memset(&odata[opos], 0, 4); opos += 4;
 
-				out_file.Write(odata, opos);
+				tape_out->Write(odata, opos);
 
 				if (!in_file.GetTypeFlag(psAscii)) {
 					// gap reset when it's binary save
@@ -277,33 +237,79 @@ bool ParseL3S1Basic::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &o
 				break;
 			case 2:
 				// footer data
-				chk_sum = 0;
 				opos = 0;
 
 				memset(&odata[opos], 0xff, hlen); opos += hlen;
 				memcpy(&odata[opos], &cmt_ident[1], 2); opos += 2;
 				// header_type
+				type_pos = opos;
 				odata[opos++] = 0xff;
-				chk_sum += 0xff;
 				//
 				dlen = 0;
 				odata[opos++] = (dlen & 0xff);
-				chk_sum += dlen;
 				// chk sum
-				odata[opos++] = (chk_sum & 0xff);
+				odata[opos] = L3TapeBlocks::CheckSum(&odata[type_pos], opos - type_pos);
+				opos++;
 				// 0 x4
 				memset(&odata[opos], 0, 4); opos += 4;
 
-				out_file.Write(odata, opos);
+				tape_out->Write(odata, opos);
 
 				phase = -1;
 				break;
 		}
 	}
 
+	if (to_wave) {
+		// テープイメージを音声にする
+		PsFileStrInput tape_in(tape_data);
+		wxMemoryBuffer image;
+		tape_in.ReadAll(image);
+		L3WaveEncoder encoder(mWaveParam);
+		rc = encoder.Encode((const wxUint8 *)image.GetData(), image.GetDataLen(), out_file);
+		if (!rc) {
+			mErrInfo.SetInfo(__LINE__, psError, psErrWaveFormat);
+			mErrInfo.ShowMsgBox();
+		}
+	}
+
 	return rc;
 }
 
+/// 複数のファイルが入ったテープイメージを開く
+///
+/// ファイルの一覧を作り、内部ファイル名を表示用に変換する。
+/// @param[in]  path    イメージのファイル
+/// @param[out] archive ファイルの一覧
+/// @return 読めなかった場合false
+bool ParseL3S1Basic::OpenTapeArchive(const wxString &path, L3TapeArchive &archive)
+{
+	if (!archive.Open(path)) {
+		return false;
+	}
+	for(size_t i = 0; i < archive.Count(); i++) {
+		wxString name = ConvInternalName(archive[i].raw_name, L3TAPE_NAME_LEN);
+		archive.SetName(i, name.Trim());
+	}
+	return true;
+}
+
+/// テープイメージのチェックサムだけを調べる
+///
+/// BASICとしては解析しない。
+/// @param[in]  path       イメージのファイル
+/// @param[out] archive    ファイルの一覧
+/// @param[out] bad_blocks チェックサムが合わないブロックの番号
+/// @return 読めなかった場合false
+bool ParseL3S1Basic::VerifyTapeImage(const wxString &path, L3TapeArchive &archive, wxArrayInt &bad_blocks)
+{
+	if (!archive.Open(path)) {
+		return false;
+	}
+	archive.GetBlocks().GetBadBlocks(bad_blocks);
+	return true;
+}
+
 /// @brief 内部ファイル名のキャラクターコードを変換するテーブル
 static const wxString chr2utf8tbl[128] = {
 	_T("年"),_T("月"),_T("日"),_T("市"),_T("区"),_T("町"),_T("を"),_T("ぁ"),_T("ぃ"),_T("ぅ"),_T("ぇ"),_T("ぉ"),_T("ゃ"),_T("ゅ"),_T("ょ"),_T("っ"),
@@ -28,90 +28,25 @@ bool ParseMSXBasic::CheckTapeDataFormat(PsFileInput &in_data, PsFileOutput &out_
 }
 
 /// テープイメージから実ファイルを取り出す
+///
+/// イメージ全体からファイルの一覧を作り、最初の中間言語かアスキー形式のファイルを取り出す。
 bool ParseMSXBasic::ReadTapeToRealData(PsFileInput &in_data, PsFileOutput &out_data)
 {
-//	wxString name = _("Tape->RealData");
-
-	wxUint8 vals[VALS_SIZE + 1];
-	size_t vlen;
+	PARSE_STATS_STAGE_INPUT(mStats, psStageTape, in_data);
 
-	// fmsx casette image
-	in_data.SeekStartPos(8);
+	MsxTapeArchive archive;
+	archive.Load(in_data);
+	int idx = archive.FindBasic();
+	if (idx < 0) {
+		return false;
+	}
+	const MsxTapeFile &file = archive[idx];
 
-	in_data.Read(vals, 16);
 	// イメージ内のファイル名
-	out_data.SetInternalName(&vals[10], 6);
-
-	// skip indentifier
-	in_data.SeekStartPos(32);
-
-	vlen = 1;
-	if (in_data.GetTypeFlag(psAscii)) {
-		// アスキーの時 テキスト中にヘッダがあるのでとり除く
-		size_t  valpos = VALS_SIZE;
-		size_t  valsta = VALS_SIZE;
-		size_t  vallen = VALS_SIZE;
-		size_t  valend = VALS_SIZE;
-		vals[VALS_SIZE] = 0;
-
-		memset((void *)vals, 0, sizeof(vals));
-
-		for(;;) {
-			if (valsta > 0) {
-				// shift
-				for(size_t i=0; i<(vallen + 1 - valsta); i++)
-					vals[i] = vals[i + valsta];
-				// read
-				vlen = valend - valsta;
-				vallen = in_data.Read(&vals[vlen], VALS_SIZE - vlen);
-				if (vallen + vlen < VALS_SIZE) {
-					valend = vallen + vlen;
-				} else {
-					valend = VALS_SIZE;
-				}
-				vallen = VALS_SIZE;
-				valpos -= valsta;
-				valsta = 0;
-			}
-
-			// ヘッダをとり除く
-			for(; valpos + 32 <= vallen && valpos < valend; valpos++) { 
-				if (memcmp(&vals[valpos], FMSX_HEADER, 8) == 0) {
-					// delete header
-					// shift
-					for(size_t i=valpos; i<(vallen-8); i++)
-						vals[i] = vals[i + 8];
-
-					valend -= 8;
-					vallen -= 8;
-					break;
-				} else if (vals[valpos] == 0x1a) {
-					// end of text
-					valend = valpos;
-					break;
-				}
-			}
-
-			// 出力
-			if (valsta < valpos) {
-				out_data.Write(&vals[valsta], valpos - valsta);
-			}
-			if (valpos >= valend) {
-				// end of line
-				break;
-			}
-			valsta = valpos;
-		}
+	out_data.SetInternalName(file.raw_name, MSXTAPE_NAME_LEN);
+	out_data.SetTypeFlag(psAscii, file.file_type == MSXTAPE_ASCII);
 
-	} else {
-		// バイナリの時 そのまま出力
-		while(vlen > 0) {
-			vlen = in_data.Read(vals, VALS_SIZE);
-			if (vlen == 0) break;
-			out_data.Write(vals, vlen);
-		}
-
-	}
+	archive.Write(idx, out_data);
 
 	out_data.SetTypeFlag(psTapeImage, true);
 
@@ -121,6 +56,8 @@ bool ParseMSXBasic::ReadTapeToRealData(PsFileInput &in_data, PsFileOutput &out_d
 /// 実データをテープイメージにして出力
 bool ParseMSXBasic::WriteTapeFromRealData(PsFileInput &in_file, PsFileOutput &out_file)
 {
+	PARSE_STATS_STAGE_INPUT(mStats, psStageWrite, in_file);
+
 	wxUint8 vals[260];
 	size_t len = 1;
 
@@ -0,0 +1,196 @@
+﻿/// @file parseworker.cpp
+///
+/// @brief 行単位の並列変換
+///
+#include "parseworker.h"
+#include "parse.h"
+
+//////////////////////////////////////////////////////////////////////
+
+ParseLineBlock::ParseLineBlock(size_t start_row, size_t end_row)
+{
+	mStartRow = start_row;
+	mEndRow = end_row;
+	mBytes = 0;
+	mUsedLines = 0;
+	mBaseAddress = 0;
+	mOutPos = 0;
+	mStartPos = 0;
+	mEndPos = 0;
+	mReadEnd = 0;
+	mResult.SetLimit(0);
+}
+
+void ParseLineBlock::AddInfo(const line_info_t &info)
+{
+	mInfos.AppendData(&info, sizeof(info));
+}
+
+const ParseLineBlock::line_info_t &ParseLineBlock::GetInfo(size_t idx) const
+{
+	wxASSERT(idx < GetInfoCount());
+	return ((const line_info_t *)mInfos.GetData())[idx];
+}
+
+size_t ParseLineBlock::GetInfoCount() const
+{
+	return mInfos.GetDataLen() / sizeof(line_info_t);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseLineJob::ParseLineJob(int type, ParseLineBlock **blocks, size_t block_count)
+{
+	mType = type;
+	pInData = NULL;
+	pOutBuf = NULL;
+	pInBuf = NULL;
+	mInLen = 0;
+	pBlocks = blocks;
+	mBlockCount = block_count;
+	mNextBlock = 0;
+}
+
+/// 次のかたまりを取り出す
+/// @return なくなったらNULL
+ParseLineBlock *ParseLineJob::Next()
+{
+	wxCriticalSectionLocker lock(mLock);
+	if (mNextBlock >= mBlockCount) {
+		return NULL;
+	}
+	return pBlocks[mNextBlock++];
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseWorkerThread::ParseWorkerThread(Parse *worker, ParseLineJob *job, const PsFileType &in_type, const PsFileType &out_type)
+	: wxThread(wxTHREAD_JOINABLE)
+	, mInType(in_type)
+	, mOutType(out_type)
+{
+	pWorker = worker;
+	pJob = job;
+}
+
+ParseWorkerThread::~ParseWorkerThread()
+{
+}
+
+ParseWorkerThread::ExitCode ParseWorkerThread::Entry()
+{
+	DoJob(pWorker, *pJob, mInType, mOutType);
+	return (ParseWorkerThread::ExitCode)0;
+}
+
+/// かたまりがなくなるまで処理する
+/// @note JOB_DECODEではスレッドごとに入力ストリームを作る
+void ParseWorkerThread::DoJob(Parse *worker, ParseLineJob &job, PsFileType &in_type, PsFileType &out_type)
+{
+	ParseLineBlock *block;
+	PsFileStrInput *in_file = NULL;
+	while((block = job.Next()) != NULL) {
+		switch(job.mType) {
+		case ParseLineJob::JOB_ENCODE:
+			worker->EncodeLineBlock(in_type, *job.pInData, out_type, *block);
+			break;
+		case ParseLineJob::JOB_LINK:
+			worker->LinkLineBlock(*block, job.pOutBuf + block->mOutPos);
+			break;
+		case ParseLineJob::JOB_DECODE:
+			if (!in_file) {
+				in_file = new PsFileStrInput(wxString::From8BitData((const char *)job.pInBuf, job.mInLen));
+			}
+			worker->DecodeLineBlock(*in_file, out_type, *block);
+			break;
+		}
+	}
+	delete in_file;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+ParseWorkerPool::ParseWorkerPool()
+{
+	for(int i=0; i<PARSE_PARALLEL_MAX_THREADS; i++) {
+		mWorkers[i] = NULL;
+	}
+	mCount = 0;
+}
+
+ParseWorkerPool::~ParseWorkerPool()
+{
+	Clear();
+}
+
+/// ワーカーを用意する
+/// @param[in] owner 呼び出し元のパーサー
+/// @param[in] count 必要な数
+/// @return 用意できた数
+int ParseWorkerPool::Prepare(const Parse *owner, int count)
+{
+	if (count > PARSE_PARALLEL_MAX_THREADS) count = PARSE_PARALLEL_MAX_THREADS;
+	while(mCount < count) {
+		Parse *worker = owner->NewWorker();
+		if (!worker) {
+			break;
+		}
+		if (!worker->InitWorker()) {
+			delete worker;
+			break;
+		}
+		mWorkers[mCount++] = worker;
+	}
+	return (mCount < count ? mCount : count);
+}
+
+/// ワーカーを破棄する
+void ParseWorkerPool::Clear()
+{
+	for(int i=0; i<mCount; i++) {
+		delete mWorkers[i];
+		mWorkers[i] = NULL;
+	}
+	mCount = 0;
+}
+
+/// 処理をワーカーで実行して終わるまで待つ
+///
+/// 起動できたスレッドだけで残りのかたまりも処理する。
+/// 1つも起動できない場合は呼び出したスレッドで処理する。
+/// @param[in,out] job      処理内容
+/// @param[in]     count    スレッド数
+/// @param[in]     in_type  入力データ形式
+/// @param[in]     out_type 出力データ形式
+void ParseWorkerPool::Run(ParseLineJob &job, int count, const PsFileType &in_type, const PsFileType &out_type)
+{
+	ParseWorkerThread *threads[PARSE_PARALLEL_MAX_THREADS];
+	int started = 0;
+
+	if (count > mCount) count = mCount;
+	for(int i=0; i<count; i++) {
+		ParseWorkerThread *thread = new ParseWorkerThread(mWorkers[i], &job, in_type, out_type);
+		if (thread->Run() != wxTHREAD_NO_ERROR) {
+			delete thread;
+			break;
+		}
+		threads[started++] = thread;
+	}
+	if (started == 0 && mCount > 0) {
+		PsFileType in_copy(in_type);
+		PsFileType out_copy(out_type);
+		ParseWorkerThread::DoJob(mWorkers[0], job, in_copy, out_copy);
+	}
+	for(int i=0; i<started; i++) {
+		threads[i]->Wait();
+		delete threads[i];
+	}
+}
+
+/// 使用できるCPU数
+int ParseWorkerPool::GetThreadCount()
+{
+	int count = wxThread::GetCPUCount();
+	if (count > PARSE_PARALLEL_MAX_THREADS) count = PARSE_PARALLEL_MAX_THREADS;
+	return count;
+}
@@ -0,0 +1,147 @@
+﻿/// @file parseworker.h
+///
+/// @brief 行単位の並列変換
+///
+#ifndef _PARSEWORKER_H_
+#define _PARSEWORKER_H_
+
+/// アスキー形式と中間言語の間の変換を並列で行う コメントアウトすると常に1スレッドで変換する
+#define USE_PARSE_PARALLEL 1
+
+/// 並列で変換する最小の行数 これより少ない場合は1スレッドで変換する
+#define PARSE_PARALLEL_MIN_LINES	2048
+/// 1つのかたまりの行数 スレッドはかたまり単位で処理を取り出す
+#define PARSE_PARALLEL_BLOCK_LINES	512
+/// 最大スレッド数
+#define PARSE_PARALLEL_MAX_THREADS	16
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include "fileinfo.h"
+#include "parseresult.h"
+
+class Parse;
+
+/// 並列変換で1スレッドがまとめて処理する行のかたまり
+///
+/// ワーカーが1行ずつ変換した結果と解析結果を入れ、
+/// メインスレッドが行順に解析結果を結合してから次アドレスを決める。
+/// 中間言語からの変換では入力の開始位置と終了位置でかたまりを分ける。
+class ParseLineBlock
+{
+public:
+	/// 行ごとの情報
+	typedef struct st_line_info {
+		long line_number;		///< BASIC行番号
+		wxUint32 home_col;		///< 行番号の後の列
+		wxUint32 end_col;		///< 行末の列
+		wxUint32 result_end;	///< この行までの解析結果の件数
+		wxUint32 flags;			///< enLineInfoFlags
+	} line_info_t;
+	enum enLineInfoFlags {
+		LINE_HAS_HOME = 0x01,	///< 行頭に次アドレスと行番号がある
+		LINE_STOPPED = 0x02,	///< この行で変換終了
+		LINE_EOL = 0x04,		///< 行末まで変換した (中間言語からの変換のみ)
+		LINE_END = 0x08,		///< 終端に達した (中間言語からの変換のみ)
+	};
+
+	size_t mStartRow;		///< 開始行
+	size_t mEndRow;			///< 終了行(含まない)
+	PsFileData mLines;		///< 変換後の行 行末の0を含む
+	wxMemoryBuffer mInfos;	///< 行ごとの情報 line_info_t の並び
+	ParseResult mResult;	///< 解析結果 出力先を設定せずに保持する
+	size_t mBytes;			///< 変換後の行の合計バイト数
+	size_t mUsedLines;		///< 出力する行数 (エラーで中止した場合は途中まで)
+	int mBaseAddress;		///< 先頭行の前の次アドレス
+	size_t mOutPos;			///< 出力先での位置
+	size_t mStartPos;		///< 入力の開始位置 (中間言語からの変換のみ)
+	size_t mEndPos;			///< 入力の終了位置 ここを越えた行で止める 0:終端まで
+	size_t mReadEnd;		///< 実際に読み終えた位置
+
+	ParseLineBlock(size_t start_row, size_t end_row);
+
+	void AddInfo(const line_info_t &info);
+	const line_info_t &GetInfo(size_t idx) const;
+	size_t GetInfoCount() const;
+};
+
+/// 並列変換の処理内容
+class ParseLineJob
+{
+public:
+	enum enJobTypes {
+		JOB_ENCODE = 0,	///< 行を変換する
+		JOB_LINK,		///< 次アドレスを埋めて出力先にコピーする
+		JOB_DECODE		///< 中間言語の行をアスキー形式にする
+	};
+
+	int mType;					///< enJobTypes
+	PsFileData *pInData;		///< 入力データ
+	wxUint8 *pOutBuf;			///< 出力先 JOB_LINKのみ
+	const wxUint8 *pInBuf;		///< 入力データ JOB_DECODEのみ
+	size_t mInLen;				///< 入力データの長さ JOB_DECODEのみ
+	ParseLineBlock **pBlocks;	///< かたまり
+	size_t mBlockCount;			///< かたまりの数
+	size_t mNextBlock;			///< 次に取り出すかたまり
+	wxCriticalSection mLock;	///< mNextBlockの排他用
+
+	ParseLineJob(int type, ParseLineBlock **blocks, size_t block_count);
+
+	/// 次のかたまりを取り出す
+	ParseLineBlock *Next();
+};
+
+/// 並列変換のスレッド
+///
+/// 受け持ったワーカーでかたまりがなくなるまで処理する。
+class ParseWorkerThread : public wxThread
+{
+protected:
+	Parse *pWorker;
+	ParseLineJob *pJob;
+	PsFileType mInType;		///< 入力データ形式(スレッドごとに持つ)
+	PsFileType mOutType;	///< 出力データ形式(スレッドごとに持つ)
+
+	virtual ExitCode Entry();
+
+public:
+	ParseWorkerThread(Parse *worker, ParseLineJob *job, const PsFileType &in_type, const PsFileType &out_type);
+	~ParseWorkerThread();
+
+	/// かたまりがなくなるまで処理する
+	static void DoJob(Parse *worker, ParseLineJob &job, PsFileType &in_type, PsFileType &out_type);
+};
+
+/// 並列変換用のワーカーの集まり
+///
+/// ワーカーは呼び出し元と同じ種類のパーサーで、変換表は各ワーカーで持つ。
+/// 一度作成したワーカーは呼び出し元が破棄されるまで使いまわす。
+class ParseWorkerPool
+{
+private:
+	Parse *mWorkers[PARSE_PARALLEL_MAX_THREADS];
+	int mCount;
+
+public:
+	ParseWorkerPool();
+	~ParseWorkerPool();
+
+	/// ワーカーを用意する
+	int  Prepare(const Parse *owner, int count);
+	/// ワーカーを破棄する
+	void Clear();
+	/// ワーカー数
+	int  GetCount() const { return mCount; }
+	/// ワーカーを返す
+	Parse *Get(int idx) { return mWorkers[idx]; }
+	/// 処理をワーカーで実行して終わるまで待つ
+	void Run(ParseLineJob &job, int count, const PsFileType &in_type, const PsFileType &out_type);
+
+	/// 使用できるCPU数
+	static int GetThreadCount();
+
+	DECLARE_NO_COPY_CLASS(ParseWorkerPool)
+};
+
+#endif /* _PARSEWORKER_H_ */
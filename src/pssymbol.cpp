@@ -4,135 +4,135 @@
 ///
 
 #include "pssymbol.h"
-#include "wx/arrimpl.cpp"
 
 //////////////////////////////////////////////////////////////////////
 
-PsSymbol::PsSymbol()
+/// 文字列を8bitのまま書き込む
+/// @param[in]  str 文字列
+/// @param[out] dst 書き込み先
+static void StrTo8Bit(const wxString &str, wxUint8 *dst)
 {
-	mType = 0;
+	for(wxString::const_iterator it = str.begin(); it != str.end(); ++it) {
+		*dst++ = (wxUint8)(*it).GetValue();
+	}
 }
 
-PsSymbol::~PsSymbol()
+//////////////////////////////////////////////////////////////////////
+
+PsSymbol::PsSymbol(PsSymbolArena *arena)
 {
+	pArena = arena;
+	mType = 0;
+	mAscPos = 0;
+	mAscLen = 0;
+	mBinPos = 0;
+	mBinLen = 0;
 }
 
 /// クリア
+/// @note 領域は解放しない
 void PsSymbol::Empty()
 {
 	mType = 0;
-	mAscStr.Empty();
-	mBinStr.Empty();
+	mAscLen = 0;
+	mBinLen = 0;
 }
 
 /// アスキー文字列が空白か
 bool PsSymbol::AscStrIsEmpty() const
 {
-	return mAscStr.IsEmpty();
+	return (mAscLen == 0);
 }
 
 /// バイナリ文字列が空白か
 bool PsSymbol::BinStrIsEmpty() const
 {
-	return mBinStr.IsEmpty();
+	return (mBinLen == 0);
 }
 
 /// セット
-void PsSymbol::Set(const BinString &ascStr, const BinString &binStr)
+void PsSymbol::Set(const wxString &ascStr, const wxString &binStr)
 {
-	mAscStr = ascStr;
-	mBinStr = binStr;
+	mAscLen = 0;
+	mBinLen = 0;
+	Append(ascStr, binStr);
 }
 
-void PsSymbol::SetAscStr(const BinString &str)
+void PsSymbol::SetAscStr(const wxString &str)
 {
-	mAscStr = str;
+	mAscLen = 0;
+	AppendAscStr(str);
 }
 
-const BinString &PsSymbol::GetAscStr() const
+BinString PsSymbol::GetAscStr() const
 {
-	return mAscStr;
+	return BinString(GetAscPtr(), mAscLen);
 }
 
-BinString &PsSymbol::GetSetAscStr()
+const wxUint8 *PsSymbol::GetAscPtr() const
 {
-	return mAscStr;
+	return pArena->GetPtr(PsSymbolArena::ASC_STR, mAscPos);
 }
 
 size_t PsSymbol::AscStrLen() const
 {
-	return mAscStr.Len();
+	return mAscLen;
 }
 
-void PsSymbol::SetBinStr(const BinString &str)
+/// バイナリ文字列をセット
+/// @note 同じ長さなら同じ位置に上書きする
+void PsSymbol::SetBinStr(const wxString &str)
 {
-	mBinStr = str;
+	if (mBinLen > 0 && str.Len() == mBinLen) {
+		StrTo8Bit(str, (wxUint8 *)GetBinPtr());
+		return;
+	}
+	mBinLen = 0;
+	AppendBinStr(str);
 }
 
-const BinString &PsSymbol::GetBinStr() const
+BinString PsSymbol::GetBinStr() const
 {
-	return mBinStr;
+	return BinString(GetBinPtr(), mBinLen);
 }
 
-BinString &PsSymbol::GetSetBinStr()
+const wxUint8 *PsSymbol::GetBinPtr() const
 {
-	return mBinStr;
+	return pArena->GetPtr(PsSymbolArena::BIN_STR, mBinPos);
 }
 
 size_t PsSymbol::BinStrLen() const
 {
-	return mBinStr.Len();
-}
-
-void PsSymbol::Append(const BinString &ascStr, const BinString &binStr)
-{
-	mAscStr.Append(ascStr);
-	mBinStr.Append(binStr);
+	return mBinLen;
 }
 
-#if 0
-void PsSymbol::Append(wxUniCharRef ascCh, wxUniCharRef binCh)
+void PsSymbol::Append(const wxString &ascStr, const wxString &binStr)
 {
-	mAscStr.Append(ascCh);
-	mBinStr.Append(binCh);
+	AppendAscStr(ascStr);
+	AppendBinStr(binStr);
 }
-#endif
 
 void PsSymbol::Append(const wxUint8 *ascStr, size_t ascLen, const wxUint8 *binStr, size_t binLen)
 {
-	mAscStr.Append(ascStr, ascLen);
-	mBinStr.Append(binStr, binLen);
+	memcpy(pArena->Extend(PsSymbolArena::ASC_STR, mAscPos, mAscLen, ascLen), ascStr, ascLen);
+	memcpy(pArena->Extend(PsSymbolArena::BIN_STR, mBinPos, mBinLen, binLen), binStr, binLen);
 }
 
 void PsSymbol::Append(wxUint8 ascCh, wxUint8 binCh)
 {
-	mAscStr.Append(ascCh);
-	mBinStr.Append(binCh);
-}
-
-void PsSymbol::AppendAscStr(const BinString &str)
-{
-	mAscStr.Append(str);
-}
-
-#if 0
-void PsSymbol::AppendAscStr(wxUniCharRef ch)
-{
-	mAscStr.Append(ch);
+	*pArena->Extend(PsSymbolArena::ASC_STR, mAscPos, mAscLen, 1) = ascCh;
+	*pArena->Extend(PsSymbolArena::BIN_STR, mBinPos, mBinLen, 1) = binCh;
 }
-#endif
 
-void PsSymbol::AppendBinStr(const BinString &str)
+void PsSymbol::AppendAscStr(const wxString &str)
 {
-	mBinStr.Append(str);
+	StrTo8Bit(str, pArena->Extend(PsSymbolArena::ASC_STR, mAscPos, mAscLen, str.Len()));
 }
 
-#if 0
-void PsSymbol::AppendBinStr(wxUniCharRef ch)
+void PsSymbol::AppendBinStr(const wxString &str)
 {
-	mBinStr.Append(ch);
+	StrTo8Bit(str, pArena->Extend(PsSymbolArena::BIN_STR, mBinPos, mBinLen, str.Len()));
 }
-#endif
 
 /// 形式を指定
 void PsSymbol::SetType(wxUint32 type)
@@ -159,47 +159,128 @@ wxUint32 PsSymbol::ClearBitType(wxUint32 type)
 }
 
 //////////////////////////////////////////////////////////////////////
-/// 解析文字列のArray
-WX_DEFINE_OBJARRAY(PsSymbolArray);
+/// 解析文字列の格納領域
+
+PsSymbolArena::PsSymbolArena()
+{
+}
+
+/// 先頭に戻す
+/// @note 確保した領域はそのまま再利用する
+void PsSymbolArena::Rewind()
+{
+	for(int i=0; i<KIND_COUNT; i++) {
+		mBuf[i].SetDataLen(0);
+	}
+}
 
-#if 0
-void PsSymbolSentence::Add(const PsSymbol &symbol)
+/// 使用済みの長さを返す
+size_t PsSymbolArena::Tail(int kind) const
 {
-	PsSymbolArray::Add(symbol);
+	return mBuf[kind].GetDataLen();
 }
 
-void PsSymbolSentence::Add(PsSymbol::enTypes type, const wxString &str)
+/// 指定位置のポインタを返す
+const wxUint8 *PsSymbolArena::GetPtr(int kind, size_t pos) const
+{
+	return (const wxUint8 *)mBuf[kind].GetData() + pos;
+}
+
+/// 文字列の末尾を伸ばす
+/// 末尾以外にある文字列は末尾にコピーしてから伸ばす
+/// @param[in]     kind ASC_STR/BIN_STR
+/// @param[in,out] pos  文字列の位置
+/// @param[in,out] len  文字列の長さ
+/// @param[in]     add  伸ばす長さ
+/// @return 書き込み先
+wxUint8 *PsSymbolArena::Extend(int kind, wxUint32 &pos, wxUint32 &len, size_t add)
+{
+	wxMemoryBuffer &buf = mBuf[kind];
+	size_t tail = buf.GetDataLen();
+	if (len == 0) {
+		pos = (wxUint32)tail;
+	}
+	if (pos + len != tail) {
+		// 末尾に移動する
+		wxUint8 *dst = (wxUint8 *)buf.GetAppendBuf(len + add);
+		memcpy(dst, (const wxUint8 *)buf.GetData() + pos, len);
+		buf.UngetAppendBuf(len);
+		pos = (wxUint32)tail;
+	}
+	wxUint8 *dst = (wxUint8 *)buf.GetAppendBuf(add);
+	buf.UngetAppendBuf(add);
+	len += (wxUint32)add;
+	return dst;
+}
+
+//////////////////////////////////////////////////////////////////////
+/// 解析文字列の集合 文
+
+PsSymbolSentence::PsSymbolSentence()
 {
-	PsSymbolArray::Add(new PsSymbol(type, str));
 }
-#endif
 
 /// 解析文字列を追加 ただし空文字なら追加しない
 /// @note Add an item unless is empty.
-void PsSymbolSentence::Add(const PsSymbol &item, size_t nInsert)
+void PsSymbolSentence::Add(const PsSymbol &item)
 {
 	if (item.AscStrIsEmpty() && item.BinStrIsEmpty()) return;
-	PsSymbolArray::Add(item, nInsert);
+	mItems.AppendData(&item, sizeof(PsSymbol));
+}
+
+/// クリア
+/// @note 領域は次の行で再利用する
+void PsSymbolSentence::Empty()
+{
+	mItems.SetDataLen(0);
+	mArena.Rewind();
+}
+
+/// 要素数
+size_t PsSymbolSentence::Count() const
+{
+	return mItems.GetDataLen() / sizeof(PsSymbol);
+}
+
+PsSymbol &PsSymbolSentence::Item(size_t index)
+{
+	wxASSERT(index < Count());
+	return ((PsSymbol *)mItems.GetData())[index];
+}
+
+const PsSymbol &PsSymbolSentence::Item(size_t index) const
+{
+	wxASSERT(index < Count());
+	return ((const PsSymbol *)mItems.GetData())[index];
 }
 
 /// 文字列をすべて合わせた文字列を返す
 wxString PsSymbolSentence::JoinAscStr() const
 {
-	wxString str;
+	size_t len = 0;
 	for(size_t i=0; i<Count(); i++) {
-		str += Item(i).GetAscStr();
+		len += Item(i).AscStrLen();
 	}
-	return str;
+	wxCharBuffer buf(len);
+	char *p = buf.data();
+	for(size_t i=0; i<Count(); i++) {
+		memcpy(p, Item(i).GetAscPtr(), Item(i).AscStrLen());
+		p += Item(i).AscStrLen();
+	}
+	return wxString::From8BitData(buf.data(), len);
 }
 
 /// 文字列をすべて合わせた文字列を返す
 wxString PsSymbolSentence::JoinBinStr() const
 {
-	wxString str;
+	size_t len = BinStrLen();
+	wxCharBuffer buf(len);
+	char *p = buf.data();
 	for(size_t i=0; i<Count(); i++) {
-		str += Item(i).GetBinStr();
+		memcpy(p, Item(i).GetBinPtr(), Item(i).BinStrLen());
+		p += Item(i).BinStrLen();
 	}
-	return str;
+	return wxString::From8BitData(buf.data(), len);
 }
 
 /// 文字列をすべて合わせた長さを返す
@@ -216,15 +297,30 @@ size_t PsSymbolSentence::BinStrLen() const
 /// 通常はバイナリ側ただしCHAR_NUMBERの場合はアスキー側
 wxString PsSymbolSentence::JoinSelectedStr() const
 {
-	wxString str;
+	size_t len = SelectedStrLen();
+	wxCharBuffer buf(len);
+	CopySelectedStr((wxUint8 *)buf.data());
+	return wxString::From8BitData(buf.data(), len);
+}
+
+/// 文字列をすべて合わせてコピーする
+/// 通常はバイナリ側ただしCHAR_NUMBERの場合はアスキー側
+/// @param[out] dst コピー先 SelectedStrLen()以上の長さが必要
+/// @return コピーした長さ
+size_t PsSymbolSentence::CopySelectedStr(wxUint8 *dst) const
+{
+	wxUint8 *p = dst;
 	for(size_t i=0; i<Count(); i++) {
-		if (Item(i).GetType() & PsSymbol::CHAR_NUMBER) {
-			str += Item(i).GetAscStr();
+		const PsSymbol &item = Item(i);
+		if (item.GetType() & PsSymbol::CHAR_NUMBER) {
+			memcpy(p, item.GetAscPtr(), item.AscStrLen());
+			p += item.AscStrLen();
 		} else {
-			str += Item(i).GetBinStr();
+			memcpy(p, item.GetBinPtr(), item.BinStrLen());
+			p += item.BinStrLen();
 		}
 	}
-	return str;
+	return (size_t)(p - dst);
 }
 
 /// 文字列をすべて合わせた長さを返す
@@ -241,7 +337,3 @@ size_t PsSymbolSentence::SelectedStrLen() const
 	}
 	return len;
 }
-
-//////////////////////////////////////////////////////////////////////
-/// 解析文字列の集合Array
-WX_DEFINE_OBJARRAY(PsSymbolSentenceArray);
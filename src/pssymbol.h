@@ -7,11 +7,15 @@
 
 #include "common.h"
 #include <wx/string.h>
-#include <wx/dynarray.h>
+#include <wx/buffer.h>
 #include "bsstring.h"
 
+class PsSymbolArena;
+
 //////////////////////////////////////////////////////////////////////
 /// 解析文字列格納
+///
+/// 文字列の実体はPsSymbolArenaにあり、ここでは位置と長さのみを保持する。
 class PsSymbol
 {
 public:
@@ -34,38 +38,37 @@ public:
 	};
 
 protected:
+	PsSymbolArena *pArena;	///< 文字列の格納先
 	wxUint32 mType;
-	BinString mAscStr;
-	BinString mBinStr;
+	wxUint32 mAscPos;		///< アスキー文字列の位置
+	wxUint32 mAscLen;		///< アスキー文字列の長さ
+	wxUint32 mBinPos;		///< バイナリ文字列の位置
+	wxUint32 mBinLen;		///< バイナリ文字列の長さ
 
 public:
-	PsSymbol();
-	~PsSymbol();
+	PsSymbol(PsSymbolArena *arena);
 
 	void Empty();
 	bool AscStrIsEmpty() const;
 	bool BinStrIsEmpty() const;
 
-	void Set(const BinString &ascStr, const BinString &binStr);
+	void Set(const wxString &ascStr, const wxString &binStr);
 
-	void SetAscStr(const BinString &str);
-	const BinString &GetAscStr() const;
-	BinString &GetSetAscStr();
+	void SetAscStr(const wxString &str);
+	BinString GetAscStr() const;
+	const wxUint8 *GetAscPtr() const;
 	size_t AscStrLen() const;
-	void SetBinStr(const BinString &str);
-	const BinString &GetBinStr() const;
-	BinString &GetSetBinStr();
+	void SetBinStr(const wxString &str);
+	BinString GetBinStr() const;
+	const wxUint8 *GetBinPtr() const;
 	size_t BinStrLen() const;
 
-	void Append(const BinString &ascStr, const BinString &binStr);
-//	void Append(wxUniCharRef ascCh, wxUniCharRef binCh);
+	void Append(const wxString &ascStr, const wxString &binStr);
 	void Append(const wxUint8 *ascStr, size_t ascLen, const wxUint8 *binStr, size_t binLen);
 	void Append(wxUint8 ascCh, wxUint8 binCh);
 
-	void AppendAscStr(const BinString &str);
-//	void AppendAscStr(wxUniCharRef ch);
-	void AppendBinStr(const BinString &str);
-//	void AppendBinStr(wxUniCharRef ch);
+	void AppendAscStr(const wxString &str);
+	void AppendBinStr(const wxString &str);
 
 	void SetType(wxUint32 type);
 	wxUint32 GetType() const;
@@ -74,32 +77,63 @@ public:
 };
 
 //////////////////////////////////////////////////////////////////////
-/// 解析文字列のArray
-WX_DECLARE_OBJARRAY(PsSymbol, PsSymbolArray);
+/// 解析文字列の格納領域
+///
+/// 変換中は同じ領域を使いまわし、行ごとにRewind()で先頭に戻す。
+class PsSymbolArena
+{
+public:
+	enum enKinds {
+		ASC_STR = 0,
+		BIN_STR,
+		KIND_COUNT
+	};
+
+private:
+	wxMemoryBuffer mBuf[KIND_COUNT];
+
+	DECLARE_NO_COPY_CLASS(PsSymbolArena)
+
+public:
+	PsSymbolArena();
+
+	void Rewind();
+	size_t Tail(int kind) const;
+	const wxUint8 *GetPtr(int kind, size_t pos) const;
+	wxUint8 *Extend(int kind, wxUint32 &pos, wxUint32 &len, size_t add);
+};
 
 //////////////////////////////////////////////////////////////////////
 /// 解析文字列の集合 文
-class PsSymbolSentence : public PsSymbolArray
+///
+/// 要素はPsSymbolをそのまま並べて格納し、Empty()しても領域は解放しない。
+class PsSymbolSentence
 {
+private:
+	PsSymbolArena mArena;
+	wxMemoryBuffer mItems;
+
+	DECLARE_NO_COPY_CLASS(PsSymbolSentence)
+
 public:
-//	void Add(const PsSymbol &symbol);
-//	void Add(PsSymbol::enTypes type, const wxString &str);
-	void Add(const PsSymbol &item, size_t nInsert = 1);
+	PsSymbolSentence();
+
+	PsSymbolArena *GetArena() { return &mArena; }
+
+	void Add(const PsSymbol &item);
+	void Empty();
+	size_t Count() const;
+	PsSymbol &Item(size_t index);
+	const PsSymbol &Item(size_t index) const;
+	PsSymbol &operator[](size_t index) { return Item(index); }
+	const PsSymbol &operator[](size_t index) const { return Item(index); }
+
 	wxString JoinAscStr() const;
 	wxString JoinBinStr() const;
 	size_t BinStrLen() const;
 	wxString JoinSelectedStr() const;
+	size_t CopySelectedStr(wxUint8 *dst) const;
 	size_t SelectedStrLen() const;
 };
 
-//////////////////////////////////////////////////////////////////////
-/// 解析文字列の集合Array
-WX_DECLARE_OBJARRAY(PsSymbolSentence, PsSymbolSentenceArray);
-
-//////////////////////////////////////////////////////////////////////
-/// 解析文字列の集合の行
-class PsSymbolChapter : public PsSymbolSentenceArray
-{
-};
-
 #endif /* PSSYMBOL_H */
@@ -2,13 +2,59 @@
 
  @brief 192ビット数値
 
+ 64ビット単位で計算する。
+ Add/Subの桁上がり、Mul/Mul10の足し算の順番は以前のビット単位の実装と同じにしてあり、
+ 同じ結果を返す。(bench/uint192ref.cpp と l3s1basic_floatbench uint192 で確認)
+
 */
 
 #include "uint192.h"
 #include <string.h>
+#if defined(_MSC_VER) && defined(_WIN64)
+#include <intrin.h>
+#endif
 
 #define UINT64_SIZE_BITS	64
 
+/// 上位から0が続くビット数 (val != 0)
+static inline int uint64_clz(unsigned long long val)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(val);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long idx;
+	_BitScanReverse64(&idx, val);
+	return 63 - (int)idx;
+#else
+	int n = 0;
+	while(!(val & ((unsigned long long)1 << (UINT64_SIZE_BITS-1)))) {
+		val <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/// 下位から0が続くビット数 (val != 0)
+static inline int uint64_ctz(unsigned long long val)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(val);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long idx;
+	_BitScanForward64(&idx, val);
+	return (int)idx;
+#else
+	int n = 0;
+	while(!(val & 1)) {
+		val >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+#ifndef USE_UINT192_CONSTEXPR
 UINT192::UINT192()
 {
 	memset(value.u.d, 0, sizeof(t_uint192));
@@ -24,11 +70,13 @@ UINT192::UINT192(unsigned int val)
 	memset(value.u.d, 0, sizeof(t_uint192));
 	value.u.d[0] = val;
 }
+#endif
 
 void UINT192::Set(unsigned int val)
 {
-	memset(value.u.d, 0, sizeof(t_uint192));
 	value.u.d[0] = val;
+	value.u.d[1] = 0;
+	value.u.d[2] = 0;
 }
 
 UINT192::UINT192(const unsigned int *vals)
@@ -43,16 +91,7 @@ void UINT192::Set(const unsigned int *vals)
 
 UINT192::UINT192(const unsigned char *vals, int size, bool bigendian)
 {
-	memset(value.u.d, 0, sizeof(t_uint192));
-	if (bigendian) {
-		for(int i=0; i<size && i<UINT192_MAX_BYTE; i++) {
-			value.u.b[size-i-1] = vals[i];
-		}
-	} else {
-		for(int i=0; i<size && i<UINT192_MAX_BYTE; i++) {
-			value.u.b[i] = vals[i];
-		}
-	}
+	Set(vals, size, bigendian);
 }
 
 void UINT192::Set(const unsigned char *vals, int size, bool bigendian)
@@ -69,36 +108,35 @@ void UINT192::Set(const unsigned char *vals, int size, bool bigendian)
 	}
 }
 
+#ifndef USE_UINT192_CONSTEXPR
 UINT192::~UINT192()
 {
 }
+#endif
 
 UINT192 &UINT192::operator=(const UINT192 &src)
 {
-	memcpy(value.u.d, src.value.u.d, sizeof(t_uint192));
+	value.u.d[0] = src.value.u.d[0];
+	value.u.d[1] = src.value.u.d[1];
+	value.u.d[2] = src.value.u.d[2];
 	return *this;
 }
 
 UINT192 &UINT192::operator=(unsigned int src)
 {
-	memset(value.u.d, 0, sizeof(t_uint192));
-	value.u.d[0] = src;
+	Set(src);
 	return *this;
 }
 
 /// たし算
+/// srcの64ビットが全て1で下位から桁上がりがあるときは、以前の実装と同じく上へ桁上がりしない
 UINT192 &UINT192::Add(const UINT192 &src)
 {
-	unsigned int carry = 0;
+	unsigned long long carry = 0;
 	for(int i=0; i<UINT192_MAX_INT64; i++) {
 		unsigned long long prev = value.u.d[i];
 		value.u.d[i] += (src.value.u.d[i] + carry);
-		if (prev > value.u.d[i]) {
-			// over flow
-			carry = 1;
-		} else {
-			carry = 0;
-		}
+		carry = (prev > value.u.d[i]);
 	}
 	return *this;
 }
@@ -110,39 +148,26 @@ UINT192 &UINT192::operator+=(const UINT192 &src)
 
 UINT192 &UINT192::Add(unsigned int src)
 {
-	unsigned int carry = 0;
 	unsigned long long prev = value.u.d[0];
 	value.u.d[0] += src;
 	if (prev > value.u.d[0]) {
 		// over flow
-		carry = 1;
-	}
-	for(int i=1; i<UINT192_MAX_INT64; i++) {
-		prev = value.u.d[i];
-		value.u.d[i] += carry;
-		if (prev > value.u.d[i]) {
-			// over flow
-			carry = 1;
-		} else {
-			carry = 0;
+		if (++value.u.d[1] == 0) {
+			++value.u.d[2];
 		}
 	}
 	return *this;
 }
 
 /// 引き算
+/// srcの64ビットが全て1で下位から桁借りがあるときは、以前の実装と同じく上から桁借りしない
 UINT192 &UINT192::Sub(const UINT192 &src)
 {
-	unsigned int carry = 0;
+	unsigned long long carry = 0;
 	for(int i=0; i<UINT192_MAX_INT64; i++) {
 		unsigned long long prev = value.u.d[i];
 		value.u.d[i] -= (src.value.u.d[i] + carry);
-		if (prev < value.u.d[i]) {
-			// under flow
-			carry = 1;
-		} else {
-			carry = 0;
-		}
+		carry = (prev < value.u.d[i]);
 	}
 	return *this;
 }
@@ -155,27 +180,27 @@ UINT192 &UINT192::operator-=(const UINT192 &src)
 /// AND
 UINT192 &UINT192::And(const UINT192 &src)
 {
-	for(int i=0; i<UINT192_MAX_INT64; i++) {
-		value.u.d[i] &= src.value.u.d[i];
-	}
+	value.u.d[0] &= src.value.u.d[0];
+	value.u.d[1] &= src.value.u.d[1];
+	value.u.d[2] &= src.value.u.d[2];
 	return *this;
 }
 
 /// OR
 UINT192 &UINT192::Or(const UINT192 &src)
 {
-	for(int i=0; i<UINT192_MAX_INT64; i++) {
-		value.u.d[i] |= src.value.u.d[i];
-	}
+	value.u.d[0] |= src.value.u.d[0];
+	value.u.d[1] |= src.value.u.d[1];
+	value.u.d[2] |= src.value.u.d[2];
 	return *this;
 }
 
 /// NOT
 UINT192 &UINT192::Not()
 {
-	for(int i=0; i<UINT192_MAX_INT64; i++) {
-		value.u.d[i] = ~value.u.d[i];
-	}
+	value.u.d[0] = ~value.u.d[0];
+	value.u.d[1] = ~value.u.d[1];
+	value.u.d[2] = ~value.u.d[2];
 	return *this;
 }
 
@@ -192,61 +217,65 @@ UINT192 &UINT192::Shift(int size)
 UINT192 &UINT192::LShift(unsigned int size)
 {
 	if (size == 0) return *this;
+	if (size >= UINT192_MAX_BITS) {
+		Set(0U);
+		return *this;
+	}
 
+	int n=(size / UINT64_SIZE_BITS);
 	int s=(size % UINT64_SIZE_BITS);
 
-	t_uint192 tmp;
-	memset(tmp.u.d, 0, sizeof(t_uint192));
-	for(int i=0; i<UINT192_MAX_INT64; i++) {
-		int j=i + (size / UINT64_SIZE_BITS);
-		if (0 <= j && j < UINT192_MAX_INT64) {
-			tmp.u.d[j] |= (value.u.d[i] << s);
-		}
-		if (s != 0) {
-			j++;
-			if (0 <= j && j < UINT192_MAX_INT64) {
-				tmp.u.d[j] |= (value.u.d[i] >> (UINT64_SIZE_BITS-s));
+	for(int i=(UINT192_MAX_INT64-1); i>=0; i--) {
+		int j=i - n;
+		unsigned long long v = 0;
+		if (j >= 0) {
+			v = (value.u.d[j] << s);
+			if (s != 0 && j >= 1) {
+				v |= (value.u.d[j-1] >> (UINT64_SIZE_BITS-s));
 			}
 		}
+		value.u.d[i] = v;
 	}
-	memcpy(value.u.d, tmp.u.d, sizeof(t_uint192));
 	return *this;
 }
 
 UINT192 &UINT192::RShift(unsigned int size)
 {
 	if (size == 0) return *this;
+	if (size >= UINT192_MAX_BITS) {
+		Set(0U);
+		return *this;
+	}
 
+	int n=(size / UINT64_SIZE_BITS);
 	int s=(size % UINT64_SIZE_BITS);
 
-	t_uint192 tmp;
-	memset(tmp.u.d, 0, sizeof(t_uint192));
 	for(int i=0; i<UINT192_MAX_INT64; i++) {
-		int j=i - (size / UINT64_SIZE_BITS);
-		if (0 <= j && j < UINT192_MAX_INT64) {
-			tmp.u.d[j] |= (value.u.d[i] >> s);
-		}
-		if (s != 0) {
-			j--;
-			if (0 <= j && j < UINT192_MAX_INT64) {
-				tmp.u.d[j] |= (value.u.d[i] << (UINT64_SIZE_BITS-s));
+		int j=i + n;
+		unsigned long long v = 0;
+		if (j < UINT192_MAX_INT64) {
+			v = (value.u.d[j] >> s);
+			if (s != 0 && j+1 < UINT192_MAX_INT64) {
+				v |= (value.u.d[j+1] << (UINT64_SIZE_BITS-s));
 			}
 		}
+		value.u.d[i] = v;
 	}
-	memcpy(value.u.d, tmp.u.d, sizeof(t_uint192));
 	return *this;
 }
 
 /// 掛け算
+/// srcの立っているビットの位置だけシフトしたものを下位から足す
 UINT192 &UINT192::Mul(const UINT192 &src)
 {
 	UINT192 tmp;
-	for(int i=0; i<UINT192_MAX_BITS; i++) {
-		int di=(i / UINT64_SIZE_BITS);
-		int dd=(i % UINT64_SIZE_BITS);
-		if (src.value.u.d[di] & ((unsigned long long)1 << dd)) {
+	for(int di=0; di<UINT192_MAX_INT64; di++) {
+		unsigned long long bits = src.value.u.d[di];
+		while(bits) {
+			int dd = uint64_ctz(bits);
+			bits &= (bits - 1);
 			UINT192 sh(*this);
-			sh.LShift(i);
+			sh.LShift(di * UINT64_SIZE_BITS + dd);
 			tmp.Add(sh);
 		}
 	}
@@ -260,65 +289,53 @@ UINT192 &UINT192::operator*=(const UINT192 &src)
 }
 
 /// 10倍
+/// 2倍と8倍を足す
 void UINT192::Mul10()
 {
-	UINT192 tmp;
-	UINT192 sh(*this);
-	sh.LShift(1);
-	tmp.Add(sh);
-	sh.LShift(2);
-	tmp.Add(sh);
-	*this = tmp;
+	unsigned long long d0 = value.u.d[0];
+	unsigned long long d1 = value.u.d[1];
+	unsigned long long d2 = value.u.d[2];
+
+	// 2倍
+	value.u.d[0] = (d0 << 1);
+	value.u.d[1] = (d1 << 1) | (d0 >> 63);
+	value.u.d[2] = (d2 << 1) | (d1 >> 63);
+
+	// 8倍
+	UINT192 sh;
+	sh.value.u.d[0] = (d0 << 3);
+	sh.value.u.d[1] = (d1 << 3) | (d0 >> 61);
+	sh.value.u.d[2] = (d2 << 3) | (d1 >> 61);
+
+	Add(sh);
 }
 
 bool UINT192::operator==(const UINT192 &src)
 {
-	return (memcmp(value.u.d, src.value.u.d, sizeof(t_uint192)) == 0);
+	return (value.u.d[0] == src.value.u.d[0]
+		&& value.u.d[1] == src.value.u.d[1]
+		&& value.u.d[2] == src.value.u.d[2]);
 }
 
 bool UINT192::operator==(unsigned int src)
 {
-	bool rc = false;
-	if (value.u.d[0] == src) {
-		rc = true;
-		for(int i=1; i<UINT192_MAX_INT64; i++) {
-			if (value.u.d[i] != 0) {
-				rc = false;
-				break;
-			}
-		}
-	}
-	return rc;
+	return (value.u.d[0] == src
+		&& value.u.d[1] == 0
+		&& value.u.d[2] == 0);
 }
 
 bool UINT192::operator>(const UINT192 &src)
 {
-	bool rc = false;
-	for(int i=(UINT192_MAX_INT64-1); i>=0; i--) {
-		if (value.u.d[i] > src.value.u.d[i]) {
-			rc = true;
-			break;
-		} else if (value.u.d[i] < src.value.u.d[i]) {
-			rc = false;
-			break;
-		}
-	}
-	return rc;
+	if (value.u.d[2] != src.value.u.d[2]) return (value.u.d[2] > src.value.u.d[2]);
+	if (value.u.d[1] != src.value.u.d[1]) return (value.u.d[1] > src.value.u.d[1]);
+	return (value.u.d[0] > src.value.u.d[0]);
 }
 
 bool UINT192::operator<(const UINT192 &src)
 {
-	bool rc = false;
-	for(int i=(UINT192_MAX_INT64-1); i>=0; i--) {
-		if (value.u.d[i] < src.value.u.d[i]) {
-			rc = true;
-			break;
-		} else if (value.u.d[i] > src.value.u.d[i]) {
-			rc = false;
-			break;
-		}
-	}
-	return rc;
+	if (value.u.d[2] != src.value.u.d[2]) return (value.u.d[2] < src.value.u.d[2]);
+	if (value.u.d[1] != src.value.u.d[1]) return (value.u.d[1] < src.value.u.d[1]);
+	return (value.u.d[0] < src.value.u.d[0]);
 }
 
 unsigned char UINT192::GetByte(unsigned int pos)
@@ -339,22 +356,15 @@ void UINT192::SetByte(unsigned int pos, unsigned char val)
 	}
 }
 
+/// 有効ビット数
 unsigned int UINT192::Digits() const
 {
-	unsigned int d = 0;
 	for(int i=(UINT192_MAX_INT64-1); i>=0; i--) {
 		if (value.u.d[i] != 0) {
-			unsigned long long v = value.u.d[i];
-			for(int j=0; j<UINT64_SIZE_BITS; j++) {
-				if (v & ((unsigned long long)1 << (UINT64_SIZE_BITS-1))) break;
-				v = (v << 1);
-				d++;
-			}
-			break;
+			return (unsigned int)((i + 1) * UINT64_SIZE_BITS - uint64_clz(value.u.d[i]));
 		}
-		d += UINT64_SIZE_BITS;
 	}
-	return (UINT192_MAX_BITS-d);
+	return 0;
 }
 
 /// 特定の位置を四捨五入
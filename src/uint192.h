@@ -13,6 +13,11 @@
 #define UINT192_MAX_BYTE  24
 #define UINT192_MAX_BITS  192
 
+#if (defined(__cplusplus) && __cplusplus >= 201103L) || (defined(_MSC_VER) && _MSC_VER >= 1900)
+/// コンストラクタをconstexprにする
+#define USE_UINT192_CONSTEXPR 1
+#endif
+
 /// 192ビットunsigned int
 class UINT192
 {
@@ -26,12 +31,20 @@ private:
 
 	t_uint192 value;
 public:
+#ifdef USE_UINT192_CONSTEXPR
+	constexpr UINT192() : value() {}
+	constexpr UINT192(const UINT192 &src) : value(src.value) {}
+	constexpr UINT192(unsigned int val) : value{{{val, 0, 0}}} {}
+#else
 	UINT192();
 	UINT192(const UINT192 &src);
 	UINT192(unsigned int val);
+#endif
 	UINT192(const unsigned int *vals);
 	UINT192(const unsigned char *vals, int size, bool bigendian = false);
+#ifndef USE_UINT192_CONSTEXPR
 	~UINT192();
+#endif
 
 	void Set(unsigned int val);
 	void Set(const unsigned int *vals);
@@ -0,0 +1,459 @@
+﻿/// @file watchfolder.cpp
+///
+/// @brief 監視フォルダ
+///
+///
+#include "watchfolder.h"
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/dir.h>
+#include <wx/textfile.h>
+#include <signal.h>
+#ifdef USE_WATCH_INOTIFY
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+/// 止める要求
+static volatile sig_atomic_t gWatchFolderStop = 0;
+
+/// SIGINT/SIGTERMを受け取った
+static void watch_folder_on_signal(int)
+{
+	gWatchFolderStop = 1;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+WatchFolder::WatchFolder()
+{
+	mSettle = WATCH_FOLDER_SETTLE_MSEC;
+#ifdef USE_WATCH_INOTIFY
+	mFd = -1;
+#else
+	mLastScan = 0;
+#endif
+}
+
+WatchFolder::~WatchFolder()
+{
+	Close();
+}
+
+/// 絶対パスにする
+/// @param[in] dir ディレクトリ
+/// @return 末尾に区切りのないパス
+wxString WatchFolder::NormalizeDir(const wxString &dir)
+{
+	wxFileName fn = wxFileName::DirName(dir);
+	fn.MakeAbsolute();
+	return fn.GetPath();
+}
+
+/// 監視を始める
+///
+/// 始めた時点でディレクトリにあるファイルも変更があったものとして扱う。
+/// 変換済みで内容が同じものはIsConvertedで除ける。
+/// @param[in] dirs        監視するディレクトリ
+/// @param[in] ignore_dir  無視するディレクトリ (出力先)
+/// @param[in] settle_msec 書き込みが終わったとみなすまでの時間
+/// @return 監視できない場合false
+bool WatchFolder::Open(const wxArrayString &dirs, const wxString &ignore_dir, int settle_msec)
+{
+	Close();
+	mSettle = settle_msec;
+	mIgnoreDir = (ignore_dir.IsEmpty() ? wxString() : NormalizeDir(ignore_dir));
+	for(size_t i=0; i<dirs.Count(); i++) {
+		if (!wxFileName::DirExists(dirs[i])) {
+			return false;
+		}
+		mDirs.Add(NormalizeDir(dirs[i]));
+	}
+	mClock.Start();
+
+#ifdef USE_WATCH_INOTIFY
+	mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mFd < 0) {
+		return false;
+	}
+	for(size_t i=0; i<mDirs.Count(); i++) {
+		AddWatchTree(mDirs[i]);
+	}
+	for(size_t i=0; i<mDirs.Count(); i++) {
+		TouchTree(mDirs[i]);
+	}
+#else
+	Scan(true);
+#endif
+	return true;
+}
+
+/// 監視をやめる
+void WatchFolder::Close()
+{
+#ifdef USE_WATCH_INOTIFY
+	if (mFd >= 0) {
+		close(mFd);
+		mFd = -1;
+	}
+	mWatches.clear();
+#else
+	mStamps.clear();
+#endif
+	mDirs.Empty();
+	mPendings.clear();
+}
+
+/// 無視するファイルか
+///
+/// 出力先の下のファイル、ドットで始まるファイル、エディタや転送途中の一時ファイルは変換しない。
+/// @param[in] path ファイルのパス
+bool WatchFolder::IsIgnored(const wxString &path) const
+{
+	if (!mIgnoreDir.IsEmpty()) {
+		wxString dir = mIgnoreDir + wxFileName::GetPathSeparator();
+		if (path.StartsWith(dir)) {
+			return true;
+		}
+	}
+	wxFileName fn(path);
+	wxString name = fn.GetFullName();
+	if (name.IsEmpty() || name.StartsWith(_T(".")) || name.EndsWith(_T("~"))) {
+		return true;
+	}
+	wxString ext = fn.GetExt();
+	return (ext.CmpNoCase(_T("tmp")) == 0 || ext.CmpNoCase(_T("part")) == 0
+		|| ext.CmpNoCase(_T("swp")) == 0 || ext.CmpNoCase(_T("crdownload")) == 0);
+}
+
+/// 変更を受け取った
+///
+/// 書き込み中とみなし、落ち着くまでの時間を延ばす。
+/// @param[in] path ファイルのパス
+void WatchFolder::Touch(const wxString &path)
+{
+	if (IsIgnored(path)) {
+		return;
+	}
+	WatchFolderPending &pending = mPendings[path];
+	pending.last = Now();
+	pending.size = -1;
+}
+
+/// ディレクトリ以下のファイルをすべて変更があったものとする
+/// @param[in] dir ディレクトリ
+void WatchFolder::TouchTree(const wxString &dir)
+{
+	wxArrayString files;
+	wxDir::GetAllFiles(dir, &files, wxEmptyString, wxDIR_FILES | wxDIR_DIRS);
+	for(size_t i=0; i<files.Count(); i++) {
+		Touch(files[i]);
+	}
+}
+
+/// 書き込みが終わったファイルを集める
+///
+/// 最後の変更から落ち着くまでの時間が過ぎ、前に調べたときから長さが変わっていないものを返す。
+/// 長さが変わっていればまだ書き込み中とみなして待ちなおす。
+/// @param[in]  now   現在の時刻
+/// @param[out] ready 書き込みが終わったファイル (名前順)
+void WatchFolder::CollectReady(wxLongLong now, wxArrayString &ready)
+{
+	wxArrayString done;
+	for(WatchFolderPendings::iterator it = mPendings.begin(); it != mPendings.end(); ++it) {
+		WatchFolderPending &pending = it->second;
+		if (now - pending.last < mSettle) {
+			continue;
+		}
+		if (!wxFileName::FileExists(it->first)) {
+			// なくなった
+			done.Add(it->first);
+			continue;
+		}
+		wxLongLong size = wxFileName::GetSize(it->first).GetValue();
+		if (size != pending.size) {
+			pending.size = size;
+			pending.last = now;
+			continue;
+		}
+		done.Add(it->first);
+		ready.Add(it->first);
+	}
+	for(size_t i=0; i<done.Count(); i++) {
+		mPendings.erase(done[i]);
+	}
+	ready.Sort();
+}
+
+/// 書き込みが終わったファイルを待つ
+///
+/// 書き込みが終わったファイルがあるか、時間が過ぎるか、止める要求があるまで待つ。
+/// @param[out] ready        書き込みが終わったファイル
+/// @param[in]  timeout_msec 待つ時間
+/// @return 監視できなくなった場合false
+bool WatchFolder::Wait(wxArrayString &ready, int timeout_msec)
+{
+	ready.Empty();
+	wxLongLong end = Now() + timeout_msec;
+	while(!IsStopRequested()) {
+		wxLongLong now = Now();
+		CollectReady(now, ready);
+		if (!ready.IsEmpty() || now >= end) {
+			break;
+		}
+		// 次のファイルが落ち着くまでか、終わりまで待つ
+		wxLongLong wait = end - now;
+		for(WatchFolderPendings::iterator it = mPendings.begin(); it != mPendings.end(); ++it) {
+			wxLongLong left = it->second.last + mSettle - now;
+			if (left < wait) wait = left;
+		}
+		if (wait < 10) wait = 10;
+#ifdef USE_WATCH_INOTIFY
+		struct pollfd pfd;
+		pfd.fd = mFd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int n = poll(&pfd, 1, (int)wait.GetValue());
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (n > 0) {
+			ReadEvents();
+		}
+#else
+		if (wait > WATCH_FOLDER_POLL_MSEC) wait = WATCH_FOLDER_POLL_MSEC;
+		wxMilliSleep((unsigned long)wait.GetValue());
+		if (Now() - mLastScan >= WATCH_FOLDER_POLL_MSEC) {
+			Scan(true);
+		}
+#endif
+	}
+	return true;
+}
+
+#ifdef USE_WATCH_INOTIFY
+/// ディレクトリ以下を監視に加える
+/// @param[in] dir ディレクトリ
+void WatchFolder::AddWatchTree(const wxString &dir)
+{
+	if (!mIgnoreDir.IsEmpty() && dir == mIgnoreDir) {
+		return;
+	}
+	int wd = inotify_add_watch(mFd, dir.fn_str(),
+		IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR);
+	if (wd < 0) {
+		return;
+	}
+	mWatches[wd] = dir;
+
+	wxDir d(dir);
+	if (!d.IsOpened()) {
+		return;
+	}
+	wxString name;
+	bool cont = d.GetFirst(&name, wxEmptyString, wxDIR_DIRS);
+	while(cont) {
+		AddWatchTree(wxFileName(dir, name).GetFullPath());
+		cont = d.GetNext(&name);
+	}
+}
+
+/// inotifyのイベントを読む
+///
+/// 取りこぼした場合はすべてのファイルを変更があったものとして扱う。
+void WatchFolder::ReadEvents()
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	for(;;) {
+		ssize_t len = read(mFd, buf, sizeof(buf));
+		if (len <= 0) {
+			break;
+		}
+		for(char *p = buf; p < buf + len; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				for(size_t i=0; i<mDirs.Count(); i++) {
+					TouchTree(mDirs[i]);
+				}
+				continue;
+			}
+			if (ev->mask & IN_IGNORED) {
+				mWatches.erase(ev->wd);
+				continue;
+			}
+			WatchFolderDirs::iterator it = mWatches.find(ev->wd);
+			if (it == mWatches.end() || ev->len == 0) {
+				continue;
+			}
+			wxString path = wxFileName(it->second, wxString(ev->name, *wxConvFileName)).GetFullPath();
+			if (ev->mask & IN_ISDIR) {
+				if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+					// 新しいディレクトリとその中身
+					AddWatchTree(path);
+					TouchTree(path);
+				}
+			} else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+				mPendings.erase(path);
+				mHashes.erase(path);
+			} else {
+				Touch(path);
+			}
+		}
+	}
+}
+#else
+/// ディレクトリを調べて変わったファイルを見つける
+/// @param[in] touch 変わったファイルを変更があったものとする
+void WatchFolder::Scan(bool touch)
+{
+	WatchFolderStamps stamps;
+	for(size_t n=0; n<mDirs.Count(); n++) {
+		wxArrayString files;
+		wxDir::GetAllFiles(mDirs[n], &files, wxEmptyString, wxDIR_FILES | wxDIR_DIRS);
+		for(size_t i=0; i<files.Count(); i++) {
+			if (IsIgnored(files[i])) {
+				continue;
+			}
+			wxFileName fn(files[i]);
+			WatchFolderStamp stamp;
+			stamp.mtime = fn.GetModificationTime().GetValue();
+			stamp.size = fn.GetSize().GetValue();
+			stamps[files[i]] = stamp;
+
+			WatchFolderStamps::iterator it = mStamps.find(files[i]);
+			if (touch && (it == mStamps.end() || it->second.mtime != stamp.mtime || it->second.size != stamp.size)) {
+				Touch(files[i]);
+			}
+		}
+	}
+	mStamps = stamps;
+	mLastScan = Now();
+}
+#endif
+
+/// 同じ内容のファイルを変換済みか
+///
+/// 変換に成功したものだけRememberで覚えるので、失敗したファイルは次に書き込まれたときにまた変換する。
+/// @param[in] path ファイルのパス
+/// @param[in] hash 今の内容のハッシュ
+/// @return 前に変換したときと同じ内容ならtrue
+bool WatchFolder::IsConverted(const wxString &path, const wxULongLong &hash) const
+{
+	WatchFolderHashes::const_iterator it = mHashes.find(path);
+	return (it != mHashes.end() && it->second == hash);
+}
+
+/// ハッシュを読み込む
+///
+/// 1行に16進のハッシュとタブとパスを書いたファイル。
+/// 再起動しても変換済みのファイルを変換しなおさないようにする。
+/// @param[in] path ハッシュを保存するファイル
+void WatchFolder::LoadState(const wxString &path)
+{
+	mStatePath = path;
+	wxTextFile file;
+	if (!wxFileName::FileExists(path) || !file.Open(path, wxConvUTF8)) {
+		return;
+	}
+	for(wxString line = file.GetFirstLine(); !file.Eof(); line = file.GetNextLine()) {
+		int pos = line.Find(_T('\t'));
+		if (pos <= 0) continue;
+		wxULongLong_t val;
+		if (!line.Left(pos).ToULongLong(&val, 16)) continue;
+		mHashes[line.Mid(pos + 1)] = wxULongLong(val);
+	}
+}
+
+/// ハッシュを保存する
+/// @return 書けなかった場合false
+bool WatchFolder::SaveState() const
+{
+	if (mStatePath.IsEmpty()) {
+		return true;
+	}
+	wxTextFile file(mStatePath);
+	if (!(wxFileName::FileExists(mStatePath) ? file.Open(wxConvUTF8) : file.Create())) {
+		return false;
+	}
+	file.Clear();
+	for(WatchFolderHashes::const_iterator it = mHashes.begin(); it != mHashes.end(); ++it) {
+		file.AddLine(wxString::Format(_T("%08lx%08lx\t%s"),
+			(unsigned long)it->second.GetHi(), (unsigned long)it->second.GetLo(), it->first));
+	}
+	return file.Write(wxTextFileType_Unix, wxConvUTF8);
+}
+
+/// ファイルの内容のハッシュ(FNV-1a 64bit)
+/// @note 読み込み用の領域は使いまわす
+/// @param[in]  path ファイルのパス
+/// @param[out] hash ハッシュ
+/// @return 読めない場合false
+bool WatchFolder::HashFile(const wxString &path, wxULongLong &hash)
+{
+	wxFile file;
+	if (!file.Open(path)) {
+		return false;
+	}
+	wxULongLong_t h = wxULL(0xcbf29ce484222325);
+	wxUint8 *buf = (wxUint8 *)mReadBuf.GetWriteBuf(65536);
+	for(;;) {
+		ssize_t len = file.Read(buf, 65536);
+		if (len < 0) {
+			return false;
+		}
+		if (len == 0) {
+			break;
+		}
+		for(ssize_t i = 0; i < len; i++) {
+			h ^= buf[i];
+			h *= wxULL(0x100000001b3);
+		}
+	}
+	hash = h;
+	return true;
+}
+
+/// 監視するディレクトリから見たファイルのディレクトリ
+///
+/// 出力先に同じ構成のサブディレクトリを作るのに使う。
+/// 監視するディレクトリが複数ある場合はそのディレクトリ名から始める。
+/// @param[in] path ファイルのパス
+/// @return 相対パス 監視するディレクトリの直下なら空
+wxString WatchFolder::GetRelativeDir(const wxString &path) const
+{
+	for(size_t i=0; i<mDirs.Count(); i++) {
+		if (!path.StartsWith(mDirs[i] + wxFileName::GetPathSeparator())) {
+			continue;
+		}
+		wxFileName fn(path);
+		fn.MakeRelativeTo(mDirs[i]);
+		wxString rel = fn.GetPath();
+		if (mDirs.Count() > 1) {
+			wxString top = wxFileName(mDirs[i]).GetFullName();
+			rel = (rel.IsEmpty() ? top : top + wxFileName::GetPathSeparator() + rel);
+		}
+		return rel;
+	}
+	return wxEmptyString;
+}
+
+/// SIGINT/SIGTERMで止まるようにする
+void WatchFolder::CatchStopSignals()
+{
+	gWatchFolderStop = 0;
+	signal(SIGINT, watch_folder_on_signal);
+#ifdef SIGTERM
+	signal(SIGTERM, watch_folder_on_signal);
+#endif
+}
+
+/// 止める要求があったか
+bool WatchFolder::IsStopRequested()
+{
+	return (gWatchFolderStop != 0);
+}
@@ -0,0 +1,124 @@
+﻿/// @file watchfolder.h
+///
+/// @brief 監視フォルダ
+///
+///
+#ifndef _WATCHFOLDER_H_
+#define _WATCHFOLDER_H_
+
+#include "common.h"
+#include <wx/wx.h>
+#include <wx/hashmap.h>
+#include <wx/stopwatch.h>
+
+#if defined(__LINUX__)
+/// inotifyで変更を受け取る コメントアウトするとディレクトリを定期的に調べる
+#define USE_WATCH_INOTIFY 1
+#endif
+
+/// 書き込みが終わったとみなすまでの時間(msec)
+#define WATCH_FOLDER_SETTLE_MSEC	500
+/// inotifyを使わない場合にディレクトリを調べる間隔(msec)
+#define WATCH_FOLDER_POLL_MSEC		1000
+/// 変換済みのファイルの内容のハッシュを保存するファイル名
+#define WATCH_FOLDER_STATE_FILE		_T(".l3s1basic_watch")
+
+/// 書き込み中のファイル
+typedef struct st_watch_folder_pending {
+	wxLongLong last;	///< 最後に変更を受け取った時刻(msec)
+	wxLongLong size;	///< そのときの長さ
+} WatchFolderPending;
+
+/// 定期的に調べるときのファイルの状態
+typedef struct st_watch_folder_stamp {
+	wxLongLong mtime;	///< 更新時刻(msec)
+	wxLongLong size;	///< 長さ
+} WatchFolderStamp;
+
+WX_DECLARE_STRING_HASH_MAP(WatchFolderPending, WatchFolderPendings);
+WX_DECLARE_STRING_HASH_MAP(WatchFolderStamp, WatchFolderStamps);
+WX_DECLARE_STRING_HASH_MAP(wxULongLong, WatchFolderHashes);
+WX_DECLARE_HASH_MAP(int, wxString, wxIntegerHash, wxIntegerEqual, WatchFolderDirs);
+
+/// 監視フォルダ
+///
+/// ディレクトリ(サブディレクトリも含む)に置かれたファイルや書き換えられたファイルを見つける。
+/// 変更を受け取ってから一定時間変更がなく長さも変わらなくなったものを書き込み済みとして返す。
+/// 内容のハッシュを覚えておき、内容が変わっていないファイルは変換しないようにする。
+class WatchFolder
+{
+private:
+	wxArrayString mDirs;		///< 監視するディレクトリ
+	wxString mIgnoreDir;		///< 無視するディレクトリ (出力先)
+	int mSettle;				///< 書き込みが終わったとみなすまでの時間(msec)
+	wxStopWatch mClock;			///< 時刻
+	WatchFolderPendings mPendings;	///< 書き込み中のファイル
+	WatchFolderHashes mHashes;	///< 変換したファイルの内容のハッシュ
+	wxString mStatePath;		///< ハッシュを保存するファイル
+	wxMemoryBuffer mReadBuf;	///< ハッシュを求めるときの読み込み用
+#ifdef USE_WATCH_INOTIFY
+	int mFd;					///< inotifyの記述子
+	WatchFolderDirs mWatches;	///< 監視番号ごとのディレクトリ
+#else
+	WatchFolderStamps mStamps;	///< ファイルの状態
+	wxLongLong mLastScan;		///< 最後に調べた時刻(msec)
+#endif
+
+	/// 現在の時刻(msec)
+	wxLongLong Now() const { return mClock.TimeInMicro() / 1000; }
+	/// 絶対パスにする
+	static wxString NormalizeDir(const wxString &dir);
+	/// 無視するファイルか
+	bool IsIgnored(const wxString &path) const;
+	/// 変更を受け取った
+	void Touch(const wxString &path);
+	/// ディレクトリ以下のファイルをすべて変更があったものとする
+	void TouchTree(const wxString &dir);
+	/// 書き込みが終わったファイルを集める
+	void CollectReady(wxLongLong now, wxArrayString &ready);
+#ifdef USE_WATCH_INOTIFY
+	/// ディレクトリ以下を監視に加える
+	void AddWatchTree(const wxString &dir);
+	/// inotifyのイベントを読む
+	void ReadEvents();
+#else
+	/// ディレクトリを調べて変わったファイルを見つける
+	void Scan(bool touch);
+#endif
+
+public:
+	WatchFolder();
+	~WatchFolder();
+
+	/// 監視を始める
+	bool Open(const wxArrayString &dirs, const wxString &ignore_dir, int settle_msec = WATCH_FOLDER_SETTLE_MSEC);
+	/// 監視をやめる
+	void Close();
+	/// 書き込みが終わったファイルを待つ
+	bool Wait(wxArrayString &ready, int timeout_msec);
+
+	/// 同じ内容のファイルを変換済みか
+	bool IsConverted(const wxString &path, const wxULongLong &hash) const;
+	/// 変換したファイルのハッシュを覚える
+	void Remember(const wxString &path, const wxULongLong &hash) { mHashes[path] = hash; }
+	/// 覚えたハッシュを忘れる
+	void ForgetHashes() { mHashes.clear(); }
+	/// ハッシュを読み込む
+	void LoadState(const wxString &path);
+	/// ハッシュを保存する
+	bool SaveState() const;
+
+	/// ファイルの内容のハッシュ(FNV-1a 64bit)
+	bool HashFile(const wxString &path, wxULongLong &hash);
+	/// 監視するディレクトリから見たファイルのディレクトリ
+	wxString GetRelativeDir(const wxString &path) const;
+
+	/// SIGINT/SIGTERMで止まるようにする
+	static void CatchStopSignals();
+	/// 止める要求があったか
+	static bool IsStopRequested();
+
+	DECLARE_NO_COPY_CLASS(WatchFolder)
+};
+
+#endif /* _WATCHFOLDER_H_ */